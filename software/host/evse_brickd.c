@@ -0,0 +1,513 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * evse_brickd.c: TCP server that emulates brickd with simulated EVSE Bricklets
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+// Speaks the Tinkerforge IP protocol on a TCP port, so that the normal
+// bindings (tests/tinkerforge) and brickv can be used with simulated
+// EVSE Bricklets. Requests are routed into the handle_message of the
+// host build, the simulation runs in real time (or faster with -x).
+//
+// Like on the real Bricklet the bootloader functions (get_identity,
+// reset, read_uid, ...) are handled outside of handle_message.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "bricklib2/bootloader/bootloader.h"
+#include "bricklib2/protocols/tfp/tfp.h"
+#include "bricklib2/utility/util_definitions.h"
+
+#include "configs/config.h"
+#include "configs/config_custom_bootloader.h"
+#include "communication.h"
+
+#include "host_vehicle.h"
+#include "host_context.h"
+
+#define BRICKD_PORT_DEFAULT            4223
+#define BRICKD_CLIENT_MAX              64
+#define BRICKD_UID_BASE_DEFAULT        100000
+#define BRICKD_CATCH_UP_MAX_MS         100 // If the simulation falls behind by more than this, the time is dropped
+
+#define BRICKD_UID_BROADCAST           0
+#define BRICKD_UID_DAEMON              1
+
+#define BRICKD_FID_DISCONNECT_PROBE    128
+#define BRICKD_FID_CHIP_TEMPERATURE    242
+#define BRICKD_FID_RESET               243
+#define BRICKD_FID_READ_UID            249
+#define BRICKD_FID_ENUMERATE_CALLBACK  253
+#define BRICKD_FID_ENUMERATE           254
+#define BRICKD_FID_GET_IDENTITY        255
+
+#define BRICKD_ERROR_INVALID_PARAMETER 1
+#define BRICKD_ERROR_NOT_SUPPORTED     2
+
+#define BRICKD_ENUMERATION_TYPE_AVAILABLE 0
+#define BRICKD_ENUMERATION_TYPE_CONNECTED 1
+
+typedef struct {
+	TFPMessageHeader header;
+	char uid[8];
+	char connected_uid[8];
+	char position;
+	uint8_t hardware_version[3];
+	uint8_t firmware_version[3];
+	uint16_t device_identifier;
+} __attribute__((__packed__)) BrickdGetIdentity_Response;
+
+typedef struct {
+	BrickdGetIdentity_Response identity;
+	uint8_t enumeration_type;
+} __attribute__((__packed__)) BrickdEnumerate_Callback;
+
+typedef struct {
+	TFPMessageHeader header;
+	int16_t temperature;
+} __attribute__((__packed__)) BrickdGetChipTemperature_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint32_t uid;
+} __attribute__((__packed__)) BrickdReadUID_Response;
+
+typedef struct {
+	int fd;
+	uint8_t buffer[TFP_MESSAGE_MAX_LENGTH];
+	uint8_t buffer_length;
+} BrickdClient;
+
+typedef struct {
+	uint32_t uid;
+	EVSEContext *context;
+	HostVehicle *vehicle;
+	uint32_t reset_count;
+} BrickdCharger;
+
+typedef struct {
+	int listen_fd;
+	BrickdClient clients[BRICKD_CLIENT_MAX];
+	uint32_t client_num;
+
+	BrickdCharger *chargers;
+	uint32_t charger_num;
+	uint32_t uid_base;
+
+	uint32_t speed;
+	uint64_t simulated_ms;
+} Brickd;
+
+static volatile sig_atomic_t brickd_running = 1;
+
+static void brickd_handle_signal(int signal_number) {
+	brickd_running = 0;
+}
+
+static uint64_t brickd_get_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1000ULL + ts.tv_nsec/1000000;
+}
+
+// Same encoding as base58encode in ip_connection.py
+static void brickd_base58_encode(uint32_t value, char *encoded) {
+	const char alphabet[] = "123456789abcdefghijkmnopqrstuvwxyzABCDEFGHJKLMNPQRSTUVWXYZ";
+	char reverse[8];
+	uint8_t length = 0;
+
+	do {
+		reverse[length++] = alphabet[value % 58];
+		value /= 58;
+	} while((value > 0) && (length < sizeof(reverse)));
+
+	memset(encoded, 0, 8);
+	for(uint8_t i = 0; i < length; i++) {
+		encoded[i] = reverse[length - 1 - i];
+	}
+}
+
+static BrickdCharger *brickd_get_charger(Brickd *brickd, const uint32_t uid) {
+	if((uid < brickd->uid_base) || (uid - brickd->uid_base >= brickd->charger_num)) {
+		return NULL;
+	}
+
+	return &brickd->chargers[uid - brickd->uid_base];
+}
+
+static void brickd_client_close(Brickd *brickd, const uint32_t index) {
+	close(brickd->clients[index].fd);
+	brickd->clients[index] = brickd->clients[brickd->client_num - 1];
+	brickd->client_num--;
+}
+
+// Clients are expected to be fast (local test tooling). A client that can't
+// take a whole packet is disconnected, brickd does the same with full send queues.
+static bool brickd_client_send(BrickdClient *client, const void *data, const uint8_t length) {
+	return send(client->fd, data, length, MSG_NOSIGNAL | MSG_DONTWAIT) == length;
+}
+
+static void brickd_broadcast(Brickd *brickd, const void *data, const uint8_t length) {
+	for(uint32_t i = 0; i < brickd->client_num;) {
+		if(brickd_client_send(&brickd->clients[i], data, length)) {
+			i++;
+		} else {
+			brickd_client_close(brickd, i);
+		}
+	}
+}
+
+static void brickd_fill_identity(BrickdCharger *charger, BrickdGetIdentity_Response *identity) {
+	brickd_base58_encode(charger->uid, identity->uid);
+	memset(identity->connected_uid, 0, sizeof(identity->connected_uid));
+	identity->connected_uid[0]    = '0';
+	identity->position            = 'a';
+	identity->hardware_version[0] = BOOTLOADER_HW_VERSION_MAJOR;
+	identity->hardware_version[1] = BOOTLOADER_HW_VERSION_MINOR;
+	identity->hardware_version[2] = BOOTLOADER_HW_VERSION_REVISION;
+	identity->firmware_version[0] = FIRMWARE_VERSION_MAJOR;
+	identity->firmware_version[1] = FIRMWARE_VERSION_MINOR;
+	identity->firmware_version[2] = FIRMWARE_VERSION_REVISION;
+	identity->device_identifier   = BOOTLOADER_DEVICE_IDENTIFIER;
+}
+
+static void brickd_send_enumerate(Brickd *brickd, BrickdClient *client, BrickdCharger *charger, const uint8_t enumeration_type) {
+	BrickdEnumerate_Callback cb;
+	memset(&cb, 0, sizeof(cb));
+	brickd_fill_identity(charger, &cb.identity);
+	cb.identity.header.uid    = charger->uid;
+	cb.identity.header.length = sizeof(cb);
+	cb.identity.header.fid    = BRICKD_FID_ENUMERATE_CALLBACK;
+	cb.enumeration_type       = enumeration_type;
+
+	if(client == NULL) {
+		brickd_broadcast(brickd, &cb, sizeof(cb));
+	} else {
+		brickd_client_send(client, &cb, sizeof(cb));
+	}
+}
+
+// Bootloader part of the protocol, these functions are not in handle_message on the Bricklet either
+static BootloaderHandleMessageResponse brickd_handle_bootloader_message(BrickdCharger *charger, const TFPMessageFull *message, TFPMessageFull *response) {
+	switch(message->header.fid) {
+		case BRICKD_FID_GET_IDENTITY: {
+			brickd_fill_identity(charger, (BrickdGetIdentity_Response*)response);
+			response->header.length = sizeof(BrickdGetIdentity_Response);
+			return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+		}
+
+		case BRICKD_FID_READ_UID: {
+			((BrickdReadUID_Response*)response)->uid = charger->uid;
+			response->header.length = sizeof(BrickdReadUID_Response);
+			return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+		}
+
+		case BRICKD_FID_CHIP_TEMPERATURE: {
+			((BrickdGetChipTemperature_Response*)response)->temperature = 25;
+			response->header.length = sizeof(BrickdGetChipTemperature_Response);
+			return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+		}
+
+		case BRICKD_FID_RESET: {
+			charger->context->hardware.reset_requested = true;
+			return HANDLE_MESSAGE_RESPONSE_EMPTY;
+		}
+
+		default: {
+			host_context_select(charger->context);
+			return handle_message(message, response);
+		}
+	}
+}
+
+static void brickd_handle_request(Brickd *brickd, BrickdClient *client, const TFPMessageFull *message) {
+	const TFPMessageHeader *header = &message->header;
+
+	if(header->uid == BRICKD_UID_BROADCAST) {
+		if(header->fid == BRICKD_FID_ENUMERATE) {
+			for(uint32_t i = 0; i < brickd->charger_num; i++) {
+				brickd_send_enumerate(brickd, client, &brickd->chargers[i], BRICKD_ENUMERATION_TYPE_AVAILABLE);
+			}
+		}
+		// Disconnect probe and unknown broadcasts don't have a response
+		return;
+	}
+
+	TFPMessageFull response;
+	memset(&response, 0, sizeof(response));
+	response.header        = *header;
+	response.header.length = sizeof(TFPMessageHeader);
+
+	BootloaderHandleMessageResponse result = HANDLE_MESSAGE_RESPONSE_NOT_SUPPORTED;
+	BrickdCharger *charger = brickd_get_charger(brickd, header->uid);
+	if(charger != NULL) {
+		result = brickd_handle_bootloader_message(charger, message, &response);
+	} else if(header->uid != BRICKD_UID_DAEMON) {
+		// Unknown device, brickd doesn't answer either (the request times out)
+		return;
+	}
+
+	switch(result) {
+		case HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE:       break;
+		case HANDLE_MESSAGE_RESPONSE_EMPTY:             if(!header->return_expected) { return; } break;
+		case HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER: response.header.error = BRICKD_ERROR_INVALID_PARAMETER; break;
+		case HANDLE_MESSAGE_RESPONSE_NOT_SUPPORTED:     response.header.error = BRICKD_ERROR_NOT_SUPPORTED;     break;
+		default:                                        return;
+	}
+
+	if(response.header.error != 0) {
+		if(!header->return_expected) {
+			return;
+		}
+		response.header.length = sizeof(TFPMessageHeader);
+	}
+
+	brickd_client_send(client, &response, response.header.length);
+}
+
+// Returns false if the client has to be closed
+static bool brickd_client_receive(Brickd *brickd, BrickdClient *client) {
+	const ssize_t length = recv(client->fd, client->buffer + client->buffer_length, sizeof(client->buffer) - client->buffer_length, 0);
+	if(length <= 0) {
+		return (length < 0) && (errno == EINTR);
+	}
+	client->buffer_length += length;
+
+	while(client->buffer_length >= TFP_MESSAGE_MIN_LENGTH) {
+		const uint8_t message_length = tfp_get_length_from_message(client->buffer);
+		if((message_length < TFP_MESSAGE_MIN_LENGTH) || (message_length > TFP_MESSAGE_MAX_LENGTH)) {
+			return false;
+		}
+		if(client->buffer_length < message_length) {
+			break;
+		}
+
+		TFPMessageFull message;
+		memset(&message, 0, sizeof(message));
+		memcpy(&message, client->buffer, message_length);
+		brickd_handle_request(brickd, client, &message);
+
+		memmove(client->buffer, client->buffer + message_length, client->buffer_length - message_length);
+		client->buffer_length -= message_length;
+	}
+
+	return true;
+}
+
+static void brickd_accept(Brickd *brickd) {
+	const int fd = accept(brickd->listen_fd, NULL, NULL);
+	if(fd < 0) {
+		return;
+	}
+
+	if(brickd->client_num >= BRICKD_CLIENT_MAX) {
+		fprintf(stderr, "Too many clients, rejecting connection\n");
+		close(fd);
+		return;
+	}
+
+	const int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	brickd->clients[brickd->client_num].fd            = fd;
+	brickd->clients[brickd->client_num].buffer_length = 0;
+	brickd->client_num++;
+}
+
+static void brickd_step(Brickd *brickd) {
+	for(uint32_t i = 0; i < brickd->charger_num; i++) {
+		BrickdCharger *charger = &brickd->chargers[i];
+		if(charger->vehicle != NULL) {
+			host_vehicle_tick(charger->vehicle, &charger->context->hardware);
+		}
+		host_context_step(charger->context);
+
+		// Callbacks are sent to all clients, as brickd does
+		HostHardware *hardware = &charger->context->hardware;
+		for(uint8_t j = 0; j < hardware->tfp_tx_count; j++) {
+			brickd_broadcast(brickd, hardware->tfp_tx[j], ((TFPMessageHeader*)hardware->tfp_tx[j])->length);
+		}
+		hardware->tfp_tx_count = 0;
+
+		// A Bricklet enumerates itself as connected after a reset
+		if(charger->reset_count != charger->context->hardware.reset_count) {
+			charger->reset_count = charger->context->hardware.reset_count;
+			brickd_send_enumerate(brickd, NULL, charger, BRICKD_ENUMERATION_TYPE_CONNECTED);
+		}
+	}
+
+	brickd->simulated_ms++;
+}
+
+static int brickd_listen(const uint16_t port) {
+	const int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if(fd < 0) {
+		return -1;
+	}
+
+	const int one = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	struct sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family      = AF_INET;
+	address.sin_port        = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+
+	if((bind(fd, (struct sockaddr*)&address, sizeof(address)) < 0) || (listen(fd, 16) < 0)) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static void brickd_run(Brickd *brickd) {
+	struct pollfd fds[BRICKD_CLIENT_MAX + 1];
+	uint64_t last_ms = brickd_get_ms();
+
+	while(brickd_running) {
+		fds[0].fd     = brickd->listen_fd;
+		fds[0].events = POLLIN;
+		for(uint32_t i = 0; i < brickd->client_num; i++) {
+			fds[i + 1].fd     = brickd->clients[i].fd;
+			fds[i + 1].events = POLLIN;
+		}
+
+		const uint32_t fd_num = brickd->client_num + 1;
+		if(poll(fds, fd_num, 1) > 0) {
+			// Handle clients in reverse order, closing a client moves the last one into its place
+			for(uint32_t i = fd_num - 1; i > 0; i--) {
+				if((fds[i].revents != 0) && !brickd_client_receive(brickd, &brickd->clients[i - 1])) {
+					brickd_client_close(brickd, i - 1);
+				}
+			}
+
+			if(fds[0].revents & POLLIN) {
+				brickd_accept(brickd);
+			}
+		}
+
+		const uint64_t now = brickd_get_ms();
+		const uint32_t ms  = MIN(now - last_ms, BRICKD_CATCH_UP_MAX_MS)*brickd->speed;
+		last_ms            = now;
+		for(uint32_t i = 0; i < ms; i++) {
+			brickd_step(brickd);
+		}
+	}
+}
+
+static void brickd_usage(const char *name) {
+	fprintf(stderr, "Usage: %s [-n evse_num] [-p port] [-u uid_base] [-x speed] [-v] [-r seed]\n", name);
+	fprintf(stderr, "  -u  UID of the first EVSE, the others follow consecutively (default %u)\n", BRICKD_UID_BASE_DEFAULT);
+	fprintf(stderr, "  -x  simulated milliseconds per real millisecond (default 1)\n");
+	fprintf(stderr, "  -v  connect a simulated vehicle with random behaviour to each EVSE\n");
+}
+
+int main(int argc, char **argv) {
+	Brickd brickd;
+	memset(&brickd, 0, sizeof(brickd));
+	brickd.charger_num = 1;
+	brickd.uid_base    = BRICKD_UID_BASE_DEFAULT;
+	brickd.speed       = 1;
+
+	uint16_t port      = BRICKD_PORT_DEFAULT;
+	bool with_vehicles = false;
+	unsigned int seed  = 1;
+
+	int option;
+	while((option = getopt(argc, argv, "n:p:u:x:vr:h")) != -1) {
+		switch(option) {
+			case 'n': brickd.charger_num = strtoul(optarg, NULL, 0); break;
+			case 'p': port               = strtoul(optarg, NULL, 0); break;
+			case 'u': brickd.uid_base    = strtoul(optarg, NULL, 0); break;
+			case 'x': brickd.speed       = strtoul(optarg, NULL, 0); break;
+			case 'v': with_vehicles      = true; break;
+			case 'r': seed               = strtoul(optarg, NULL, 0); break;
+			default: brickd_usage(argv[0]); return 1;
+		}
+	}
+
+	if((brickd.charger_num == 0) || (brickd.speed == 0) || (brickd.uid_base <= BRICKD_UID_DAEMON)) {
+		brickd_usage(argv[0]);
+		return 1;
+	}
+
+	brickd.chargers = calloc(brickd.charger_num, sizeof(BrickdCharger));
+	for(uint32_t i = 0; i < brickd.charger_num; i++) {
+		BrickdCharger *charger = &brickd.chargers[i];
+		charger->uid     = brickd.uid_base + i;
+		charger->context = host_context_create();
+		if(charger->context == NULL) {
+			fprintf(stderr, "Could not allocate context %u\n", i);
+			return 1;
+		}
+		charger->context->hardware.uid = charger->uid;
+
+		if(with_vehicles) {
+			HostVehicleConfig config;
+			host_vehicle_get_default_config(&config, (HostVehicleBehaviour)(rand_r(&seed) % HOST_VEHICLE_BEHAVIOUR_NUM));
+			config.plug_in_delay_ms   += rand_r(&seed) % 10000;
+			config.charge_duration_ms += rand_r(&seed) % 60000;
+
+			charger->vehicle = calloc(1, sizeof(HostVehicle));
+			host_vehicle_init(charger->vehicle, &config);
+		}
+	}
+
+	brickd.listen_fd = brickd_listen(port);
+	if(brickd.listen_fd < 0) {
+		fprintf(stderr, "Could not listen on port %u: %s\n", port, strerror(errno));
+		return 1;
+	}
+
+	char first_uid[9] = {0};
+	char last_uid[9]  = {0};
+	brickd_base58_encode(brickd.uid_base, first_uid);
+	brickd_base58_encode(brickd.uid_base + brickd.charger_num - 1, last_uid);
+	printf("Listening on port %u with %u EVSE Bricklets (UID %s to %s)\n", port, brickd.charger_num, first_uid, last_uid);
+
+	signal(SIGINT,  brickd_handle_signal);
+	signal(SIGTERM, brickd_handle_signal);
+	brickd_run(&brickd);
+
+	printf("Simulated %llu ms\n", (unsigned long long)brickd.simulated_ms);
+	for(uint32_t i = 0; i < brickd.client_num; i++) {
+		close(brickd.clients[i].fd);
+	}
+	close(brickd.listen_fd);
+	for(uint32_t i = 0; i < brickd.charger_num; i++) {
+		host_context_destroy(brickd.chargers[i].context);
+		free(brickd.chargers[i].vehicle);
+	}
+	free(brickd.chargers);
+
+	return 0;
+}
@@ -0,0 +1,238 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * evse_drift.c: Replays a temperature trace with synthetic CP drift and compares the resistance measurement
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <math.h>
+
+#include "bricklib2/utility/util_definitions.h"
+
+#include "configs/config_evse.h"
+#include "host_vehicle.h"
+#include "host_context.h"
+
+// The same sessions and temperatures are simulated three times: without drift (reference),
+// with drift but without the drift compensation and with drift and compensation.
+#define DRIFT_RUN_REFERENCE     0
+#define DRIFT_RUN_UNCOMPENSATED 1
+#define DRIFT_RUN_COMPENSATED   2
+#define DRIFT_RUN_NUM           3
+
+#define DRIFT_TRACE_MAX         (64*1024)
+#define DRIFT_SAMPLE_MS         100
+
+// Self-heating of the EVSE while the contactor is closed (first order, on top of the ambient temperature)
+#define DRIFT_HEATING_MAX       25.0   // °C
+#define DRIFT_HEATING_TAU_S     (15*60.0)
+#define DRIFT_DRIFT_REF         25.0   // °C, temperature without drift
+
+typedef struct {
+	uint32_t time_s[DRIFT_TRACE_MAX];
+	float temperature[DRIFT_TRACE_MAX];
+	uint32_t num;
+} DriftTrace;
+
+typedef struct {
+	uint64_t error_sum;
+	uint32_t error_max;
+	uint32_t error_num;
+	uint32_t state_mismatch_ms;
+} DriftResult;
+
+static DriftTrace trace;
+
+// Text file with one "seconds temperature" pair per line, sorted by time. It is replayed in a loop.
+static bool drift_trace_load(const char *path) {
+	FILE *f = fopen(path, "r");
+	if(f == NULL) {
+		return false;
+	}
+
+	char line[128];
+	while((trace.num < DRIFT_TRACE_MAX) && (fgets(line, sizeof(line), f) != NULL)) {
+		unsigned int time_s;
+		float temperature;
+		if((line[0] != '#') && (sscanf(line, "%u %f", &time_s, &temperature) == 2)) {
+			trace.time_s[trace.num]      = time_s;
+			trace.temperature[trace.num] = temperature;
+			trace.num++;
+		}
+	}
+
+	fclose(f);
+	return trace.num >= 2;
+}
+
+// Ambient temperature, linear interpolation between the trace points.
+// Without trace a day with 20°C +- 6°C is used.
+static double drift_get_ambient(const uint32_t time_s) {
+	if(trace.num == 0) {
+		return 20.0 - 6.0*cos(2*M_PI*(time_s % 86400)/86400.0);
+	}
+
+	const uint32_t duration = trace.time_s[trace.num-1] - trace.time_s[0];
+	const uint32_t t = trace.time_s[0] + ((duration > 0) ? (time_s % duration) : 0);
+
+	uint32_t i = 0;
+	while((i < trace.num-2) && (t >= trace.time_s[i+1])) {
+		i++;
+	}
+
+	const double dt = trace.time_s[i+1] - trace.time_s[i];
+	const double f  = (dt > 0) ? (t - trace.time_s[i])/dt : 0;
+	return trace.temperature[i] + (trace.temperature[i+1] - trace.temperature[i])*BETWEEN(0.0, f, 1.0);
+}
+
+static void drift_set_temperature(HostHardware *hardware, const double temperature) {
+	// 14 bit left aligned, 1 LSB = 0.03125°C
+	const int16_t value = (int16_t)lround(temperature*32);
+	hardware->ads1118_input[HOST_ADS1118_INPUT_TEMPERATURE] = (uint16_t)(value*4);
+}
+
+static void drift_print_result(const char *name, const DriftResult *result) {
+	printf("%-13s: mean error %6.2f Ohm, max error %4u Ohm (%u samples in state C), state differs %.1f s\n",
+	       name, result->error_num ? result->error_sum/(double)result->error_num : 0.0, result->error_max,
+	       result->error_num, result->state_mismatch_ms/1000.0);
+}
+
+static void drift_usage(const char *name) {
+	fprintf(stderr, "Usage: %s [-d hours] [-k mV_per_degree] [-c charge_minutes] [-p pause_minutes] [-f trace]\n", name);
+	fprintf(stderr, "  -k  drift of the +-12V CP output over temperature (default 4 mV/°C)\n");
+	fprintf(stderr, "  -f  ambient temperature trace, one \"seconds temperature\" pair per line (default 20°C +- 6°C per day)\n");
+}
+
+int main(int argc, char **argv) {
+	uint32_t duration_h   = 24;
+	double drift_per_degree = 4.0;
+	uint32_t charge_min   = 120;
+	uint32_t pause_min    = 180;
+
+	int option;
+	while((option = getopt(argc, argv, "d:k:c:p:f:h")) != -1) {
+		switch(option) {
+			case 'd': duration_h       = strtoul(optarg, NULL, 0); break;
+			case 'k': drift_per_degree = strtod(optarg, NULL);     break;
+			case 'c': charge_min       = strtoul(optarg, NULL, 0); break;
+			case 'p': pause_min        = strtoul(optarg, NULL, 0); break;
+			case 'f':
+				if(!drift_trace_load(optarg)) {
+					fprintf(stderr, "Could not load trace %s\n", optarg);
+					return 1;
+				}
+				break;
+			default: drift_usage(argv[0]); return 1;
+		}
+	}
+
+	if((duration_h == 0) || (charge_min == 0)) {
+		drift_usage(argv[0]);
+		return 1;
+	}
+
+	// Long sessions, after charging the vehicle stays connected for a while and
+	// is unplugged while the EVSE is still warm (state A with higher temperature)
+	HostVehicleConfig config;
+	host_vehicle_get_default_config(&config, HOST_VEHICLE_BEHAVIOUR_NORMAL);
+	config.plug_in_delay_ms   = pause_min*60*1000;
+	config.charge_duration_ms = charge_min*60*1000;
+	config.unplug_delay_ms    = 10*60*1000;
+
+	EVSEContext *contexts[DRIFT_RUN_NUM];
+	HostVehicle vehicles[DRIFT_RUN_NUM];
+	DriftResult results[DRIFT_RUN_NUM];
+	memset(results, 0, sizeof(results));
+	for(uint8_t i = 0; i < DRIFT_RUN_NUM; i++) {
+		contexts[i] = host_context_create();
+		if(contexts[i] == NULL) {
+			fprintf(stderr, "Could not allocate context %u\n", i);
+			return 1;
+		}
+		host_vehicle_init(&vehicles[i], &config);
+	}
+
+	host_context_select(contexts[DRIFT_RUN_UNCOMPENSATED]);
+	EVSE_CTX(ads1118).cp_drift_compensation_active = false;
+
+	double heating = 0;
+	double temperature = drift_get_ambient(0);
+	const uint64_t duration_ms = duration_h*3600ULL*1000ULL;
+	for(uint64_t time = 0; time < duration_ms; time++) {
+		if(time % 1000 == 0) {
+			// The contactor of all runs should be in the same state, the reference decides
+			const bool relay = host_hardware_get_output(&contexts[DRIFT_RUN_REFERENCE]->hardware, EVSE_RELAY_PIN);
+			heating    += ((relay ? DRIFT_HEATING_MAX : 0) - heating)/DRIFT_HEATING_TAU_S;
+			temperature = drift_get_ambient(time/1000) + heating;
+
+			for(uint8_t i = 0; i < DRIFT_RUN_NUM; i++) {
+				drift_set_temperature(&contexts[i]->hardware, temperature);
+				if(i != DRIFT_RUN_REFERENCE) {
+					contexts[i]->hardware.cp_drift_mv = (int16_t)lround((temperature - DRIFT_DRIFT_REF)*drift_per_degree);
+				}
+			}
+		}
+
+		for(uint8_t i = 0; i < DRIFT_RUN_NUM; i++) {
+			host_vehicle_tick(&vehicles[i], &contexts[i]->hardware);
+			host_context_step(contexts[i]);
+		}
+
+		host_context_select(contexts[DRIFT_RUN_REFERENCE]);
+		const IEC61851State reference_state = EVSE_CTX(iec61851).state;
+		const uint32_t reference_resistance = EVSE_CTX(ads1118).cp_pe_resistance;
+
+		for(uint8_t i = DRIFT_RUN_UNCOMPENSATED; i < DRIFT_RUN_NUM; i++) {
+			host_context_select(contexts[i]);
+			if(EVSE_CTX(iec61851).state != reference_state) {
+				results[i].state_mismatch_ms++;
+			} else if((reference_state == IEC61851_STATE_C) && (time % DRIFT_SAMPLE_MS == 0)) {
+				const uint32_t error = ABS((int32_t)EVSE_CTX(ads1118).cp_pe_resistance - (int32_t)reference_resistance);
+				results[i].error_sum += error;
+				results[i].error_max  = MAX(results[i].error_max, error);
+				results[i].error_num++;
+			}
+		}
+	}
+
+	printf("Simulated %u h, drift %.1f mV/°C, %u sessions\n", duration_h, drift_per_degree, vehicles[DRIFT_RUN_REFERENCE].sessions);
+	drift_print_result("uncompensated", &results[DRIFT_RUN_UNCOMPENSATED]);
+	drift_print_result("compensated",   &results[DRIFT_RUN_COMPENSATED]);
+
+	host_context_select(contexts[DRIFT_RUN_COMPENSATED]);
+	printf("Learned drift %s: %.2f mV/°C\n", EVSE_CTX(ads1118).cp_drift_valid ? "valid" : "not valid (temperature span too small)",
+	       EVSE_CTX(ads1118).cp_drift_slope/(double)(1 << ADS1118_DRIFT_SLOPE_SHIFT));
+
+	const DriftResult *uncompensated = &results[DRIFT_RUN_UNCOMPENSATED];
+	const DriftResult *compensated   = &results[DRIFT_RUN_COMPENSATED];
+	if((uncompensated->error_sum > 0) && (compensated->error_num > 0) && (uncompensated->error_num > 0)) {
+		const double before = uncompensated->error_sum/(double)uncompensated->error_num;
+		const double after  = compensated->error_sum/(double)compensated->error_num;
+		printf("Mean resistance error reduced by %.0f%%\n", 100.0*(before - after)/before);
+	}
+
+	for(uint8_t i = 0; i < DRIFT_RUN_NUM; i++) {
+		host_context_destroy(contexts[i]);
+	}
+
+	return 0;
+}
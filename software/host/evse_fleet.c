@@ -0,0 +1,223 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * evse_fleet.c: Runs many simulated EVSEs in parallel worker threads
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bricklib2/utility/util_definitions.h"
+
+#include "host_vehicle.h"
+#include "host_context.h"
+
+// All workers advance their contexts by FLEET_SYNC_MS and then meet at a barrier,
+// so the simulated time of all EVSEs never differs by more than this.
+#define FLEET_SYNC_MS_DEFAULT 100
+
+typedef struct {
+	EVSEContext **contexts;
+	HostVehicle *vehicles;
+	uint32_t context_num;
+	uint32_t duration_ms;
+	uint32_t sync_ms;
+	pthread_barrier_t *barrier;
+} FleetWorker;
+
+static void *fleet_worker_run(void *argument) {
+	FleetWorker *worker = argument;
+
+	for(uint32_t time = 0; time < worker->duration_ms; time += worker->sync_ms) {
+		for(uint32_t i = 0; i < worker->context_num; i++) {
+			for(uint32_t ms = 0; ms < worker->sync_ms; ms++) {
+				if(worker->vehicles != NULL) {
+					host_vehicle_tick(&worker->vehicles[i], &worker->contexts[i]->hardware);
+				}
+				host_context_step(worker->contexts[i]);
+			}
+		}
+
+		pthread_barrier_wait(worker->barrier);
+	}
+
+	return NULL;
+}
+
+static double fleet_get_seconds(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+// Mix of behaviours with randomized timing, so that the sessions of the fleet don't run in lockstep
+static void fleet_vehicle_init(HostVehicle *vehicle, unsigned int *seed, const int behaviour) {
+	HostVehicleConfig config;
+	host_vehicle_get_default_config(&config, (behaviour >= 0) ? (HostVehicleBehaviour)behaviour : (HostVehicleBehaviour)(rand_r(seed) % HOST_VEHICLE_BEHAVIOUR_NUM));
+
+	config.plug_in_delay_ms   += rand_r(seed) % 10000;
+	config.wake_up_delay_ms   += rand_r(seed) % 2000;
+	config.charge_duration_ms += rand_r(seed) % 60000;
+
+	host_vehicle_init(vehicle, &config);
+}
+
+static void fleet_print_vehicle_summary(HostVehicle *vehicles, const uint32_t context_num, const uint32_t duration_s) {
+	uint32_t sessions[HOST_VEHICLE_BEHAVIOUR_NUM]         = {0};
+	uint32_t sessions_charged[HOST_VEHICLE_BEHAVIOUR_NUM] = {0};
+	uint32_t sessions_failed[HOST_VEHICLE_BEHAVIOUR_NUM]  = {0};
+	uint32_t interruptions = 0;
+	uint64_t charge_time   = 0;
+	const char *names[HOST_VEHICLE_BEHAVIOUR_NUM] = {"normal", "id3 spike", "stop charging", "diode fault", "ventilation"};
+
+	for(uint32_t i = 0; i < context_num; i++) {
+		const HostVehicleBehaviour behaviour = vehicles[i].config.behaviour;
+		sessions[behaviour]         += vehicles[i].sessions;
+		sessions_charged[behaviour] += vehicles[i].sessions_charged;
+		sessions_failed[behaviour]  += vehicles[i].sessions_failed;
+		interruptions               += vehicles[i].contactor_interruptions;
+		charge_time                 += vehicles[i].charge_time_ms;
+	}
+
+	uint32_t sessions_sum = 0;
+	for(uint8_t i = 0; i < HOST_VEHICLE_BEHAVIOUR_NUM; i++) {
+		sessions_sum += sessions[i];
+		if(sessions[i] > 0) {
+			printf("Vehicles %-13s: %5u sessions, %5u charged, %5u failed\n", names[i], sessions[i], sessions_charged[i], sessions_failed[i]);
+		}
+	}
+	printf("Sessions: %u (%.0f per simulated minute), charge time %.1f h, contactor interruptions %u\n",
+	       sessions_sum, sessions_sum*60.0/duration_s, charge_time/3600000.0, interruptions);
+}
+
+static void fleet_print_summary(EVSEContext **contexts, const uint32_t context_num) {
+	uint32_t states[5]  = {0};
+	uint32_t errors     = 0;
+	uint32_t resets     = 0;
+
+	for(uint32_t i = 0; i < context_num; i++) {
+		host_context_select(contexts[i]);
+		states[EVSE_CTX(iec61851).state % 5]++;
+		errors += (EVSE_CTX(led).state == LED_STATE_BLINKING) ? 1 : 0;
+		resets += contexts[i]->hardware.reset_count;
+	}
+
+	printf("IEC 61851 state: A %u, B %u, C %u, D %u, EF %u\n", states[0], states[1], states[2], states[3], states[4]);
+	printf("Error (LED blinking): %u, resets: %u\n", errors, resets);
+}
+
+static void fleet_usage(const char *name) {
+	fprintf(stderr, "Usage: %s [-n evse_num] [-t thread_num] [-d seconds] [-s sync_ms] [-v] [-b behaviour] [-r seed]\n", name);
+	fprintf(stderr, "  -v  connect a simulated vehicle to each EVSE\n");
+	fprintf(stderr, "  -b  use only one vehicle behaviour (0 normal, 1 id3 spike, 2 stop charging, 3 diode fault, 4 ventilation)\n");
+}
+
+int main(int argc, char **argv) {
+	uint32_t context_num = 100;
+	uint32_t thread_num  = sysconf(_SC_NPROCESSORS_ONLN);
+	uint32_t duration_s  = 60;
+	uint32_t sync_ms     = FLEET_SYNC_MS_DEFAULT;
+	bool with_vehicles   = false;
+	int behaviour        = -1;
+	unsigned int seed    = 1;
+
+	int option;
+	while((option = getopt(argc, argv, "n:t:d:s:vb:r:h")) != -1) {
+		switch(option) {
+			case 'n': context_num = strtoul(optarg, NULL, 0); break;
+			case 't': thread_num  = strtoul(optarg, NULL, 0); break;
+			case 'd': duration_s  = strtoul(optarg, NULL, 0); break;
+			case 's': sync_ms     = strtoul(optarg, NULL, 0); break;
+			case 'v': with_vehicles = true; break;
+			case 'b': behaviour   = strtol(optarg, NULL, 0); with_vehicles = true; break;
+			case 'r': seed        = strtoul(optarg, NULL, 0); break;
+			default: fleet_usage(argv[0]); return 1;
+		}
+	}
+
+	if((context_num == 0) || (thread_num == 0) || (sync_ms == 0) || (behaviour >= HOST_VEHICLE_BEHAVIOUR_NUM)) {
+		fleet_usage(argv[0]);
+		return 1;
+	}
+	thread_num = MIN(thread_num, context_num);
+
+	EVSEContext **contexts = calloc(context_num, sizeof(EVSEContext*));
+	for(uint32_t i = 0; i < context_num; i++) {
+		contexts[i] = host_context_create();
+		if(contexts[i] == NULL) {
+			fprintf(stderr, "Could not allocate context %u\n", i);
+			return 1;
+		}
+	}
+
+	HostVehicle *vehicles = NULL;
+	if(with_vehicles) {
+		vehicles = calloc(context_num, sizeof(HostVehicle));
+		for(uint32_t i = 0; i < context_num; i++) {
+			fleet_vehicle_init(&vehicles[i], &seed, behaviour);
+		}
+	}
+
+	pthread_barrier_t barrier;
+	pthread_barrier_init(&barrier, NULL, thread_num);
+
+	FleetWorker *workers = calloc(thread_num, sizeof(FleetWorker));
+	pthread_t *threads   = calloc(thread_num, sizeof(pthread_t));
+
+	const double start = fleet_get_seconds();
+	for(uint32_t i = 0; i < thread_num; i++) {
+		const uint32_t first = i*context_num/thread_num;
+		const uint32_t last  = (i + 1)*context_num/thread_num;
+
+		workers[i].contexts    = &contexts[first];
+		workers[i].vehicles    = (vehicles != NULL) ? &vehicles[first] : NULL;
+		workers[i].context_num = last - first;
+		workers[i].duration_ms = duration_s*1000;
+		workers[i].sync_ms     = sync_ms;
+		workers[i].barrier     = &barrier;
+		pthread_create(&threads[i], NULL, fleet_worker_run, &workers[i]);
+	}
+
+	for(uint32_t i = 0; i < thread_num; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	const double elapsed = fleet_get_seconds() - start;
+
+	printf("Simulated %u EVSEs for %u s with %u threads in %.2f s (%.0fx real time per EVSE)\n",
+	       context_num, duration_s, thread_num, elapsed, duration_s*(double)context_num/elapsed);
+	fleet_print_summary(contexts, context_num);
+	if(vehicles != NULL) {
+		fleet_print_vehicle_summary(vehicles, context_num, duration_s);
+	}
+
+	for(uint32_t i = 0; i < context_num; i++) {
+		host_context_destroy(contexts[i]);
+	}
+	pthread_barrier_destroy(&barrier);
+	free(workers);
+	free(threads);
+	free(contexts);
+	free(vehicles);
+
+	return 0;
+}
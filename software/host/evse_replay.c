@@ -0,0 +1,245 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * evse_replay.c: Replays a flight recorder CSV through iec61851_tick and compares the result
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <getopt.h>
+
+#include "recorder.h"
+#include "host_context.h"
+
+#define REPLAY_ENTRY_MAX   (64*1024)
+#define REPLAY_LINE_LENGTH 512
+
+// Columns of recorder.csv as written by tests/recorder.py
+typedef enum {
+	REPLAY_COLUMN_TIME = 0,
+	REPLAY_COLUMN_CP_PE_RESISTANCE,
+	REPLAY_COLUMN_PP_PE_RESISTANCE,
+	REPLAY_COLUMN_CP_DUTY_CYCLE,
+	REPLAY_COLUMN_MAX_CURRENT,
+	REPLAY_COLUMN_RELAY,
+	REPLAY_COLUMN_CP_INVALID,
+	REPLAY_COLUMN_CALIBRATION,
+	REPLAY_COLUMN_CONTACTOR_ERROR,
+	REPLAY_COLUMN_JUMPER_CONFIGURATION,
+	REPLAY_COLUMN_IEC61851_STATE,
+	REPLAY_COLUMN_NUM
+} ReplayColumn;
+
+static const char *replay_column_names[REPLAY_COLUMN_NUM] = {
+	"time", "cp_pe_resistance", "pp_pe_resistance", "cp_duty_cycle", "max_current", "relay",
+	"cp_invalid", "calibration", "contactor_error", "jumper_configuration", "iec61851_state"
+};
+
+typedef struct {
+	uint32_t value[REPLAY_COLUMN_NUM];
+} ReplayEntry;
+
+static ReplayEntry entries[REPLAY_ENTRY_MAX];
+static uint32_t entry_num;
+
+// Python writes booleans as True/False
+static uint32_t replay_parse_value(const char *field) {
+	if(strcasecmp(field, "true") == 0) {
+		return 1;
+	}
+	if(strcasecmp(field, "false") == 0) {
+		return 0;
+	}
+
+	return strtoul(field, NULL, 0);
+}
+
+static bool replay_load(const char *path) {
+	FILE *f = fopen(path, "r");
+	if(f == NULL) {
+		return false;
+	}
+
+	// Maps the CSV columns to the replay columns by the names in the header
+	int8_t mapping[32];
+	uint8_t mapping_num = 0;
+	uint32_t found      = 0;
+
+	char line[REPLAY_LINE_LENGTH];
+	bool header = true;
+	while((entry_num < REPLAY_ENTRY_MAX) && (fgets(line, sizeof(line), f) != NULL)) {
+		line[strcspn(line, "\r\n")] = '\0';
+		if(line[0] == '\0') {
+			continue;
+		}
+
+		uint8_t column = 0;
+		for(char *field = strtok(line, ","); (field != NULL) && (column < 32); field = strtok(NULL, ","), column++) {
+			if(header) {
+				mapping[column] = -1;
+				for(uint8_t i = 0; i < REPLAY_COLUMN_NUM; i++) {
+					if(strcmp(field, replay_column_names[i]) == 0) {
+						mapping[column] = i;
+						found |= 1 << i;
+					}
+				}
+				mapping_num = column + 1;
+			} else if((column < mapping_num) && (mapping[column] >= 0)) {
+				entries[entry_num].value[mapping[column]] = replay_parse_value(field);
+			}
+		}
+
+		if(header) {
+			header = false;
+			if(found != (1 << REPLAY_COLUMN_NUM) - 1) {
+				fprintf(stderr, "%s does not have all recorder columns\n", path);
+				fclose(f);
+				return false;
+			}
+		} else {
+			entry_num++;
+		}
+	}
+
+	fclose(f);
+	return entry_num > 0;
+}
+
+// The external inputs of the state machine. The relay and the CP duty cycle are outputs,
+// they are set by the replayed state machine itself and compared with the recording.
+static void replay_set_inputs(const ReplayEntry *entry, const bool cp_invalid) {
+	EVSE_CTX(ads1118).cp_pe_resistance   = entry->value[REPLAY_COLUMN_CP_PE_RESISTANCE];
+	EVSE_CTX(ads1118).pp_pe_resistance   = entry->value[REPLAY_COLUMN_PP_PE_RESISTANCE];
+	EVSE_CTX(ads1118).cp_invalid_counter = cp_invalid ? 1 : 0;
+
+	// The recorded max current is the minimum of all active slots, one slot is enough to reproduce it
+	for(uint8_t i = 0; i < CHARGING_SLOT_NUM; i++) {
+		EVSE_CTX(charging_slot).active[i]              = false;
+		EVSE_CTX(charging_slot).clear_on_disconnect[i] = false;
+	}
+	EVSE_CTX(charging_slot).active[CHARGING_SLOT_INCOMING_CABLE]      = true;
+	EVSE_CTX(charging_slot).max_current[CHARGING_SLOT_INCOMING_CABLE] = (uint16_t)entry->value[REPLAY_COLUMN_MAX_CURRENT];
+
+	EVSE_CTX(button).was_pressed           = false;
+	contactor_check.error                  = (uint8_t)entry->value[REPLAY_COLUMN_CONTACTOR_ERROR];
+	EVSE_CTX(evse).config_jumper_current   = (uint8_t)entry->value[REPLAY_COLUMN_JUMPER_CONFIGURATION];
+	EVSE_CTX(evse).calibration_state       = entry->value[REPLAY_COLUMN_CALIBRATION] ? 1 : 0;
+}
+
+static void replay_usage(const char *name) {
+	fprintf(stderr, "Usage: %s [-v] recorder.csv\n", name);
+	fprintf(stderr, "  -v  print every entry, not only the differences\n");
+}
+
+int main(int argc, char **argv) {
+	bool verbose = false;
+
+	int option;
+	while((option = getopt(argc, argv, "vh")) != -1) {
+		switch(option) {
+			case 'v': verbose = true; break;
+			default: replay_usage(argv[0]); return 1;
+		}
+	}
+
+	if(optind != argc - 1) {
+		replay_usage(argv[0]);
+		return 1;
+	}
+
+	if(!replay_load(argv[optind])) {
+		fprintf(stderr, "Could not load %s\n", argv[optind]);
+		return 1;
+	}
+
+	EVSEContext *context = host_context_create();
+	if(context == NULL) {
+		fprintf(stderr, "Could not allocate context\n");
+		return 1;
+	}
+
+	// Start in the recorded state. Timers of the state machine from before
+	// the first entry (e.g. the 30s hold-off after an error) are not known.
+	const ReplayEntry *first = &entries[0];
+	context->hardware.time_ms = first->value[REPLAY_COLUMN_TIME];
+	replay_set_inputs(first, false);
+	evse_set_output((uint16_t)first->value[REPLAY_COLUMN_CP_DUTY_CYCLE], first->value[REPLAY_COLUMN_RELAY]);
+	EVSE_CTX(iec61851).state             = (IEC61851State)first->value[REPLAY_COLUMN_IEC61851_STATE];
+	EVSE_CTX(iec61851).last_state_change = context->hardware.time_ms;
+
+	uint32_t differences = 0;
+	for(uint32_t i = 0; i < entry_num; i++) {
+		const ReplayEntry *entry    = &entries[i];
+		const ReplayEntry *previous = &entries[(i > 0) ? (i - 1) : 0];
+		const uint32_t end          = (i + 1 < entry_num) ? entries[i+1].value[REPLAY_COLUMN_TIME] : entry->value[REPLAY_COLUMN_TIME] + 1;
+
+		// The recorded CP invalid flag is taken after iec61851_tick. If the tick changed an
+		// output it was not skipped, the flag was then set by the output change itself.
+		const bool outputs_changed = (entry->value[REPLAY_COLUMN_RELAY] != previous->value[REPLAY_COLUMN_RELAY]) ||
+		                             (entry->value[REPLAY_COLUMN_CP_DUTY_CYCLE] != previous->value[REPLAY_COLUMN_CP_DUTY_CYCLE]);
+
+		// The inputs are held until the next entry, the recorder adds an entry on every change
+		for(uint32_t time = entry->value[REPLAY_COLUMN_TIME]; (int32_t)(time - end) < 0; time++) {
+			context->hardware.time_ms = time;
+			replay_set_inputs(entry, entry->value[REPLAY_COLUMN_CP_INVALID] && !(outputs_changed && (time == entry->value[REPLAY_COLUMN_TIME])));
+			iec61851_tick();
+
+			// Only the tick at the time of the entry can be compared
+			if(time != entry->value[REPLAY_COLUMN_TIME]) {
+				continue;
+			}
+
+			const bool state_ok = EVSE_CTX(iec61851).state == entry->value[REPLAY_COLUMN_IEC61851_STATE];
+			const bool relay_ok = evse_is_relay_active() == (bool)entry->value[REPLAY_COLUMN_RELAY];
+			const bool duty_ok  = evse_get_cp_duty_cycle() == entry->value[REPLAY_COLUMN_CP_DUTY_CYCLE];
+			if(verbose || !state_ok || !relay_ok || !duty_ok) {
+				printf("%10u ms: state %u/%u relay %u/%u duty cycle %4u/%4u%s\n", time,
+				       entry->value[REPLAY_COLUMN_IEC61851_STATE], EVSE_CTX(iec61851).state,
+				       entry->value[REPLAY_COLUMN_RELAY], evse_is_relay_active(),
+				       entry->value[REPLAY_COLUMN_CP_DUTY_CYCLE], evse_get_cp_duty_cycle(),
+				       (state_ok && relay_ok && duty_ok) ? "" : " (recorded/replayed differ)");
+			}
+
+			if(!state_ok || !relay_ok || !duty_ok) {
+				differences++;
+
+				// Continue from the recorded state and outputs, otherwise one difference is repeated in all
+				// following entries. The firmware clears the hold-off timers when it enters state C.
+				const IEC61851State state = (IEC61851State)entry->value[REPLAY_COLUMN_IEC61851_STATE];
+				if((state == IEC61851_STATE_C) && (EVSE_CTX(iec61851).state != IEC61851_STATE_C)) {
+					EVSE_CTX(iec61851).last_error_time       = 0;
+					EVSE_CTX(iec61851).last_state_c_end_time = 0;
+				}
+				if(state != EVSE_CTX(iec61851).state) {
+					EVSE_CTX(iec61851).last_state_change = time;
+				}
+				EVSE_CTX(iec61851).state = state;
+				evse_set_output((uint16_t)entry->value[REPLAY_COLUMN_CP_DUTY_CYCLE], entry->value[REPLAY_COLUMN_RELAY]);
+			}
+		}
+	}
+
+	printf("Replayed %u entries (%.1f s), %u differ\n", entry_num,
+	       (entries[entry_num-1].value[REPLAY_COLUMN_TIME] - first->value[REPLAY_COLUMN_TIME])/1000.0, differences);
+
+	host_context_destroy(context);
+
+	return (differences == 0) ? 0 : 1;
+}
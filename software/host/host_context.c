@@ -0,0 +1,147 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * host_context.c: Create, step and reset EVSE contexts on the host
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "configs/config.h"
+#include "bricklib2/warp/contactor_check.h"
+#include "communication.h"
+#include "evse.h"
+#include "ads1118.h"
+#include "iec61851.h"
+#include "lock.h"
+#include "led.h"
+#include "button.h"
+#include "step_timer.h"
+#include "charging_slot.h"
+#include "recorder.h"
+#include "journal.h"
+#include "scheduler.h"
+#include "logring.h"
+#include "configs/config_step_timer.h"
+#include "host_context.h"
+
+__thread EVSEContext *evse_context_current = NULL;
+
+void host_context_select(EVSEContext *context) {
+	evse_context_current = context;
+}
+
+// Same order as in main.c
+static void host_context_init_modules(void) {
+	logring_init();
+
+	scheduler_init();
+	communication_init();
+	recorder_init();
+	lock_init();
+	derating_init();
+	evse_init();
+	journal_init();
+	journal_add(JOURNAL_EVENT_BOOT, EVSE_CTX(evse).warm_start, (FIRMWARE_VERSION_MAJOR << 16) | (FIRMWARE_VERSION_MINOR << 8) | FIRMWARE_VERSION_REVISION);
+	charging_slot_init();
+	ads1118_init();
+	iec61851_init();
+	contactor_check_init();
+	led_init();
+	button_init();
+	step_timer_init();
+}
+
+EVSEContext *host_context_create(void) {
+	EVSEContext *context = calloc(1, sizeof(EVSEContext));
+	if(context == NULL) {
+		return NULL;
+	}
+
+	host_hardware_init(&context->hardware);
+	host_context_select(context);
+	host_context_init_modules();
+
+	return context;
+}
+
+void host_context_destroy(EVSEContext *context) {
+	if(evse_context_current == context) {
+		evse_context_current = NULL;
+	}
+
+	free(context);
+}
+
+// RAM is lost, the hardware keeps EEPROM, flash and external inputs
+static void host_context_reset(EVSEContext *context) {
+	HostHardware hardware = context->hardware;
+	memset(context, 0, sizeof(EVSEContext));
+	context->hardware = hardware;
+	host_hardware_reset(&context->hardware);
+
+	host_context_select(context);
+	host_context_init_modules();
+}
+
+void host_context_reboot(EVSEContext *context) {
+	context->hardware.noinit_warm_start_marker = 0;
+	host_context_reset(context);
+}
+
+void host_context_step(EVSEContext *context) {
+	host_context_select(context);
+
+	// Same order as the main loop in main.c
+	bootloader_tick();
+	communication_tick();
+	evse_tick();
+	if(scheduler_is_due(SCHEDULER_TASK_ADS1118)) {
+		ads1118_tick();
+	}
+#ifdef LOCK_ENABLE
+	if(scheduler_is_due(SCHEDULER_TASK_LOCK)) {
+		lock_tick();
+	}
+#endif
+	contactor_check_tick();
+	if(scheduler_is_due(SCHEDULER_TASK_LED)) {
+		led_tick();
+	}
+	if(scheduler_is_due(SCHEDULER_TASK_BUTTON)) {
+		button_tick();
+	}
+	if(scheduler_is_due(SCHEDULER_TASK_CHARGING_SLOT)) {
+		charging_slot_tick();
+	}
+	if(scheduler_is_due(SCHEDULER_TASK_DERATING)) {
+		derating_tick();
+	}
+	if(scheduler_is_due(SCHEDULER_TASK_JOURNAL)) {
+		journal_tick();
+	}
+
+	context->hardware.time_ms++;
+
+	// The period match interrupt of the step timer
+	STEP_TIMER_IRQ_HANDLER();
+
+	if(context->hardware.reset_requested) {
+		host_context_reset(context);
+	}
+}
@@ -0,0 +1,42 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * host_context.h: Create, step and reset EVSE contexts on the host
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef HOST_CONTEXT_H
+#define HOST_CONTEXT_H
+
+#include <stdint.h>
+
+#include "context.h"
+
+// A context may only be stepped by one thread at a time. All firmware
+// functions work on the context that was selected last in the calling thread.
+void host_context_select(EVSEContext *context);
+
+EVSEContext *host_context_create(void);
+void host_context_destroy(EVSEContext *context);
+
+// Runs one main loop iteration and advances the simulated time by 1ms
+void host_context_step(EVSEContext *context);
+
+// Power cycle, EEPROM and journal flash are retained
+void host_context_reboot(EVSEContext *context);
+
+#endif
@@ -0,0 +1,67 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * host_coop_task.c: Cooperative tasks on the host with ucontext
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "bricklib2/os/coop_task.h"
+
+#include <string.h>
+
+#include "bricklib2/hal/system_timer/system_timer.h"
+
+// Task that is currently running in this thread (NULL if we are in the main loop)
+static __thread CoopTask *coop_task_current = NULL;
+
+static void coop_task_entry(void) {
+	coop_task_current->function();
+
+	// Task functions never return on the firmware, if one does we stay parked here
+	while(true) {
+		coop_task_yield();
+	}
+}
+
+void coop_task_init(CoopTask *task, CoopTaskFunction function) {
+	memset(task, 0, sizeof(CoopTask));
+	task->function = function;
+
+	getcontext(&task->context);
+	task->context.uc_stack.ss_sp   = task->stack;
+	task->context.uc_stack.ss_size = sizeof(task->stack);
+	task->context.uc_link          = NULL;
+	makecontext(&task->context, coop_task_entry, 0);
+}
+
+void coop_task_tick(CoopTask *task) {
+	coop_task_current = task;
+	swapcontext(&task->caller_context, &task->context);
+	coop_task_current = NULL;
+}
+
+void coop_task_yield(void) {
+	CoopTask *task = coop_task_current;
+	swapcontext(&task->context, &task->caller_context);
+}
+
+void coop_task_sleep_ms(const uint32_t sleep) {
+	const uint32_t start = system_timer_get_ms();
+	while(!system_timer_is_time_elapsed_ms(start, sleep)) {
+		coop_task_yield();
+	}
+}
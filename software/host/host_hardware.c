@@ -0,0 +1,418 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * host_hardware.c: Simulated peripherals of one EVSE
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "host_hardware.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "xmc_gpio.h"
+#include "xmc_ccu4.h"
+#include "xmc_flash.h"
+#include "bricklib2/hal/system_timer/system_timer.h"
+#include "bricklib2/hal/ccu4_pwm/ccu4_pwm.h"
+#include "bricklib2/hal/spi_fifo/spi_fifo.h"
+#include "bricklib2/hal/uartbb/uartbb.h"
+#include "bricklib2/bootloader/bootloader.h"
+#include "bricklib2/protocols/tfp/tfp.h"
+#include "bricklib2/utility/moving_average.h"
+#include "bricklib2/utility/util_definitions.h"
+#include "bricklib2/warp/contactor_check.h"
+#include "bricklib2/utility/communication_callback.h"
+
+#include "configs/config_evse.h"
+#include "configs/config_ads1118.h"
+#include "configs/config_contactor_check.h"
+#include "ads1118.h"
+#include "memory_usage.h"
+#include "communication.h"
+#include "context.h"
+
+#define hardware (EVSE_CONTEXT.hardware)
+
+XMC_GPIO_PORT_t host_gpio_port[3]     = {{0}, {1}, {2}};
+XMC_CCU4_MODULE_t host_ccu4_module[1] = {{0}};
+XMC_CCU4_SLICE_t host_ccu4_slice[4]   = {{0}, {1}, {2}, {3}};
+
+void host_hardware_init(HostHardware *hw) {
+	memset(hw, 0, sizeof(HostHardware));
+	hw->time_ms = HOST_HARDWARE_BOOT_TIME_MS;
+
+	for(uint8_t port = 0; port < HOST_GPIO_PORT_NUM; port++) {
+		for(uint8_t pin = 0; pin < HOST_GPIO_PIN_NUM; pin++) {
+			hw->gpio_external[port][pin] = HOST_GPIO_FLOATING;
+		}
+	}
+
+	// Jumper: pin 0 open, pin 1 low (32A)
+	host_hardware_set_input(hw, EVSE_CONFIG_JUMPER_PIN1, 0);
+
+	// Shutdown input/button not pressed
+	host_hardware_set_input(hw, EVSE_INPUT_GP_PIN, 0);
+
+	hw->ads1118_input[ADS1118_CONFIG_INP_IS_IN1_AND_INN_IS_GND >> 12] = HOST_ADS1118_CODE_CP_12V;
+	hw->ads1118_input[ADS1118_CONFIG_INP_IS_IN2_AND_INN_IS_IN3 >> 12] = HOST_ADS1118_CODE_PP_OPEN;
+	hw->ads1118_input[HOST_ADS1118_INPUT_TEMPERATURE]                 = (25*32) << 2; // 25°C, 14 bit left aligned
+}
+
+// Everything that is not retained over a reset of the MCU is cleared,
+// the external inputs are not touched (the car and jumpers are still there).
+void host_hardware_reset(HostHardware *hw) {
+	hw->time_ms = HOST_HARDWARE_BOOT_TIME_MS;
+
+	memset(hw->gpio_mode,   0, sizeof(hw->gpio_mode));
+	memset(hw->gpio_output, 0, sizeof(hw->gpio_output));
+	memset(hw->pwm_period,  0, sizeof(hw->pwm_period));
+	memset(hw->pwm_compare, 0, sizeof(hw->pwm_compare));
+
+	hw->ads1118_config           = 0;
+	hw->ads1118_conversion_start = 0;
+	hw->ads1118_result           = 0;
+
+	hw->tfp_tx_count             = 0;
+	hw->reset_requested          = false;
+	hw->reset_count++;
+}
+
+bool host_hardware_get_output(const HostHardware *hw, XMC_GPIO_PORT_t *const port, const uint8_t pin) {
+	return hw->gpio_output[port->number][pin];
+}
+
+void host_hardware_set_input(HostHardware *hw, XMC_GPIO_PORT_t *const port, const uint8_t pin, const int8_t level) {
+	hw->gpio_external[port->number][pin] = level;
+}
+
+// --- Core ---
+
+void NVIC_SystemReset(void) {
+	// Carried out by host_context_step after the current main loop iteration
+	hardware.reset_requested = true;
+}
+
+// --- GPIO ---
+
+static uint32_t host_ads1118_get_drdy(void);
+
+void XMC_GPIO_Init(XMC_GPIO_PORT_t *const port, const uint8_t pin, const XMC_GPIO_CONFIG_t *const config) {
+	hardware.gpio_mode[port->number][pin]   = config->mode;
+	hardware.gpio_output[port->number][pin] = config->output_level;
+}
+
+uint32_t XMC_GPIO_GetInput(XMC_GPIO_PORT_t *const port, const uint8_t pin) {
+	// DOUT/DRDY of the ADS1118
+	if((port == ADS1118_MISO_PORT) && (pin == ADS1118_MISO_PIN)) {
+		return host_ads1118_get_drdy();
+	}
+
+	const uint32_t mode = hardware.gpio_mode[port->number][pin];
+	if(XMC_GPIO_MODE_IS_OUTPUT(mode)) {
+		return hardware.gpio_output[port->number][pin];
+	}
+
+	if(hardware.gpio_external[port->number][pin] != HOST_GPIO_FLOATING) {
+		return hardware.gpio_external[port->number][pin];
+	}
+
+	return mode == XMC_GPIO_MODE_INPUT_PULL_UP;
+}
+
+void XMC_GPIO_SetOutputHigh(XMC_GPIO_PORT_t *const port, const uint8_t pin) {
+	hardware.gpio_output[port->number][pin] = 1;
+}
+
+void XMC_GPIO_SetOutputLow(XMC_GPIO_PORT_t *const port, const uint8_t pin) {
+	hardware.gpio_output[port->number][pin] = 0;
+}
+
+// --- CCU4/PWM ---
+
+void XMC_CCU4_SLICE_SetTimerCompareMatch(XMC_CCU4_SLICE_t *const slice, const uint16_t compare_value) {
+	hardware.pwm_compare[slice->number] = compare_value;
+}
+
+void XMC_CCU4_EnableShadowTransfer(XMC_CCU4_MODULE_t *const module, const uint32_t shadow_transfer_msk) {
+	// Compare values are taken over immediately on the host
+}
+
+// Timer configuration has no effect, host_context_step calls the interrupt handlers every ms
+
+void XMC_CCU4_SLICE_CompareInit(XMC_CCU4_SLICE_t *const slice, const XMC_CCU4_SLICE_COMPARE_CONFIG_t *const config) {}
+void XMC_CCU4_SLICE_SetTimerPeriodMatch(XMC_CCU4_SLICE_t *const slice, const uint16_t period_value) {}
+void XMC_CCU4_SLICE_EnableEvent(XMC_CCU4_SLICE_t *const slice, const XMC_CCU4_SLICE_IRQ_ID_t event) {}
+void XMC_CCU4_SLICE_SetInterruptNode(XMC_CCU4_SLICE_t *const slice, const XMC_CCU4_SLICE_IRQ_ID_t event, const XMC_CCU4_SLICE_SR_ID_t sr) {}
+void XMC_CCU4_SLICE_StartTimer(XMC_CCU4_SLICE_t *const slice) {}
+void XMC_CCU4_EnableClock(XMC_CCU4_MODULE_t *const module, const uint8_t slice_number) {}
+void NVIC_SetPriority(const int32_t irq, const uint32_t priority) {}
+void NVIC_EnableIRQ(const int32_t irq) {}
+
+void ccu4_pwm_init(XMC_GPIO_PORT_t *const port, const uint8_t pin, const uint8_t ccu4_slice_number, const uint16_t period_value) {
+	const XMC_GPIO_CONFIG_t config = {
+		.mode         = XMC_GPIO_MODE_OUTPUT_PUSH_PULL_ALT6,
+		.output_level = XMC_GPIO_OUTPUT_LEVEL_LOW,
+	};
+	XMC_GPIO_Init(port, pin, &config);
+
+	hardware.pwm_period[ccu4_slice_number]  = period_value;
+	hardware.pwm_compare[ccu4_slice_number] = period_value + 1;
+}
+
+void ccu4_pwm_set_duty_cycle(const uint8_t ccu4_slice_number, const uint16_t duty_cycle) {
+	hardware.pwm_compare[ccu4_slice_number] = duty_cycle;
+}
+
+uint16_t ccu4_pwm_get_duty_cycle(const uint8_t ccu4_slice_number) {
+	return hardware.pwm_compare[ccu4_slice_number];
+}
+
+// --- System timer ---
+
+uint32_t system_timer_get_ms(void) {
+	return hardware.time_ms;
+}
+
+bool system_timer_is_time_elapsed_ms(const uint32_t start_measurement, const uint32_t time_to_be_elapsed) {
+	return (uint32_t)(hardware.time_ms - start_measurement) >= time_to_be_elapsed;
+}
+
+void system_timer_sleep_ms(const uint32_t sleep) {
+	hardware.time_ms += sleep;
+}
+
+// --- ADS1118 ---
+
+static uint32_t host_ads1118_get_conversion_time(const uint16_t config) {
+	static const uint8_t conversion_time[8] = {125, 63, 32, 16, 8, 4, 3, 2}; // ms for 8 to 860 SPS
+	return conversion_time[(config >> 5) & 0b111];
+}
+
+static uint32_t host_ads1118_get_drdy(void) {
+	if(hardware.ads1118_config == 0) {
+		return 0;
+	}
+
+	return !system_timer_is_time_elapsed_ms(hardware.ads1118_conversion_start, host_ads1118_get_conversion_time(hardware.ads1118_config));
+}
+
+void spi_fifo_init(SPIFifo *spi_fifo) {
+	const XMC_GPIO_CONFIG_t config_input = {
+		.mode         = XMC_GPIO_MODE_INPUT_TRISTATE,
+	};
+	XMC_GPIO_Init(spi_fifo->miso_port, spi_fifo->miso_pin, &config_input);
+}
+
+bool spi_fifo_coop_transceive(SPIFifo *spi_fifo, const uint16_t length, const uint8_t *data_mosi, uint8_t *data_miso) {
+	// Result of the last finished conversion
+	if(!host_ads1118_get_drdy()) {
+		const uint16_t config = hardware.ads1118_config;
+		if(config & ADS1118_CONFIG_TEMPERATURE_MODE) {
+			hardware.ads1118_result = hardware.ads1118_input[HOST_ADS1118_INPUT_TEMPERATURE];
+		} else {
+			hardware.ads1118_result = hardware.ads1118_input[(config >> 12) & 0b111];
+		}
+	}
+
+	data_miso[0] = hardware.ads1118_result >> 8;
+	data_miso[1] = hardware.ads1118_result & 0xFF;
+
+	// A new conversion starts with every configuration
+	// (single shot bit or continuous mode)
+	hardware.ads1118_config           = (data_mosi[0] << 8) | data_mosi[1];
+	hardware.ads1118_conversion_start = hardware.time_ms;
+
+	return true;
+}
+
+// --- Contactor check ---
+
+void contactor_check_init(void) {
+	memset(&contactor_check, 0, sizeof(ContactorCheck));
+}
+
+void contactor_check_tick(void) {
+	if(!system_timer_is_time_elapsed_ms(contactor_check.last_check_time, 20)) {
+		return;
+	}
+	contactor_check.last_check_time = system_timer_get_ms();
+
+	bool relay = XMC_GPIO_GetInput(EVSE_RELAY_PIN);
+	if(CONTACTOR_CHECK_RELAY_PIN_IS_INVERTED) {
+		relay = !relay;
+	}
+
+	bool live = relay;
+	if(hardware.contactor_welded) {
+		live = true;
+	} else if(hardware.contactor_stuck_open) {
+		live = false;
+	}
+
+	contactor_check.state = live ? 0b11 : 0b00;
+	if(live) {
+		contactor_check.ac1_edge_count += 2;
+		contactor_check.ac2_edge_count += 2;
+	}
+
+	if(contactor_check.invalid_counter > 0) {
+		contactor_check.invalid_counter--;
+		return;
+	}
+
+	// The firmware only checks for error != 0, the value itself is informational:
+	// 1 = contactor live but relay off (welded), 2 = relay on but contactor not live
+	if(live && !relay) {
+		contactor_check.error = 1;
+	} else if(!live && relay) {
+		contactor_check.error = 2;
+	}
+}
+
+// --- Bootloader ---
+
+BootloaderStatus bootloader_status;
+
+void bootloader_tick(void) {
+	// TFP messages are handed to handle_message directly by the host tools
+}
+
+uint32_t bootloader_get_uid(void) {
+	return hardware.uid;
+}
+
+bool bootloader_spitfp_is_send_possible(SPITFP *st) {
+	return hardware.tfp_tx_count < HOST_TFP_TX_NUM;
+}
+
+void bootloader_spitfp_send_ack_and_message(BootloaderStatus *bs, uint8_t *data, const uint8_t length) {
+	if((hardware.tfp_tx_count < HOST_TFP_TX_NUM) && (length <= TFP_MESSAGE_MAX_LENGTH)) {
+		memcpy(hardware.tfp_tx[hardware.tfp_tx_count], data, length);
+		hardware.tfp_tx_count++;
+	}
+}
+
+bool bootloader_read_eeprom_page(const uint32_t page_num, uint32_t *data) {
+	if(page_num >= HOST_EEPROM_PAGE_NUM) {
+		return false;
+	}
+
+	memcpy(data, hardware.eeprom[page_num], HOST_EEPROM_PAGE_SIZE);
+	return true;
+}
+
+bool bootloader_write_eeprom_page(const uint32_t page_num, uint32_t *data) {
+	if(page_num >= HOST_EEPROM_PAGE_NUM) {
+		return false;
+	}
+
+	memcpy(hardware.eeprom[page_num], data, HOST_EEPROM_PAGE_SIZE);
+	return true;
+}
+
+// --- Flash ---
+
+void XMC_FLASH_ErasePage(uint32_t *address) {
+	memset(address, 0, XMC_FLASH_BYTES_PER_PAGE);
+}
+
+void XMC_FLASH_WriteBlocks(uint32_t *address, const uint32_t *data, uint32_t num_blocks, bool verify) {
+	memcpy(address, data, num_blocks*XMC_FLASH_BYTES_PER_BLOCK);
+}
+
+// --- TFP ---
+
+uint8_t tfp_get_fid_from_message(const void *message) {
+	return ((const TFPMessageHeader*)message)->fid;
+}
+
+uint8_t tfp_get_length_from_message(const void *message) {
+	return ((const TFPMessageHeader*)message)->length;
+}
+
+void tfp_make_default_header(TFPMessageHeader *header, const uint32_t uid, const uint8_t length, const uint8_t fid) {
+	memset(header, 0, sizeof(TFPMessageHeader));
+	header->uid             = uid;
+	header->length          = length;
+	header->fid             = fid;
+	header->return_expected = 1;
+}
+
+// --- Communication callbacks ---
+// bricklib2 polls one handler per tick, on the host all of them are polled
+
+static bool (*const host_communication_callbacks[])(void) = {
+	COMMUNICATION_CALLBACK_LIST_INIT
+};
+
+void communication_callback_init(void) {
+}
+
+void communication_callback_tick(void) {
+	for(uint32_t i = 0; i < COMMUNICATION_CALLBACK_HANDLER_NUM; i++) {
+		host_communication_callbacks[i]();
+	}
+}
+
+// --- Utility ---
+
+void moving_average_init(MovingAverage *ma, const MOVING_AVERAGE_TYPE init_value, const uint16_t length) {
+	ma->length = MIN(length, MOVING_AVERAGE_MAX_LENGTH);
+	ma->pos    = 0;
+	ma->sum    = init_value*ma->length;
+	for(uint16_t i = 0; i < ma->length; i++) {
+		ma->values[i] = init_value;
+	}
+}
+
+void moving_average_handle_value(MovingAverage *ma, const MOVING_AVERAGE_TYPE value) {
+	ma->sum            = ma->sum - ma->values[ma->pos] + value;
+	ma->values[ma->pos] = value;
+	ma->pos            = (ma->pos + 1) % ma->length;
+}
+
+MOVING_AVERAGE_TYPE moving_average_get(MovingAverage *ma) {
+	return ma->sum/ma->length;
+}
+
+void uartbb_printf(const char *fmt, ...) {
+	va_list args;
+	va_start(args, fmt);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+}
+
+// --- Memory usage ---
+// There is no stack painting on the host, the task stack is
+// much larger and the main stack belongs to the host thread.
+
+void memory_usage_paint(uint32_t *start, const uint32_t length) {
+}
+
+uint32_t memory_usage_get_stack_used(const uint32_t *start, const uint32_t length) {
+	return 0;
+}
+
+uint32_t memory_usage_get_main_stack_size(void) {
+	return 0;
+}
+
+uint32_t memory_usage_get_main_stack_used(void) {
+	return 0;
+}
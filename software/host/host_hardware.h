@@ -0,0 +1,105 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * host_hardware.h: Simulated peripherals of one EVSE
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef HOST_HARDWARE_H
+#define HOST_HARDWARE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "xmc_gpio.h"
+#include "configs/config_journal.h"
+#include "bricklib2/protocols/tfp/tfp.h"
+
+#define HOST_GPIO_PORT_NUM      3
+#define HOST_GPIO_PIN_NUM       16
+#define HOST_PWM_SLICE_NUM      4
+#define HOST_EEPROM_PAGE_NUM    4
+#define HOST_EEPROM_PAGE_SIZE   256
+#define HOST_TFP_TX_NUM         4
+
+// The bootloader runs before the firmware, so the system timer never starts at 0
+// (the firmware uses a time stamp of 0 as "not set")
+#define HOST_HARDWARE_BOOT_TIME_MS 10
+
+// Level of an input pin that is not driven from outside, it reads as the pull-up/pull-down
+#define HOST_GPIO_FLOATING      -1
+
+// The ADS1118 result register per input multiplexer setting (config bits 14:12),
+// index 8 is the temperature sensor.
+#define HOST_ADS1118_INPUT_NUM  9
+#define HOST_ADS1118_INPUT_TEMPERATURE 8
+
+// ADC codes of an EVSE V1.5 without car and cable (CP +12V on IN1, PP open)
+#define HOST_ADS1118_CODE_CP_12V   31643
+#define HOST_ADS1118_CODE_PP_OPEN  32760
+
+typedef struct {
+	// Simulated uptime in ms (starts again with every reset as on the real hardware)
+	uint32_t time_ms;
+
+	uint32_t gpio_mode[HOST_GPIO_PORT_NUM][HOST_GPIO_PIN_NUM];
+	uint8_t gpio_output[HOST_GPIO_PORT_NUM][HOST_GPIO_PIN_NUM];
+	int8_t gpio_external[HOST_GPIO_PORT_NUM][HOST_GPIO_PIN_NUM];
+
+	uint16_t pwm_period[HOST_PWM_SLICE_NUM];
+	uint16_t pwm_compare[HOST_PWM_SLICE_NUM];
+
+	// The ADS1118 returns the result of the previous conversion while a new configuration
+	// is shifted in. DOUT/DRDY is high until the conversion with this configuration is done.
+	uint16_t ads1118_config;
+	uint32_t ads1118_conversion_start;
+	uint16_t ads1118_result;
+	uint16_t ads1118_input[HOST_ADS1118_INPUT_NUM];
+
+	// Drift of the +-12V CP output in mV (e.g. over temperature), positive increases both levels.
+	// Used by the vehicle model, the ADS1118 inputs are not changed directly.
+	int16_t cp_drift_mv;
+
+	// Both AC inputs of the contactor check follow the relay, unless a fault is injected
+	bool contactor_welded;
+	bool contactor_stuck_open;
+
+	uint32_t eeprom[HOST_EEPROM_PAGE_NUM][HOST_EEPROM_PAGE_SIZE/sizeof(uint32_t)];
+	uint32_t journal_flash[JOURNAL_PAGE_NUM*JOURNAL_PAGE_SIZE/sizeof(uint32_t)];
+
+	// TFP messages (callbacks) that the Bricklet sent on its own, the host
+	// tool takes them out after each step. A full queue is "send not possible".
+	uint32_t uid;
+	uint8_t tfp_tx[HOST_TFP_TX_NUM][TFP_MESSAGE_MAX_LENGTH];
+	uint8_t tfp_tx_count;
+
+	// RAM in .noinit on the firmware, kept over a reset but not over a power cycle
+	uint32_t noinit_warm_start_marker;
+
+	bool reset_requested;
+	uint32_t reset_count;
+} HostHardware;
+
+void host_hardware_init(HostHardware *hardware);
+void host_hardware_reset(HostHardware *hardware);
+
+// Access for models of the outside world (vehicle, test rigs), these
+// take the hardware explicitly and don't need a selected context
+bool host_hardware_get_output(const HostHardware *hardware, XMC_GPIO_PORT_t *const port, const uint8_t pin);
+void host_hardware_set_input(HostHardware *hardware, XMC_GPIO_PORT_t *const port, const uint8_t pin, const int8_t level);
+
+#endif
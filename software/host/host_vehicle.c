@@ -0,0 +1,215 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * host_vehicle.c: Closed-loop vehicle model for the host simulation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "host_vehicle.h"
+
+#include <string.h>
+
+#include "xmc_gpio.h"
+#include "bricklib2/utility/util_definitions.h"
+#include "configs/config_evse.h"
+#include "ads1118.h"
+#include "evse.h"
+
+void host_vehicle_get_default_config(HostVehicleConfig *config, const HostVehicleBehaviour behaviour) {
+	memset(config, 0, sizeof(HostVehicleConfig));
+
+	config->behaviour          = behaviour;
+	config->pp_resistance      = HOST_VEHICLE_PP_32A;
+	config->diode_drop_mv      = 650;
+	config->plug_in_delay_ms   = 2000;
+	config->wake_up_delay_ms   = 500;
+	config->spike_ms           = 0;
+	config->charge_duration_ms = 30*1000;
+	config->unplug_delay_ms    = 2000;
+	config->timeout_ms         = 60*1000;
+
+	switch(behaviour) {
+		case HOST_VEHICLE_BEHAVIOUR_ID3_SPIKE:     config->spike_ms        = 1500;           break;
+		case HOST_VEHICLE_BEHAVIOUR_STOP_CHARGING: config->unplug_delay_ms = 4*60*1000;      break; // longer than the 3 minutes of B2 that set car_stopped_charging
+		case HOST_VEHICLE_BEHAVIOUR_DIODE_FAULT:   config->diode_drop_mv   = 0;              break;
+		default: break;
+	}
+}
+
+void host_vehicle_init(HostVehicle *vehicle, const HostVehicleConfig *config) {
+	memset(vehicle, 0, sizeof(HostVehicle));
+	vehicle->config = *config;
+}
+
+// CP duty cycle of the EVSE in pro mille, 1000 = constant +12V
+static uint32_t host_vehicle_get_duty_cycle(const HostHardware *hardware) {
+	const uint32_t period  = hardware->pwm_period[EVSE_CP_PWM_SLICE_NUMBER] + 1;
+	const uint32_t compare = MIN(hardware->pwm_compare[EVSE_CP_PWM_SLICE_NUMBER], period);
+	return (period - compare)*1000/period;
+}
+
+static bool host_vehicle_has_pwm(const HostHardware *hardware) {
+	const uint32_t duty_cycle = host_vehicle_get_duty_cycle(hardware);
+	return (duty_cycle > 0) && (duty_cycle < 1000);
+}
+
+static bool host_vehicle_is_contactor_closed(const HostHardware *hardware) {
+	return host_hardware_get_output(hardware, EVSE_RELAY_PIN) && !hardware->contactor_stuck_open;
+}
+
+static uint32_t host_vehicle_get_cp_resistance(const HostVehicle *vehicle) {
+	const uint32_t r_charge = (vehicle->config.behaviour == HOST_VEHICLE_BEHAVIOUR_VENTILATION) ? HOST_VEHICLE_R_STATE_D : HOST_VEHICLE_R_STATE_C;
+
+	switch(vehicle->phase) {
+		case HOST_VEHICLE_PHASE_UNPLUGGED:  return HOST_VEHICLE_R_OPEN;
+		case HOST_VEHICLE_PHASE_CONNECTED:  return HOST_VEHICLE_R_STATE_B;
+		case HOST_VEHICLE_PHASE_WAKING_UP:  return HOST_VEHICLE_R_STATE_B;
+		case HOST_VEHICLE_PHASE_STOPPED:    return HOST_VEHICLE_R_STATE_B;
+		case HOST_VEHICLE_PHASE_CHARGING:   return r_charge;
+		case HOST_VEHICLE_PHASE_REQUESTING: {
+			if((vehicle->time_ms - vehicle->phase_time) < vehicle->config.spike_ms) {
+				return HOST_VEHICLE_R_OPEN;
+			}
+			return r_charge;
+		}
+	}
+
+	return HOST_VEHICLE_R_OPEN;
+}
+
+// ADS1118 code as the EVSE V1.5 measures CP (IN1 vs GND), 0.8217V => -12V, 3.9554V => 12V.
+// The ADC integrates over many PWM periods, so it sees the average of both half waves.
+uint16_t host_vehicle_get_cp_adc_code(const HostVehicle *vehicle, const HostHardware *hardware) {
+	const int64_t r = host_vehicle_get_cp_resistance(vehicle);
+
+	const int64_t source_high_mv = HOST_VEHICLE_CP_HIGH_MV + hardware->cp_drift_mv;
+	const int64_t source_low_mv  = HOST_VEHICLE_CP_LOW_MV  - hardware->cp_drift_mv;
+
+	int64_t high_mv = source_high_mv;
+	int64_t low_mv  = source_low_mv;
+	if(r != HOST_VEHICLE_R_OPEN) {
+		const int64_t diode_mv = vehicle->config.diode_drop_mv;
+		high_mv = (diode_mv*HOST_VEHICLE_CP_SOURCE_OHM + source_high_mv*r)/(r + HOST_VEHICLE_CP_SOURCE_OHM);
+		if(vehicle->config.behaviour == HOST_VEHICLE_BEHAVIOUR_DIODE_FAULT) {
+			low_mv = source_low_mv*r/(r + HOST_VEHICLE_CP_SOURCE_OHM);
+		}
+	}
+
+	const int64_t duty_cycle = host_vehicle_get_duty_cycle(hardware);
+	const int64_t mv         = (high_mv*duty_cycle + low_mv*(1000 - duty_cycle))/1000;
+
+	return BETWEEN(0, SCALE(mv, -12000, 12000, 6574, 31643), 0x7FFF);
+}
+
+// PP is measured against 1k to 5V, 1 LSB = 125uV
+uint16_t host_vehicle_get_pp_adc_code(const HostVehicle *vehicle) {
+	if((vehicle->phase == HOST_VEHICLE_PHASE_UNPLUGGED) || (vehicle->config.pp_resistance == 0)) {
+		return HOST_ADS1118_CODE_PP_OPEN;
+	}
+
+	const uint32_t mv = 5000*vehicle->config.pp_resistance/(vehicle->config.pp_resistance + 1000);
+	return mv*8;
+}
+
+static void host_vehicle_set_phase(HostVehicle *vehicle, const HostVehiclePhase phase) {
+	vehicle->phase      = phase;
+	vehicle->phase_time = vehicle->time_ms;
+}
+
+static bool host_vehicle_is_phase_elapsed(const HostVehicle *vehicle, const uint32_t time) {
+	return (vehicle->time_ms - vehicle->phase_time) >= time;
+}
+
+static void host_vehicle_fail(HostVehicle *vehicle) {
+	vehicle->sessions_failed++;
+	host_vehicle_set_phase(vehicle, HOST_VEHICLE_PHASE_UNPLUGGED);
+}
+
+void host_vehicle_tick(HostVehicle *vehicle, HostHardware *hardware) {
+	const HostVehicleConfig *config = &vehicle->config;
+
+	switch(vehicle->phase) {
+		case HOST_VEHICLE_PHASE_UNPLUGGED: {
+			if(host_vehicle_is_phase_elapsed(vehicle, config->plug_in_delay_ms)) {
+				vehicle->sessions++;
+				vehicle->charged = false;
+				vehicle->session_interruptions = 0;
+				host_vehicle_set_phase(vehicle, HOST_VEHICLE_PHASE_CONNECTED);
+			}
+			break;
+		}
+
+		case HOST_VEHICLE_PHASE_CONNECTED: {
+			if(host_vehicle_has_pwm(hardware)) {
+				host_vehicle_set_phase(vehicle, HOST_VEHICLE_PHASE_WAKING_UP);
+			} else if(host_vehicle_is_phase_elapsed(vehicle, config->timeout_ms)) {
+				host_vehicle_fail(vehicle);
+			}
+			break;
+		}
+
+		case HOST_VEHICLE_PHASE_WAKING_UP: {
+			if(!host_vehicle_has_pwm(hardware)) {
+				host_vehicle_set_phase(vehicle, HOST_VEHICLE_PHASE_CONNECTED);
+			} else if(host_vehicle_is_phase_elapsed(vehicle, config->wake_up_delay_ms)) {
+				host_vehicle_set_phase(vehicle, HOST_VEHICLE_PHASE_REQUESTING);
+			}
+			break;
+		}
+
+		case HOST_VEHICLE_PHASE_REQUESTING: {
+			if(host_vehicle_is_contactor_closed(hardware)) {
+				host_vehicle_set_phase(vehicle, HOST_VEHICLE_PHASE_CHARGING);
+			} else if(host_vehicle_is_phase_elapsed(vehicle, config->timeout_ms)) {
+				host_vehicle_fail(vehicle);
+			}
+			break;
+		}
+
+		case HOST_VEHICLE_PHASE_CHARGING: {
+			vehicle->charge_time_ms++;
+			if(!host_vehicle_is_contactor_closed(hardware)) {
+				// EVSE interrupted charging, request again (as long as there is PWM)
+				vehicle->contactor_interruptions++;
+				vehicle->session_interruptions++;
+				if(vehicle->session_interruptions > HOST_VEHICLE_MAX_INTERRUPTIONS) {
+					host_vehicle_fail(vehicle);
+				} else {
+					host_vehicle_set_phase(vehicle, HOST_VEHICLE_PHASE_REQUESTING);
+				}
+			} else if(host_vehicle_is_phase_elapsed(vehicle, config->charge_duration_ms)) {
+				vehicle->sessions_charged++;
+				vehicle->charged = true;
+				host_vehicle_set_phase(vehicle, HOST_VEHICLE_PHASE_STOPPED);
+			}
+			break;
+		}
+
+		case HOST_VEHICLE_PHASE_STOPPED: {
+			if(host_vehicle_is_phase_elapsed(vehicle, config->unplug_delay_ms)) {
+				host_vehicle_set_phase(vehicle, HOST_VEHICLE_PHASE_UNPLUGGED);
+			}
+			break;
+		}
+	}
+
+	// V1.5: CP on IN1 vs GND (also used for the version detection), PP on IN2 vs IN3
+	hardware->ads1118_input[ADS1118_CONFIG_INP_IS_IN1_AND_INN_IS_GND >> 12] = host_vehicle_get_cp_adc_code(vehicle, hardware);
+	hardware->ads1118_input[ADS1118_CONFIG_INP_IS_IN2_AND_INN_IS_IN3 >> 12] = host_vehicle_get_pp_adc_code(vehicle);
+
+	vehicle->time_ms++;
+}
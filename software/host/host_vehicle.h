@@ -0,0 +1,109 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * host_vehicle.h: Closed-loop vehicle model for the host simulation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef HOST_VEHICLE_H
+#define HOST_VEHICLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "host_hardware.h"
+
+// Resistances of the vehicle between CP and PE (behind the diode)
+#define HOST_VEHICLE_R_STATE_B           2740
+#define HOST_VEHICLE_R_STATE_C           882  // 2740 || 1300
+#define HOST_VEHICLE_R_STATE_D           246  // 2740 || 270
+#define HOST_VEHICLE_R_OPEN              0xFFFFFFFF
+
+// Cable coding resistor between PP and PE
+#define HOST_VEHICLE_PP_13A              1500
+#define HOST_VEHICLE_PP_20A              680
+#define HOST_VEHICLE_PP_32A              220
+#define HOST_VEHICLE_PP_63A              100
+
+// CP output of the EVSE: +-12V through 910 Ohm, the negative level
+// matches the default calibration (cp_cal_diff_voltage -90mV)
+#define HOST_VEHICLE_CP_HIGH_MV          12100
+#define HOST_VEHICLE_CP_LOW_MV           -12190
+#define HOST_VEHICLE_CP_SOURCE_OHM       910
+
+// A session in which the contactor opens more often than this without the
+// vehicle asking for it is counted as failed and the vehicle is unplugged
+#define HOST_VEHICLE_MAX_INTERRUPTIONS   5
+
+typedef enum {
+	HOST_VEHICLE_BEHAVIOUR_NORMAL = 0,
+	HOST_VEHICLE_BEHAVIOUR_ID3_SPIKE,     // CP/PE looks open for a while when the 1.3k resistor is engaged (seen with ID.3)
+	HOST_VEHICLE_BEHAVIOUR_STOP_CHARGING, // Vehicle stops charging on its own and stays connected in state B
+	HOST_VEHICLE_BEHAVIOUR_DIODE_FAULT,   // Diode in the vehicle is shorted, the negative half wave is loaded too
+	HOST_VEHICLE_BEHAVIOUR_VENTILATION,   // Vehicle requests charging with ventilation (state D)
+	HOST_VEHICLE_BEHAVIOUR_NUM
+} HostVehicleBehaviour;
+
+typedef enum {
+	HOST_VEHICLE_PHASE_UNPLUGGED = 0,
+	HOST_VEHICLE_PHASE_CONNECTED,  // State B, waiting for PWM
+	HOST_VEHICLE_PHASE_WAKING_UP,  // PWM seen, vehicle needs some time to request charging
+	HOST_VEHICLE_PHASE_REQUESTING, // State C/D, waiting for contactor
+	HOST_VEHICLE_PHASE_CHARGING,
+	HOST_VEHICLE_PHASE_STOPPED,    // State B after charging, waiting for unplug
+} HostVehiclePhase;
+
+typedef struct {
+	HostVehicleBehaviour behaviour;
+	uint16_t pp_resistance;       // Ohm, 0 = no cable coding resistor
+	uint16_t diode_drop_mv;
+
+	uint32_t plug_in_delay_ms;    // Time until the vehicle is plugged in (again)
+	uint32_t wake_up_delay_ms;    // Time from PWM to the charging request
+	uint32_t spike_ms;            // Length of the ID.3 spike
+	uint32_t charge_duration_ms;  // Time from contactor closed to the vehicle stopping
+	uint32_t unplug_delay_ms;     // Time from stopping to unplugging
+	uint32_t timeout_ms;          // Max wait for PWM or contactor, after that the session counts as failed
+} HostVehicleConfig;
+
+typedef struct {
+	HostVehicleConfig config;
+
+	HostVehiclePhase phase;
+	uint32_t phase_time;
+	uint32_t time_ms;
+	bool charged;
+	uint8_t session_interruptions;
+
+	uint32_t sessions;
+	uint32_t sessions_charged;
+	uint32_t sessions_failed;
+	uint32_t contactor_interruptions;
+	uint64_t charge_time_ms;
+} HostVehicle;
+
+void host_vehicle_get_default_config(HostVehicleConfig *config, const HostVehicleBehaviour behaviour);
+void host_vehicle_init(HostVehicle *vehicle, const HostVehicleConfig *config);
+
+// Reads CP PWM and relay from the hardware and updates the ADC inputs,
+// has to be called once before every host_context_step.
+void host_vehicle_tick(HostVehicle *vehicle, HostHardware *hardware);
+
+uint16_t host_vehicle_get_cp_adc_code(const HostVehicle *vehicle, const HostHardware *hardware);
+uint16_t host_vehicle_get_pp_adc_code(const HostVehicle *vehicle);
+
+#endif
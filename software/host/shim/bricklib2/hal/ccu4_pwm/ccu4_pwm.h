@@ -0,0 +1,32 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * ccu4_pwm.h: Host replacement, PWM compare values in the current context
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef CCU4_PWM_H
+#define CCU4_PWM_H
+
+#include "xmc_gpio.h"
+#include "xmc_ccu4.h"
+
+void ccu4_pwm_init(XMC_GPIO_PORT_t *const port, const uint8_t pin, const uint8_t ccu4_slice_number, const uint16_t period_value);
+void ccu4_pwm_set_duty_cycle(const uint8_t ccu4_slice_number, const uint16_t duty_cycle);
+uint16_t ccu4_pwm_get_duty_cycle(const uint8_t ccu4_slice_number);
+
+#endif
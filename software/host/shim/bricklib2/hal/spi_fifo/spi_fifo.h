@@ -0,0 +1,60 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * spi_fifo.h: Host replacement, transfers go to the simulated ADS1118
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef SPI_FIFO_H
+#define SPI_FIFO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "xmc_spi.h"
+#include "bricklib2/hal/system_timer/system_timer.h"
+
+typedef struct {
+	uint32_t channel;
+	uint32_t baudrate;
+	uint32_t rx_fifo_size;
+	uint32_t rx_fifo_pointer;
+	uint32_t tx_fifo_size;
+	uint32_t tx_fifo_pointer;
+	uint32_t slave;
+	uint32_t clock_output;
+	uint32_t clock_passive_level;
+
+	XMC_GPIO_PORT_t *sclk_port;
+	uint8_t sclk_pin;
+	uint32_t sclk_pin_mode;
+	XMC_GPIO_PORT_t *select_port;
+	uint8_t select_pin;
+	uint32_t select_pin_mode;
+	XMC_GPIO_PORT_t *mosi_port;
+	uint8_t mosi_pin;
+	uint32_t mosi_pin_mode;
+	XMC_GPIO_PORT_t *miso_port;
+	uint8_t miso_pin;
+	uint32_t miso_input;
+	uint32_t miso_source;
+} SPIFifo;
+
+void spi_fifo_init(SPIFifo *spi_fifo);
+bool spi_fifo_coop_transceive(SPIFifo *spi_fifo, const uint16_t length, const uint8_t *data_mosi, uint8_t *data_miso);
+
+#endif
@@ -0,0 +1,50 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * logging.h: Host replacement for the UART logging
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef LOGGING_H
+#define LOGGING_H
+
+#include "configs/config_logging.h"
+
+#define LOGGING_DEBUG   0
+#define LOGGING_INFO    1
+#define LOGGING_WARNING 2
+#define LOGGING_ERROR   3
+#define LOGGING_FATAL   4
+#define LOGGING_NONE    5
+
+#include "bricklib2/hal/uartbb/uartbb.h"
+
+#if LOGGING_LEVEL == LOGGING_NONE
+#define logd(str, ...) {}
+#define logi(str, ...) {}
+#define logw(str, ...) {}
+#define loge(str, ...) {}
+#else
+#define logd(str, ...) uartbb_printf(str, ##__VA_ARGS__)
+#define logi(str, ...) uartbb_printf(str, ##__VA_ARGS__)
+#define logw(str, ...) uartbb_printf(str, ##__VA_ARGS__)
+#define loge(str, ...) uartbb_printf(str, ##__VA_ARGS__)
+#endif
+
+#define logging_init()
+
+#endif
@@ -0,0 +1,47 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * coop_task.h: Host replacement, cooperative tasks with ucontext
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef COOP_TASK_H
+#define COOP_TASK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <ucontext.h>
+
+// Much larger than on the firmware, libc functions (qsort, printf)
+// called from a task need more stack on the host
+#define COOP_TASK_STACK_SIZE (32*1024)
+
+typedef void (*CoopTaskFunction)(void);
+
+typedef struct {
+	ucontext_t context;
+	ucontext_t caller_context;
+	CoopTaskFunction function;
+	uint32_t stack[COOP_TASK_STACK_SIZE/sizeof(uint32_t)];
+} CoopTask;
+
+void coop_task_init(CoopTask *task, CoopTaskFunction function);
+void coop_task_tick(CoopTask *task);
+void coop_task_yield(void);
+void coop_task_sleep_ms(const uint32_t sleep);
+
+#endif
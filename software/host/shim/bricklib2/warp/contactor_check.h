@@ -0,0 +1,41 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * contactor_check.h: Host replacement, contactor check against the simulated relay
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef CONTACTOR_CHECK_H
+#define CONTACTOR_CHECK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// The state is part of the EVSEContext on the host (see context.h)
+typedef struct {
+	uint32_t ac1_edge_count;
+	uint32_t ac2_edge_count;
+	uint8_t state;
+	uint8_t error;
+	uint8_t invalid_counter;
+	uint32_t last_check_time;
+} ContactorCheck;
+
+void contactor_check_init(void);
+void contactor_check_tick(void);
+
+#endif
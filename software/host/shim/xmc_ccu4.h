@@ -0,0 +1,99 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * xmc_ccu4.h: Host replacement for the XMC CCU4 driver
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef XMC_CCU4_H
+#define XMC_CCU4_H
+
+#include "xmc_device.h"
+
+typedef struct {
+	uint8_t number;
+} XMC_CCU4_MODULE_t;
+
+typedef struct {
+	uint8_t number;
+} XMC_CCU4_SLICE_t;
+
+extern XMC_CCU4_MODULE_t host_ccu4_module[1];
+extern XMC_CCU4_SLICE_t host_ccu4_slice[4];
+
+#define CCU40      (&host_ccu4_module[0])
+#define CCU40_CC40 (&host_ccu4_slice[0])
+#define CCU40_CC41 (&host_ccu4_slice[1])
+#define CCU40_CC42 (&host_ccu4_slice[2])
+#define CCU40_CC43 (&host_ccu4_slice[3])
+
+#define XMC_CCU4_SHADOW_TRANSFER_SLICE_0           (1 << 0)
+#define XMC_CCU4_SHADOW_TRANSFER_PRESCALER_SLICE_0 (1 << 2)
+
+typedef enum {
+	XMC_CCU4_SLICE_TIMER_COUNT_MODE_EA
+} XMC_CCU4_SLICE_TIMER_COUNT_MODE_t;
+
+typedef enum {
+	XMC_CCU4_SLICE_TIMER_REPEAT_MODE_REPEAT
+} XMC_CCU4_SLICE_TIMER_REPEAT_MODE_t;
+
+typedef enum {
+	XMC_CCU4_SLICE_PRESCALER_MODE_NORMAL
+} XMC_CCU4_SLICE_PRESCALER_MODE_t;
+
+typedef enum {
+	XMC_CCU4_SLICE_PRESCALER_1
+} XMC_CCU4_SLICE_PRESCALER_t;
+
+typedef enum {
+	XMC_CCU4_SLICE_OUTPUT_PASSIVE_LEVEL_LOW
+} XMC_CCU4_SLICE_OUTPUT_PASSIVE_LEVEL_t;
+
+typedef enum {
+	XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH
+} XMC_CCU4_SLICE_IRQ_ID_t;
+
+typedef enum {
+	XMC_CCU4_SLICE_SR_ID_0
+} XMC_CCU4_SLICE_SR_ID_t;
+
+typedef struct {
+	XMC_CCU4_SLICE_TIMER_COUNT_MODE_t timer_mode;
+	XMC_CCU4_SLICE_TIMER_REPEAT_MODE_t monoshot;
+	bool shadow_xfer_clear;
+	bool dither_timer_period;
+	bool dither_duty_cycle;
+	XMC_CCU4_SLICE_PRESCALER_MODE_t prescaler_mode;
+	bool mcm_enable;
+	XMC_CCU4_SLICE_PRESCALER_t prescaler_initval;
+	uint8_t float_limit;
+	uint8_t dither_limit;
+	XMC_CCU4_SLICE_OUTPUT_PASSIVE_LEVEL_t passive_level;
+	bool timer_concatenation;
+} XMC_CCU4_SLICE_COMPARE_CONFIG_t;
+
+void XMC_CCU4_SLICE_CompareInit(XMC_CCU4_SLICE_t *const slice, const XMC_CCU4_SLICE_COMPARE_CONFIG_t *const config);
+void XMC_CCU4_SLICE_SetTimerPeriodMatch(XMC_CCU4_SLICE_t *const slice, const uint16_t period_value);
+void XMC_CCU4_SLICE_EnableEvent(XMC_CCU4_SLICE_t *const slice, const XMC_CCU4_SLICE_IRQ_ID_t event);
+void XMC_CCU4_SLICE_SetInterruptNode(XMC_CCU4_SLICE_t *const slice, const XMC_CCU4_SLICE_IRQ_ID_t event, const XMC_CCU4_SLICE_SR_ID_t sr);
+void XMC_CCU4_SLICE_StartTimer(XMC_CCU4_SLICE_t *const slice);
+void XMC_CCU4_EnableClock(XMC_CCU4_MODULE_t *const module, const uint8_t slice_number);
+void XMC_CCU4_SLICE_SetTimerCompareMatch(XMC_CCU4_SLICE_t *const slice, const uint16_t compare_value);
+void XMC_CCU4_EnableShadowTransfer(XMC_CCU4_MODULE_t *const module, const uint32_t shadow_transfer_msk);
+
+#endif
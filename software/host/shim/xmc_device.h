@@ -0,0 +1,43 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * xmc_device.h: Host replacement for the XMC device header
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef XMC_DEVICE_H
+#define XMC_DEVICE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// The host build has no interrupts and no memory barriers are needed,
+// a reset is only requested and carried out by host_context_step.
+#define __DMB()
+#define __WFI()
+#define __NOP()
+#define __disable_irq()
+#define __enable_irq()
+
+void NVIC_SystemReset(void);
+void NVIC_SetPriority(const int32_t irq, const uint32_t priority);
+void NVIC_EnableIRQ(const int32_t irq);
+
+// Interrupt handlers are called by host_context_step at the simulated time
+void IRQ_Hdlr_21(void);
+
+#endif
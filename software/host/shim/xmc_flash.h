@@ -0,0 +1,36 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * xmc_flash.h: Host replacement for the XMC flash driver
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef XMC_FLASH_H
+#define XMC_FLASH_H
+
+#include "xmc_device.h"
+
+#define XMC_FLASH_BYTES_PER_PAGE  256
+#define XMC_FLASH_WORDS_PER_PAGE  64
+#define XMC_FLASH_BYTES_PER_BLOCK 16
+#define XMC_FLASH_WORDS_PER_BLOCK 4
+
+// On the host the address points into the simulated flash of the context (erased flash reads 0 as on XMC1)
+void XMC_FLASH_ErasePage(uint32_t *address);
+void XMC_FLASH_WriteBlocks(uint32_t *address, const uint32_t *data, uint32_t num_blocks, bool verify);
+
+#endif
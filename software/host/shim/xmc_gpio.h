@@ -0,0 +1,98 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * xmc_gpio.h: Host replacement for the XMC GPIO driver
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef XMC_GPIO_H
+#define XMC_GPIO_H
+
+#include "xmc_device.h"
+
+// A port only identifies itself, the pin state lives in the HostHardware of the current context
+typedef struct {
+	uint8_t number;
+} XMC_GPIO_PORT_t;
+
+extern XMC_GPIO_PORT_t host_gpio_port[3];
+
+#define XMC_GPIO_PORT0 (&host_gpio_port[0])
+#define XMC_GPIO_PORT1 (&host_gpio_port[1])
+#define XMC_GPIO_PORT2 (&host_gpio_port[2])
+
+#define P0_0  XMC_GPIO_PORT0, 0
+#define P0_5  XMC_GPIO_PORT0, 5
+#define P0_6  XMC_GPIO_PORT0, 6
+#define P0_7  XMC_GPIO_PORT0, 7
+#define P0_8  XMC_GPIO_PORT0, 8
+#define P0_9  XMC_GPIO_PORT0, 9
+#define P0_12 XMC_GPIO_PORT0, 12
+#define P0_13 XMC_GPIO_PORT0, 13
+#define P0_14 XMC_GPIO_PORT0, 14
+#define P0_15 XMC_GPIO_PORT0, 15
+#define P1_0  XMC_GPIO_PORT1, 0
+#define P1_1  XMC_GPIO_PORT1, 1
+#define P1_2  XMC_GPIO_PORT1, 2
+#define P1_3  XMC_GPIO_PORT1, 3
+#define P2_0  XMC_GPIO_PORT2, 0
+#define P2_1  XMC_GPIO_PORT2, 1
+#define P2_2  XMC_GPIO_PORT2, 2
+#define P2_6  XMC_GPIO_PORT2, 6
+#define P2_8  XMC_GPIO_PORT2, 8
+#define P2_9  XMC_GPIO_PORT2, 9
+#define P2_10 XMC_GPIO_PORT2, 10
+#define P2_11 XMC_GPIO_PORT2, 11
+
+#define P0_6_AF_U0C1_DX0     0
+#define P0_7_AF_U0C1_DOUT0   0
+#define P0_8_AF_U0C1_SCLKOUT 0
+#define P0_9_AF_U0C1_SELO0   0
+
+typedef enum {
+	XMC_GPIO_MODE_INPUT_TRISTATE        = 0x00,
+	XMC_GPIO_MODE_INPUT_PULL_DOWN       = 0x08,
+	XMC_GPIO_MODE_INPUT_PULL_UP         = 0x10,
+	XMC_GPIO_MODE_OUTPUT_PUSH_PULL      = 0x80,
+	XMC_GPIO_MODE_OUTPUT_PUSH_PULL_ALT6 = 0x98,
+	XMC_GPIO_MODE_OUTPUT_PUSH_PULL_ALT7 = 0x9C,
+} XMC_GPIO_MODE_t;
+
+#define XMC_GPIO_MODE_IS_OUTPUT(mode) (((mode) & 0x80) != 0)
+
+typedef enum {
+	XMC_GPIO_OUTPUT_LEVEL_LOW  = 0,
+	XMC_GPIO_OUTPUT_LEVEL_HIGH = 1,
+} XMC_GPIO_OUTPUT_LEVEL_t;
+
+typedef enum {
+	XMC_GPIO_INPUT_HYSTERESIS_STANDARD = 0,
+	XMC_GPIO_INPUT_HYSTERESIS_LARGE    = 1,
+} XMC_GPIO_INPUT_HYSTERESIS_t;
+
+typedef struct {
+	uint32_t mode;
+	XMC_GPIO_OUTPUT_LEVEL_t output_level;
+	XMC_GPIO_INPUT_HYSTERESIS_t input_hysteresis;
+} XMC_GPIO_CONFIG_t;
+
+void XMC_GPIO_Init(XMC_GPIO_PORT_t *const port, const uint8_t pin, const XMC_GPIO_CONFIG_t *const config);
+uint32_t XMC_GPIO_GetInput(XMC_GPIO_PORT_t *const port, const uint8_t pin);
+void XMC_GPIO_SetOutputHigh(XMC_GPIO_PORT_t *const port, const uint8_t pin);
+void XMC_GPIO_SetOutputLow(XMC_GPIO_PORT_t *const port, const uint8_t pin);
+
+#endif
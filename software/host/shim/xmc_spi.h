@@ -0,0 +1,39 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * xmc_spi.h: Host replacement for the XMC SPI driver
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef XMC_SPI_H
+#define XMC_SPI_H
+
+#include "xmc_gpio.h"
+
+// Only the constants used by the configs, the SPI communication itself is simulated in spi_fifo
+#define XMC_SPI0_CH0 0
+#define XMC_SPI0_CH1 1
+#define USIC0_CH0    0
+#define USIC0_CH1    1
+
+#define XMC_USIC_CH_FIFO_SIZE_16WORDS                             4
+#define XMC_SPI_CH_BRG_SHIFT_CLOCK_PASSIVE_LEVEL_0_DELAY_DISABLED 0
+#define XMC_SPI_CH_BRG_SHIFT_CLOCK_OUTPUT_SCLK                    0
+#define XMC_SPI_CH_SLAVE_SELECT_0                                 1
+#define XMC_USIC_CH_INPUT_DX0                                     0
+
+#endif
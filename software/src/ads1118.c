@@ -36,56 +36,57 @@
 
 #define ADS1118_MOVING_AVERAGE_LENGTH 4
 #define ADS1118_CONFIGURE_TIMEOUT 200
+#define ADS1118_TEMPERATURE_CONFIGURE_TIMEOUT 10
 
 #include "configs/config_evse.h"
 
 #include "evse.h"
 #include "iec61851.h"
 #include "button.h"
-
-CoopTask ads1118_task;
-ADS1118 ads1118;
+#include "calibration.h"
+#include "profiler.h"
+#include "scheduler.h"
+#include "memory_usage.h"
+#include "context.h"
 
 
 static void ads1118_init_spi(void) {
-	ads1118.spi_fifo.channel             = ADS1118_USIC_SPI;
-	ads1118.spi_fifo.baudrate            = ADS1118_SPI_BAUDRATE;
+	EVSE_CTX(ads1118).spi_fifo.channel             = ADS1118_USIC_SPI;
+	EVSE_CTX(ads1118).spi_fifo.baudrate            = ADS1118_SPI_BAUDRATE;
 
-	ads1118.spi_fifo.rx_fifo_size        = ADS1118_RX_FIFO_SIZE;
-	ads1118.spi_fifo.rx_fifo_pointer     = ADS1118_RX_FIFO_POINTER;
-	ads1118.spi_fifo.tx_fifo_size        = ADS1118_TX_FIFO_SIZE;
-	ads1118.spi_fifo.tx_fifo_pointer     = ADS1118_TX_FIFO_POINTER;
+	EVSE_CTX(ads1118).spi_fifo.rx_fifo_size        = ADS1118_RX_FIFO_SIZE;
+	EVSE_CTX(ads1118).spi_fifo.rx_fifo_pointer     = ADS1118_RX_FIFO_POINTER;
+	EVSE_CTX(ads1118).spi_fifo.tx_fifo_size        = ADS1118_TX_FIFO_SIZE;
+	EVSE_CTX(ads1118).spi_fifo.tx_fifo_pointer     = ADS1118_TX_FIFO_POINTER;
 
-	ads1118.spi_fifo.slave               = ADS1118_SLAVE;
-	ads1118.spi_fifo.clock_output        = ADS1118_CLOCK_OUTPUT;
-	ads1118.spi_fifo.clock_passive_level = ADS1118_CLOCK_PASSIVE_LEVEL;
+	EVSE_CTX(ads1118).spi_fifo.slave               = ADS1118_SLAVE;
+	EVSE_CTX(ads1118).spi_fifo.clock_output        = ADS1118_CLOCK_OUTPUT;
+	EVSE_CTX(ads1118).spi_fifo.clock_passive_level = ADS1118_CLOCK_PASSIVE_LEVEL;
 
-	ads1118.spi_fifo.sclk_pin            = ADS1118_SCLK_PIN;
-	ads1118.spi_fifo.sclk_port           = ADS1118_SCLK_PORT;
-	ads1118.spi_fifo.sclk_pin_mode       = ADS1118_SCLK_PIN_MODE;
+	EVSE_CTX(ads1118).spi_fifo.sclk_pin            = ADS1118_SCLK_PIN;
+	EVSE_CTX(ads1118).spi_fifo.sclk_port           = ADS1118_SCLK_PORT;
+	EVSE_CTX(ads1118).spi_fifo.sclk_pin_mode       = ADS1118_SCLK_PIN_MODE;
 
-	ads1118.spi_fifo.select_pin          = ADS1118_SELECT_PIN;
-	ads1118.spi_fifo.select_port         = ADS1118_SELECT_PORT;
-	ads1118.spi_fifo.select_pin_mode     = ADS1118_SELECT_PIN_MODE;
+	EVSE_CTX(ads1118).spi_fifo.select_pin          = ADS1118_SELECT_PIN;
+	EVSE_CTX(ads1118).spi_fifo.select_port         = ADS1118_SELECT_PORT;
+	EVSE_CTX(ads1118).spi_fifo.select_pin_mode     = ADS1118_SELECT_PIN_MODE;
 
-	ads1118.spi_fifo.mosi_pin            = ADS1118_MOSI_PIN;
-	ads1118.spi_fifo.mosi_port           = ADS1118_MOSI_PORT;
-	ads1118.spi_fifo.mosi_pin_mode       = ADS1118_MOSI_PIN_MODE;
+	EVSE_CTX(ads1118).spi_fifo.mosi_pin            = ADS1118_MOSI_PIN;
+	EVSE_CTX(ads1118).spi_fifo.mosi_port           = ADS1118_MOSI_PORT;
+	EVSE_CTX(ads1118).spi_fifo.mosi_pin_mode       = ADS1118_MOSI_PIN_MODE;
 
-	ads1118.spi_fifo.miso_pin            = ADS1118_MISO_PIN;
-	ads1118.spi_fifo.miso_port           = ADS1118_MISO_PORT;
-	ads1118.spi_fifo.miso_input          = ADS1118_MISO_INPUT;
-	ads1118.spi_fifo.miso_source         = ADS1118_MISO_SOURCE;
+	EVSE_CTX(ads1118).spi_fifo.miso_pin            = ADS1118_MISO_PIN;
+	EVSE_CTX(ads1118).spi_fifo.miso_port           = ADS1118_MISO_PORT;
+	EVSE_CTX(ads1118).spi_fifo.miso_input          = ADS1118_MISO_INPUT;
+	EVSE_CTX(ads1118).spi_fifo.miso_source         = ADS1118_MISO_SOURCE;
 
-	spi_fifo_init(&ads1118.spi_fifo);
+	spi_fifo_init(&EVSE_CTX(ads1118).spi_fifo);
 }
 
 // channel 0 = measure CP
 // channel 1 = measure PP
 // channel 2 = measure temperature
 uint8_t *ads1118_get_config_for_mosi(const uint8_t channel, const bool normal) {
-	static uint8_t mosi[2] = {0, 0};
-
 	uint16_t config = 0;
 	if(normal) { // normal loop
 		config = ADS1118_CONFIG_SINGLE_SHOT | ADS1118_CONFIG_POWER_DOWN | ADS1118_CONFIG_GAIN_4_096V | ADS1118_CONFIG_DATA_RATE_8SPS  | ADS1118_CONFIG_PULL_UP_ENABLE | ADS1118_CONFIG_NOP;
@@ -97,7 +98,7 @@ uint8_t *ads1118_get_config_for_mosi(const uint8_t channel, const bool normal) {
 		// We use channel 3 for version testing, version testing is done by measuring between IN1 and GND
 		config |= ADS1118_CONFIG_INP_IS_IN1_AND_INN_IS_GND;
 	} else {
-		if(ads1118.is_v15) {
+		if(EVSE_CTX(ads1118).is_v15) {
 			switch(channel) {
 				case 0: config |= ADS1118_CONFIG_INP_IS_IN1_AND_INN_IS_GND; break;
 				case 1: config |= ADS1118_CONFIG_INP_IS_IN2_AND_INN_IS_IN3; break;
@@ -114,14 +115,28 @@ uint8_t *ads1118_get_config_for_mosi(const uint8_t channel, const bool normal) {
 		}
 	}
 
-	mosi[0] = (config >> 8) & 0xFF;
-	mosi[1] = (config >> 0) & 0xFF;
-	return mosi;
+	EVSE_CTX(ads1118).config_mosi[0] = (config >> 8) & 0xFF;
+	EVSE_CTX(ads1118).config_mosi[1] = (config >> 0) & 0xFF;
+	return EVSE_CTX(ads1118).config_mosi;
+}
+
+// The temperature is converted with 860 SPS (~1.2ms) between two CP/PP conversions,
+// so it only delays the next CP/PP conversion a little and never replaces one.
+uint8_t *ads1118_get_temperature_config_for_mosi(void) {
+	const uint16_t config = ADS1118_CONFIG_SINGLE_SHOT | ADS1118_CONFIG_POWER_DOWN | ADS1118_CONFIG_DATA_RATE_860SPS | ADS1118_CONFIG_TEMPERATURE_MODE | ADS1118_CONFIG_PULL_UP_ENABLE | ADS1118_CONFIG_NOP;
+
+	EVSE_CTX(ads1118).config_mosi[0] = (config >> 8) & 0xFF;
+	EVSE_CTX(ads1118).config_mosi[1] = (config >> 0) & 0xFF;
+	return EVSE_CTX(ads1118).config_mosi;
+}
+
+bool ads1118_is_temperature_due(void) {
+	return (EVSE_CTX(ads1118).temperature_time == 0) || system_timer_is_time_elapsed_ms(EVSE_CTX(ads1118).temperature_time, ADS1118_TEMPERATURE_INTERVAL);
 }
 
 void ads1118_cp_adc_avg_queue_add(uint16_t value) {
-	ads1118.cp_adc_avg_queue[ads1118.cp_adc_avg_queue_pos] = value;
-	ads1118.cp_adc_avg_queue_pos = (ads1118.cp_adc_avg_queue_pos + 1) % ADS1118_CP_ADC_AVG_NUM;
+	EVSE_CTX(ads1118).cp_adc_avg_queue[EVSE_CTX(ads1118).cp_adc_avg_queue_pos] = value;
+	EVSE_CTX(ads1118).cp_adc_avg_queue_pos = (EVSE_CTX(ads1118).cp_adc_avg_queue_pos + 1) % ADS1118_CP_ADC_AVG_NUM;
 }
 
 int ads1118_sort_compare( const void* a, const void* b) {
@@ -133,7 +148,7 @@ int ads1118_sort_compare( const void* a, const void* b) {
 
 uint16_t ads1118_cp_adc_avg_queue_get(void) {
 	uint16_t tmp[ADS1118_CP_ADC_AVG_NUM];
-	memcpy(tmp, ads1118.cp_adc_avg_queue, sizeof(uint16_t)*ADS1118_CP_ADC_AVG_NUM);
+	memcpy(tmp, EVSE_CTX(ads1118).cp_adc_avg_queue, sizeof(uint16_t)*ADS1118_CP_ADC_AVG_NUM);
 
 	// Sort the queue
 	qsort(tmp, ADS1118_CP_ADC_AVG_NUM, sizeof(uint16_t), ads1118_sort_compare);
@@ -142,9 +157,26 @@ uint16_t ads1118_cp_adc_avg_queue_get(void) {
 	return tmp[ADS1118_CP_ADC_AVG_NUM*2/3];
 }
 
+// Max voltage measured without load (in mV, without ADC calibration)
+static void ads1118_cp_set_cal_max_voltage(const int16_t v) {
+	// Apply additional ADC calibration
+	if(EVSE_CTX(ads1118).cp_user_cal_active) {
+		EVSE_CTX(ads1118).cp_cal_max_voltage = v * EVSE_CTX(ads1118).cp_user_cal_mul / EVSE_CTX(ads1118).cp_user_cal_div;
+	} else {
+		EVSE_CTX(ads1118).cp_cal_max_voltage = v * EVSE_CTX(ads1118).cp_cal_mul / EVSE_CTX(ads1118).cp_cal_div;
+	}
+
+	// For the min voltage we use a fixed difference that is calibrated on intial flashing
+	if(EVSE_CTX(ads1118).cp_user_cal_active) {
+		EVSE_CTX(ads1118).cp_cal_min_voltage = -EVSE_CTX(ads1118).cp_cal_max_voltage + EVSE_CTX(ads1118).cp_user_cal_diff_voltage;
+	} else {
+		EVSE_CTX(ads1118).cp_cal_min_voltage = -EVSE_CTX(ads1118).cp_cal_max_voltage + EVSE_CTX(ads1118).cp_cal_diff_voltage;
+	}
+}
+
 void ads1118_cp_handle_continuous_calibration(const uint16_t adc_value) {
 	// We don't do the calibration if the box is not enabled
-	if(button.state == BUTTON_STATE_PRESSED) {
+	if(EVSE_CTX(button).state == BUTTON_STATE_PRESSED) {
 		return;
 	}
 
@@ -157,19 +189,19 @@ void ads1118_cp_handle_continuous_calibration(const uint16_t adc_value) {
 
 	// Do continuous calibration in IEC61851 State A
 	// and 500ms between state change and continuous calibration.
-	if((iec61851.state == IEC61851_STATE_A) && system_timer_is_time_elapsed_ms(iec61851.last_state_change, 500)) {
-		if(ads1118.moving_average_cp_adc_12v_new) {
-			ads1118.moving_average_cp_adc_12v_new = false;
-			moving_average_init(&ads1118.moving_average_cp_adc_12v, adc_value, ADS1118_MOVING_AVERAGE_LENGTH);
+	if((EVSE_CTX(iec61851).state == IEC61851_STATE_A) && system_timer_is_time_elapsed_ms(EVSE_CTX(iec61851).last_state_change, 500)) {
+		if(EVSE_CTX(ads1118).moving_average_cp_adc_12v_new) {
+			EVSE_CTX(ads1118).moving_average_cp_adc_12v_new = false;
+			moving_average_init(&EVSE_CTX(ads1118).moving_average_cp_adc_12v, adc_value, ADS1118_MOVING_AVERAGE_LENGTH);
 			for(uint8_t i = 0; i < ADS1118_CP_ADC_AVG_NUM; i++) {
-				ads1118.cp_adc_avg_queue[i] = adc_value;
+				EVSE_CTX(ads1118).cp_adc_avg_queue[i] = adc_value;
 			}
 		} else {
-			moving_average_handle_value(&ads1118.moving_average_cp_adc_12v, adc_value);
+			moving_average_handle_value(&EVSE_CTX(ads1118).moving_average_cp_adc_12v, adc_value);
 		}
 
 		// Take moving average
-		int32_t adc_max_value_avg  = moving_average_get(&ads1118.moving_average_cp_adc_12v);
+		int32_t adc_max_value_avg  = moving_average_get(&EVSE_CTX(ads1118).moving_average_cp_adc_12v);
 
 		// and put it into queue.
 		ads1118_cp_adc_avg_queue_add(adc_max_value_avg);
@@ -179,30 +211,149 @@ void ads1118_cp_handle_continuous_calibration(const uint16_t adc_value) {
 
 		// The voltage in the queue is the continuous calibrated max voltage (ADC value),
 		const int16_t v = SCALE(adc_max_value_avg, 6574, 31643, -12000, 12000);
+		ads1118_cp_set_cal_max_voltage(v);
 
-		// Apply additional ADC calibration
-		if(ads1118.cp_user_cal_active) {
-			ads1118.cp_cal_max_voltage = v * ads1118.cp_user_cal_mul / ads1118.cp_user_cal_div;
+		// Reference for the drift compensation outside of state A
+		EVSE_CTX(ads1118).cp_drift_ref_voltage = v;
+		EVSE_CTX(ads1118).cp_drift_ref_time    = system_timer_get_ms();
+	}
+}
+
+static bool ads1118_cp_is_drift_ref_fresh(void) {
+	return (EVSE_CTX(ads1118).cp_drift_ref_time != 0) && !system_timer_is_time_elapsed_ms(EVSE_CTX(ads1118).cp_drift_ref_time, 1000);
+}
+
+// Least squares fit of the voltage over the temperature through all bins that contain values.
+// The slope is only used if the learned values span a large enough temperature range.
+static void ads1118_cp_update_drift_slope(void) {
+	int32_t sum_temperature = 0;
+	int32_t sum_voltage     = 0;
+	int16_t min_temperature = INT16_MAX;
+	int16_t max_temperature = INT16_MIN;
+	uint8_t num             = 0;
+
+	for(uint8_t i = 0; i < ADS1118_DRIFT_BIN_NUM; i++) {
+		const ADS1118DriftBin *bin = &EVSE_CTX(ads1118).cp_drift_bins[i];
+		if(bin->count > 0) {
+			sum_temperature += bin->temperature;
+			sum_voltage     += bin->voltage;
+			min_temperature  = MIN(min_temperature, bin->temperature);
+			max_temperature  = MAX(max_temperature, bin->temperature);
+			num++;
+		}
+	}
+
+	// Until enough is learned again the slope from the config page (if any) stays in use
+	if((num < 2) || (max_temperature - min_temperature < ADS1118_DRIFT_MIN_SPAN)) {
+		return;
+	}
+
+	const int32_t mean_temperature = sum_temperature/num;
+	const int32_t mean_voltage     = sum_voltage/num;
+	int64_t sum_xy = 0;
+	int64_t sum_xx = 0;
+	for(uint8_t i = 0; i < ADS1118_DRIFT_BIN_NUM; i++) {
+		const ADS1118DriftBin *bin = &EVSE_CTX(ads1118).cp_drift_bins[i];
+		if(bin->count > 0) {
+			const int32_t dx = bin->temperature - mean_temperature;
+			const int32_t dy = bin->voltage     - mean_voltage;
+			sum_xy += dx*dy;
+			sum_xx += dx*dx;
+		}
+	}
+
+	// Temperature is in 1/100 °C, slope is in mV per °C
+	const int32_t slope              = sum_xy*100*(1 << ADS1118_DRIFT_SLOPE_SHIFT)/sum_xx;
+	EVSE_CTX(ads1118).cp_drift_slope = BETWEEN(-ADS1118_DRIFT_SLOPE_MAX, slope, ADS1118_DRIFT_SLOPE_MAX);
+	EVSE_CTX(ads1118).cp_drift_valid = true;
+}
+
+// Called for every new temperature. In state A the max CP voltage from the continuous calibration
+// is learned together with the temperature. During B/C/D the continuous calibration can't see
+// the +12V, here the last value from state A is corrected by the learned drift instead.
+static void ads1118_cp_handle_drift(void) {
+	if(EVSE_CTX(iec61851).state == IEC61851_STATE_A) {
+		if(!ads1118_cp_is_drift_ref_fresh()) {
+			return;
+		}
+
+		EVSE_CTX(ads1118).cp_drift_ref_temperature = EVSE_CTX(ads1118).temperature;
+		if(EVSE_CTX(ads1118).cp_drift_ref_temperature < ADS1118_DRIFT_BIN_MIN) {
+			return;
+		}
+
+		const uint8_t index = (EVSE_CTX(ads1118).cp_drift_ref_temperature - ADS1118_DRIFT_BIN_MIN)/ADS1118_DRIFT_BIN_WIDTH;
+		if(index >= ADS1118_DRIFT_BIN_NUM) {
+			return;
+		}
+
+		ADS1118DriftBin *bin = &EVSE_CTX(ads1118).cp_drift_bins[index];
+		if(bin->count == 0) {
+			bin->temperature = EVSE_CTX(ads1118).cp_drift_ref_temperature;
+			bin->voltage     = EVSE_CTX(ads1118).cp_drift_ref_voltage;
 		} else {
-			ads1118.cp_cal_max_voltage = v * ads1118.cp_cal_mul / ads1118.cp_cal_div;
+			bin->temperature += (EVSE_CTX(ads1118).cp_drift_ref_temperature - bin->temperature) / (1 << ADS1118_DRIFT_FILTER_SHIFT);
+			bin->voltage     += (EVSE_CTX(ads1118).cp_drift_ref_voltage     - bin->voltage)     / (1 << ADS1118_DRIFT_FILTER_SHIFT);
 		}
+		bin->count = MIN(bin->count + 1, UINT8_MAX);
+
+		ads1118_cp_update_drift_slope();
+		return;
+	}
+
+	// No compensation while calibrating (calibration values are measured against the uncorrected max voltage)
+	if(!EVSE_CTX(ads1118).cp_drift_compensation_active || !EVSE_CTX(ads1118).cp_drift_valid || (EVSE_CTX(ads1118).cp_drift_ref_time == 0) ||
+	   (EVSE_CTX(evse).calibration_state != 0) || calibration_is_running()) {
+		return;
+	}
+
+	const int32_t correction = (EVSE_CTX(ads1118).temperature - EVSE_CTX(ads1118).cp_drift_ref_temperature)*EVSE_CTX(ads1118).cp_drift_slope/(100*(1 << ADS1118_DRIFT_SLOPE_SHIFT));
+	ads1118_cp_set_cal_max_voltage(EVSE_CTX(ads1118).cp_drift_ref_voltage + BETWEEN(-ADS1118_DRIFT_CORRECTION_MAX, correction, ADS1118_DRIFT_CORRECTION_MAX));
+}
+
+void ads1118_update_calibration_knots(void) {
+	const int16_t *cal_880ohm = EVSE_CTX(ads1118).cp_user_cal_active ? EVSE_CTX(ads1118).cp_user_cal_880ohm : EVSE_CTX(ads1118).cp_cal_880ohm;
+	ADS1118CalKnot *knots     = EVSE_CTX(ads1118).cp_cal_880ohm_knots;
+
+	for(uint8_t i = 0; i < ADS1118_880OHM_CAL_NUM; i++) {
+		knots[i].duty_cycle = iec61851_get_duty_cycle_for_ma(6000 + i*2000);
+		knots[i].offset     = cal_880ohm[i];
+	}
 
-		// For the min voltage we use a fixed difference that is calibrated on intial flashing
-		if(ads1118.cp_user_cal_active) {
-			ads1118.cp_cal_min_voltage = -ads1118.cp_cal_max_voltage + ads1118.cp_user_cal_diff_voltage;
+	// The last knot has no slope, above 32A its offset is used as is
+	for(uint8_t i = 0; i < ADS1118_880OHM_CAL_NUM; i++) {
+		if(i == ADS1118_880OHM_CAL_NUM-1) {
+			knots[i].slope = 0;
 		} else {
-			ads1118.cp_cal_min_voltage = -ads1118.cp_cal_max_voltage + ads1118.cp_cal_diff_voltage;
+			knots[i].slope = ((int32_t)knots[i+1].offset - knots[i].offset)*(1 << ADS1118_CAL_SLOPE_SHIFT)/(knots[i+1].duty_cycle - knots[i].duty_cycle);
 		}
 	}
 }
 
+// Offset of the 880 Ohm calibration for the given duty cycle,
+// clamped to the first/last knot outside of the calibrated 6A-32A.
+static int16_t ads1118_get_cal_880ohm(const uint16_t duty_cycle) {
+	const ADS1118CalKnot *knots = EVSE_CTX(ads1118).cp_cal_880ohm_knots;
+	if(duty_cycle <= knots[0].duty_cycle) {
+		return knots[0].offset;
+	}
+
+	uint8_t i = ADS1118_880OHM_CAL_NUM-1;
+	while(duty_cycle < knots[i].duty_cycle) {
+		i--;
+	}
+
+	return knots[i].offset + ((knots[i].slope*(duty_cycle - knots[i].duty_cycle)) >> ADS1118_CAL_SLOPE_SHIFT);
+}
+
 void ads1118_cp_voltage_from_miso(const uint8_t *miso) {
-	ads1118.cp_adc_value = (miso[1] | (miso[0] << 8));
-	ads1118_cp_handle_continuous_calibration(ads1118.cp_adc_value);
+	EVSE_CTX(ads1118).cp_adc_value = (miso[1] | (miso[0] << 8));
+	ads1118_cp_handle_continuous_calibration(EVSE_CTX(ads1118).cp_adc_value);
 
 	// adc_sum and adc_sum_count is used during calibration and otherwise ignored
-	ads1118.cp_adc_sum += ads1118.cp_adc_value;
-	ads1118.cp_adc_sum_count++;
+	EVSE_CTX(ads1118).cp_adc_sum += EVSE_CTX(ads1118).cp_adc_value;
+	EVSE_CTX(ads1118).cp_adc_sum_square += EVSE_CTX(ads1118).cp_adc_value*EVSE_CTX(ads1118).cp_adc_value;
+	EVSE_CTX(ads1118).cp_adc_sum_count++;
 
 	// 0.8217V => -12V
 	// 3.9554V =>  12V
@@ -211,14 +362,19 @@ void ads1118_cp_voltage_from_miso(const uint8_t *miso) {
 	// 6574 LSB  => -12V
 	// 31643 LSB =>  12V
 
-	ads1118.cp_voltage = SCALE(ads1118.cp_adc_value, 6574, 31643, -12000, 12000);
-	if(ads1118.cp_user_cal_active) {
-		ads1118.cp_voltage_calibrated = ads1118.cp_voltage * ads1118.cp_user_cal_mul / ads1118.cp_user_cal_div;
+	EVSE_CTX(ads1118).cp_voltage = SCALE(EVSE_CTX(ads1118).cp_adc_value, 6574, 31643, -12000, 12000);
+	if(EVSE_CTX(ads1118).cp_user_cal_active) {
+		EVSE_CTX(ads1118).cp_voltage_calibrated = EVSE_CTX(ads1118).cp_voltage * EVSE_CTX(ads1118).cp_user_cal_mul / EVSE_CTX(ads1118).cp_user_cal_div;
 	} else {
-		ads1118.cp_voltage_calibrated = ads1118.cp_voltage * ads1118.cp_cal_mul / ads1118.cp_cal_div;
+		EVSE_CTX(ads1118).cp_voltage_calibrated = EVSE_CTX(ads1118).cp_voltage * EVSE_CTX(ads1118).cp_cal_mul / EVSE_CTX(ads1118).cp_cal_div;
 	}
 	const uint16_t current_cp_duty_cycle = evse_get_cp_duty_cycle();
-	ads1118.cp_high_voltage = (ads1118.cp_voltage_calibrated - ads1118.cp_cal_min_voltage)*1000/current_cp_duty_cycle + ads1118.cp_cal_min_voltage;
+	if(current_cp_duty_cycle == 0) {
+		// 0% duty cycle is only used to measure -12V during calibration, there is no high phase
+		EVSE_CTX(ads1118).cp_high_voltage = EVSE_CTX(ads1118).cp_voltage_calibrated;
+	} else {
+		EVSE_CTX(ads1118).cp_high_voltage = (EVSE_CTX(ads1118).cp_voltage_calibrated - EVSE_CTX(ads1118).cp_cal_min_voltage)*1000/current_cp_duty_cycle + EVSE_CTX(ads1118).cp_cal_min_voltage;
+	}
 
 
 	// If the measured high voltage is near the calibration max voltage
@@ -232,88 +388,128 @@ void ads1118_cp_voltage_from_miso(const uint8_t *miso) {
 	// other cars, we assume this is some kind of capacitive effect. To make sure
 	// that we don't cancel the charging here, we increase the "infinite resistance"
 	// threshold for this scenario.
-	const bool id3_mode = (current_cp_duty_cycle != 1000) && !XMC_GPIO_GetInput(EVSE_RELAY_PIN);
-	const bool has_forced_16a = !XMC_GPIO_GetInput(EVSE_RELAY_PIN) && (current_cp_duty_cycle == 266);
-	if(!has_forced_16a && id3_mode && (ads1118.cp_high_voltage + 500 > ads1118.cp_cal_max_voltage)) {
+	const bool id3_mode = (current_cp_duty_cycle != 1000) && !evse_is_relay_active();
+	const bool has_forced_16a = !evse_is_relay_active() && (current_cp_duty_cycle == 266);
+	if(!has_forced_16a && id3_mode && (EVSE_CTX(ads1118).cp_high_voltage + 500 > EVSE_CTX(ads1118).cp_cal_max_voltage)) {
 		new_resistance = 0xFFFF;
-	} else if(!has_forced_16a && !id3_mode && (ads1118.cp_high_voltage + 1000 > ads1118.cp_cal_max_voltage)) {
+	} else if(!has_forced_16a && !id3_mode && (EVSE_CTX(ads1118).cp_high_voltage + 1000 > EVSE_CTX(ads1118).cp_cal_max_voltage)) {
 		new_resistance = 0xFFFF;
 	} else {
 		// resistance divider, 910 ohm on EVSE
 		// diode voltage drop 650mV (value is educated guess)
 		// voltage drop of opamp under with 880 ohm load: 617mV
 		if(current_cp_duty_cycle == 1000) { // w/o PWM
-			if(ads1118.cp_user_cal_active) {
-				if(ads1118.cp_high_voltage > (ads1118.cp_cal_max_voltage - ads1118.cp_user_cal_2700ohm)) {
+			if(EVSE_CTX(ads1118).cp_user_cal_active) {
+				if(EVSE_CTX(ads1118).cp_high_voltage > (EVSE_CTX(ads1118).cp_cal_max_voltage - EVSE_CTX(ads1118).cp_user_cal_2700ohm)) {
 					new_resistance = 0xFFFF;
 				} else {
-					new_resistance = 910*(ads1118.cp_high_voltage - ADS1118_DIODE_DROP)/((ads1118.cp_cal_max_voltage - ads1118.cp_user_cal_2700ohm) - ads1118.cp_high_voltage);
+					new_resistance = 910*(EVSE_CTX(ads1118).cp_high_voltage - ADS1118_DIODE_DROP)/((EVSE_CTX(ads1118).cp_cal_max_voltage - EVSE_CTX(ads1118).cp_user_cal_2700ohm) - EVSE_CTX(ads1118).cp_high_voltage);
 				}
 			} else {
-				if(ads1118.cp_high_voltage > (ads1118.cp_cal_max_voltage - ads1118.cp_cal_2700ohm)) {
+				if(EVSE_CTX(ads1118).cp_high_voltage > (EVSE_CTX(ads1118).cp_cal_max_voltage - EVSE_CTX(ads1118).cp_cal_2700ohm)) {
 					new_resistance = 0xFFFF;
 				} else {
-					new_resistance = 910*(ads1118.cp_high_voltage - ADS1118_DIODE_DROP)/((ads1118.cp_cal_max_voltage - ads1118.cp_cal_2700ohm) - ads1118.cp_high_voltage);
+					new_resistance = 910*(EVSE_CTX(ads1118).cp_high_voltage - ADS1118_DIODE_DROP)/((EVSE_CTX(ads1118).cp_cal_max_voltage - EVSE_CTX(ads1118).cp_cal_2700ohm) - EVSE_CTX(ads1118).cp_high_voltage);
 				}
 			}
 		} else { // w/ PWM
-			uint32_t ma = iec61851_get_max_ma();
-
-			uint32_t index = SCALE(ma, 6000, 32000, 0, ADS1118_880OHM_CAL_NUM-1);
-			// Special handling for 16A forced mode
-			if(current_cp_duty_cycle == 266) {
-				index = 5;
-			}
-			if(ads1118.cp_user_cal_active) {
-				if(ads1118.cp_high_voltage > (ads1118.cp_cal_max_voltage - ads1118.cp_user_cal_880ohm[index])) {
-					new_resistance = 0xFFFF;
-				} else {
-					new_resistance = 910*(ads1118.cp_high_voltage - ADS1118_DIODE_DROP)/((ads1118.cp_cal_max_voltage - ads1118.cp_user_cal_880ohm[index])  - ads1118.cp_high_voltage);
-				}
+			// The offset follows the duty cycle that is actually applied (including boost mode and forced 16A)
+			const int16_t cal_880ohm = ads1118_get_cal_880ohm(current_cp_duty_cycle);
+			if(EVSE_CTX(ads1118).cp_high_voltage > (EVSE_CTX(ads1118).cp_cal_max_voltage - cal_880ohm)) {
+				new_resistance = 0xFFFF;
 			} else {
-				if(ads1118.cp_high_voltage > (ads1118.cp_cal_max_voltage - ads1118.cp_cal_880ohm[index])) {
-					new_resistance = 0xFFFF;
-				} else {
-					new_resistance = 910*(ads1118.cp_high_voltage - ADS1118_DIODE_DROP)/((ads1118.cp_cal_max_voltage - ads1118.cp_cal_880ohm[index])  - ads1118.cp_high_voltage);
-				}
+				new_resistance = 910*(EVSE_CTX(ads1118).cp_high_voltage - ADS1118_DIODE_DROP)/((EVSE_CTX(ads1118).cp_cal_max_voltage - cal_880ohm) - EVSE_CTX(ads1118).cp_high_voltage);
 			}
 		}
 		new_resistance = MIN(0xFFFF, new_resistance);
 	}
 
-	if(ads1118.moving_average_cp_new) {
-		ads1118.moving_average_cp_new = false;
-		moving_average_init(&ads1118.moving_average_cp, new_resistance, ADS1118_MOVING_AVERAGE_LENGTH);
+	if(EVSE_CTX(ads1118).moving_average_cp_new) {
+		EVSE_CTX(ads1118).moving_average_cp_new = false;
+		moving_average_init(&EVSE_CTX(ads1118).moving_average_cp, new_resistance, ADS1118_MOVING_AVERAGE_LENGTH);
 	} else {
-		moving_average_handle_value(&ads1118.moving_average_cp, new_resistance);
+		moving_average_handle_value(&EVSE_CTX(ads1118).moving_average_cp, new_resistance);
 	}
 
-	ads1118.cp_pe_resistance = moving_average_get(&ads1118.moving_average_cp);
+	EVSE_CTX(ads1118).cp_pe_resistance = moving_average_get(&EVSE_CTX(ads1118).moving_average_cp);
 }
 
 void ads1118_pp_voltage_from_miso(const uint8_t *miso) {
-	ads1118.pp_adc_value = (miso[1] | (miso[0] << 8));
+	EVSE_CTX(ads1118).pp_adc_value = (miso[1] | (miso[0] << 8));
 
 	// 1 LSB = 125uV
-	ads1118.pp_voltage = ads1118.pp_adc_value/8;
+	EVSE_CTX(ads1118).pp_voltage = EVSE_CTX(ads1118).pp_adc_value/8;
 
 	uint32_t new_resistance;
 	// If the measured high voltage is near the calibration max voltage
 	// we assume that there is no resistance
-	if(ABS(ads1118.pp_voltage - 4095) < 150) {
+	if(ABS(EVSE_CTX(ads1118).pp_voltage - 4095) < 150) {
 		new_resistance = 0xFFFFFFFF;
 	} else {
-		new_resistance = 1000*ads1118.pp_voltage/(5000 - ads1118.pp_voltage);
+		new_resistance = 1000*EVSE_CTX(ads1118).pp_voltage/(5000 - EVSE_CTX(ads1118).pp_voltage);
 	}
 
-	if(ads1118.moving_average_pp_new) {
-		ads1118.moving_average_pp_new = false;
-		moving_average_init(&ads1118.moving_average_pp, new_resistance, ADS1118_MOVING_AVERAGE_LENGTH);
+	if(EVSE_CTX(ads1118).moving_average_pp_new) {
+		EVSE_CTX(ads1118).moving_average_pp_new = false;
+		moving_average_init(&EVSE_CTX(ads1118).moving_average_pp, new_resistance, ADS1118_MOVING_AVERAGE_LENGTH);
 	} else {
-		moving_average_handle_value(&ads1118.moving_average_pp, new_resistance);
+		moving_average_handle_value(&EVSE_CTX(ads1118).moving_average_pp, new_resistance);
+	}
+
+	EVSE_CTX(ads1118).pp_pe_resistance = moving_average_get(&EVSE_CTX(ads1118).moving_average_pp);
+	scheduler_trigger(SCHEDULER_TASK_CHARGING_SLOT);
+}
+
+void ads1118_temperature_from_miso(const uint8_t *miso) {
+	// 14 bit left aligned, 1 LSB = 0.03125°C
+	const int16_t value = ((int16_t)(miso[1] | (miso[0] << 8))) >> 2;
+
+	EVSE_CTX(ads1118).temperature      = value*25/8;
+	EVSE_CTX(ads1118).temperature_time = system_timer_get_ms();
+	scheduler_trigger(SCHEDULER_TASK_DERATING);
+
+	ads1118_cp_handle_drift();
+}
+
+// Called directly after a CP/PP result was read together with the temperature configuration.
+// Reads the temperature and configures the channel that would have been configured otherwise.
+uint32_t ads1118_task_temperature(const uint8_t channel, const bool normal) {
+	const XMC_GPIO_CONFIG_t config_low = {
+		.mode         = XMC_GPIO_MODE_OUTPUT_PUSH_PULL,
+		.output_level = XMC_GPIO_OUTPUT_LEVEL_LOW,
+	};
+
+	const XMC_GPIO_CONFIG_t config_select = {
+		.mode         = ADS1118_SELECT_PIN_MODE,
+		.output_level = XMC_GPIO_OUTPUT_LEVEL_LOW,
+	};
+
+	uint8_t miso[2] = {0, 0};
+
+	// Wait for DRDY
+	coop_task_sleep_ms(1);
+	XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_low);
+
+	uint32_t configure_time = system_timer_get_ms();
+	while(XMC_GPIO_GetInput(ADS1118_MISO_PORT, ADS1118_MISO_PIN)) {
+		if(system_timer_is_time_elapsed_ms(configure_time, ADS1118_TEMPERATURE_CONFIGURE_TIMEOUT)) {
+			// Give up on this temperature conversion, CP/PP measurement is more important
+			XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_select);
+			spi_fifo_coop_transceive(&EVSE_CTX(ads1118).spi_fifo, 2, ads1118_get_config_for_mosi(channel, normal), miso);
+			EVSE_CTX(ads1118).temperature_time = system_timer_get_ms();
+			scheduler_trigger(SCHEDULER_TASK_DERATING);
+			return system_timer_get_ms();
+		}
+		scheduler_set_deadline_in(SCHEDULER_TASK_ADS1118, 1);
+		coop_task_yield();
 	}
+	XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_select);
 
-	ads1118.pp_pe_resistance = moving_average_get(&ads1118.moving_average_pp);
+	// Read temperature -> Configure CP/PP
+	spi_fifo_coop_transceive(&EVSE_CTX(ads1118).spi_fifo, 2, ads1118_get_config_for_mosi(channel, normal), miso);
+	ads1118_temperature_from_miso(miso);
+
+	return system_timer_get_ms();
 }
 
 // ADS1118 runs with 8 samples per second, so each loop takes about 250ms
@@ -331,6 +527,7 @@ uint32_t ads1118_task_normal_loop(uint32_t configure_time) {
 	uint8_t miso[2] = {0, 0};
 
 	// Wait for DRDY
+	scheduler_set_deadline_in(SCHEDULER_TASK_ADS1118, 10);
 	coop_task_sleep_ms(10);
 	XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_low);
 
@@ -338,22 +535,25 @@ uint32_t ads1118_task_normal_loop(uint32_t configure_time) {
 	while(XMC_GPIO_GetInput(ADS1118_MISO_PORT, ADS1118_MISO_PIN)) {
 		if(system_timer_is_time_elapsed_ms(configure_time, ADS1118_CONFIGURE_TIMEOUT)) {
 			XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_select);
-			spi_fifo_coop_transceive(&ads1118.spi_fifo, 2, ads1118_get_config_for_mosi(0, true), miso);
+			spi_fifo_coop_transceive(&EVSE_CTX(ads1118).spi_fifo, 2, ads1118_get_config_for_mosi(0, true), miso);
 			XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_low);
 			configure_time = system_timer_get_ms();
 		}
+		// Conversion takes ~125ms, it is enough to poll DRDY once per ms
+		scheduler_set_deadline_in(SCHEDULER_TASK_ADS1118, 1);
 		coop_task_yield();
 	}
 	XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_select);
 	// Read CP -> Configure PP
-	spi_fifo_coop_transceive(&ads1118.spi_fifo, 2, ads1118_get_config_for_mosi(1, true), miso);
-	if(ads1118.cp_invalid_counter > 0) {
-		ads1118.cp_invalid_counter--;
+	spi_fifo_coop_transceive(&EVSE_CTX(ads1118).spi_fifo, 2, ads1118_get_config_for_mosi(1, true), miso);
+	if(EVSE_CTX(ads1118).cp_invalid_counter > 0) {
+		EVSE_CTX(ads1118).cp_invalid_counter--;
 	} else {
 		ads1118_cp_voltage_from_miso(miso);
 	}
 
 	// Wait for DRDY
+	scheduler_set_deadline_in(SCHEDULER_TASK_ADS1118, 10);
 	coop_task_sleep_ms(10);
 	XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_low);
 
@@ -361,21 +561,28 @@ uint32_t ads1118_task_normal_loop(uint32_t configure_time) {
 	while(XMC_GPIO_GetInput(ADS1118_MISO_PORT, ADS1118_MISO_PIN)) {
 		if(system_timer_is_time_elapsed_ms(configure_time, ADS1118_CONFIGURE_TIMEOUT)) {
 			XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_select);
-			spi_fifo_coop_transceive(&ads1118.spi_fifo, 2, ads1118_get_config_for_mosi(1, true), miso);
+			spi_fifo_coop_transceive(&EVSE_CTX(ads1118).spi_fifo, 2, ads1118_get_config_for_mosi(1, true), miso);
 			XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_low);
 			configure_time = system_timer_get_ms();
 		}
+		// Conversion takes ~125ms, it is enough to poll DRDY once per ms
+		scheduler_set_deadline_in(SCHEDULER_TASK_ADS1118, 1);
 		coop_task_yield();
 	}
 	XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_select);
-	// Read PP -> Configure CP
-	spi_fifo_coop_transceive(&ads1118.spi_fifo, 2, ads1118_get_config_for_mosi(0, true), miso);
-	if(ads1118.pp_invalid_counter > 0) {
-		ads1118.pp_invalid_counter--;
+	// Read PP -> Configure CP (or temperature first)
+	const bool temperature = ads1118_is_temperature_due();
+	spi_fifo_coop_transceive(&EVSE_CTX(ads1118).spi_fifo, 2, temperature ? ads1118_get_temperature_config_for_mosi() : ads1118_get_config_for_mosi(0, true), miso);
+	if(EVSE_CTX(ads1118).pp_invalid_counter > 0) {
+		EVSE_CTX(ads1118).pp_invalid_counter--;
 	} else {
 		ads1118_pp_voltage_from_miso(miso);
 	}
 
+	if(temperature) {
+		configure_time = ads1118_task_temperature(0, true);
+	}
+
 	return configure_time;
 }
 
@@ -401,7 +608,7 @@ uint32_t ads1118_task_fast_loop(uint32_t configure_time) {
 	while(XMC_GPIO_GetInput(ADS1118_MISO_PORT, ADS1118_MISO_PIN)) {
 		if(system_timer_is_time_elapsed_ms(configure_time, ADS1118_CONFIGURE_TIMEOUT)) {
 			XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_select);
-			spi_fifo_coop_transceive(&ads1118.spi_fifo, 2, ads1118_get_config_for_mosi(0, false), miso);
+			spi_fifo_coop_transceive(&EVSE_CTX(ads1118).spi_fifo, 2, ads1118_get_config_for_mosi(0, false), miso);
 			XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_low);
 			configure_time = system_timer_get_ms();
 		}
@@ -409,14 +616,19 @@ uint32_t ads1118_task_fast_loop(uint32_t configure_time) {
 	}
 	XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_select);
 
-	// Read / Configure CP
-	spi_fifo_coop_transceive(&ads1118.spi_fifo, 2, ads1118_get_config_for_mosi(0, false), miso);
-	if(ads1118.cp_invalid_counter > 0) {
-		ads1118.cp_invalid_counter--;
+	// Read / Configure CP (or temperature first)
+	const bool temperature = ads1118_is_temperature_due();
+	spi_fifo_coop_transceive(&EVSE_CTX(ads1118).spi_fifo, 2, temperature ? ads1118_get_temperature_config_for_mosi() : ads1118_get_config_for_mosi(0, false), miso);
+	if(EVSE_CTX(ads1118).cp_invalid_counter > 0) {
+		EVSE_CTX(ads1118).cp_invalid_counter--;
 	} else {
 		ads1118_cp_voltage_from_miso(miso);
 	}
 
+	if(temperature) {
+		configure_time = ads1118_task_temperature(0, false);
+	}
+
 	return configure_time;
 }
 
@@ -441,7 +653,7 @@ uint32_t ads1118_task_fast_find_version(uint32_t configure_time) {
 	while(XMC_GPIO_GetInput(ADS1118_MISO_PORT, ADS1118_MISO_PIN)) {
 		if(system_timer_is_time_elapsed_ms(configure_time, ADS1118_CONFIGURE_TIMEOUT)) {
 			XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_select);
-			spi_fifo_coop_transceive(&ads1118.spi_fifo, 2, ads1118_get_config_for_mosi(3, true), miso);
+			spi_fifo_coop_transceive(&EVSE_CTX(ads1118).spi_fifo, 2, ads1118_get_config_for_mosi(3, true), miso);
 			XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_low);
 			configure_time = system_timer_get_ms();
 		}
@@ -450,21 +662,21 @@ uint32_t ads1118_task_fast_find_version(uint32_t configure_time) {
 	XMC_GPIO_Init(ADS1118_SELECT_PORT, ADS1118_SELECT_PIN, &config_select);
 
 	// Read / Configure CP
-	spi_fifo_coop_transceive(&ads1118.spi_fifo, 2, ads1118_get_config_for_mosi(3, true), miso);
-	if(ads1118.cp_invalid_counter > 0) {
-		ads1118.cp_invalid_counter--;
+	spi_fifo_coop_transceive(&EVSE_CTX(ads1118).spi_fifo, 2, ads1118_get_config_for_mosi(3, true), miso);
+	if(EVSE_CTX(ads1118).cp_invalid_counter > 0) {
+		EVSE_CTX(ads1118).cp_invalid_counter--;
 	} else {
 		// To find out if the EVSE is hardware version 1.5 we measure between IN1 und GND.
 		// In version 1.4 and lower in1 is connected to GND and we will measure something near 0.
 		// In version 1.5 in1 is used for the CP/PE measurement and we expect a value > 0.
-		const uint16_t in1_vs_gnd = (miso[1] | (miso[0] << 8));
-		ads1118.is_v15            = in1_vs_gnd > 128;
-		ads1118.version_found     = true;
+		const uint16_t in1_vs_gnd           = (miso[1] | (miso[0] << 8));
+		EVSE_CTX(ads1118).is_v15            = in1_vs_gnd > 128;
+		EVSE_CTX(ads1118).version_found     = true;
 
 		// Invalidate the next measurement on both channels,
 		// to make sure that this can't be mixed up with the version test measurements
-		ads1118.pp_invalid_counter = MAX(ads1118.pp_invalid_counter, 1);
-		ads1118.cp_invalid_counter = MAX(ads1118.cp_invalid_counter, 1);
+		EVSE_CTX(ads1118).pp_invalid_counter = MAX(EVSE_CTX(ads1118).pp_invalid_counter, 1);
+		EVSE_CTX(ads1118).cp_invalid_counter = MAX(EVSE_CTX(ads1118).cp_invalid_counter, 1);
 	}
 
 	return configure_time;
@@ -474,7 +686,7 @@ void ads1118_task_tick(void) {
 	uint8_t miso[2] = {0, 0};
 
 	// Configure for find version
-	spi_fifo_coop_transceive(&ads1118.spi_fifo, 2, ads1118_get_config_for_mosi(3, true), miso);
+	spi_fifo_coop_transceive(&EVSE_CTX(ads1118).spi_fifo, 2, ads1118_get_config_for_mosi(3, true), miso);
 
 	uint32_t configure_time = 0;
 
@@ -490,8 +702,8 @@ void ads1118_task_tick(void) {
 		// The voltage between PP/PE is ignored (the cable obviously can't be
 		// changed out while a car is charging, so it is save to ignore the
 		// PP/PE voltage while in state C).
-		if(ads1118.version_found) {
-			if(XMC_GPIO_GetInput(EVSE_RELAY_PIN)) {
+		if(EVSE_CTX(ads1118).version_found) {
+			if(evse_is_relay_active()) {
 				configure_time = ads1118_task_fast_loop(configure_time);
 			} else {
 				configure_time = ads1118_task_normal_loop(configure_time);
@@ -506,48 +718,75 @@ void ads1118_task_tick(void) {
 
 void ads1118_init(void) {
 	// Temporarily save calibration
-	int16_t tmp_diff = ads1118.cp_cal_diff_voltage;
-	int16_t tmp_div  = ads1118.cp_cal_div;
-	int16_t tmp_mul  = ads1118.cp_cal_mul;
-	int16_t tmp_2700 = ads1118.cp_cal_2700ohm;
+	int16_t tmp_diff = EVSE_CTX(ads1118).cp_cal_diff_voltage;
+	int16_t tmp_div  = EVSE_CTX(ads1118).cp_cal_div;
+	int16_t tmp_mul  = EVSE_CTX(ads1118).cp_cal_mul;
+	int16_t tmp_2700 = EVSE_CTX(ads1118).cp_cal_2700ohm;
 	int16_t tmp_880[ADS1118_880OHM_CAL_NUM];
-	memcpy(tmp_880, ads1118.cp_cal_880ohm, ADS1118_880OHM_CAL_NUM*sizeof(int16_t));
+	memcpy(tmp_880, EVSE_CTX(ads1118).cp_cal_880ohm, ADS1118_880OHM_CAL_NUM*sizeof(int16_t));
 
-	bool tmp_user_active  = ads1118.cp_user_cal_active;
-	int16_t tmp_user_diff = ads1118.cp_user_cal_diff_voltage;
-	int16_t tmp_user_div  = ads1118.cp_user_cal_div;
-	int16_t tmp_user_mul  = ads1118.cp_user_cal_mul;
-	int16_t tmp_user_2700 = ads1118.cp_user_cal_2700ohm;
+	bool tmp_user_active  = EVSE_CTX(ads1118).cp_user_cal_active;
+	int16_t tmp_user_diff = EVSE_CTX(ads1118).cp_user_cal_diff_voltage;
+	int16_t tmp_user_div  = EVSE_CTX(ads1118).cp_user_cal_div;
+	int16_t tmp_user_mul  = EVSE_CTX(ads1118).cp_user_cal_mul;
+	int16_t tmp_user_2700 = EVSE_CTX(ads1118).cp_user_cal_2700ohm;
 	int16_t tmp_user_880[ADS1118_880OHM_CAL_NUM];
-	memcpy(tmp_user_880, ads1118.cp_user_cal_880ohm, ADS1118_880OHM_CAL_NUM*sizeof(int16_t));
-
-	memset(&ads1118, 0, sizeof(ADS1118));
+	memcpy(tmp_user_880, EVSE_CTX(ads1118).cp_user_cal_880ohm, ADS1118_880OHM_CAL_NUM*sizeof(int16_t));
+
+	// Temporarily save drift slope
+	bool tmp_drift_valid   = EVSE_CTX(ads1118).cp_drift_valid;
+	int32_t tmp_drift_slope = EVSE_CTX(ads1118).cp_drift_slope;
+
+	memset(&EVSE_CTX(ads1118), 0, sizeof(ADS1118));
+
+	EVSE_CTX(ads1118).cp_cal_diff_voltage           = tmp_diff;
+	EVSE_CTX(ads1118).cp_cal_div                    = tmp_div;
+	EVSE_CTX(ads1118).cp_cal_mul                    = tmp_mul;
+	EVSE_CTX(ads1118).cp_cal_2700ohm                = tmp_2700;
+	memcpy(EVSE_CTX(ads1118).cp_cal_880ohm, tmp_880, ADS1118_880OHM_CAL_NUM*sizeof(int16_t));
+
+	EVSE_CTX(ads1118).cp_user_cal_active            = tmp_user_active;
+	EVSE_CTX(ads1118).cp_user_cal_diff_voltage      = tmp_user_diff;
+	EVSE_CTX(ads1118).cp_user_cal_div               = tmp_user_div;
+	EVSE_CTX(ads1118).cp_user_cal_mul               = tmp_user_mul;
+	EVSE_CTX(ads1118).cp_user_cal_2700ohm           = tmp_user_2700;
+	memcpy(EVSE_CTX(ads1118).cp_user_cal_880ohm, tmp_user_880, ADS1118_880OHM_CAL_NUM*sizeof(int16_t));
+	ads1118_update_calibration_knots();
+
+	EVSE_CTX(ads1118).cp_drift_valid                = tmp_drift_valid;
+	EVSE_CTX(ads1118).cp_drift_slope                = tmp_drift_slope;
+	EVSE_CTX(ads1118).cp_drift_valid_saved          = tmp_drift_valid;
+	EVSE_CTX(ads1118).cp_drift_slope_saved          = tmp_drift_slope;
+
+	EVSE_CTX(ads1118).cp_cal_max_voltage            = 12193;  // Set some sane default values for min/max voltages.
+	EVSE_CTX(ads1118).cp_cal_min_voltage            = -12289; // These will be overwritten by continuous calibration later on.
+	EVSE_CTX(ads1118).moving_average_cp_adc_12v_new = true;
+	EVSE_CTX(ads1118).moving_average_cp_new         = true;
+	EVSE_CTX(ads1118).moving_average_pp_new         = true;
+	EVSE_CTX(ads1118).cp_drift_compensation_active  = true;
 
-	ads1118.cp_cal_diff_voltage           = tmp_diff;
-	ads1118.cp_cal_div                    = tmp_div;
-	ads1118.cp_cal_mul                    = tmp_mul;
-	ads1118.cp_cal_2700ohm                = tmp_2700;
-	memcpy(ads1118.cp_cal_880ohm, tmp_880, ADS1118_880OHM_CAL_NUM*sizeof(int16_t));
-
-	ads1118.cp_user_cal_active            = tmp_user_active;
-	ads1118.cp_user_cal_diff_voltage      = tmp_user_diff;
-	ads1118.cp_user_cal_div               = tmp_user_div;
-	ads1118.cp_user_cal_mul               = tmp_user_mul;
-	ads1118.cp_user_cal_2700ohm           = tmp_user_2700;
-	memcpy(ads1118.cp_user_cal_880ohm, tmp_user_880, ADS1118_880OHM_CAL_NUM*sizeof(int16_t));
+	ads1118_init_spi();
+	coop_task_init(&EVSE_CTX(ads1118_task), ads1118_task_tick);
 
-	ads1118.cp_cal_max_voltage            = 12193;  // Set some sane default values for min/max voltages.
-	ads1118.cp_cal_min_voltage            = -12289; // These will be overwritten by continuous calibration later on.
-	ads1118.moving_average_cp_adc_12v_new = true;
-	ads1118.moving_average_cp_new         = true;
-	ads1118.moving_average_pp_new         = true;
+	// Paint task stack for high-water mark, the top of the stack
+	// already contains the initial context of the task.
+	memory_usage_paint(EVSE_CTX(ads1118_task).stack, sizeof(EVSE_CTX(ads1118_task).stack)/sizeof(uint32_t) - 16);
+}
 
-	ads1118_init_spi();
-	coop_task_init(&ads1118_task, ads1118_task_tick);
+static bool ads1118_cp_is_drift_changed(void) {
+	return (EVSE_CTX(ads1118).cp_drift_valid != EVSE_CTX(ads1118).cp_drift_valid_saved) ||
+	       (ABS(EVSE_CTX(ads1118).cp_drift_slope - EVSE_CTX(ads1118).cp_drift_slope_saved) > ADS1118_DRIFT_SLOPE_SAVE_DIFF);
 }
 
 void ads1118_tick(void) {
-	coop_task_tick(&ads1118_task);
+	PROFILER_COOP_TASK_SWITCH();
+	coop_task_tick(&EVSE_CTX(ads1118_task));
+
+	// The drift is learned in state A, so the EVSE is usually idle when the slope moved.
+	// The write of the config page blocks, it is done here and not in the task.
+	if(ads1118_cp_is_drift_changed() && evse_is_idle()) {
+		evse_save_config();
+	}
 }
 
 #pragma GCC diagnostic pop
\ No newline at end of file
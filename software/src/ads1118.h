@@ -30,10 +30,39 @@
 #define ADS1118_CP_ADC_AVG_NUM 32
 #define ADS1118_DIODE_DROP 650 // educated guess for diode drop of diode in car between CP/PE
 #define ADS1118_880OHM_CAL_NUM 14
+#define ADS1118_TEMPERATURE_INTERVAL 1000 // ms between two conversions of the internal temperature sensor
+#define ADS1118_CAL_SLOPE_SHIFT 8 // Fixed point slope of the 880 Ohm calibration knots (mV per permille duty cycle)
+
+// Drift model of the +12V CP reference over the internal temperature, see ads1118_cp_handle_drift
+#define ADS1118_DRIFT_BIN_NUM        20
+#define ADS1118_DRIFT_BIN_MIN        -2000 // 1/100 °C, 20 bins of 5°C from -20°C to 80°C
+#define ADS1118_DRIFT_BIN_WIDTH      500   // 1/100 °C
+#define ADS1118_DRIFT_FILTER_SHIFT   3     // Exponential average of the values in a bin
+#define ADS1118_DRIFT_MIN_SPAN       1000  // 1/100 °C, the model is only used if it spans at least 10°C
+#define ADS1118_DRIFT_SLOPE_SHIFT    8     // Fixed point slope (mV per °C)
+#define ADS1118_DRIFT_SLOPE_MAX      (20 << ADS1118_DRIFT_SLOPE_SHIFT)
+#define ADS1118_DRIFT_CORRECTION_MAX 300   // mV
+#define ADS1118_DRIFT_SLOPE_SAVE_DIFF (1 << (ADS1118_DRIFT_SLOPE_SHIFT - 2)) // 0.25 mV per °C, the slope is saved if it moved more than this
+
+typedef struct {
+	int16_t temperature; // 1/100 °C
+	int16_t voltage;     // Max CP voltage in mV (without ADC calibration)
+	uint8_t count;       // Number of learned values (saturates), 0 = empty
+} ADS1118DriftBin;
+
+// The 880 Ohm calibration is done at 6A, 8A, ..., 32A. For the resistance calculation the
+// calibration values are used as knots (duty cycle, offset), in between the offset is
+// interpolated linearly. The slopes to the next knot are calculated when the calibration changes.
+typedef struct {
+	uint16_t duty_cycle;
+	int16_t  offset;
+	int32_t  slope;
+} ADS1118CalKnot;
 
 typedef struct {
 	uint16_t cp_adc_value;
 	uint32_t cp_adc_sum;
+	uint64_t cp_adc_sum_square;
 	uint16_t cp_adc_sum_count;
 	int16_t  cp_voltage;
 	int16_t  cp_voltage_calibrated;
@@ -54,6 +83,20 @@ typedef struct {
 	int16_t  cp_user_cal_2700ohm;      // Calibration done by user through API
 	int16_t  cp_user_cal_880ohm[ADS1118_880OHM_CAL_NUM]; // Calibration done by user through API
 
+	ADS1118CalKnot cp_cal_880ohm_knots[ADS1118_880OHM_CAL_NUM]; // Knots of the active 880 Ohm calibration (user or flash/test)
+
+	// The continuous calibration only sees the max CP voltage in state A. In B/C/D the last
+	// value from state A is corrected by the drift that is learned over the temperature.
+	ADS1118DriftBin cp_drift_bins[ADS1118_DRIFT_BIN_NUM];
+	bool     cp_drift_valid;
+	int32_t  cp_drift_slope;           // mV per °C, fixed point with ADS1118_DRIFT_SLOPE_SHIFT
+	bool     cp_drift_valid_saved;     // Slope and validity in the EVSE config page
+	int32_t  cp_drift_slope_saved;
+	int16_t  cp_drift_ref_voltage;     // Last max CP voltage from state A (without ADC calibration)
+	int16_t  cp_drift_ref_temperature; // Temperature at the time of cp_drift_ref_voltage
+	uint32_t cp_drift_ref_time;
+	bool     cp_drift_compensation_active;
+
 	uint8_t  cp_invalid_counter;
 
 	uint16_t pp_adc_value;
@@ -61,6 +104,9 @@ typedef struct {
 	uint32_t pp_pe_resistance;
 	uint8_t  pp_invalid_counter;
 
+	int16_t  temperature;      // Internal temperature sensor in 1/100 °C
+	uint32_t temperature_time; // Time of the last temperature conversion (0 = none yet)
+
 	SPIFifo  spi_fifo;
 
 	uint16_t cp_adc_avg_queue[ADS1118_CP_ADC_AVG_NUM];
@@ -77,12 +123,13 @@ typedef struct {
 
 	bool version_found;
 	bool is_v15;
-} ADS1118;
 
-extern ADS1118 ads1118;
+	uint8_t config_mosi[2];
+} ADS1118;
 
 void ads1118_init(void);
 void ads1118_tick(void);
+void ads1118_update_calibration_knots(void);
 
 #define ADS1118_CONFIG_SINGLE_SHOT               (1     << 15)
 #define ADS1118_CONFIG_INP_IS_IN0_AND_INN_IS_IN1 (0b000 << 12)
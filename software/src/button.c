@@ -21,6 +21,8 @@
 
 #include "button.h"
 
+#include <string.h>
+
 #include "configs/config_evse.h"
 
 #include "bricklib2/hal/system_timer/system_timer.h"
@@ -28,41 +30,101 @@
 #include "led.h"
 #include "evse.h"
 #include "charging_slot.h"
+#include "scheduler.h"
+#include "context.h"
 
-#include <string.h>
+static void button_push_event(const uint8_t type, const uint32_t time) {
+	const uint8_t head = EVSE_CTX(button).events_head;
+	if((uint8_t)(head - EVSE_CTX(button).events_tail) >= BUTTON_EVENT_QUEUE_SIZE) {
+		EVSE_CTX(button).events_lost++;
+		return;
+	}
 
-#define BUTTON_DEBOUNCE 100 // ms
+	EVSE_CTX(button).events[head & BUTTON_EVENT_QUEUE_MASK].type = type;
+	EVSE_CTX(button).events[head & BUTTON_EVENT_QUEUE_MASK].time = time;
+	EVSE_CTX(button).events_head = head + 1;
+}
 
-Button button;
+// Returns the oldest event of the queue, called from the main loop only
+bool button_get_event(ButtonEvent *event) {
+	const uint8_t tail = EVSE_CTX(button).events_tail;
+	if(tail == EVSE_CTX(button).events_head) {
+		return false;
+	}
 
-void button_init(void) {
-	memset(&button, 0, sizeof(Button));
+	*event = EVSE_CTX(button).events[tail & BUTTON_EVENT_QUEUE_MASK];
+	EVSE_CTX(button).events_tail = tail + 1;
+	return true;
 }
 
-void button_tick(void) {
+// Number of events that were lost because of a full queue since the last call
+uint16_t button_get_events_lost(void) {
+	const uint16_t lost = EVSE_CTX(button).events_lost;
+	const uint16_t lost_since_last_call = lost - EVSE_CTX(button).events_lost_reported;
+	EVSE_CTX(button).events_lost_reported = lost;
+	return lost_since_last_call;
+}
+
+// Called every ms by the step timer interrupt. A press that is shorter than the
+// main loop or the poll interval of the host is not lost this way.
+void button_step(void) {
 	const bool value = XMC_GPIO_GetInput(EVSE_INPUT_GP_PIN);
 
-	if(value != button.last_value) {
-		button.last_value = value;
-		button.last_change_time = system_timer_get_ms();
-		if(!value) {
-			// We always see a button release as a state change that turns the LED on (until standby)
-			led_set_on(false);
+	// Every edge (also bouncing) starts the debounce time again
+	if(value != EVSE_CTX(button).last_value) {
+		EVSE_CTX(button).last_value = value;
+		EVSE_CTX(button).last_change_time = system_timer_get_ms();
+	}
+
+	if((value != EVSE_CTX(button).pressed) && system_timer_is_time_elapsed_ms(EVSE_CTX(button).last_change_time, BUTTON_DEBOUNCE)) {
+		EVSE_CTX(button).pressed = value;
+		if(value) {
+			EVSE_CTX(button).press_time = EVSE_CTX(button).last_change_time;
+			EVSE_CTX(button).long_press_done = false;
+			button_push_event(BUTTON_EVENT_PRESS, EVSE_CTX(button).press_time);
+
+			if(EVSE_CTX(button).double_press_possible && ((EVSE_CTX(button).press_time - EVSE_CTX(button).release_time) <= BUTTON_DOUBLE_PRESS_TIME)) {
+				EVSE_CTX(button).long_press_done = true; // A press is either a double press or a long press
+				button_push_event(BUTTON_EVENT_DOUBLE_PRESS, EVSE_CTX(button).press_time);
+			}
+		} else {
+			EVSE_CTX(button).release_time = EVSE_CTX(button).last_change_time;
+			button_push_event(BUTTON_EVENT_RELEASE, EVSE_CTX(button).release_time);
+		}
+
+		EVSE_CTX(button).double_press_possible = false;
+		if(!value && !EVSE_CTX(button).long_press_done) {
+			EVSE_CTX(button).double_press_possible = true;
 		}
 	}
 
-	if(button.last_change_time != 0 && system_timer_is_time_elapsed_ms(button.last_change_time, BUTTON_DEBOUNCE)) {
-		button.last_change_time = 0;
-		if(!value) {
-			button.state = BUTTON_STATE_RELEASED;
-			button.release_time = system_timer_get_ms();
-			led_set_on(false);
+	if(EVSE_CTX(button).pressed && !EVSE_CTX(button).long_press_done && system_timer_is_time_elapsed_ms(EVSE_CTX(button).press_time, BUTTON_LONG_PRESS_TIME)) {
+		EVSE_CTX(button).long_press_done = true;
+		button_push_event(BUTTON_EVENT_LONG_PRESS, EVSE_CTX(button).press_time + BUTTON_LONG_PRESS_TIME);
+	}
+}
+
+void button_init(void) {
+	memset(&EVSE_CTX(button), 0, sizeof(Button));
+}
+
+// The debouncing is done by button_step, here only the
+// actions that follow a change of the button state are done.
+// The tick runs periodically instead of being triggered by button_step,
+// the scheduler must not be touched from the interrupt.
+void button_tick(void) {
+	scheduler_set_deadline_in(SCHEDULER_TASK_BUTTON, BUTTON_TICK_INTERVAL);
+
+	const ButtonState state = EVSE_CTX(button).pressed ? BUTTON_STATE_PRESSED : BUTTON_STATE_RELEASED;
+	if(state != EVSE_CTX(button).state) {
+		EVSE_CTX(button).state = state;
+		if(state == BUTTON_STATE_RELEASED) {
+			// We always see a button release as a state change that turns the LED on (until standby)
+			led_set_on();
 
 			charging_slot_start_charging_by_button();
 		} else {
-			button.state = BUTTON_STATE_PRESSED;
-			button.press_time = system_timer_get_ms();
-			button.was_pressed = true;
+			EVSE_CTX(button).was_pressed = true;
 
 			// Disallow charging by button charging slot
 			charging_slot_stop_charging_by_button();
@@ -70,7 +132,5 @@ void button_tick(void) {
 	}
 
 	// As long as the button is pressed (or key is turned to off) the LED stays off
-	if(button.state == BUTTON_STATE_PRESSED) {
-		led_set_off();
-	}
-}
\ No newline at end of file
+	led_set_key_switch_off(EVSE_CTX(button).state == BUTTON_STATE_PRESSED);
+}
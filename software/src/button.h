@@ -25,25 +25,59 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+// Debounced edges of the button are detected in the step timer interrupt (button_step)
+// and put into an event queue, the host can read it with get_button_events or get
+// the events as callbacks. The time of press and release is the time of the last
+// edge before the input was stable (the time of the event itself for a long press).
+#define BUTTON_DEBOUNCE          100  // ms the input has to be stable
+#define BUTTON_LONG_PRESS_TIME   2000 // ms pressed until the long press event
+#define BUTTON_DOUBLE_PRESS_TIME 400  // ms between a release and the next press for a double press
+#define BUTTON_TICK_INTERVAL     10   // ms between two button ticks
+
+#define BUTTON_EVENT_QUEUE_SIZE  8    // Has to be a power of 2
+#define BUTTON_EVENT_QUEUE_MASK  (BUTTON_EVENT_QUEUE_SIZE-1)
+
+#define BUTTON_EVENT_PRESS        0
+#define BUTTON_EVENT_RELEASE      1
+#define BUTTON_EVENT_LONG_PRESS   2
+#define BUTTON_EVENT_DOUBLE_PRESS 3
+
 typedef enum {
 	BUTTON_STATE_RELEASED,
 	BUTTON_STATE_PRESSED
 } ButtonState;
 
 typedef struct {
-	ButtonState state;
+	uint8_t type;
+	uint32_t time;
+} ButtonEvent;
 
-	bool last_value;
-	uint32_t last_change_time;
+typedef struct {
+	ButtonState state;
 
 	bool was_pressed;
 
 	uint32_t press_time;
 	uint32_t release_time;
-} Button;
 
-extern Button button;
+	// Written by button_step in the interrupt
+	volatile bool pressed;           // Debounced input
+	bool last_value;
+	uint32_t last_change_time;       // First edge of the current change
+	bool long_press_done;
+	bool double_press_possible;      // Last press was short (no long or double press)
+
+	ButtonEvent events[BUTTON_EVENT_QUEUE_SIZE];
+	volatile uint8_t events_head;    // Written by button_step
+	volatile uint8_t events_tail;    // Written by the main loop
+	volatile uint16_t events_lost;   // Queue was full, counts up
+	uint16_t events_lost_reported;
+	bool event_callback_enabled;
+} Button;
 
+bool button_get_event(ButtonEvent *event);
+uint16_t button_get_events_lost(void);
+void button_step(void);
 void button_init(void);
 void button_tick(void);
 
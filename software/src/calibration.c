@@ -0,0 +1,269 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * calibration.c: Automated CP/PE calibration sequence
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+// Runs the same calibration as the calibrate() handshake, but the EVSE sets
+// the duty cycles and waits for the measurements to settle by itself. The host
+// only switches the resistors when asked to (phase WAIT_FOR_RESISTOR) and
+// gives the externally measured +12V/-12V. Every state change is reported
+// through the calibration state callback.
+
+#define LOGRING_FILE_ID LOGRING_FILE_CALIBRATION
+
+#include "calibration.h"
+
+#include "bricklib2/hal/system_timer/system_timer.h"
+#include "bricklib2/logging/logging.h"
+#include "logring.h"
+#include "bricklib2/utility/util_definitions.h"
+
+#include "configs/config_evse.h"
+#include "evse.h"
+#include "ads1118.h"
+#include "iec61851.h"
+#include "context.h"
+
+static void calibration_set_phase(const uint8_t phase) {
+	EVSE_CTX(calibration).phase         = phase;
+	EVSE_CTX(calibration).phase_time    = system_timer_get_ms();
+	EVSE_CTX(calibration).state_changed = true;
+}
+
+static void calibration_set_duty_cycle(const uint16_t duty_cycle) {
+	EVSE_CTX(calibration).duty_cycle = duty_cycle;
+	evse_write_cp_duty_cycle(duty_cycle);
+}
+
+// Starts a new settle-gated measurement window for the current step
+static void calibration_measure(void) {
+	EVSE_CTX(calibration).settled           = false;
+	EVSE_CTX(calibration).last_sample       = 0xFFFF;
+	EVSE_CTX(calibration).last_sample_count = EVSE_CTX(ads1118).cp_adc_sum_count;
+
+	// The sample that is currently being converted may have been taken before the change
+	EVSE_CTX(ads1118).cp_invalid_counter = MAX(EVSE_CTX(ads1118).cp_invalid_counter, 1);
+
+	calibration_set_phase(CALIBRATION_PHASE_MEASURE);
+}
+
+static void calibration_start_step(const uint8_t step) {
+	EVSE_CTX(calibration).step       = step;
+	EVSE_CTX(calibration).step_time  = system_timer_get_ms();
+	EVSE_CTX(evse).calibration_state = MIN(step, CALIBRATION_STEP_880OHM_LAST);
+
+	if(step == CALIBRATION_STEP_2700OHM) {
+		EVSE_CTX(calibration).resistor = CALIBRATION_RESISTOR_2700OHM;
+		calibration_set_phase(CALIBRATION_PHASE_WAIT_FOR_RESISTOR);
+	} else if(step == CALIBRATION_STEP_880OHM_FIRST) {
+		calibration_set_duty_cycle(iec61851_get_duty_cycle_for_ma(6000));
+		EVSE_CTX(calibration).resistor = CALIBRATION_RESISTOR_880OHM;
+		calibration_set_phase(CALIBRATION_PHASE_WAIT_FOR_RESISTOR);
+	} else if(step <= CALIBRATION_STEP_880OHM_LAST) {
+		// The resistor stays connected for the whole sweep
+		calibration_set_duty_cycle(iec61851_get_duty_cycle_for_ma(6000U + (step - CALIBRATION_STEP_880OHM_FIRST)*2000U));
+		calibration_measure();
+	} else {
+		// 0% duty cycle for the -12V measurement of the host
+		calibration_set_duty_cycle(0);
+		EVSE_CTX(calibration).resistor = CALIBRATION_RESISTOR_NONE;
+		calibration_set_phase(CALIBRATION_PHASE_WAIT_FOR_RESISTOR);
+	}
+}
+
+static void calibration_error(const uint8_t error) {
+	logw("Calibration error %d in step %d\n\r", error, EVSE_CTX(calibration).step);
+	EVSE_CTX(calibration).error = error;
+
+	// Back to the last saved calibration
+	evse_load_calibration();
+	calibration_set_duty_cycle(1000);
+	EVSE_CTX(evse).calibration_state = 0;
+
+	calibration_set_phase(CALIBRATION_PHASE_ERROR);
+}
+
+// Calibration value for a resistor (same calculation as in calibrate())
+static int16_t calibration_get_resistor_value(const int32_t high_voltage, const int32_t resistance) {
+	return EVSE_CTX(ads1118).cp_cal_max_voltage - (910*(high_voltage - ADS1118_DIODE_DROP) + resistance*high_voltage)/resistance;
+}
+
+static void calibration_finish_step(void) {
+	const uint32_t n      = EVSE_CTX(ads1118).cp_adc_sum_count;
+	const uint32_t sum    = EVSE_CTX(ads1118).cp_adc_sum;
+	const uint16_t mean   = (sum + n/2)/n;
+	const int16_t voltage = SCALE(mean, 6574, 31643, -12000, 12000);
+
+	EVSE_CTX(calibration).variance  = (uint32_t)((n*EVSE_CTX(ads1118).cp_adc_sum_square - (uint64_t)sum*sum)/(n*n));
+	EVSE_CTX(calibration).duration  = system_timer_get_ms() - EVSE_CTX(calibration).step_time;
+	if(EVSE_CTX(calibration).variance > CALIBRATION_VARIANCE_MAX) {
+		calibration_error(CALIBRATION_ERROR_NOISY);
+		return;
+	}
+
+	if(EVSE_CTX(calibration).step == CALIBRATION_STEP_VOLTAGE) {
+		EVSE_CTX(ads1118).cp_cal_mul        = EVSE_CTX(calibration).cp_voltage_high; // multiply by calibrated voltage
+		EVSE_CTX(ads1118).cp_cal_div        = voltage;                     // divide by uncalibrated voltage
+		EVSE_CTX(calibration).value         = voltage;
+		EVSE_CTX(calibration).high_voltage  = EVSE_CTX(calibration).cp_voltage_high;
+		logd("Calibration mul %d, div %d\n\r", EVSE_CTX(ads1118).cp_cal_mul, EVSE_CTX(ads1118).cp_cal_div);
+		calibration_start_step(CALIBRATION_STEP_2700OHM);
+		return;
+	}
+
+	const int32_t voltage_calibrated = voltage * EVSE_CTX(ads1118).cp_cal_mul / EVSE_CTX(ads1118).cp_cal_div;
+	if(EVSE_CTX(calibration).step == CALIBRATION_STEP_LOW_VOLTAGE) {
+		EVSE_CTX(calibration).value        = voltage_calibrated;
+		EVSE_CTX(calibration).high_voltage = voltage_calibrated;
+		calibration_set_phase(CALIBRATION_PHASE_WAIT_FOR_LOW_VOLTAGE);
+		return;
+	}
+
+	const int32_t min_voltage            = EVSE_CTX(ads1118).cp_cal_min_voltage;
+	const int32_t high_voltage           = (voltage_calibrated - min_voltage)*1000/EVSE_CTX(calibration).duty_cycle + min_voltage;
+	EVSE_CTX(calibration).high_voltage   = high_voltage;
+
+	// With 2700 or 880 Ohm the high voltage is at least 2V below the open circuit voltage
+	if(high_voltage + 1000 > EVSE_CTX(ads1118).cp_cal_max_voltage) {
+		calibration_error(CALIBRATION_ERROR_NO_RESISTOR);
+		return;
+	}
+
+	if(EVSE_CTX(calibration).step == CALIBRATION_STEP_2700OHM) {
+		EVSE_CTX(ads1118).cp_cal_2700ohm = calibration_get_resistor_value(high_voltage, 2700);
+		EVSE_CTX(calibration).value      = EVSE_CTX(ads1118).cp_cal_2700ohm;
+	} else {
+		const uint8_t index                    = EVSE_CTX(calibration).step - CALIBRATION_STEP_880OHM_FIRST;
+		EVSE_CTX(ads1118).cp_cal_880ohm[index] = calibration_get_resistor_value(high_voltage, 880);
+		EVSE_CTX(calibration).value            = EVSE_CTX(ads1118).cp_cal_880ohm[index];
+	}
+
+	logd("Calibration step %d: %d (variance %u, %u ms)\n\r", EVSE_CTX(calibration).step, EVSE_CTX(calibration).value, EVSE_CTX(calibration).variance, EVSE_CTX(calibration).duration);
+	calibration_start_step(EVSE_CTX(calibration).step + 1);
+}
+
+bool calibration_start(const int16_t cp_voltage_high) {
+	// Same preconditions as for calibrate(): nothing connected, no other calibration running.
+	// Additionally the startup has to be done, evse_tick does not call calibration_tick before.
+	if((EVSE_CTX(evse).startup_time != 0) || (EVSE_CTX(ads1118).cp_pe_resistance != 0xFFFF) || (EVSE_CTX(evse).calibration_state != 0) || calibration_is_running()) {
+		return false;
+	}
+
+	if((cp_voltage_high < 11500) || (cp_voltage_high > 12500)) {
+		return false;
+	}
+
+	EVSE_CTX(calibration).cp_voltage_high = cp_voltage_high;
+	EVSE_CTX(calibration).error           = CALIBRATION_ERROR_NONE;
+	EVSE_CTX(calibration).resistor        = CALIBRATION_RESISTOR_NONE;
+	EVSE_CTX(calibration).step            = CALIBRATION_STEP_VOLTAGE;
+	EVSE_CTX(calibration).step_time       = system_timer_get_ms();
+	EVSE_CTX(evse).calibration_state      = CALIBRATION_STEP_VOLTAGE;
+
+	calibration_set_duty_cycle(1000);
+	calibration_measure();
+
+	return true;
+}
+
+bool calibration_set_resistor(const uint8_t resistor) {
+	if((EVSE_CTX(calibration).phase != CALIBRATION_PHASE_WAIT_FOR_RESISTOR) || (resistor != EVSE_CTX(calibration).resistor)) {
+		return false;
+	}
+
+	calibration_measure();
+	return true;
+}
+
+bool calibration_set_low_voltage(const int16_t cp_voltage_low) {
+	if(EVSE_CTX(calibration).phase != CALIBRATION_PHASE_WAIT_FOR_LOW_VOLTAGE) {
+		return false;
+	}
+
+	// Same limit as the production test
+	const int16_t diff = EVSE_CTX(calibration).cp_voltage_high + cp_voltage_low;
+	if(ABS(diff) >= 200) {
+		return false;
+	}
+
+	EVSE_CTX(ads1118).cp_cal_diff_voltage = diff;
+	EVSE_CTX(calibration).value           = diff;
+	EVSE_CTX(calibration).duration        = system_timer_get_ms() - EVSE_CTX(calibration).step_time;
+
+	calibration_set_duty_cycle(1000);
+	EVSE_CTX(evse).calibration_state = 0;
+	evse_save_calibration();
+
+	calibration_set_phase(CALIBRATION_PHASE_DONE);
+	return true;
+}
+
+void calibration_abort(void) {
+	if(calibration_is_running()) {
+		calibration_error(CALIBRATION_ERROR_ABORTED);
+	}
+}
+
+bool calibration_is_running(void) {
+	return (EVSE_CTX(calibration).phase == CALIBRATION_PHASE_MEASURE) ||
+	       (EVSE_CTX(calibration).phase == CALIBRATION_PHASE_WAIT_FOR_RESISTOR) ||
+	       (EVSE_CTX(calibration).phase == CALIBRATION_PHASE_WAIT_FOR_LOW_VOLTAGE);
+}
+
+void calibration_tick(void) {
+	if((EVSE_CTX(calibration).phase == CALIBRATION_PHASE_WAIT_FOR_RESISTOR) || (EVSE_CTX(calibration).phase == CALIBRATION_PHASE_WAIT_FOR_LOW_VOLTAGE)) {
+		if(system_timer_is_time_elapsed_ms(EVSE_CTX(calibration).phase_time, CALIBRATION_HOST_TIMEOUT)) {
+			calibration_error(CALIBRATION_ERROR_HOST_TIMEOUT);
+		}
+		return;
+	}
+
+	if(EVSE_CTX(calibration).phase != CALIBRATION_PHASE_MEASURE) {
+		return;
+	}
+
+	if(!EVSE_CTX(calibration).settled) {
+		if(EVSE_CTX(ads1118).cp_adc_sum_count == EVSE_CTX(calibration).last_sample_count) {
+			if(system_timer_is_time_elapsed_ms(EVSE_CTX(calibration).phase_time, CALIBRATION_SETTLE_TIMEOUT)) {
+				calibration_error(CALIBRATION_ERROR_NOT_SETTLED);
+			}
+			return;
+		}
+
+		const uint16_t sample                    = EVSE_CTX(ads1118).cp_adc_value;
+		const uint16_t last_sample               = EVSE_CTX(calibration).last_sample;
+		EVSE_CTX(calibration).last_sample        = sample;
+		EVSE_CTX(calibration).last_sample_count  = EVSE_CTX(ads1118).cp_adc_sum_count;
+
+		if((last_sample != 0xFFFF) && (ABS((int32_t)sample - (int32_t)last_sample) <= CALIBRATION_SETTLE_THRESHOLD)) {
+			// The averaging window starts with the next sample
+			EVSE_CTX(calibration).settled        = true;
+			EVSE_CTX(ads1118).cp_adc_sum         = 0;
+			EVSE_CTX(ads1118).cp_adc_sum_square  = 0;
+			EVSE_CTX(ads1118).cp_adc_sum_count   = 0;
+		} else if(system_timer_is_time_elapsed_ms(EVSE_CTX(calibration).phase_time, CALIBRATION_SETTLE_TIMEOUT)) {
+			calibration_error(CALIBRATION_ERROR_NOT_SETTLED);
+		}
+		return;
+	}
+
+	if(EVSE_CTX(ads1118).cp_adc_sum_count >= CALIBRATION_WINDOW_SAMPLES) {
+		calibration_finish_step();
+	}
+}
@@ -0,0 +1,95 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * calibration.h: Automated CP/PE calibration sequence
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CALIBRATION_PASSWORD              0x0BB03200
+
+// The normal ADC loop delivers about 4 CP samples per second.
+// A step is settled if two consecutive samples differ by at most
+// CALIBRATION_SETTLE_THRESHOLD LSB, after that the next
+// CALIBRATION_WINDOW_SAMPLES samples are averaged.
+#define CALIBRATION_SETTLE_THRESHOLD      8
+#define CALIBRATION_SETTLE_TIMEOUT        5000
+#define CALIBRATION_WINDOW_SAMPLES        6
+#define CALIBRATION_VARIANCE_MAX          100 // LSB^2, 1 LSB is about 1mV
+#define CALIBRATION_HOST_TIMEOUT          (60*1000)
+
+#define CALIBRATION_STEP_VOLTAGE          1
+#define CALIBRATION_STEP_2700OHM          2
+#define CALIBRATION_STEP_880OHM_FIRST     3  // 6A, then +2A per step up to 32A
+#define CALIBRATION_STEP_880OHM_LAST      16
+#define CALIBRATION_STEP_LOW_VOLTAGE      17
+
+#define CALIBRATION_PHASE_IDLE                  0
+#define CALIBRATION_PHASE_MEASURE               1
+#define CALIBRATION_PHASE_WAIT_FOR_RESISTOR     2
+#define CALIBRATION_PHASE_WAIT_FOR_LOW_VOLTAGE  3
+#define CALIBRATION_PHASE_DONE                  4
+#define CALIBRATION_PHASE_ERROR                 5
+
+#define CALIBRATION_RESISTOR_NONE         0
+#define CALIBRATION_RESISTOR_2700OHM      1
+#define CALIBRATION_RESISTOR_880OHM       2 // 2700 Ohm || 1300 Ohm
+
+#define CALIBRATION_ERROR_NONE            0
+#define CALIBRATION_ERROR_NOT_SETTLED     1
+#define CALIBRATION_ERROR_NOISY           2
+#define CALIBRATION_ERROR_NO_RESISTOR     3
+#define CALIBRATION_ERROR_HOST_TIMEOUT    4
+#define CALIBRATION_ERROR_ABORTED         5
+
+typedef struct {
+	uint8_t phase;
+	uint8_t step;
+	uint8_t resistor;     // Resistor that the host has to connect (in WAIT_FOR_RESISTOR)
+	uint8_t error;
+
+	uint32_t phase_time;
+	uint32_t step_time;
+	uint16_t duty_cycle;
+	bool settled;
+	uint16_t last_sample;
+	uint16_t last_sample_count;
+
+	int16_t cp_voltage_high; // +12V measured by the host
+
+	// Result of the last finished step
+	int16_t value;
+	int16_t high_voltage;
+	uint32_t variance;
+	uint16_t duration;
+
+	bool state_changed;   // A new state has to be reported through the callback
+} Calibration;
+
+bool calibration_start(const int16_t cp_voltage_high);
+bool calibration_set_resistor(const uint8_t resistor);
+bool calibration_set_low_voltage(const int16_t cp_voltage_low);
+void calibration_abort(void);
+bool calibration_is_running(void);
+void calibration_tick(void);
+
+#endif
@@ -25,8 +25,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-#define CHARGING_SLOT_NUM 20
-#define CHARGING_SLOT_DEFAULT_NUM (CHARGING_SLOT_NUM - 2)
+#define CHARGING_SLOT_NUM 21
+#define CHARGING_SLOT_DEFAULT_NUM 18 // Slots 2-19 have a default (saved in the EVSE config page)
 
 #define CHARGING_SLOT_INCOMING_CABLE  0
 #define CHARGING_SLOT_OUTGOING_CABLE  1
@@ -35,6 +35,7 @@
 #define CHARGING_SLOT_BUTTON          4
 #define CHARGING_SLOT_LOAD_MANAGEMENT 7
 #define CHARGING_SLOT_EXTERNAL        8
+#define CHARGING_SLOT_TEMPERATURE     20 // Owned by the thermal derating (see derating.h), read-only through the API
 
 typedef struct {
 	uint16_t max_current_default[CHARGING_SLOT_DEFAULT_NUM];
@@ -46,11 +47,10 @@ typedef struct {
 	bool clear_on_disconnect[CHARGING_SLOT_NUM];
 } ChargingSlot;
 
-extern ChargingSlot charging_slot;
-
 void charging_slot_init(void);
 void charging_slot_tick(void);
 uint16_t charging_slot_get_max_current(void);
+uint32_t charging_slot_get_ma_incoming_cable(void);
 void charging_slot_start_charging_by_button(void);
 void charging_slot_stop_charging_by_button(void);
 void charging_slot_handle_disconnect(void);
@@ -19,13 +19,16 @@
  * Boston, MA 02111-1307, USA.
  */
 
+#define LOGRING_FILE_ID LOGRING_FILE_COMMUNICATION
+
 #include "communication.h"
 
 #include "bricklib2/utility/communication_callback.h"
 #include "bricklib2/protocols/tfp/tfp.h"
+#include "bricklib2/bootloader/bootloader.h"
 #include "bricklib2/hal/system_timer/system_timer.h"
-#include "bricklib2/hal/ccu4_pwm/ccu4_pwm.h"
 #include "bricklib2/logging/logging.h"
+#include "logring.h"
 #include "bricklib2/utility/util_definitions.h"
 #include "bricklib2/warp/contactor_check.h"
 
@@ -38,12 +41,71 @@
 #include "lock.h"
 #include "button.h"
 #include "charging_slot.h"
+#include "profiler.h"
+#include "scheduler.h"
+#include "memory_usage.h"
+#include "recorder.h"
+#include "journal.h"
+#include "calibration.h"
+#include "derating.h"
+#include "context.h"
 
 #define LOW_LEVEL_PASSWORD 0x4223B00B
 
+// Fills parts with the response of the getter that belongs to the data group
+// and returns the payload length (without TFP header).
+static uint8_t communication_get_data_group(const uint8_t group, TFPMessageFull *parts) {
+	switch(group) {
+		case 0: get_state(NULL, (GetState_Response*)parts);                                   return sizeof(GetState_Response)                 - sizeof(TFPMessageHeader);
+		case 1: get_hardware_configuration(NULL, (GetHardwareConfiguration_Response*)parts); return sizeof(GetHardwareConfiguration_Response) - sizeof(TFPMessageHeader);
+		case 2: get_low_level_state(NULL, (GetLowLevelState_Response*)parts);                return sizeof(GetLowLevelState_Response)         - sizeof(TFPMessageHeader);
+		case 3: get_indicator_led(NULL, (GetIndicatorLED_Response*)parts);                   return sizeof(GetIndicatorLED_Response)          - sizeof(TFPMessageHeader);
+		case 4: get_button_state(NULL, (GetButtonState_Response*)parts);                     return sizeof(GetButtonState_Response)           - sizeof(TFPMessageHeader);
+		case 5: get_boost_mode(NULL, (GetBoostMode_Response*)parts);                         return sizeof(GetBoostMode_Response)             - sizeof(TFPMessageHeader);
+		case 6: get_all_charging_slots(NULL, (GetAllChargingSlots_Response*)parts);          return sizeof(GetAllChargingSlots_Response)      - sizeof(TFPMessageHeader);
+		case 7: {
+			// There is no getter for all slot defaults, we use the same layout as for all charging slots
+			DataGroupChargingSlotDefaults *defaults = (DataGroupChargingSlotDefaults*)parts->data;
+			for(uint8_t i = 0; i < CHARGING_SLOT_DEFAULT_NUM; i++) {
+				defaults->max_current[i]                    = EVSE_CTX(charging_slot).max_current_default[i];
+				defaults->active_and_clear_on_disconnect[i] = (EVSE_CTX(charging_slot).active_default[i] << 0) | (EVSE_CTX(charging_slot).clear_on_disconnect_default[i] << 1);
+			}
+			return sizeof(DataGroupChargingSlotDefaults);
+		}
+		case 8: get_user_calibration(NULL, (GetUserCalibration_Response*)parts);             return sizeof(GetUserCalibration_Response)       - sizeof(TFPMessageHeader);
+		default: return 0;
+	}
+}
+
+// Concatenates the payload of all requested groups (in order of their bit) and copies
+// the part that starts at offset into buffer. Returns the length of all requested groups.
+static uint16_t communication_pack_data_groups(const uint16_t groups, const uint16_t offset, uint8_t *buffer, const uint16_t length) {
+	TFPMessageFull parts;
+	uint16_t group_offset = 0;
+
+	for(uint8_t group = 0; group < DATA_GROUP_NUM; group++) {
+		if(!(groups & (1 << group))) {
+			continue;
+		}
+
+		const uint8_t group_length = communication_get_data_group(group, &parts);
+
+		// Copy the part of the group that overlaps with [offset, offset+length)
+		const uint16_t start = MAX(group_offset, offset);
+		const uint16_t end   = MIN(group_offset + group_length, offset + length);
+		if(start < end) {
+			memcpy(&buffer[start - offset], &parts.data[start - group_offset], end - start);
+		}
+
+		group_offset += group_length;
+	}
+
+	return group_offset;
+}
+
 BootloaderHandleMessageResponse handle_message(const void *message, void *response) {
 	// Restart communication watchdog timer.
-	evse.communication_watchdog_time = system_timer_get_ms();
+	EVSE_CTX(evse).communication_watchdog_time = system_timer_get_ms();
 
 	switch(tfp_get_fid_from_message(message)) {
 		case FID_GET_STATE: return get_state(message, response);
@@ -69,68 +131,96 @@ BootloaderHandleMessageResponse handle_message(const void *message, void *respon
 		case FID_FACTORY_RESET: return factory_reset(message);
 		case FID_SET_BOOST_MODE: return set_boost_mode(message);
 		case FID_GET_BOOST_MODE: return get_boost_mode(message, response);
+		case FID_GET_DATA_CHANGES: return get_data_changes(message, response);
+		case FID_GET_DATA_GROUPS_LOW_LEVEL: return get_data_groups_low_level(message, response);
+		case FID_GET_TICK_PROFILE: return get_tick_profile(message, response);
+		case FID_RESET_TICK_PROFILE: return reset_tick_profile(message);
+		case FID_GET_MEMORY_USAGE: return get_memory_usage(message, response);
+		case FID_GET_BOOT_INFO: return get_boot_info(message, response);
+		case FID_READ_LOG_LOW_LEVEL: return read_log_low_level(message, response);
+		case FID_SET_RECORDER_CONFIGURATION: return set_recorder_configuration(message);
+		case FID_GET_RECORDER_CONFIGURATION: return get_recorder_configuration(message, response);
+		case FID_TRIGGER_RECORDER: return trigger_recorder(message);
+		case FID_REARM_RECORDER: return rearm_recorder(message);
+		case FID_GET_RECORDER_STATE: return get_recorder_state(message, response);
+		case FID_READ_RECORDER_LOW_LEVEL: return read_recorder_low_level(message, response);
+		case FID_READ_JOURNAL_LOW_LEVEL: return read_journal_low_level(message, response);
+		case FID_START_CALIBRATION: return start_calibration(message);
+		case FID_SET_CALIBRATION_RESISTOR: return set_calibration_resistor(message);
+		case FID_SET_CALIBRATION_LOW_VOLTAGE: return set_calibration_low_voltage(message);
+		case FID_ABORT_CALIBRATION: return abort_calibration(message);
+		case FID_GET_CALIBRATION_STATE: return get_calibration_state(message, response);
+		case FID_SET_TEMPERATURE_DERATING: return set_temperature_derating(message);
+		case FID_GET_TEMPERATURE_DERATING: return get_temperature_derating(message, response);
+		case FID_GET_TEMPERATURE_STATE: return get_temperature_state(message, response);
+		case FID_READ_TEMPERATURE_HISTORY_LOW_LEVEL: return read_temperature_history_low_level(message, response);
+		case FID_SET_INDICATOR_LED_PATTERN: return set_indicator_led_pattern(message);
+		case FID_GET_INDICATOR_LED_PATTERN: return get_indicator_led_pattern(message, response);
+		case FID_GET_INDICATOR_LED_LAYERS: return get_indicator_led_layers(message, response);
+		case FID_GET_BUTTON_EVENTS: return get_button_events(message, response);
+		case FID_SET_BUTTON_EVENT_CALLBACK_CONFIGURATION: return set_button_event_callback_configuration(message);
+		case FID_GET_BUTTON_EVENT_CALLBACK_CONFIGURATION: return get_button_event_callback_configuration(message, response);
+		case FID_GET_LOCK_STATISTICS: return get_lock_statistics(message, response);
 		default: return HANDLE_MESSAGE_RESPONSE_NOT_SUPPORTED;
 	}
 }
 
 
 BootloaderHandleMessageResponse get_state(const GetState *data, GetState_Response *response) {
+	EVSETelemetry telemetry;
+	evse_get_telemetry(&telemetry);
+
 	response->header.length            = sizeof(GetState_Response);
-	response->iec61851_state           = iec61851.state;
-	response->contactor_state          = contactor_check.state;
-	response->contactor_error          = contactor_check.error;
-	response->allowed_charging_current = iec61851_get_max_ma();
-	response->error_state              = led.state == LED_STATE_BLINKING ? led.blink_num : 0;
-	response->lock_state               = lock.state;
-
-	if(response->error_state != 0) {
-		response->charger_state = EVSE_CHARGER_STATE_ERROR;
-	} else if(iec61851.state == IEC61851_STATE_C) {
-		response->charger_state = EVSE_CHARGER_STATE_CHARGING;
-	} else if(iec61851.state == IEC61851_STATE_B) {
-		if(charging_slot_get_max_current() == 0) {
-			response->charger_state = EVSE_CHARGER_STATE_WAITING_FOR_CHARGE_RELEASE;
-		} else {
-			response->charger_state = EVSE_CHARGER_STATE_READY_TO_CHARGE;
-		}
-	} else {
-		response->charger_state = EVSE_CHARGER_STATE_NOT_CONNECTED;
-	}
+	response->iec61851_state           = telemetry.iec61851_state;
+	response->charger_state            = telemetry.charger_state;
+	response->contactor_state          = telemetry.contactor_state;
+	response->contactor_error          = telemetry.contactor_error;
+	response->allowed_charging_current = telemetry.allowed_charging_current;
+	response->error_state              = telemetry.error_state;
+	response->lock_state               = telemetry.lock_state;
 
 	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
 }
 
 BootloaderHandleMessageResponse get_hardware_configuration(const GetHardwareConfiguration *data, GetHardwareConfiguration_Response *response) {
 	response->header.length        = sizeof(GetHardwareConfiguration_Response);
-	response->jumper_configuration = evse.config_jumper_current;
-	response->has_lock_switch      = evse.has_lock_switch;
-	response->evse_version         = ads1118.is_v15 ? 15 : 14;
+	response->jumper_configuration = EVSE_CTX(evse).config_jumper_current;
+	response->has_lock_switch      = EVSE_CTX(evse).has_lock_switch;
+	response->evse_version         = EVSE_CTX(ads1118).is_v15 ? 15 : 14;
 
 	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
 }
 
 BootloaderHandleMessageResponse get_low_level_state(const GetLowLevelState *data, GetLowLevelState_Response *response) {
+	EVSETelemetry telemetry;
+	evse_get_telemetry(&telemetry);
+
 	response->header.length            = sizeof(GetLowLevelState_Response);
-	response->led_state                = led.state;
-	response->cp_pwm_duty_cycle        = evse_get_cp_duty_cycle();
-	response->adc_values[0]            = ads1118.cp_adc_value;
-	response->adc_values[1]            = ads1118.pp_adc_value;
-	response->voltages[0]              = ads1118.cp_voltage_calibrated;
-	response->voltages[1]              = ads1118.pp_voltage;
-	response->voltages[2]              = ads1118.cp_high_voltage;
-	response->resistances[0]           = ads1118.cp_pe_resistance;
-	response->resistances[1]           = ads1118.pp_pe_resistance;
-	response->gpio[0]                  = XMC_GPIO_GetInput(EVSE_INPUT_GP_PIN) | (XMC_GPIO_GetInput(EVSE_OUTPUT_GP_PIN) << 1) | (XMC_GPIO_GetInput(EVSE_MOTOR_INPUT_SWITCH_PIN) << 2) | (XMC_GPIO_GetInput(EVSE_RELAY_PIN) << 3) | (XMC_GPIO_GetInput(EVSE_MOTOR_FAULT_PIN) << 4);
-	response->car_stopped_charging	   = evse.car_stopped_charging;
-	response->uptime                   = system_timer_get_ms();
-	response->time_since_state_change  = response->uptime - iec61851.last_state_change;
+	response->led_state                = telemetry.led_state;
+	response->cp_pwm_duty_cycle        = telemetry.cp_pwm_duty_cycle;
+	response->adc_values[0]            = telemetry.adc_values[0];
+	response->adc_values[1]            = telemetry.adc_values[1];
+	response->voltages[0]              = telemetry.voltages[0];
+	response->voltages[1]              = telemetry.voltages[1];
+	response->voltages[2]              = telemetry.voltages[2];
+	response->resistances[0]           = telemetry.resistances[0];
+	response->resistances[1]           = telemetry.resistances[1];
+	response->gpio[0]                  = telemetry.gpio;
+	response->car_stopped_charging	   = telemetry.car_stopped_charging;
+	response->uptime                   = telemetry.time;
+	response->time_since_state_change  = telemetry.time - telemetry.last_state_change;
 
 	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
 }
 
+// The first two slots are read-only, the temperature slot is owned by the thermal derating.
+// The writable slots are the ones with a default.
+static bool communication_is_charging_slot_writable(const uint8_t slot) {
+	return (slot >= 2) && (slot < 2 + CHARGING_SLOT_DEFAULT_NUM);
+}
+
 BootloaderHandleMessageResponse set_charging_slot(const SetChargingSlot *data) {
-	// The first two slots are read-only
-	if((data->slot < 2) || (data->slot >= CHARGING_SLOT_NUM)) {
+	if(!communication_is_charging_slot_writable(data->slot)) {
 		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
 	}
 
@@ -139,18 +229,17 @@ BootloaderHandleMessageResponse set_charging_slot(const SetChargingSlot *data) {
 	}
 
 	// If button is pressed (key switch is turned off) we don't allow to change the max current in the button slot
-	if((data->slot != CHARGING_SLOT_BUTTON) || (button.state != BUTTON_STATE_PRESSED)) {
-		charging_slot.max_current[data->slot]     = data->max_current;
+	if((data->slot != CHARGING_SLOT_BUTTON) || (EVSE_CTX(button).state != BUTTON_STATE_PRESSED)) {
+		EVSE_CTX(charging_slot).max_current[data->slot]     = data->max_current;
 	}
-	charging_slot.active[data->slot]              = data->active;
-	charging_slot.clear_on_disconnect[data->slot] = data->clear_on_disconnect;
+	EVSE_CTX(charging_slot).active[data->slot]              = data->active;
+	EVSE_CTX(charging_slot).clear_on_disconnect[data->slot] = data->clear_on_disconnect;
 
 	return HANDLE_MESSAGE_RESPONSE_EMPTY;
 }
 
 BootloaderHandleMessageResponse set_charging_slot_max_current(const SetChargingSlotMaxCurrent *data) {
-	// The first two slots are read-only
-	if((data->slot < 2) || (data->slot >= CHARGING_SLOT_NUM)) {
+	if(!communication_is_charging_slot_writable(data->slot)) {
 		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
 	}
 
@@ -159,10 +248,10 @@ BootloaderHandleMessageResponse set_charging_slot_max_current(const SetChargingS
 	}
 
 	// If button is pressed (key switch is turned off) we don't allow to change the max current in the button slot
-	if((data->slot != CHARGING_SLOT_BUTTON) || (button.state != BUTTON_STATE_PRESSED)) {
-		charging_slot.max_current[data->slot] = data->max_current;
-		if((data->slot == CHARGING_SLOT_BUTTON) && (charging_slot.max_current[data->slot] == 0)) {
-			button.was_pressed = true;
+	if((data->slot != CHARGING_SLOT_BUTTON) || (EVSE_CTX(button).state != BUTTON_STATE_PRESSED)) {
+		EVSE_CTX(charging_slot).max_current[data->slot] = data->max_current;
+		if((data->slot == CHARGING_SLOT_BUTTON) && (EVSE_CTX(charging_slot).max_current[data->slot] == 0)) {
+			EVSE_CTX(button).was_pressed = true;
 		}
 	}
 
@@ -170,23 +259,21 @@ BootloaderHandleMessageResponse set_charging_slot_max_current(const SetChargingS
 }
 
 BootloaderHandleMessageResponse set_charging_slot_active(const SetChargingSlotActive *data) {
-	// The first two slots are read-only
-	if((data->slot < 2) || (data->slot >= CHARGING_SLOT_NUM)) {
+	if(!communication_is_charging_slot_writable(data->slot)) {
 		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
 	}
 
-	charging_slot.active[data->slot] = data->active;
+	EVSE_CTX(charging_slot).active[data->slot] = data->active;
 
 	return HANDLE_MESSAGE_RESPONSE_EMPTY;
 }
 
 BootloaderHandleMessageResponse set_charging_slot_clear_on_disconnect(const SetChargingSlotClearOnDisconnect *data) {
-	// The first two slots are read-only
-	if((data->slot < 2) || (data->slot >= CHARGING_SLOT_NUM)) {
+	if(!communication_is_charging_slot_writable(data->slot)) {
 		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
 	}
 
-	charging_slot.clear_on_disconnect[data->slot] = data->clear_on_disconnect;
+	EVSE_CTX(charging_slot).clear_on_disconnect[data->slot] = data->clear_on_disconnect;
 
 	return HANDLE_MESSAGE_RESPONSE_EMPTY;
 }
@@ -197,25 +284,26 @@ BootloaderHandleMessageResponse get_charging_slot(const GetChargingSlot *data, G
 	}
 
 	response->header.length       = sizeof(GetChargingSlot_Response);
-	response->max_current         = charging_slot.max_current[data->slot];
-	response->active              = charging_slot.active[data->slot];
-	response->clear_on_disconnect = charging_slot.clear_on_disconnect[data->slot];
+	response->max_current         = EVSE_CTX(charging_slot).max_current[data->slot];
+	response->active              = EVSE_CTX(charging_slot).active[data->slot];
+	response->clear_on_disconnect = EVSE_CTX(charging_slot).clear_on_disconnect[data->slot];
 
 	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
 }
 
 BootloaderHandleMessageResponse get_all_charging_slots(const GetAllChargingSlots *data, GetAllChargingSlots_Response *response) {
 	response->header.length = sizeof(GetAllChargingSlots_Response);
-	for(uint8_t i = 0; i < CHARGING_SLOT_NUM; i++) {
-		response->max_current[i]                    = charging_slot.max_current[i];
-		response->active_and_clear_on_disconnect[i] = (charging_slot.active[i] << 0) | (charging_slot.clear_on_disconnect[i] << 1);
+	// The response has room for the first 20 slots, the temperature slot can be read with get_charging_slot
+	for(uint8_t i = 0; i < CHARGING_SLOT_TEMPERATURE; i++) {
+		response->max_current[i]                    = EVSE_CTX(charging_slot).max_current[i];
+		response->active_and_clear_on_disconnect[i] = (EVSE_CTX(charging_slot).active[i] << 0) | (EVSE_CTX(charging_slot).clear_on_disconnect[i] << 1);
 	}
 
 	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
 }
 
 BootloaderHandleMessageResponse set_charging_slot_default(const SetChargingSlotDefault *data) {
-	if((data->slot < 2) || (data->slot >= CHARGING_SLOT_NUM)) {
+	if(!communication_is_charging_slot_writable(data->slot)) {
 		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
 	}
 
@@ -225,9 +313,9 @@ BootloaderHandleMessageResponse set_charging_slot_default(const SetChargingSlotD
 
 	const uint8_t slot = data->slot - 2;
 
-	charging_slot.max_current_default[slot]         = data->max_current;
-	charging_slot.active_default[slot]              = data->active;
-	charging_slot.clear_on_disconnect_default[slot] = data->clear_on_disconnect;
+	EVSE_CTX(charging_slot).max_current_default[slot]         = data->max_current;
+	EVSE_CTX(charging_slot).active_default[slot]              = data->active;
+	EVSE_CTX(charging_slot).clear_on_disconnect_default[slot] = data->clear_on_disconnect;
 
 	evse_save_config();
 
@@ -235,65 +323,71 @@ BootloaderHandleMessageResponse set_charging_slot_default(const SetChargingSlotD
 }
 
 BootloaderHandleMessageResponse get_charging_slot_default(const GetChargingSlotDefault *data, GetChargingSlotDefault_Response *response) {
-	if((data->slot < 2) || (data->slot >= CHARGING_SLOT_NUM)) {
+	if(!communication_is_charging_slot_writable(data->slot)) {
 		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
 	}
 
 	const uint8_t slot = data->slot - 2;
 
 	response->header.length       = sizeof(GetChargingSlotDefault_Response);
-	response->max_current         = charging_slot.max_current_default[slot];
-	response->active              = charging_slot.active_default[slot];
-	response->clear_on_disconnect = charging_slot.clear_on_disconnect_default[slot];
+	response->max_current         = EVSE_CTX(charging_slot).max_current_default[slot];
+	response->active              = EVSE_CTX(charging_slot).active_default[slot];
+	response->clear_on_disconnect = EVSE_CTX(charging_slot).clear_on_disconnect_default[slot];
 
 	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
 }
 
 BootloaderHandleMessageResponse calibrate(const Calibrate *data, Calibrate_Response *response) {
 	response->header.length = sizeof(Calibrate_Response);
-	logd("calibrate (iec61851.state %d): %d %x -> %d\n\r", iec61851.state, data->state, data->password, data->value);
-	if(((ads1118.cp_pe_resistance != 0xFFFF) && (evse.calibration_state == 0)) || (data->password != (0x0BB03200U + data->state))) {
+	logd("calibrate (iec61851.state %d): %d %x -> %d\n\r", EVSE_CTX(iec61851).state, data->state, data->password, data->value);
+	// The step-by-step calibration can't be mixed with the automated sequence
+	if(calibration_is_running()) {
+		response->success = false;
+		return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+	}
+
+	if(((EVSE_CTX(ads1118).cp_pe_resistance != 0xFFFF) && (EVSE_CTX(evse).calibration_state == 0)) || (data->password != (0x0BB03200U + data->state))) {
 		response->success = false;
 		return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
 	}
 
-	logd("calibration_state: %d\n\r", evse.calibration_state);
-	if((evse.calibration_state == 0) && (data->state == 1)) {
-		evse.calibration_state = 1;
-		ads1118.cp_cal_mul = data->value;        // multiply by calibrated voltage
-		ads1118.cp_cal_div = ads1118.cp_voltage; // divide by uncalibrated voltage
+	logd("calibration_state: %d\n\r", EVSE_CTX(evse).calibration_state);
+	if((EVSE_CTX(evse).calibration_state == 0) && (data->state == 1)) {
+		EVSE_CTX(evse).calibration_state = 1;
+		EVSE_CTX(ads1118).cp_cal_mul = data->value;        // multiply by calibrated voltage
+		EVSE_CTX(ads1118).cp_cal_div = EVSE_CTX(ads1118).cp_voltage; // divide by uncalibrated voltage
 
 		response->success = true;
-		logd("cal mul %d, div %d\n\r", ads1118.cp_cal_mul, ads1118.cp_cal_div);
-	} else if((evse.calibration_state == 1) && (data->state == 2)) {
-		evse.calibration_state = 2;
-		ads1118.cp_cal_2700ohm = ads1118.cp_cal_max_voltage - (910*(ads1118.cp_high_voltage - ADS1118_DIODE_DROP) + 2700*ads1118.cp_high_voltage)/2700;
+		logd("cal mul %d, div %d\n\r", EVSE_CTX(ads1118).cp_cal_mul, EVSE_CTX(ads1118).cp_cal_div);
+	} else if((EVSE_CTX(evse).calibration_state == 1) && (data->state == 2)) {
+		EVSE_CTX(evse).calibration_state = 2;
+		EVSE_CTX(ads1118).cp_cal_2700ohm = EVSE_CTX(ads1118).cp_cal_max_voltage - (910*(EVSE_CTX(ads1118).cp_high_voltage - ADS1118_DIODE_DROP) + 2700*EVSE_CTX(ads1118).cp_high_voltage)/2700;
 
 		response->success = true;
-		logd("cal 2700ohm %d\n\r", ads1118.cp_cal_2700ohm);
+		logd("cal 2700ohm %d\n\r", EVSE_CTX(ads1118).cp_cal_2700ohm);
 
 		uint16_t dc = iec61851_get_duty_cycle_for_ma(6000);
-		ccu4_pwm_set_duty_cycle(EVSE_CP_PWM_SLICE_NUMBER, 64000 - dc*64);
-	} else if((evse.calibration_state >= 2) && (evse.calibration_state <= 15) && (data->state == (evse.calibration_state + 1))) {
-		ads1118.cp_cal_880ohm[evse.calibration_state-2] = ads1118.cp_cal_max_voltage - (910*(ads1118.cp_high_voltage - ADS1118_DIODE_DROP) + 880*ads1118.cp_high_voltage)/880;
+		evse_write_cp_duty_cycle(dc);
+	} else if((EVSE_CTX(evse).calibration_state >= 2) && (EVSE_CTX(evse).calibration_state <= 15) && (data->state == (EVSE_CTX(evse).calibration_state + 1))) {
+		EVSE_CTX(ads1118).cp_cal_880ohm[EVSE_CTX(evse).calibration_state-2] = EVSE_CTX(ads1118).cp_cal_max_voltage - (910*(EVSE_CTX(ads1118).cp_high_voltage - ADS1118_DIODE_DROP) + 880*EVSE_CTX(ads1118).cp_high_voltage)/880;
 
 		response->success = true;
-		logd("cal 880ohm %d -> %d\n\r", evse.calibration_state-2, ads1118.cp_cal_880ohm[evse.calibration_state-2]);
+		logd("cal 880ohm %d -> %d\n\r", EVSE_CTX(evse).calibration_state-2, EVSE_CTX(ads1118).cp_cal_880ohm[EVSE_CTX(evse).calibration_state-2]);
 
-		evse.calibration_state++;
-		if(evse.calibration_state < 16) {
-			uint16_t dc = iec61851_get_duty_cycle_for_ma(6000U + (evse.calibration_state-2)*2000U);
-			ccu4_pwm_set_duty_cycle(EVSE_CP_PWM_SLICE_NUMBER, 64000 - dc*64);
-		} else if(evse.calibration_state == 16) {
+		EVSE_CTX(evse).calibration_state++;
+		if(EVSE_CTX(evse).calibration_state < 16) {
+			uint16_t dc = iec61851_get_duty_cycle_for_ma(6000U + (EVSE_CTX(evse).calibration_state-2)*2000U);
+			evse_write_cp_duty_cycle(dc);
+		} else if(EVSE_CTX(evse).calibration_state == 16) {
 			// Set duty cycle to 0%
-			ccu4_pwm_set_duty_cycle(EVSE_CP_PWM_SLICE_NUMBER, 64000 - 0*64);
+			evse_write_cp_duty_cycle(0);
 		}
-	} else if((evse.calibration_state == 16) && (data->state == 17)) {
-		evse.calibration_state = 0;
-		ads1118.cp_cal_diff_voltage = data->value;
+	} else if((EVSE_CTX(evse).calibration_state == 16) && (data->state == 17)) {
+		EVSE_CTX(evse).calibration_state = 0;
+		EVSE_CTX(ads1118).cp_cal_diff_voltage = data->value;
 
 		// Set duty cycle back to 100%
-		ccu4_pwm_set_duty_cycle(EVSE_CP_PWM_SLICE_NUMBER, 64000 - 1000*64);
+		evse_write_cp_duty_cycle(1000);
 		response->success = true;
 
 		evse_save_calibration();
@@ -309,25 +403,25 @@ BootloaderHandleMessageResponse calibrate(const Calibrate *data, Calibrate_Respo
 
 BootloaderHandleMessageResponse get_user_calibration(const GetUserCalibration *data, GetUserCalibration_Response *response) {
 	response->header.length           = sizeof(GetUserCalibration_Response);
-	response->user_calibration_active = ads1118.cp_user_cal_active;
+	response->user_calibration_active = EVSE_CTX(ads1118).cp_user_cal_active;
 
-	if(ads1118.cp_user_cal_active) {
-		response->voltage_mul     = ads1118.cp_user_cal_mul;
-		response->voltage_div     = ads1118.cp_user_cal_div;
-		response->voltage_diff    = ads1118.cp_user_cal_diff_voltage;
-		response->resistance_2700 = ads1118.cp_user_cal_2700ohm;
+	if(EVSE_CTX(ads1118).cp_user_cal_active) {
+		response->voltage_mul     = EVSE_CTX(ads1118).cp_user_cal_mul;
+		response->voltage_div     = EVSE_CTX(ads1118).cp_user_cal_div;
+		response->voltage_diff    = EVSE_CTX(ads1118).cp_user_cal_diff_voltage;
+		response->resistance_2700 = EVSE_CTX(ads1118).cp_user_cal_2700ohm;
 
 		for(uint8_t i = 0; i < ADS1118_880OHM_CAL_NUM; i++) {
-			response->resistance_880[i] = ads1118.cp_user_cal_880ohm[i];
+			response->resistance_880[i] = EVSE_CTX(ads1118).cp_user_cal_880ohm[i];
 		}
 	} else {
-		response->voltage_mul     = ads1118.cp_cal_mul;
-		response->voltage_div     = ads1118.cp_cal_div;
-		response->voltage_diff    = ads1118.cp_cal_diff_voltage;
-		response->resistance_2700 = ads1118.cp_cal_2700ohm;
+		response->voltage_mul     = EVSE_CTX(ads1118).cp_cal_mul;
+		response->voltage_div     = EVSE_CTX(ads1118).cp_cal_div;
+		response->voltage_diff    = EVSE_CTX(ads1118).cp_cal_diff_voltage;
+		response->resistance_2700 = EVSE_CTX(ads1118).cp_cal_2700ohm;
 
 		for(uint8_t i = 0; i < ADS1118_880OHM_CAL_NUM; i++) {
-			response->resistance_880[i] = ads1118.cp_cal_880ohm[i];
+			response->resistance_880[i] = EVSE_CTX(ads1118).cp_cal_880ohm[i];
 		}
 	}
 
@@ -344,24 +438,24 @@ BootloaderHandleMessageResponse set_user_calibration(const SetUserCalibration *d
 			return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
 		}
 
-		ads1118.cp_user_cal_active       = true;
-		ads1118.cp_user_cal_mul          = data->voltage_mul;
-		ads1118.cp_user_cal_div          = data->voltage_div;
-		ads1118.cp_user_cal_diff_voltage = data->voltage_diff;
-		ads1118.cp_user_cal_2700ohm      = data->resistance_2700;
+		EVSE_CTX(ads1118).cp_user_cal_active       = true;
+		EVSE_CTX(ads1118).cp_user_cal_mul          = data->voltage_mul;
+		EVSE_CTX(ads1118).cp_user_cal_div          = data->voltage_div;
+		EVSE_CTX(ads1118).cp_user_cal_diff_voltage = data->voltage_diff;
+		EVSE_CTX(ads1118).cp_user_cal_2700ohm      = data->resistance_2700;
 
 		for(uint8_t i = 0; i < ADS1118_880OHM_CAL_NUM; i++) {
-			ads1118.cp_user_cal_880ohm[i] = data->resistance_880[i];
+			EVSE_CTX(ads1118).cp_user_cal_880ohm[i] = data->resistance_880[i];
 		}
 	} else {
-		ads1118.cp_user_cal_active       = false;
-		ads1118.cp_user_cal_mul          = 1;
-		ads1118.cp_user_cal_div          = 1;
-		ads1118.cp_user_cal_diff_voltage = -90;
-		ads1118.cp_user_cal_2700ohm      = 0;
+		EVSE_CTX(ads1118).cp_user_cal_active       = false;
+		EVSE_CTX(ads1118).cp_user_cal_mul          = 1;
+		EVSE_CTX(ads1118).cp_user_cal_div          = 1;
+		EVSE_CTX(ads1118).cp_user_cal_diff_voltage = -90;
+		EVSE_CTX(ads1118).cp_user_cal_2700ohm      = 0;
 
 		for(uint8_t i = 0; i < ADS1118_880OHM_CAL_NUM; i++) {
-			ads1118.cp_user_cal_880ohm[i] = 0;
+			EVSE_CTX(ads1118).cp_user_cal_880ohm[i] = 0;
 		}
 	}
 	evse_save_user_calibration();
@@ -375,7 +469,7 @@ BootloaderHandleMessageResponse get_data_storage(const GetDataStorage *data, Get
 	}
 
 	response->header.length = sizeof(GetDataStorage_Response);
-	memcpy(response->data, evse.storage[data->page], 63);
+	memcpy(response->data, EVSE_CTX(evse).storage[data->page], 63);
 
 	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
 }
@@ -385,82 +479,63 @@ BootloaderHandleMessageResponse set_data_storage(const SetDataStorage *data) {
 		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
 	}
 
-	memcpy(evse.storage[data->page], data->data, 63);
+	memcpy(EVSE_CTX(evse).storage[data->page], data->data, 63);
 
 	return HANDLE_MESSAGE_RESPONSE_EMPTY;
 }
 
 BootloaderHandleMessageResponse get_indicator_led(const GetIndicatorLED *data, GetIndicatorLED_Response *response) {
-	response->header.length = sizeof(GetIndicatorLED_Response);
-	response->indication    = led.api_indication;
-	if((led.api_duration == 0) || system_timer_is_time_elapsed_ms(led.api_start, led.api_duration)) {
-		response->duration  = 0;
-	} else {
-		response->duration  = led.api_duration - ((uint32_t)(system_timer_get_ms() - led.api_start));
-	}
+	EVSETelemetry telemetry;
+	evse_get_telemetry(&telemetry);
 
+	response->header.length = sizeof(GetIndicatorLED_Response);
+	response->indication    = telemetry.indicator_led;
+	response->duration      = telemetry.indicator_led_duration;
 
 	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
 }
 
 BootloaderHandleMessageResponse set_indicator_led(const SetIndicatorLED *data, SetIndicatorLED_Response *response) {
-	if((data->indication >= 256) && (data->indication != 1001) && (data->indication != 1002) && (data->indication != 1003) && ((data->indication < 2001) || (data->indication > 2010))) {
+	if(!led_is_api_indication_valid(data->indication)) {
 		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
 	}
 
 	response->header.length = sizeof(SetIndicatorLED_Response);
 
-	// If the state and indication stays the same we just update the duration
-	// This way the animation does not become choppy
-	if((led.state == LED_STATE_API) && (led.api_indication == data->indication)) {
-		led.api_duration = data->duration;
-		led.api_start    = system_timer_get_ms();
-		response->status = 0;
-		return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+	if(data->indication < 0) {
+		// Gives the LED back to the EVSE (LED on until standby) if an indication is active
+		led_clear_api_indication();
+	} else if(EVSE_CTX(led).layers[LED_LAYER_API].active && (EVSE_CTX(led).api_indication == data->indication)) {
+		// If the indication stays the same we just update the duration
+		// This way the animation does not become choppy
+		EVSE_CTX(led).api_duration = data->duration;
+		EVSE_CTX(led).api_start    = system_timer_get_ms();
+		scheduler_trigger(SCHEDULER_TASK_LED);
+	} else {
+		led_set_api_indication(data->indication, data->duration);
 	}
+	evse_update_telemetry_led();
 
-	// Otherwise we reset the current animation and start the new one
-	if((led.state == LED_STATE_OFF) || (led.state == LED_STATE_ON) || (led.state == LED_STATE_API) || (led.state == LED_STATE_BREATHING)) {
-		response->status     = 0;
-
-		led.api_ack_counter  = 0;
-		led.api_ack_index    = 0;
-		led.api_ack_time     = 0;
-
-		led.api_nack_counter = 0;
-		led.api_nack_index   = 0;
-		led.api_nack_time    = 0;
-
-		led.api_nag_counter  = 0;
-		led.api_nag_index    = 0;
-		led.api_nag_time     = 0;
-
-		if(data->indication < 0) {
-			// If LED state is currently LED_STATE_OFF or LED_STATE_ON we
-			// leave the LED where it is (and don't restart the standby timer).
-			// If LED state is currently in LED_STATE_API we
-			// turn the LED on (which brings it in LED_STATE_ON) and restarts the standby timer.
-			if(led.state == LED_STATE_API) {
-				led_set_on(true);
-			}
-		} else {
-			led.state          = LED_STATE_API;
-			led.api_indication = data->indication;
-			led.api_duration   = data->duration;
-			led.api_start      = system_timer_get_ms();
-		}
+	// The indication is always taken. If a layer with higher priority (error blinking, key switch)
+	// is visible, the status is the LED state of that layer and the indication is shown after it.
+	const uint8_t top_layer = led_get_top_layer();
+	if((data->indication < 0) || (top_layer >= LED_LAYER_API)) {
+		response->status = 0;
 	} else {
-		response->status = led.state;
+		response->status = EVSE_CTX(led).layers[top_layer].state;
 	}
 
 	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
 }
 
 BootloaderHandleMessageResponse get_button_state(const GetButtonState *data, GetButtonState_Response *response) {
+	EVSETelemetry telemetry;
+	evse_get_telemetry(&telemetry);
+
 	response->header.length       = sizeof(GetButtonState_Response);
-	response->button_press_time   = button.press_time;
-	response->button_release_time = button.release_time;
-	response->button_pressed      = button.state == BUTTON_STATE_PRESSED;
+	response->button_press_time   = telemetry.button_press_time;
+	response->button_release_time = telemetry.button_release_time;
+	response->button_pressed      = telemetry.button_pressed;
 
 	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
 }
@@ -468,32 +543,18 @@ BootloaderHandleMessageResponse get_button_state(const GetButtonState *data, Get
 BootloaderHandleMessageResponse get_all_data_1(const GetAllData1 *data, GetAllData1_Response *response) {
 	response->header.length = sizeof(GetAllData1_Response);
 
-	TFPMessageFull parts;
-
-	get_state(NULL, (GetState_Response*)&parts);
-	memcpy(&response->iec61851_state, parts.data, sizeof(GetState_Response) - sizeof(TFPMessageHeader));
-
-	get_hardware_configuration(NULL, (GetHardwareConfiguration_Response*)&parts);
-	memcpy(&response->jumper_configuration, parts.data, sizeof(GetHardwareConfiguration_Response) - sizeof(TFPMessageHeader));
-
-	get_low_level_state(NULL, (GetLowLevelState_Response*)&parts);
-	memcpy(&response->led_state, parts.data, sizeof(GetLowLevelState_Response) - sizeof(TFPMessageHeader));
-
-	get_indicator_led(NULL, (GetIndicatorLED_Response*)&parts);
-	memcpy(&response->indication, parts.data, sizeof(GetIndicatorLED_Response) - sizeof(TFPMessageHeader));
-
-	get_button_state(NULL, (GetButtonState_Response*)&parts);
-	memcpy(&response->button_press_time, parts.data, sizeof(GetButtonState_Response) - sizeof(TFPMessageHeader));
-
-	get_boost_mode(NULL, (GetBoostMode_Response*)&parts);
-	memcpy(&response->boost_mode_enabled, parts.data, sizeof(GetBoostMode_Response) - sizeof(TFPMessageHeader));
+	// All data 1 is the concatenation of the state, hardware configuration, low-level state,
+	// indicator LED, button state and boost mode groups
+	const uint16_t groups = EVSE_DATA_GROUP_STATE | EVSE_DATA_GROUP_HARDWARE_CONFIGURATION | EVSE_DATA_GROUP_LOW_LEVEL_STATE |
+	                        EVSE_DATA_GROUP_INDICATOR_LED | EVSE_DATA_GROUP_BUTTON_STATE | EVSE_DATA_GROUP_BOOST_MODE;
+	communication_pack_data_groups(groups, 0, &response->iec61851_state, sizeof(GetAllData1_Response) - sizeof(TFPMessageHeader));
 
 	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
 }
 
 BootloaderHandleMessageResponse factory_reset(const FactoryReset *data) {
 	if(data->password == 0x2342FACD) {
-		evse.factory_reset_time = system_timer_get_ms();
+		EVSE_CTX(evse).factory_reset_time = system_timer_get_ms();
 		return HANDLE_MESSAGE_RESPONSE_EMPTY;
 	}
 
@@ -501,7 +562,11 @@ BootloaderHandleMessageResponse factory_reset(const FactoryReset *data) {
 }
 
 BootloaderHandleMessageResponse set_boost_mode(const SetBoostMode *data) {
-	evse.boost_mode_enabled = data->boost_mode_enabled;
+	if(EVSE_CTX(evse).boost_mode_enabled != data->boost_mode_enabled) {
+		journal_add(JOURNAL_EVENT_BOOST_MODE, data->boost_mode_enabled, 0);
+	}
+
+	EVSE_CTX(evse).boost_mode_enabled = data->boost_mode_enabled;
 	evse_save_config();
 
 	return HANDLE_MESSAGE_RESPONSE_EMPTY;
@@ -509,16 +574,525 @@ BootloaderHandleMessageResponse set_boost_mode(const SetBoostMode *data) {
 
 BootloaderHandleMessageResponse get_boost_mode(const GetBoostMode *data, GetBoostMode_Response *response) {
 	response->header.length      = sizeof(GetBoostMode_Response);
-	response->boost_mode_enabled = evse.boost_mode_enabled;
+	response->boost_mode_enabled = EVSE_CTX(evse).boost_mode_enabled;
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+// FNV-1a, only used to detect if a data group has changed since the last check
+static uint32_t communication_hash(const uint8_t *data, const uint8_t length) {
+	uint32_t hash = 2166136261U;
+	for(uint8_t i = 0; i < length; i++) {
+		hash = (hash ^ data[i]) * 16777619U;
+	}
+
+	return hash;
+}
+
+// Thresholds of the CP/PE states and the PP/PE cable codings (see iec61851.h)
+static const uint32_t communication_cp_bands[] = {IEC61851_CP_RESISTANCE_STATE_D, IEC61851_CP_RESISTANCE_STATE_C, IEC61851_CP_RESISTANCE_STATE_B, IEC61851_CP_RESISTANCE_STATE_A};
+static const uint32_t communication_pp_bands[] = {IEC61851_PP_RESISTANCE_32A, IEC61851_PP_RESISTANCE_20A, IEC61851_PP_RESISTANCE_13A};
+
+// Number of thresholds (ascending) that are below the value
+static uint32_t communication_get_band(const uint32_t value, const uint32_t *thresholds, const uint8_t num) {
+	uint32_t band = 0;
+	while((band < num) && (value > thresholds[band])) {
+		band++;
+	}
+
+	return band;
+}
+
+static void communication_update_data_changes(void) {
+	TFPMessageFull parts;
+
+	// The sequence of a boot starts at the boot epoch. The journal sequence is counted
+	// across reboots, so the sequences of this boot are greater than the ones of the
+	// last boot. A host that still holds a sequence of the last boot gets all groups.
+	if(EVSE_CTX(data_changes).sequence == 0) {
+		EVSE_CTX(data_changes).sequence = EVSE_CTX(journal).next_sequence << DATA_CHANGES_EPOCH_SHIFT;
+	}
+
+	for(uint8_t group = 0; group < DATA_GROUP_NUM; group++) {
+		const uint8_t length = communication_get_data_group(group, &parts);
+
+		// Fields that are derived from the system time change with every call,
+		// the host can extrapolate them itself. They don't count as a change.
+		// The ADC codes and the voltages and resistances derived from them
+		// change with every conversion (noise), only the resistance band
+		// that the state machine acts on counts.
+		if(group == 2) {
+			GetLowLevelState_Response *low_level = (GetLowLevelState_Response*)&parts;
+			low_level->time_since_state_change = 0;
+			low_level->uptime                  = 0;
+			low_level->adc_values[0]           = 0;
+			low_level->adc_values[1]           = 0;
+			memset(low_level->voltages, 0, sizeof(low_level->voltages));
+			low_level->resistances[0]          = communication_get_band(low_level->resistances[0], communication_cp_bands, sizeof(communication_cp_bands)/sizeof(uint32_t));
+			low_level->resistances[1]          = communication_get_band(low_level->resistances[1], communication_pp_bands, sizeof(communication_pp_bands)/sizeof(uint32_t));
+		} else if(group == 3) {
+			((GetIndicatorLED_Response*)&parts)->duration = 0;
+		}
+
+		const uint32_t hash = communication_hash(parts.data, length);
+		if((hash != EVSE_CTX(data_changes).group_hash[group]) || (EVSE_CTX(data_changes).group_sequence[group] == 0)) {
+			EVSE_CTX(data_changes).sequence++;
+			EVSE_CTX(data_changes).group_hash[group]     = hash;
+			EVSE_CTX(data_changes).group_sequence[group] = EVSE_CTX(data_changes).sequence;
+		}
+	}
+}
+
+BootloaderHandleMessageResponse get_data_groups_low_level(const GetDataGroupsLowLevel *data, GetDataGroupsLowLevel_Response *response) {
+	if((data->groups == 0) || (data->groups >= (1 << DATA_GROUP_NUM))) {
+		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
+	}
+
+	// A new stream starts at offset 0. A stream that starts somewhere else
+	// (or with other groups) gets a new snapshot too.
+	DataGroupsSnapshot *snapshot = &EVSE_CTX(data_groups_snapshot);
+	if((data->stream_chunk_offset == 0) || (data->groups != snapshot->groups)) {
+		snapshot->groups = data->groups;
+		snapshot->length = communication_pack_data_groups(data->groups, 0, snapshot->data, sizeof(snapshot->data));
+	}
+
+	if(data->stream_chunk_offset >= snapshot->length) {
+		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
+	}
+
+	const uint16_t length = MIN(snapshot->length - data->stream_chunk_offset, (uint16_t)sizeof(response->stream_chunk_data));
+
+	response->header.length       = sizeof(GetDataGroupsLowLevel_Response);
+	response->stream_total_length = snapshot->length;
+	response->stream_chunk_offset = data->stream_chunk_offset;
+	memset(response->stream_chunk_data, 0, sizeof(response->stream_chunk_data));
+	memcpy(response->stream_chunk_data, &snapshot->data[data->stream_chunk_offset], length);
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+BootloaderHandleMessageResponse get_data_changes(const GetDataChanges *data, GetDataChanges_Response *response) {
+	// Changes are detected in communication_tick, a change that is reverted
+	// before the next poll is still reported. Polling an idle EVSE only
+	// costs one round trip with a 6 byte response.
+	response->header.length  = sizeof(GetDataChanges_Response);
+	response->sequence       = EVSE_CTX(data_changes).sequence;
+	response->changed_groups = 0;
+	for(uint8_t group = 0; group < DATA_GROUP_NUM; group++) {
+		// A sequence that is ahead of ours is from before a reboot (with an epoch that
+		// wrapped around or that was not committed to the journal), all groups changed
+		if((EVSE_CTX(data_changes).group_sequence[group] > data->sequence) || (data->sequence > EVSE_CTX(data_changes).sequence)) {
+			response->changed_groups |= 1 << group;
+		}
+	}
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+BootloaderHandleMessageResponse get_tick_profile(const GetTickProfile *data, GetTickProfile_Response *response) {
+#ifdef PROFILER_ENABLE
+	if(data->module >= PROFILER_MODULE_NUM) {
+		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
+	}
+
+	const ProfilerModule *module = &profiler.module[data->module];
+
+	response->header.length            = sizeof(GetTickProfile_Response);
+	response->call_count                = module->count;
+	response->min_cycles                = module->min;
+	response->avg_cycles                = module->count == 0 ? 0 : (uint32_t)(module->sum / module->count);
+	response->max_cycles                = module->max;
+	response->loops_per_second          = profiler.loops_per_second;
+	response->max_loop_gap_cycles       = profiler.loop_gap_max;
+	response->coop_task_switches        = profiler.coop_task_switches;
+	response->accesses_saved_per_second = profiler.accesses_saved_per_second;
 
 	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+#else
+	return HANDLE_MESSAGE_RESPONSE_NOT_SUPPORTED;
+#endif
+}
+
+BootloaderHandleMessageResponse reset_tick_profile(const ResetTickProfile *data) {
+#ifdef PROFILER_ENABLE
+	profiler_reset();
+
+	return HANDLE_MESSAGE_RESPONSE_EMPTY;
+#else
+	return HANDLE_MESSAGE_RESPONSE_NOT_SUPPORTED;
+#endif
+}
+
+BootloaderHandleMessageResponse get_memory_usage(const GetMemoryUsage *data, GetMemoryUsage_Response *response) {
+	response->header.length   = sizeof(GetMemoryUsage_Response);
+	response->main_stack_size = memory_usage_get_main_stack_size();
+	response->main_stack_used = memory_usage_get_main_stack_used();
+	response->task_stack_size = sizeof(EVSE_CTX(ads1118_task).stack);
+	response->task_stack_used = memory_usage_get_stack_used(EVSE_CTX(ads1118_task).stack, sizeof(EVSE_CTX(ads1118_task).stack)/sizeof(uint32_t));
+
+	response->static_ram[EVSE_RAM_MODULE_EVSE]            = sizeof(EVSE_CTX(evse));
+	response->static_ram[EVSE_RAM_MODULE_ADS1118]         = sizeof(EVSE_CTX(ads1118)) + sizeof(EVSE_CTX(ads1118_task));
+	response->static_ram[EVSE_RAM_MODULE_IEC61851]        = sizeof(EVSE_CTX(iec61851));
+	response->static_ram[EVSE_RAM_MODULE_LED]             = sizeof(EVSE_CTX(led));
+	response->static_ram[EVSE_RAM_MODULE_LOCK]            = sizeof(EVSE_CTX(lock));
+	response->static_ram[EVSE_RAM_MODULE_BUTTON]          = sizeof(EVSE_CTX(button));
+	response->static_ram[EVSE_RAM_MODULE_CHARGING_SLOT]   = sizeof(EVSE_CTX(charging_slot));
+	response->static_ram[EVSE_RAM_MODULE_CONTACTOR_CHECK] = sizeof(contactor_check);
+	response->static_ram[EVSE_RAM_MODULE_COMMUNICATION]   = sizeof(EVSE_CTX(data_changes)) + sizeof(EVSE_CTX(data_groups_snapshot));
+	response->static_ram[EVSE_RAM_MODULE_SCHEDULER]       = sizeof(EVSE_CTX(scheduler));
+#ifdef PROFILER_ENABLE
+	response->static_ram[EVSE_RAM_MODULE_PROFILER]        = sizeof(profiler);
+#else
+	response->static_ram[EVSE_RAM_MODULE_PROFILER]        = 0;
+#endif
+	response->static_ram[EVSE_RAM_MODULE_RECORDER]        = sizeof(EVSE_CTX(recorder));
+	response->static_ram[EVSE_RAM_MODULE_JOURNAL]         = sizeof(EVSE_CTX(journal));
+	response->static_ram[EVSE_RAM_MODULE_CALIBRATION]     = sizeof(EVSE_CTX(calibration));
+	response->static_ram[EVSE_RAM_MODULE_DERATING]        = sizeof(EVSE_CTX(derating));
+#ifdef LOGRING_ACTIVE
+	response->static_ram[EVSE_RAM_MODULE_LOGRING]         = sizeof(EVSE_CTX(logring));
+#else
+	response->static_ram[EVSE_RAM_MODULE_LOGRING]         = 0;
+#endif
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+BootloaderHandleMessageResponse get_boot_info(const GetBootInfo *data, GetBootInfo_Response *response) {
+	// All times are in ms since boot, 0 if the phase is not done yet
+	response->header.length          = sizeof(GetBootInfo_Response);
+	response->warm_start             = EVSE_CTX(evse).warm_start;
+	response->init_start_time        = EVSE_CTX(evse).boot_init_start_time;
+	response->config_loaded_time     = EVSE_CTX(evse).boot_config_loaded_time;
+	response->jumper_detected_time   = EVSE_CTX(evse).boot_jumper_detected_time;
+	response->adc_version_found_time = EVSE_CTX(evse).boot_adc_version_found_time;
+	response->boot_to_ready_time     = EVSE_CTX(evse).boot_to_ready_time;
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+BootloaderHandleMessageResponse read_log_low_level(const ReadLogLowLevel *data, ReadLogLowLevel_Response *response) {
+	response->header.length   = sizeof(ReadLogLowLevel_Response);
+	response->dropped_records = logring_get_dropped();
+	memset(response->log_data, 0, sizeof(response->log_data));
+	response->log_length      = logring_read(response->log_data, sizeof(response->log_data));
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+BootloaderHandleMessageResponse set_recorder_configuration(const SetRecorderConfiguration *data) {
+	if(data->post_trigger_entries >= RECORDER_ENTRY_NUM) {
+		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
+	}
+
+	EVSE_CTX(recorder).trigger_mask         = data->trigger_mask;
+	EVSE_CTX(recorder).post_trigger_entries = data->post_trigger_entries;
+	evse_save_config();
+
+	return HANDLE_MESSAGE_RESPONSE_EMPTY;
+}
+
+BootloaderHandleMessageResponse get_recorder_configuration(const GetRecorderConfiguration *data, GetRecorderConfiguration_Response *response) {
+	response->header.length        = sizeof(GetRecorderConfiguration_Response);
+	response->trigger_mask         = EVSE_CTX(recorder).trigger_mask;
+	response->post_trigger_entries = EVSE_CTX(recorder).post_trigger_entries;
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+BootloaderHandleMessageResponse trigger_recorder(const TriggerRecorder *data) {
+	recorder_trigger(RECORDER_TRIGGER_MANUAL);
+
+	return HANDLE_MESSAGE_RESPONSE_EMPTY;
 }
 
+BootloaderHandleMessageResponse rearm_recorder(const RearmRecorder *data) {
+	recorder_rearm();
+
+	return HANDLE_MESSAGE_RESPONSE_EMPTY;
+}
+
+BootloaderHandleMessageResponse get_recorder_state(const GetRecorderState *data, GetRecorderState_Response *response) {
+	response->header.length = sizeof(GetRecorderState_Response);
+	response->frozen        = EVSE_CTX(recorder).frozen;
+	response->trigger       = EVSE_CTX(recorder).trigger;
+	response->trigger_time  = EVSE_CTX(recorder).trigger_time;
+	response->entry_count   = EVSE_CTX(recorder).count;
+	response->uptime        = system_timer_get_ms();
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+BootloaderHandleMessageResponse read_recorder_low_level(const ReadRecorderLowLevel *data, ReadRecorderLowLevel_Response *response) {
+	response->header.length       = sizeof(ReadRecorderLowLevel_Response);
+	response->stream_chunk_offset = data->stream_chunk_offset;
+	memset(response->stream_chunk_data, 0, sizeof(response->stream_chunk_data));
+
+	response->stream_total_length = recorder_read(data->stream_chunk_offset, response->stream_chunk_data, sizeof(response->stream_chunk_data));
+	if((response->stream_total_length != 0) && (data->stream_chunk_offset >= response->stream_total_length)) {
+		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
+	}
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+BootloaderHandleMessageResponse read_journal_low_level(const ReadJournalLowLevel *data, ReadJournalLowLevel_Response *response) {
+	// The records in the response are unaligned, we read into an aligned buffer first
+	JournalRecord records[sizeof(response->records)/sizeof(JournalRecord)];
+
+	response->header.length = sizeof(ReadJournalLowLevel_Response);
+	response->record_count  = journal_read(data->cursor, records, sizeof(records)/sizeof(JournalRecord));
+	memset(response->records, 0, sizeof(response->records));
+	memcpy(response->records, records, response->record_count*sizeof(JournalRecord));
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+BootloaderHandleMessageResponse start_calibration(const StartCalibration *data) {
+	if(data->password != CALIBRATION_PASSWORD) {
+		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
+	}
+
+	if((data->cp_voltage_high < INT16_MIN) || (data->cp_voltage_high > INT16_MAX) || !calibration_start(data->cp_voltage_high)) {
+		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
+	}
+
+	return HANDLE_MESSAGE_RESPONSE_EMPTY;
+}
+
+BootloaderHandleMessageResponse set_calibration_resistor(const SetCalibrationResistor *data) {
+	if(!calibration_set_resistor(data->resistor)) {
+		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
+	}
+
+	return HANDLE_MESSAGE_RESPONSE_EMPTY;
+}
+
+BootloaderHandleMessageResponse set_calibration_low_voltage(const SetCalibrationLowVoltage *data) {
+	if((data->cp_voltage_low < INT16_MIN) || (data->cp_voltage_low > INT16_MAX) || !calibration_set_low_voltage(data->cp_voltage_low)) {
+		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
+	}
+
+	return HANDLE_MESSAGE_RESPONSE_EMPTY;
+}
+
+BootloaderHandleMessageResponse abort_calibration(const AbortCalibration *data) {
+	calibration_abort();
+
+	return HANDLE_MESSAGE_RESPONSE_EMPTY;
+}
+
+BootloaderHandleMessageResponse get_calibration_state(const GetCalibrationState *data, GetCalibrationState_Response *response) {
+	response->header.length = sizeof(GetCalibrationState_Response);
+	response->phase         = EVSE_CTX(calibration).phase;
+	response->step          = EVSE_CTX(calibration).step;
+	response->resistor      = EVSE_CTX(calibration).resistor;
+	response->error         = EVSE_CTX(calibration).error;
+	response->value         = EVSE_CTX(calibration).value;
+	response->high_voltage  = EVSE_CTX(calibration).high_voltage;
+	response->variance      = EVSE_CTX(calibration).variance;
+	response->duration      = EVSE_CTX(calibration).duration;
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+BootloaderHandleMessageResponse set_temperature_derating(const SetTemperatureDerating *data) {
+	if(!derating_set_configuration(data->mode, data->start_temperature, data->end_temperature, data->step_current)) {
+		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
+	}
+
+	evse_save_config();
+
+	return HANDLE_MESSAGE_RESPONSE_EMPTY;
+}
+
+BootloaderHandleMessageResponse get_temperature_derating(const GetTemperatureDerating *data, GetTemperatureDerating_Response *response) {
+	response->header.length     = sizeof(GetTemperatureDerating_Response);
+	response->mode              = EVSE_CTX(derating).mode;
+	response->start_temperature = EVSE_CTX(derating).start_temperature;
+	response->end_temperature   = EVSE_CTX(derating).end_temperature;
+	response->step_current      = EVSE_CTX(derating).step_current;
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+BootloaderHandleMessageResponse get_temperature_state(const GetTemperatureState *data, GetTemperatureState_Response *response) {
+	response->header.length   = sizeof(GetTemperatureState_Response);
+	response->temperature     = EVSE_CTX(derating).temperature;
+	response->temperature_max = EVSE_CTX(derating).temperature_max;
+	response->derating_state  = EVSE_CTX(derating).state;
+	response->max_current     = EVSE_CTX(derating).max_current;
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+BootloaderHandleMessageResponse read_temperature_history_low_level(const ReadTemperatureHistoryLowLevel *data, ReadTemperatureHistoryLowLevel_Response *response) {
+	response->header.length       = sizeof(ReadTemperatureHistoryLowLevel_Response);
+	response->stream_chunk_offset = data->stream_chunk_offset;
+	memset(response->stream_chunk_data, 0, sizeof(response->stream_chunk_data));
+
+	response->stream_total_length = derating_read_history(data->stream_chunk_offset, response->stream_chunk_data, sizeof(response->stream_chunk_data));
+	if((response->stream_total_length != 0) && (data->stream_chunk_offset >= response->stream_total_length)) {
+		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
+	}
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+
+BootloaderHandleMessageResponse set_indicator_led_pattern(const SetIndicatorLEDPattern *data) {
+	LEDKeyframe keyframes[LED_PATTERN_LENGTH_MAX];
+	if(data->length > LED_PATTERN_LENGTH_MAX) {
+		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
+	}
+
+	memcpy(keyframes, data->keyframes, data->length*sizeof(LEDKeyframe));
+	if(!led_set_custom_pattern(data->pattern, keyframes, data->length)) {
+		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
+	}
+
+	return HANDLE_MESSAGE_RESPONSE_EMPTY;
+}
+
+BootloaderHandleMessageResponse get_indicator_led_pattern(const GetIndicatorLEDPattern *data, GetIndicatorLEDPattern_Response *response) {
+	if(data->pattern >= LED_PATTERN_CUSTOM_NUM) {
+		return HANDLE_MESSAGE_RESPONSE_INVALID_PARAMETER;
+	}
+
+	const LEDPattern *pattern = &EVSE_CTX(led).custom_patterns[data->pattern];
+	response->header.length   = sizeof(GetIndicatorLEDPattern_Response);
+	response->length          = pattern->length;
+	memset(response->keyframes, 0, sizeof(response->keyframes));
+	memcpy(response->keyframes, pattern->keyframes, pattern->length*sizeof(LEDKeyframe));
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+BootloaderHandleMessageResponse get_indicator_led_layers(const GetIndicatorLEDLayers *data, GetIndicatorLEDLayers_Response *response) {
+	response->header.length = sizeof(GetIndicatorLEDLayers_Response);
+	response->visible_layer = led_get_top_layer();
+	response->active_layers = 0;
+	for(uint8_t i = 0; i < LED_LAYER_NUM; i++) {
+		if(EVSE_CTX(led).layers[i].active) {
+			response->active_layers |= 1 << i;
+		}
+	}
+	response->led_state     = (response->visible_layer < LED_LAYER_NUM) ? EVSE_CTX(led).layers[response->visible_layer].state : LED_STATE_OFF;
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+// Takes the events out of the queue, with enabled callbacks only the events
+// that were not sent yet (e.g. because the SPITFP buffer was full) are returned
+BootloaderHandleMessageResponse get_button_events(const GetButtonEvents *data, GetButtonEvents_Response *response) {
+	response->header.length = sizeof(GetButtonEvents_Response);
+	response->events_length = 0;
+	response->events_lost   = button_get_events_lost();
+	memset(response->event_type, 0, sizeof(response->event_type));
+	memset(response->event_time, 0, sizeof(response->event_time));
+
+	ButtonEvent event;
+	while((response->events_length < sizeof(response->event_type)) && button_get_event(&event)) {
+		response->event_type[response->events_length] = event.type;
+		response->event_time[response->events_length] = event.time;
+		response->events_length++;
+	}
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+BootloaderHandleMessageResponse set_button_event_callback_configuration(const SetButtonEventCallbackConfiguration *data) {
+	EVSE_CTX(button).event_callback_enabled = data->enabled;
+
+	return HANDLE_MESSAGE_RESPONSE_EMPTY;
+}
+
+BootloaderHandleMessageResponse get_button_event_callback_configuration(const GetButtonEventCallbackConfiguration *data, GetButtonEventCallbackConfiguration_Response *response) {
+	response->header.length = sizeof(GetButtonEventCallbackConfiguration_Response);
+	response->enabled       = EVSE_CTX(button).event_callback_enabled;
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+}
+
+BootloaderHandleMessageResponse get_lock_statistics(const GetLockStatistics *data, GetLockStatistics_Response *response) {
+#ifdef LOCK_ENABLE
+	response->header.length   = sizeof(GetLockStatistics_Response);
+	response->lock_state      = EVSE_CTX(lock).state;
+	response->has_lock_switch = EVSE_CTX(evse).has_lock_switch;
+	for(uint8_t direction = 0; direction < LOCK_DIRECTION_NUM; direction++) {
+		const LockStatistics *statistics = &EVSE_CTX(lock).statistics[direction];
+		response->learned_travel_time[direction] = EVSE_CTX(lock).travel_time[direction];
+		response->last_travel_time[direction]    = statistics->last_travel_time;
+		response->cycles[direction]              = statistics->cycles;
+		response->retries[direction]             = statistics->retries;
+		response->stalls[direction]              = statistics->stalls;
+		response->timeouts[direction]            = statistics->timeouts;
+		response->errors[direction]              = statistics->errors;
+	}
+
+	return HANDLE_MESSAGE_RESPONSE_NEW_MESSAGE;
+#else
+	return HANDLE_MESSAGE_RESPONSE_NOT_SUPPORTED;
+#endif
+}
+
+bool handle_calibration_state_callback(void) {
+	if(!EVSE_CTX(calibration).state_changed) {
+		return false;
+	}
+
+	CalibrationState_Callback cb;
+	if(bootloader_spitfp_is_send_possible(&bootloader_status.st)) {
+		tfp_make_default_header(&cb.header, bootloader_get_uid(), sizeof(CalibrationState_Callback), FID_CALLBACK_CALIBRATION_STATE);
+		cb.phase        = EVSE_CTX(calibration).phase;
+		cb.step         = EVSE_CTX(calibration).step;
+		cb.resistor     = EVSE_CTX(calibration).resistor;
+		cb.error        = EVSE_CTX(calibration).error;
+		cb.value        = EVSE_CTX(calibration).value;
+		cb.high_voltage = EVSE_CTX(calibration).high_voltage;
+		cb.variance     = EVSE_CTX(calibration).variance;
+		cb.duration     = EVSE_CTX(calibration).duration;
+
+		bootloader_spitfp_send_ack_and_message(&bootloader_status, (uint8_t*)&cb, sizeof(CalibrationState_Callback));
+		EVSE_CTX(calibration).state_changed = false;
+		return true;
+	}
+
+	return false;
+}
+
+bool handle_button_event_callback(void) {
+	if(!EVSE_CTX(button).event_callback_enabled) {
+		return false;
+	}
+
+	ButtonEvent_Callback cb;
+	if(bootloader_spitfp_is_send_possible(&bootloader_status.st)) {
+		ButtonEvent event;
+		if(!button_get_event(&event)) {
+			return false;
+		}
+
+		tfp_make_default_header(&cb.header, bootloader_get_uid(), sizeof(ButtonEvent_Callback), FID_CALLBACK_BUTTON_EVENT);
+		cb.type = event.type;
+		cb.time = event.time;
+
+		bootloader_spitfp_send_ack_and_message(&bootloader_status, (uint8_t*)&cb, sizeof(ButtonEvent_Callback));
+		return true;
+	}
+
+	return false;
+}
 
 void communication_tick(void) {
-//	communication_callback_tick();
+	communication_callback_tick();
+
+	if((EVSE_CTX(data_changes).sequence == 0) || system_timer_is_time_elapsed_ms(EVSE_CTX(data_changes).last_update, DATA_CHANGES_INTERVAL)) {
+		EVSE_CTX(data_changes).last_update = system_timer_get_ms();
+		communication_update_data_changes();
+	}
 }
 
 void communication_init(void) {
-//	communication_callback_init();
+	communication_callback_init();
 }
@@ -28,11 +28,30 @@
 #include "bricklib2/protocols/tfp/tfp.h"
 #include "bricklib2/bootloader/bootloader.h"
 
+#include "charging_slot.h"
+
 // Default functions
 BootloaderHandleMessageResponse handle_message(const void *data, void *response);
 void communication_tick(void);
 void communication_init(void);
 
+#define DATA_GROUP_NUM 9
+
+// The data groups are checked for changes every 10ms. The state machine, the button
+// and the LED don't change and change back faster than that.
+#define DATA_CHANGES_INTERVAL 10
+
+// The upper 8 bits of the sequence are the boot epoch (see communication_update_data_changes)
+#define DATA_CHANGES_EPOCH_SHIFT 24
+
+// Sequence numbers and hashes for the change detection of the data groups (see get_data_changes)
+typedef struct {
+	uint32_t sequence;
+	uint32_t group_sequence[DATA_GROUP_NUM];
+	uint32_t group_hash[DATA_GROUP_NUM];
+	uint32_t last_update;
+} DataChanges;
+
 // Constants
 
 #define EVSE_IEC61851_STATE_A 0
@@ -47,6 +66,18 @@ void communication_init(void);
 #define EVSE_LED_STATE_FLICKER 3
 #define EVSE_LED_STATE_BREATHING 4
 
+#define EVSE_LED_LAYER_FAULT 0
+#define EVSE_LED_LAYER_KEY_SWITCH 1
+#define EVSE_LED_LAYER_API 2
+#define EVSE_LED_LAYER_CHARGING 3
+#define EVSE_LED_LAYER_STANDBY 4
+#define EVSE_LED_LAYER_NONE 5
+
+#define EVSE_BUTTON_EVENT_PRESS 0
+#define EVSE_BUTTON_EVENT_RELEASE 1
+#define EVSE_BUTTON_EVENT_LONG_PRESS 2
+#define EVSE_BUTTON_EVENT_DOUBLE_PRESS 3
+
 #define EVSE_CHARGER_STATE_NOT_CONNECTED 0
 #define EVSE_CHARGER_STATE_WAITING_FOR_CHARGE_RELEASE 1
 #define EVSE_CHARGER_STATE_READY_TO_CHARGE 2
@@ -99,6 +130,33 @@ void communication_init(void);
 #define EVSE_STATUS_LED_CONFIG_SHOW_HEARTBEAT 2
 #define EVSE_STATUS_LED_CONFIG_SHOW_STATUS 3
 
+#define EVSE_DATA_GROUP_STATE 1
+#define EVSE_DATA_GROUP_HARDWARE_CONFIGURATION 2
+#define EVSE_DATA_GROUP_LOW_LEVEL_STATE 4
+#define EVSE_DATA_GROUP_INDICATOR_LED 8
+#define EVSE_DATA_GROUP_BUTTON_STATE 16
+#define EVSE_DATA_GROUP_BOOST_MODE 32
+#define EVSE_DATA_GROUP_ALL_CHARGING_SLOTS 64
+#define EVSE_DATA_GROUP_ALL_CHARGING_SLOT_DEFAULTS 128
+#define EVSE_DATA_GROUP_USER_CALIBRATION 256
+
+#define EVSE_RAM_MODULE_EVSE 0
+#define EVSE_RAM_MODULE_ADS1118 1
+#define EVSE_RAM_MODULE_IEC61851 2
+#define EVSE_RAM_MODULE_LED 3
+#define EVSE_RAM_MODULE_LOCK 4
+#define EVSE_RAM_MODULE_BUTTON 5
+#define EVSE_RAM_MODULE_CHARGING_SLOT 6
+#define EVSE_RAM_MODULE_CONTACTOR_CHECK 7
+#define EVSE_RAM_MODULE_COMMUNICATION 8
+#define EVSE_RAM_MODULE_SCHEDULER 9
+#define EVSE_RAM_MODULE_PROFILER 10
+#define EVSE_RAM_MODULE_RECORDER 11
+#define EVSE_RAM_MODULE_JOURNAL 12
+#define EVSE_RAM_MODULE_CALIBRATION 13
+#define EVSE_RAM_MODULE_DERATING 14
+#define EVSE_RAM_MODULE_LOGRING 15
+
 // Function and callback IDs and structs
 #define FID_GET_STATE 1
 #define FID_GET_HARDWARE_CONFIGURATION 2
@@ -123,6 +181,39 @@ void communication_init(void);
 #define FID_FACTORY_RESET 21
 #define FID_SET_BOOST_MODE 22
 #define FID_GET_BOOST_MODE 23
+#define FID_GET_DATA_CHANGES 24
+#define FID_GET_DATA_GROUPS_LOW_LEVEL 25
+#define FID_GET_TICK_PROFILE 26
+#define FID_RESET_TICK_PROFILE 27
+#define FID_GET_MEMORY_USAGE 28
+#define FID_GET_BOOT_INFO 29
+#define FID_READ_LOG_LOW_LEVEL 30
+#define FID_SET_RECORDER_CONFIGURATION 31
+#define FID_GET_RECORDER_CONFIGURATION 32
+#define FID_TRIGGER_RECORDER 33
+#define FID_REARM_RECORDER 34
+#define FID_GET_RECORDER_STATE 35
+#define FID_READ_RECORDER_LOW_LEVEL 36
+#define FID_READ_JOURNAL_LOW_LEVEL 37
+#define FID_START_CALIBRATION 38
+#define FID_SET_CALIBRATION_RESISTOR 39
+#define FID_SET_CALIBRATION_LOW_VOLTAGE 40
+#define FID_ABORT_CALIBRATION 41
+#define FID_GET_CALIBRATION_STATE 42
+#define FID_SET_TEMPERATURE_DERATING 44
+#define FID_GET_TEMPERATURE_DERATING 45
+#define FID_GET_TEMPERATURE_STATE 46
+#define FID_READ_TEMPERATURE_HISTORY_LOW_LEVEL 47
+#define FID_SET_INDICATOR_LED_PATTERN 48
+#define FID_GET_INDICATOR_LED_PATTERN 49
+#define FID_GET_INDICATOR_LED_LAYERS 50
+#define FID_GET_BUTTON_EVENTS 51
+#define FID_SET_BUTTON_EVENT_CALLBACK_CONFIGURATION 52
+#define FID_GET_BUTTON_EVENT_CALLBACK_CONFIGURATION 53
+#define FID_GET_LOCK_STATISTICS 55
+
+#define FID_CALLBACK_CALIBRATION_STATE 43
+#define FID_CALLBACK_BUTTON_EVENT 54
 
 
 typedef struct {
@@ -373,6 +464,340 @@ typedef struct {
 	bool boost_mode_enabled;
 } __attribute__((__packed__)) GetBoostMode_Response;
 
+typedef struct {
+	TFPMessageHeader header;
+	uint32_t sequence;
+} __attribute__((__packed__)) GetDataChanges;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint32_t sequence;
+	uint16_t changed_groups;
+} __attribute__((__packed__)) GetDataChanges_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint16_t groups;
+	uint16_t stream_chunk_offset;
+} __attribute__((__packed__)) GetDataGroupsLowLevel;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint16_t stream_total_length;
+	uint16_t stream_chunk_offset;
+	uint8_t stream_chunk_data[60];
+} __attribute__((__packed__)) GetDataGroupsLowLevel_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint8_t module;
+} __attribute__((__packed__)) GetTickProfile;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint32_t call_count;
+	uint32_t min_cycles;
+	uint32_t avg_cycles;
+	uint32_t max_cycles;
+	uint32_t loops_per_second;
+	uint32_t max_loop_gap_cycles;
+	uint32_t coop_task_switches;
+	uint32_t accesses_saved_per_second;
+} __attribute__((__packed__)) GetTickProfile_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+} __attribute__((__packed__)) ResetTickProfile;
+
+typedef struct {
+	TFPMessageHeader header;
+} __attribute__((__packed__)) GetMemoryUsage;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint16_t main_stack_size;
+	uint16_t main_stack_used;
+	uint16_t task_stack_size;
+	uint16_t task_stack_used;
+	uint16_t static_ram[16];
+} __attribute__((__packed__)) GetMemoryUsage_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+} __attribute__((__packed__)) GetBootInfo;
+
+typedef struct {
+	TFPMessageHeader header;
+	bool warm_start;
+	uint32_t init_start_time;
+	uint32_t config_loaded_time;
+	uint32_t jumper_detected_time;
+	uint32_t adc_version_found_time;
+	uint32_t boot_to_ready_time;
+} __attribute__((__packed__)) GetBootInfo_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+} __attribute__((__packed__)) ReadLogLowLevel;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint16_t dropped_records;
+	uint8_t log_length;
+	uint8_t log_data[60];
+} __attribute__((__packed__)) ReadLogLowLevel_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint8_t trigger_mask;
+	uint8_t post_trigger_entries;
+} __attribute__((__packed__)) SetRecorderConfiguration;
+
+typedef struct {
+	TFPMessageHeader header;
+} __attribute__((__packed__)) GetRecorderConfiguration;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint8_t trigger_mask;
+	uint8_t post_trigger_entries;
+} __attribute__((__packed__)) GetRecorderConfiguration_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+} __attribute__((__packed__)) TriggerRecorder;
+
+typedef struct {
+	TFPMessageHeader header;
+} __attribute__((__packed__)) RearmRecorder;
+
+typedef struct {
+	TFPMessageHeader header;
+} __attribute__((__packed__)) GetRecorderState;
+
+typedef struct {
+	TFPMessageHeader header;
+	bool frozen;
+	uint8_t trigger;
+	uint32_t trigger_time;
+	uint16_t entry_count;
+	uint32_t uptime;
+} __attribute__((__packed__)) GetRecorderState_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint16_t stream_chunk_offset;
+} __attribute__((__packed__)) ReadRecorderLowLevel;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint16_t stream_total_length;
+	uint16_t stream_chunk_offset;
+	uint8_t stream_chunk_data[60];
+} __attribute__((__packed__)) ReadRecorderLowLevel_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint32_t cursor;
+} __attribute__((__packed__)) ReadJournalLowLevel;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint8_t record_count;
+	uint8_t records[48];
+} __attribute__((__packed__)) ReadJournalLowLevel_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint32_t password;
+	int32_t cp_voltage_high;
+} __attribute__((__packed__)) StartCalibration;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint8_t resistor;
+} __attribute__((__packed__)) SetCalibrationResistor;
+
+typedef struct {
+	TFPMessageHeader header;
+	int32_t cp_voltage_low;
+} __attribute__((__packed__)) SetCalibrationLowVoltage;
+
+typedef struct {
+	TFPMessageHeader header;
+} __attribute__((__packed__)) AbortCalibration;
+
+typedef struct {
+	TFPMessageHeader header;
+} __attribute__((__packed__)) GetCalibrationState;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint8_t phase;
+	uint8_t step;
+	uint8_t resistor;
+	uint8_t error;
+	int16_t value;
+	int16_t high_voltage;
+	uint32_t variance;
+	uint16_t duration;
+} __attribute__((__packed__)) GetCalibrationState_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint8_t phase;
+	uint8_t step;
+	uint8_t resistor;
+	uint8_t error;
+	int16_t value;
+	int16_t high_voltage;
+	uint32_t variance;
+	uint16_t duration;
+} __attribute__((__packed__)) CalibrationState_Callback;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint8_t mode;
+	int16_t start_temperature;
+	int16_t end_temperature;
+	uint16_t step_current;
+} __attribute__((__packed__)) SetTemperatureDerating;
+
+typedef struct {
+	TFPMessageHeader header;
+} __attribute__((__packed__)) GetTemperatureDerating;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint8_t mode;
+	int16_t start_temperature;
+	int16_t end_temperature;
+	uint16_t step_current;
+} __attribute__((__packed__)) GetTemperatureDerating_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+} __attribute__((__packed__)) GetTemperatureState;
+
+typedef struct {
+	TFPMessageHeader header;
+	int16_t temperature;
+	int16_t temperature_max;
+	uint8_t derating_state;
+	uint16_t max_current;
+} __attribute__((__packed__)) GetTemperatureState_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint16_t stream_chunk_offset;
+} __attribute__((__packed__)) ReadTemperatureHistoryLowLevel;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint16_t stream_total_length;
+	uint16_t stream_chunk_offset;
+	uint8_t stream_chunk_data[60];
+} __attribute__((__packed__)) ReadTemperatureHistoryLowLevel_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint8_t pattern;
+	uint8_t length;
+	uint8_t keyframes[56]; // 14 x (type, index, duration)
+} __attribute__((__packed__)) SetIndicatorLEDPattern;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint8_t pattern;
+} __attribute__((__packed__)) GetIndicatorLEDPattern;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint8_t length;
+	uint8_t keyframes[56];
+} __attribute__((__packed__)) GetIndicatorLEDPattern_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+} __attribute__((__packed__)) GetIndicatorLEDLayers;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint8_t visible_layer;
+	uint8_t active_layers; // Bitmask, bit n = layer n
+	uint8_t led_state;
+} __attribute__((__packed__)) GetIndicatorLEDLayers_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+} __attribute__((__packed__)) GetButtonEvents;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint8_t events_length;
+	uint16_t events_lost; // Since the last call (queue was full)
+	uint8_t event_type[8];
+	uint32_t event_time[8];
+} __attribute__((__packed__)) GetButtonEvents_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+	bool enabled;
+} __attribute__((__packed__)) SetButtonEventCallbackConfiguration;
+
+typedef struct {
+	TFPMessageHeader header;
+} __attribute__((__packed__)) GetButtonEventCallbackConfiguration;
+
+typedef struct {
+	TFPMessageHeader header;
+	bool enabled;
+} __attribute__((__packed__)) GetButtonEventCallbackConfiguration_Response;
+
+typedef struct {
+	TFPMessageHeader header;
+	uint8_t type;
+	uint32_t time;
+} __attribute__((__packed__)) ButtonEvent_Callback;
+
+typedef struct {
+	TFPMessageHeader header;
+} __attribute__((__packed__)) GetLockStatistics;
+
+// Arrays are indexed by direction (0 = open, 1 = close)
+typedef struct {
+	TFPMessageHeader header;
+	uint8_t lock_state;
+	bool has_lock_switch;
+	uint16_t learned_travel_time[2];
+	uint16_t last_travel_time[2];
+	uint32_t cycles[2];
+	uint16_t retries[2];
+	uint16_t stalls[2];
+	uint16_t timeouts[2];
+	uint16_t errors[2];
+} __attribute__((__packed__)) GetLockStatistics_Response;
+
+// Payload of the charging slot defaults data group (there is no getter)
+typedef struct {
+	uint16_t max_current[CHARGING_SLOT_DEFAULT_NUM];
+	uint8_t active_and_clear_on_disconnect[CHARGING_SLOT_DEFAULT_NUM];
+} __attribute__((__packed__)) DataGroupChargingSlotDefaults;
+
+// Payload length of all data groups together (see communication_get_data_group)
+#define DATA_GROUPS_LENGTH (sizeof(GetState_Response) + sizeof(GetHardwareConfiguration_Response) + sizeof(GetLowLevelState_Response) + \
+                            sizeof(GetIndicatorLED_Response) + sizeof(GetButtonState_Response) + sizeof(GetBoostMode_Response) + \
+                            sizeof(GetAllChargingSlots_Response) + sizeof(GetUserCalibration_Response) - 8*sizeof(TFPMessageHeader) + \
+                            sizeof(DataGroupChargingSlotDefaults))
+
+// The stream of get_data_groups_low_level is packed once when the first chunk is
+// requested, the following chunks are copied from here. So all chunks are consistent
+// and the getters don't run again for every chunk.
+typedef struct {
+	uint16_t groups;
+	uint16_t length;
+	uint8_t data[DATA_GROUPS_LENGTH];
+} DataGroupsSnapshot;
 
 // Function prototypes
 BootloaderHandleMessageResponse get_state(const GetState *data, GetState_Response *response);
@@ -398,13 +823,46 @@ BootloaderHandleMessageResponse get_all_data_1(const GetAllData1 *data, GetAllDa
 BootloaderHandleMessageResponse factory_reset(const FactoryReset *data);
 BootloaderHandleMessageResponse set_boost_mode(const SetBoostMode *data);
 BootloaderHandleMessageResponse get_boost_mode(const GetBoostMode *data, GetBoostMode_Response *response);
+BootloaderHandleMessageResponse get_data_changes(const GetDataChanges *data, GetDataChanges_Response *response);
+BootloaderHandleMessageResponse get_data_groups_low_level(const GetDataGroupsLowLevel *data, GetDataGroupsLowLevel_Response *response);
+BootloaderHandleMessageResponse get_tick_profile(const GetTickProfile *data, GetTickProfile_Response *response);
+BootloaderHandleMessageResponse reset_tick_profile(const ResetTickProfile *data);
+BootloaderHandleMessageResponse get_memory_usage(const GetMemoryUsage *data, GetMemoryUsage_Response *response);
+BootloaderHandleMessageResponse get_boot_info(const GetBootInfo *data, GetBootInfo_Response *response);
+BootloaderHandleMessageResponse read_log_low_level(const ReadLogLowLevel *data, ReadLogLowLevel_Response *response);
+BootloaderHandleMessageResponse set_recorder_configuration(const SetRecorderConfiguration *data);
+BootloaderHandleMessageResponse get_recorder_configuration(const GetRecorderConfiguration *data, GetRecorderConfiguration_Response *response);
+BootloaderHandleMessageResponse trigger_recorder(const TriggerRecorder *data);
+BootloaderHandleMessageResponse rearm_recorder(const RearmRecorder *data);
+BootloaderHandleMessageResponse get_recorder_state(const GetRecorderState *data, GetRecorderState_Response *response);
+BootloaderHandleMessageResponse read_recorder_low_level(const ReadRecorderLowLevel *data, ReadRecorderLowLevel_Response *response);
+BootloaderHandleMessageResponse read_journal_low_level(const ReadJournalLowLevel *data, ReadJournalLowLevel_Response *response);
+BootloaderHandleMessageResponse start_calibration(const StartCalibration *data);
+BootloaderHandleMessageResponse set_calibration_resistor(const SetCalibrationResistor *data);
+BootloaderHandleMessageResponse set_calibration_low_voltage(const SetCalibrationLowVoltage *data);
+BootloaderHandleMessageResponse abort_calibration(const AbortCalibration *data);
+BootloaderHandleMessageResponse get_calibration_state(const GetCalibrationState *data, GetCalibrationState_Response *response);
+BootloaderHandleMessageResponse set_temperature_derating(const SetTemperatureDerating *data);
+BootloaderHandleMessageResponse get_temperature_derating(const GetTemperatureDerating *data, GetTemperatureDerating_Response *response);
+BootloaderHandleMessageResponse get_temperature_state(const GetTemperatureState *data, GetTemperatureState_Response *response);
+BootloaderHandleMessageResponse read_temperature_history_low_level(const ReadTemperatureHistoryLowLevel *data, ReadTemperatureHistoryLowLevel_Response *response);
+BootloaderHandleMessageResponse set_indicator_led_pattern(const SetIndicatorLEDPattern *data);
+BootloaderHandleMessageResponse get_indicator_led_pattern(const GetIndicatorLEDPattern *data, GetIndicatorLEDPattern_Response *response);
+BootloaderHandleMessageResponse get_indicator_led_layers(const GetIndicatorLEDLayers *data, GetIndicatorLEDLayers_Response *response);
+BootloaderHandleMessageResponse get_button_events(const GetButtonEvents *data, GetButtonEvents_Response *response);
+BootloaderHandleMessageResponse set_button_event_callback_configuration(const SetButtonEventCallbackConfiguration *data);
+BootloaderHandleMessageResponse get_button_event_callback_configuration(const GetButtonEventCallbackConfiguration *data, GetButtonEventCallbackConfiguration_Response *response);
+BootloaderHandleMessageResponse get_lock_statistics(const GetLockStatistics *data, GetLockStatistics_Response *response);
 
 // Callbacks
-
+bool handle_calibration_state_callback(void);
+bool handle_button_event_callback(void);
 
 #define COMMUNICATION_CALLBACK_TICK_WAIT_MS 1
-#define COMMUNICATION_CALLBACK_HANDLER_NUM 0
+#define COMMUNICATION_CALLBACK_HANDLER_NUM 2
 #define COMMUNICATION_CALLBACK_LIST_INIT \
+	handle_calibration_state_callback, \
+	handle_button_event_callback, \
 
 
 #endif
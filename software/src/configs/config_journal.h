@@ -0,0 +1,48 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * config_journal.h: Configuration for event journal in flash
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef CONFIG_JOURNAL_H
+#define CONFIG_JOURNAL_H
+
+#include "config_custom_bootstrapper.h"
+#include "config_custom_bootloader.h"
+
+// The journal uses the flash pages directly below the bootloader EEPROM emulation,
+// which starts after BOOTLOADER_FLASH_SIZE bytes of flash. FLASH_JOURNAL_LENGTH and
+// FLASH_EEPROM_LENGTH in CMakeLists.txt have to match (checked in journal.c).
+#define JOURNAL_FLASH_END         (BOOTSTRAPPER_FLASH_START + BOOTLOADER_FLASH_SIZE)
+#define JOURNAL_PAGE_SIZE         256
+#define JOURNAL_PAGE_NUM          4
+
+#ifdef EVSE_HOST
+// The host build simulates the journal pages per EVSEContext (see host_hardware.h)
+#define JOURNAL_FLASH_START       ((uintptr_t)EVSE_CONTEXT.hardware.journal_flash)
+#else
+#define JOURNAL_FLASH_START       (JOURNAL_FLASH_END - JOURNAL_PAGE_NUM*JOURNAL_PAGE_SIZE)
+#endif
+
+// Records are collected in RAM and written together. They are
+// written if the batch is full or the oldest record is older than
+// the commit time (or before the firmware resets).
+#define JOURNAL_BATCH_SIZE        8
+#define JOURNAL_COMMIT_TIME       (1000*10)
+
+#endif
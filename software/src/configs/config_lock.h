@@ -0,0 +1,31 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * config_lock.h: Configuration for the type 2 socket lock
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef CONFIG_LOCK_H
+#define CONFIG_LOCK_H
+
+// Uncomment to drive the lock motor of a type 2 socket. Without it the lock is never
+// moved and the contactor does not wait for it (WARP Chargers have a fixed cable).
+// The lock statistics API returns "not supported" then.
+//#define LOCK_ENABLE
+
+#endif
@@ -32,4 +32,10 @@
 #define LOGGING_SYSTEM_TIME_HEADER "bricklib2/hal/system_timer/system_timer.h"
 #define LOGGING_SYSTEM_TIME_FUNCTION system_timer_get_ms
 
+// If logging over UART is disabled, logd/logi/logw/loge write binary records
+// into a RAM ring buffer instead (see logring.h). The ring can be read
+// with read_log_low_level and decoded with tests/log_ring.py.
+#define LOGRING_ENABLE
+#define LOGRING_SIZE 512
+
 #endif
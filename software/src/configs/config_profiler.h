@@ -0,0 +1,33 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * config_profiler.h: Configuration for main loop profiler
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef CONFIG_PROFILER_H
+#define CONFIG_PROFILER_H
+
+// Uncomment to measure the run time of the main loop and the tick functions.
+// Without it the profiler is compiled out and the profiler API returns "not supported".
+//#define PROFILER_ENABLE
+
+// Only every n-th main loop iteration is measured (has to be a power of 2).
+// The loop count and the longest loop gap are measured in every iteration.
+#define PROFILER_SAMPLE_INTERVAL 8
+
+#endif
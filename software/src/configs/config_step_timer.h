@@ -0,0 +1,39 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * config_step_timer.h: Configuration for the 1ms step timer interrupt
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef CONFIG_STEP_TIMER_H
+#define CONFIG_STEP_TIMER_H
+
+#include "xmc_ccu4.h"
+
+// Slice 0 (CP), 1 (LED) and 3 (lock motor) of CCU40 are used for PWM
+#define STEP_TIMER_CCU              CCU40
+#define STEP_TIMER_SLICE            CCU40_CC42
+#define STEP_TIMER_SLICE_NUMBER     2
+#define STEP_TIMER_PERIOD           64000 // 1ms at 64MHz
+
+#define STEP_TIMER_SERVICE_REQUEST  XMC_CCU4_SLICE_SR_ID_0
+#define STEP_TIMER_IRQ              21 // CCU40.SR0
+#define STEP_TIMER_IRQ_PRIORITY     3  // Below the SPITFP RX interrupt
+#define STEP_TIMER_IRQ_HANDLER      IRQ_Hdlr_21
+
+#endif
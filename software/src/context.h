@@ -0,0 +1,104 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * context.h: All EVSE state in one context
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include "bricklib2/os/coop_task.h"
+#include "bricklib2/warp/contactor_check.h"
+
+#include "evse.h"
+#include "ads1118.h"
+#include "iec61851.h"
+#include "charging_slot.h"
+#include "led.h"
+#include "button.h"
+#include "lock.h"
+#include "recorder.h"
+#include "journal.h"
+#include "calibration.h"
+#include "derating.h"
+#include "scheduler.h"
+#include "logring.h"
+#include "communication.h"
+
+#ifdef EVSE_HOST
+#include "host_hardware.h"
+#endif
+
+// The state of all modules of one EVSE.
+//
+// The module state is accessed with EVSE_CTX(module), e.g. EVSE_CTX(led).state.
+// The firmware has exactly one static instance (evse_context), EVSE_CTX
+// resolves to a member of this instance at link time. The generated code is
+// the same as with separate globals.
+//
+// The host build (software/host) can run many EVSEs in one process. There
+// EVSE_CTX resolves through a thread-local pointer to the context that is
+// currently being stepped (see host_context_select in host_context.h).
+typedef struct {
+	EVSE evse;
+	ADS1118 ads1118;
+	CoopTask ads1118_task;
+	IEC61851 iec61851;
+	ChargingSlot charging_slot;
+	LED led;
+	Button button;
+	Lock lock;
+	Recorder recorder;
+	Journal journal;
+	Calibration calibration;
+	Derating derating;
+	Scheduler scheduler;
+	DataChanges data_changes;
+	DataGroupsSnapshot data_groups_snapshot;
+#ifdef LOGRING_ACTIVE
+	LogRing logring;
+#endif
+
+#ifdef EVSE_HOST
+	// On the firmware the contactor check state is owned by bricklib2
+	ContactorCheck contactor_check;
+
+	// Simulated peripherals (GPIOs, PWM, ADC, EEPROM, flash, time)
+	HostHardware hardware;
+#endif
+} EVSEContext;
+
+// The warm start marker (see EVSE_WARM_START_MAGIC) is not part of the context,
+// the context is cleared by the startup code. On the host it is kept by the
+// simulated hardware over a reset of the MCU.
+#ifdef EVSE_HOST
+extern __thread EVSEContext *evse_context_current;
+#define EVSE_CONTEXT (*evse_context_current)
+#define EVSE_WARM_START_MARKER (EVSE_CONTEXT.hardware.noinit_warm_start_marker)
+// Replaces the contactor check global of bricklib2 (same name as on the firmware)
+#define contactor_check (EVSE_CONTEXT.contactor_check)
+#else
+extern EVSEContext evse_context;
+extern uint32_t evse_warm_start_marker;
+#define EVSE_CONTEXT evse_context
+#define EVSE_WARM_START_MARKER evse_warm_start_marker
+#endif
+
+#define EVSE_CTX(module) (EVSE_CONTEXT.module)
+
+#endif
@@ -0,0 +1,188 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * derating.c: Thermal current derating
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+// The temperature of the ADS1118 (on the EVSE PCB) is used as a measure for
+// the temperature in the housing. If it gets too hot (e.g. wall-mounted in
+// direct sun) the charging current is reduced through the temperature charging
+// slot, instead of running into the protection of the installation.
+
+#include "derating.h"
+
+#include <string.h>
+
+#include "bricklib2/hal/system_timer/system_timer.h"
+#include "bricklib2/utility/util_definitions.h"
+
+#include "ads1118.h"
+#include "charging_slot.h"
+#include "journal.h"
+#include "scheduler.h"
+#include "context.h"
+
+static uint16_t derating_get_max_current(void) {
+	const int16_t temperature = EVSE_CTX(derating).temperature;
+
+	// Cutoff above end temperature with hysteresis
+	if(temperature >= EVSE_CTX(derating).end_temperature) {
+		EVSE_CTX(derating).state = DERATING_STATE_CUTOFF;
+	} else if((EVSE_CTX(derating).state == DERATING_STATE_CUTOFF) && (temperature >= (EVSE_CTX(derating).end_temperature - DERATING_HYSTERESIS))) {
+		EVSE_CTX(derating).state = DERATING_STATE_CUTOFF;
+	} else if(temperature >= EVSE_CTX(derating).start_temperature) {
+		EVSE_CTX(derating).state = DERATING_STATE_DERATING;
+	} else if((EVSE_CTX(derating).state != DERATING_STATE_NONE) && (temperature >= (EVSE_CTX(derating).start_temperature - DERATING_HYSTERESIS))) {
+		EVSE_CTX(derating).state = DERATING_STATE_DERATING;
+	} else {
+		EVSE_CTX(derating).state = DERATING_STATE_NONE;
+	}
+
+	switch(EVSE_CTX(derating).state) {
+		case DERATING_STATE_CUTOFF: return 0;
+		case DERATING_STATE_NONE:   return DERATING_CURRENT_MAX;
+		default: break;
+	}
+
+	if(EVSE_CTX(derating).mode == DERATING_MODE_STEP) {
+		return EVSE_CTX(derating).step_current;
+	}
+
+	// Linear, in the hysteresis below start temperature the current stays at the max current
+	const int32_t above = MAX(0, temperature - EVSE_CTX(derating).start_temperature);
+	const int32_t range = EVSE_CTX(derating).end_temperature - EVSE_CTX(derating).start_temperature;
+	const int32_t ma    = DERATING_CURRENT_MAX - above*(DERATING_CURRENT_MAX - DERATING_CURRENT_MIN)/range;
+
+	return MAX(DERATING_CURRENT_MIN, ma - ma % DERATING_CURRENT_RESOLUTION);
+}
+
+static void derating_update(void) {
+	const uint8_t state = EVSE_CTX(derating).state;
+
+	if(EVSE_CTX(derating).mode == DERATING_MODE_OFF) {
+		EVSE_CTX(derating).state       = DERATING_STATE_NONE;
+		EVSE_CTX(derating).max_current = DERATING_CURRENT_MAX;
+	} else {
+		EVSE_CTX(derating).max_current = derating_get_max_current();
+	}
+
+	if(state != EVSE_CTX(derating).state) {
+		journal_add(JOURNAL_EVENT_DERATING, EVSE_CTX(derating).state, (uint32_t)EVSE_CTX(derating).temperature);
+	}
+}
+
+static void derating_add_history(void) {
+	EVSE_CTX(derating).history[EVSE_CTX(derating).history_next].temperature = BETWEEN(INT8_MIN, EVSE_CTX(derating).history_temperature/100, INT8_MAX);
+	EVSE_CTX(derating).history[EVSE_CTX(derating).history_next].max_current = EVSE_CTX(derating).history_max_current/500;
+
+	EVSE_CTX(derating).history_next = (EVSE_CTX(derating).history_next + 1) % DERATING_HISTORY_NUM;
+	if(EVSE_CTX(derating).history_count < DERATING_HISTORY_NUM) {
+		EVSE_CTX(derating).history_count++;
+	}
+
+	EVSE_CTX(derating).history_temperature = EVSE_CTX(derating).temperature;
+	EVSE_CTX(derating).history_max_current = EVSE_CTX(derating).max_current;
+}
+
+bool derating_set_configuration(const uint8_t mode, const int16_t start_temperature, const int16_t end_temperature, const uint16_t step_current) {
+	if((mode > DERATING_MODE_STEP) || (start_temperature >= end_temperature)) {
+		return false;
+	}
+
+	if((mode == DERATING_MODE_STEP) && ((step_current < DERATING_CURRENT_MIN) || (step_current > DERATING_CURRENT_MAX))) {
+		return false;
+	}
+
+	EVSE_CTX(derating).mode              = mode;
+	EVSE_CTX(derating).start_temperature = start_temperature;
+	EVSE_CTX(derating).end_temperature   = end_temperature;
+	EVSE_CTX(derating).step_current      = step_current;
+	scheduler_trigger(SCHEDULER_TASK_DERATING);
+
+	// Apply immediately, otherwise a new configuration could take up to DERATING_UPDATE_INTERVAL
+	if(EVSE_CTX(derating).sample_time != 0) {
+		derating_update();
+		EVSE_CTX(derating).update_time = system_timer_get_ms();
+	}
+
+	return true;
+}
+
+// Oldest entry first, same as recorder_read
+uint16_t derating_read_history(const uint16_t offset, uint8_t *data, const uint16_t length) {
+	const uint16_t total = EVSE_CTX(derating).history_count*sizeof(DeratingHistoryEntry);
+	const uint16_t first = (EVSE_CTX(derating).history_next + DERATING_HISTORY_NUM - EVSE_CTX(derating).history_count) % DERATING_HISTORY_NUM;
+
+	for(uint16_t i = 0; (i < length) && (offset + i < total); i++) {
+		const uint16_t index = (first + (offset + i)/sizeof(DeratingHistoryEntry)) % DERATING_HISTORY_NUM;
+		data[i] = ((uint8_t*)&EVSE_CTX(derating).history[index])[(offset + i) % sizeof(DeratingHistoryEntry)];
+	}
+
+	return total;
+}
+
+void derating_init(void) {
+	memset(&EVSE_CTX(derating), 0, sizeof(Derating));
+
+	EVSE_CTX(derating).mode                = DERATING_MODE_OFF;
+	EVSE_CTX(derating).start_temperature   = DERATING_START_TEMPERATURE_DEFAULT;
+	EVSE_CTX(derating).end_temperature     = DERATING_END_TEMPERATURE_DEFAULT;
+	EVSE_CTX(derating).step_current        = DERATING_STEP_CURRENT_DEFAULT;
+	EVSE_CTX(derating).max_current         = DERATING_CURRENT_MAX;
+	EVSE_CTX(derating).history_max_current = DERATING_CURRENT_MAX;
+	EVSE_CTX(derating).temperature_max     = INT16_MIN;
+	EVSE_CTX(derating).history_temperature = INT16_MIN;
+}
+
+// Triggered by every new temperature sample and by a new configuration
+void derating_tick(void) {
+	scheduler_clear_deadline(SCHEDULER_TASK_DERATING);
+
+	// The slot is owned by the derating, it is written in every tick
+	// (API changes and clear on disconnect don't stick)
+	EVSE_CTX(charging_slot).max_current[CHARGING_SLOT_TEMPERATURE] = EVSE_CTX(derating).max_current;
+	EVSE_CTX(charging_slot).active[CHARGING_SLOT_TEMPERATURE]      = EVSE_CTX(derating).mode != DERATING_MODE_OFF;
+
+	if(EVSE_CTX(ads1118).temperature_time == EVSE_CTX(derating).sample_time) {
+		return;
+	}
+
+	const bool first_sample = EVSE_CTX(derating).sample_time == 0;
+	if(first_sample) {
+		EVSE_CTX(derating).temperature_filtered = EVSE_CTX(ads1118).temperature * (1 << DERATING_FILTER_SHIFT);
+		EVSE_CTX(derating).history_time         = EVSE_CTX(ads1118).temperature_time;
+	} else {
+		EVSE_CTX(derating).temperature_filtered += EVSE_CTX(ads1118).temperature - (EVSE_CTX(derating).temperature_filtered >> DERATING_FILTER_SHIFT);
+	}
+	EVSE_CTX(derating).sample_time     = EVSE_CTX(ads1118).temperature_time;
+	EVSE_CTX(derating).temperature     = EVSE_CTX(derating).temperature_filtered >> DERATING_FILTER_SHIFT;
+	EVSE_CTX(derating).temperature_max = MAX(EVSE_CTX(derating).temperature_max, EVSE_CTX(derating).temperature);
+
+	if(first_sample || system_timer_is_time_elapsed_ms(EVSE_CTX(derating).update_time, DERATING_UPDATE_INTERVAL)) {
+		EVSE_CTX(derating).update_time = system_timer_get_ms();
+		derating_update();
+	}
+
+	EVSE_CTX(derating).history_temperature = MAX(EVSE_CTX(derating).history_temperature, EVSE_CTX(derating).temperature);
+	EVSE_CTX(derating).history_max_current = MIN(EVSE_CTX(derating).history_max_current, EVSE_CTX(derating).max_current);
+	if(system_timer_is_time_elapsed_ms(EVSE_CTX(derating).history_time, DERATING_HISTORY_INTERVAL)) {
+		EVSE_CTX(derating).history_time += DERATING_HISTORY_INTERVAL;
+		derating_add_history();
+	}
+}
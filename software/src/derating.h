@@ -0,0 +1,86 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * derating.h: Thermal current derating
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef DERATING_H
+#define DERATING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define DERATING_MODE_OFF    0
+#define DERATING_MODE_LINEAR 1 // Linear from the max current at start temperature to 6A at end temperature
+#define DERATING_MODE_STEP   2 // Step current above start temperature
+
+#define DERATING_STATE_NONE     0
+#define DERATING_STATE_DERATING 1
+#define DERATING_STATE_CUTOFF   2 // Above end temperature charging is stopped
+
+#define DERATING_START_TEMPERATURE_DEFAULT 6000 // 1/100 °C
+#define DERATING_END_TEMPERATURE_DEFAULT   8000 // 1/100 °C
+#define DERATING_STEP_CURRENT_DEFAULT      16000
+
+#define DERATING_CURRENT_MAX       32000
+#define DERATING_CURRENT_MIN       6000
+#define DERATING_CURRENT_RESOLUTION 1000 // The linear limit is changed in 1A steps
+#define DERATING_HYSTERESIS        200  // 1/100 °C, needed to leave step/cutoff again
+#define DERATING_FILTER_SHIFT      3    // Exponential moving average over ~8 samples (1 sample per second)
+#define DERATING_UPDATE_INTERVAL   10000
+
+// One entry per minute: the highest temperature and lowest current limit in this minute
+#define DERATING_HISTORY_NUM       60
+#define DERATING_HISTORY_INTERVAL  (60*1000)
+
+typedef struct {
+	int8_t temperature;  // °C
+	uint8_t max_current; // 500mA
+} __attribute__((__packed__)) DeratingHistoryEntry;
+
+typedef struct {
+	// Configuration (part of the EVSE config page)
+	uint8_t mode;
+	int16_t start_temperature;
+	int16_t end_temperature;
+	uint16_t step_current;
+
+	int32_t temperature_filtered; // 1/100 °C << DERATING_FILTER_SHIFT
+	int16_t temperature;          // 1/100 °C
+	int16_t temperature_max;      // 1/100 °C, since startup
+	uint32_t sample_time;
+
+	uint8_t state;
+	uint16_t max_current;
+	uint32_t update_time;
+
+	DeratingHistoryEntry history[DERATING_HISTORY_NUM];
+	uint8_t history_next;
+	uint8_t history_count;
+	uint32_t history_time;
+	int16_t history_temperature;
+	uint16_t history_max_current;
+} Derating;
+
+bool derating_set_configuration(const uint8_t mode, const int16_t start_temperature, const int16_t end_temperature, const uint16_t step_current);
+uint16_t derating_read_history(const uint16_t offset, uint8_t *data, const uint16_t length);
+void derating_init(void);
+void derating_tick(void);
+
+#endif
@@ -19,14 +19,18 @@
  * Boston, MA 02111-1307, USA.
  */
 
+#define LOGRING_FILE_ID LOGRING_FILE_EVSE
+
 #include "evse.h"
 
 #include <float.h>
+#include <string.h>
 
 #include "configs/config_evse.h"
 #include "bricklib2/hal/ccu4_pwm/ccu4_pwm.h"
 #include "bricklib2/hal/system_timer/system_timer.h"
 #include "bricklib2/logging/logging.h"
+#include "logring.h"
 #include "bricklib2/utility/util_definitions.h"
 #include "bricklib2/bootloader/bootloader.h"
 #include "bricklib2/warp/contactor_check.h"
@@ -37,10 +41,29 @@
 #include "led.h"
 #include "communication.h"
 #include "charging_slot.h"
+#include "recorder.h"
+#include "journal.h"
+#include "calibration.h"
+#include "derating.h"
+#include "profiler.h"
+#include "context.h"
 
 #define EVSE_RELAY_MONOFLOP_TIME 10000 // 10 seconds
 
-EVSE evse;
+// The relay output is read in several places per tick, it is only written here
+static void evse_set_relay(const bool active) {
+	if(active) {
+		XMC_GPIO_SetOutputHigh(EVSE_RELAY_PIN);
+	} else {
+		XMC_GPIO_SetOutputLow(EVSE_RELAY_PIN);
+	}
+	EVSE_CTX(evse).relay_active = active;
+}
+
+bool evse_is_relay_active(void) {
+	PROFILER_ACCESS_SAVED();
+	return EVSE_CTX(evse).relay_active;
+}
 
 void evse_set_output(const uint16_t cp_duty_cycle, const bool contactor) {
 	evse_set_cp_duty_cycle(cp_duty_cycle);
@@ -48,7 +71,7 @@ void evse_set_output(const uint16_t cp_duty_cycle, const bool contactor) {
 	// If the contactor is to be enabled and the lock is currently
 	// not completely closed, we start the locking procedure and return.
 	// The contactor will only be enabled after the lock is closed.
-#if 0
+#ifdef LOCK_ENABLE
 	if(contactor) {
 		if(lock_get_state() != LOCK_STATE_CLOSE) {
 			lock_set_locked(true);
@@ -57,7 +80,7 @@ void evse_set_output(const uint16_t cp_duty_cycle, const bool contactor) {
 	}
 #endif
 
-	if(((bool)XMC_GPIO_GetInput(EVSE_RELAY_PIN)) != contactor) {
+	if(evse_is_relay_active() != contactor) {
 		if(((cp_duty_cycle == 0) || (cp_duty_cycle == 1000)) && (!contactor)) {
 			// If the duty cycle is set to either 0% or 100% PWM and the contactor is supposed to be turned off,
 			// it is possible that the WARP Charger wants to turn off the charging session while the car
@@ -70,21 +93,21 @@ void evse_set_output(const uint16_t cp_duty_cycle, const bool contactor) {
 			//       PWM value, resistance or similar.
 			//       This function is only called in non-emergency cases.
 
-			if(ads1118.cp_pe_resistance <= IEC61851_CP_RESISTANCE_STATE_B) {
-				if(evse.contactor_turn_off_time == 0) {
-					evse.contactor_turn_off_time = system_timer_get_ms();
+			if(EVSE_CTX(ads1118).cp_pe_resistance <= IEC61851_CP_RESISTANCE_STATE_B) {
+				if(EVSE_CTX(evse).contactor_turn_off_time == 0) {
+					EVSE_CTX(evse).contactor_turn_off_time = system_timer_get_ms();
 					return;
-				} else if(system_timer_is_time_elapsed_ms(evse.contactor_turn_off_time, 3*1000)) {
+				} else if(system_timer_is_time_elapsed_ms(EVSE_CTX(evse).contactor_turn_off_time, 3*1000)) {
 					// The car has to respond within 3 seconds (see IEC 61851-1 standard table A.6 sequence 10.1),
 					// thus after 3 seconds we turn the contactor off, even if the car has not yet responded yet.
 					// In this case there may be some kind of communication error between wallbox and car and it
 					// is better to turn the contactor off, even if still under load.
-					evse.contactor_turn_off_time = 0;
+					EVSE_CTX(evse).contactor_turn_off_time = 0;
 				} else {
 					return;
 				}
 			} else {
-				evse.contactor_turn_off_time = 0;
+				EVSE_CTX(evse).contactor_turn_off_time = 0;
 			}
 		}
 
@@ -92,20 +115,16 @@ void evse_set_output(const uint16_t cp_duty_cycle, const bool contactor) {
 		// Ignore all ADC measurements for a while if the contactor is
 		// switched on or off, to be sure that the resulting EMI spike does
 		// not give us a wrong measurement.
-		ads1118.cp_invalid_counter = MAX(4, ads1118.cp_invalid_counter);
-		ads1118.pp_invalid_counter = MAX(4, ads1118.pp_invalid_counter);
+		EVSE_CTX(ads1118).cp_invalid_counter = MAX(4, EVSE_CTX(ads1118).cp_invalid_counter);
+		EVSE_CTX(ads1118).pp_invalid_counter = MAX(4, EVSE_CTX(ads1118).pp_invalid_counter);
 
 		// Also ignore contactor check for a while when contactor changes state
 		contactor_check.invalid_counter = MAX(5, contactor_check.invalid_counter);
 
-		if(contactor) {
-			XMC_GPIO_SetOutputHigh(EVSE_RELAY_PIN);
-		} else {
-			XMC_GPIO_SetOutputLow(EVSE_RELAY_PIN);
-		}
+		evse_set_relay(contactor);
 	}
 
-#if 0
+#ifdef LOCK_ENABLE
 	if(!contactor) {
 		if(lock_get_state() != LOCK_STATE_OPEN) {
 			lock_set_locked(false);
@@ -114,61 +133,60 @@ void evse_set_output(const uint16_t cp_duty_cycle, const bool contactor) {
 #endif
 }
 
-// Check for presence of lock motor switch by checking between LED output and switch
+// Check for presence of lock motor switch by checking between LED output and switch.
+// The GP output is set high here and low in evse_tick_lock_switch during the startup wait,
+// until the detection is done there is no lock switch.
 void evse_init_lock_switch(void) {
-// Remove lock switch support for now, it is not used by any WARP Charger
-#if 0
-#if LOGGING_LEVEL == LOGGING_NONE
+	EVSE_CTX(evse).has_lock_switch = false;
+
+// Lock switch support is only needed for sockets with lock, it is not used by any WARP Charger
+#if defined(LOCK_ENABLE) && (LOGGING_LEVEL == LOGGING_NONE)
 	// Test if there is a connection between the GP output and the motor lock switch input
 	// If there is, it means that the EVSE is configured to run without a motor lock switch input
 	XMC_GPIO_SetOutputHigh(EVSE_OUTPUT_GP_PIN);
-	system_timer_sleep_ms(50);
-	const bool test1 = !XMC_GPIO_GetInput(EVSE_MOTOR_INPUT_SWITCH_PIN);
-
-	XMC_GPIO_SetOutputLow(EVSE_OUTPUT_GP_PIN);
-	system_timer_sleep_ms(50);
-	const bool test2 = XMC_GPIO_GetInput(EVSE_MOTOR_INPUT_SWITCH_PIN);
-
-	evse.has_lock_switch = !(test1 && test2);
+	EVSE_CTX(evse).lock_switch_detection_state = EVSE_LOCK_SWITCH_DETECTION_HIGH;
+	EVSE_CTX(evse).lock_switch_detection_time  = system_timer_get_ms();
 #else
-	evse.has_lock_switch = false;
+	EVSE_CTX(evse).lock_switch_detection_state = EVSE_LOCK_SWITCH_DETECTION_DONE;
 #endif
-#endif
-	evse.has_lock_switch = false;
 }
 
-// Check pin header for max current
-void evse_init_jumper(void) {
-	const XMC_GPIO_CONFIG_t pin_config_input_tristate = {
-		.mode             = XMC_GPIO_MODE_INPUT_TRISTATE,
-		.input_hysteresis = XMC_GPIO_INPUT_HYSTERESIS_STANDARD
-	};
-
-	const XMC_GPIO_CONFIG_t pin_config_input_pullup = {
-		.mode             = XMC_GPIO_MODE_INPUT_PULL_UP,
-		.input_hysteresis = XMC_GPIO_INPUT_HYSTERESIS_STANDARD
-	};
-
-	const XMC_GPIO_CONFIG_t pin_config_input_pulldown = {
-		.mode             = XMC_GPIO_MODE_INPUT_PULL_DOWN,
-		.input_hysteresis = XMC_GPIO_INPUT_HYSTERESIS_STANDARD
-	};
+void evse_tick_lock_switch(void) {
+	if(!system_timer_is_time_elapsed_ms(EVSE_CTX(evse).lock_switch_detection_time, 50)) {
+		return;
+	}
 
-	XMC_GPIO_Init(EVSE_CONFIG_JUMPER_PIN0, &pin_config_input_pullup);
-	XMC_GPIO_Init(EVSE_CONFIG_JUMPER_PIN1, &pin_config_input_pullup);
-	system_timer_sleep_ms(50);
-	bool pin0_pu = XMC_GPIO_GetInput(EVSE_CONFIG_JUMPER_PIN0);
-	bool pin1_pu = XMC_GPIO_GetInput(EVSE_CONFIG_JUMPER_PIN1);
+	if(EVSE_CTX(evse).lock_switch_detection_state == EVSE_LOCK_SWITCH_DETECTION_HIGH) {
+		EVSE_CTX(evse).lock_switch_test_high       = !XMC_GPIO_GetInput(EVSE_MOTOR_INPUT_SWITCH_PIN);
+		EVSE_CTX(evse).lock_switch_detection_state = EVSE_LOCK_SWITCH_DETECTION_LOW;
+		EVSE_CTX(evse).lock_switch_detection_time  = system_timer_get_ms();
 
-	XMC_GPIO_Init(EVSE_CONFIG_JUMPER_PIN0, &pin_config_input_pulldown);
-	XMC_GPIO_Init(EVSE_CONFIG_JUMPER_PIN1, &pin_config_input_pulldown);
-	system_timer_sleep_ms(50);
-	bool pin0_pd = XMC_GPIO_GetInput(EVSE_CONFIG_JUMPER_PIN0);
-	bool pin1_pd = XMC_GPIO_GetInput(EVSE_CONFIG_JUMPER_PIN1);
+		XMC_GPIO_SetOutputLow(EVSE_OUTPUT_GP_PIN);
+	} else if(EVSE_CTX(evse).lock_switch_detection_state == EVSE_LOCK_SWITCH_DETECTION_LOW) {
+		const bool test_low = XMC_GPIO_GetInput(EVSE_MOTOR_INPUT_SWITCH_PIN);
 
-	XMC_GPIO_Init(EVSE_CONFIG_JUMPER_PIN0, &pin_config_input_tristate);
-	XMC_GPIO_Init(EVSE_CONFIG_JUMPER_PIN1, &pin_config_input_tristate);
+		EVSE_CTX(evse).has_lock_switch             = !(EVSE_CTX(evse).lock_switch_test_high && test_low);
+		EVSE_CTX(evse).lock_switch_detection_state = EVSE_LOCK_SWITCH_DETECTION_DONE;
+	}
+}
 
+// Check pin header for max current
+static const XMC_GPIO_CONFIG_t evse_jumper_config_input_tristate = {
+	.mode             = XMC_GPIO_MODE_INPUT_TRISTATE,
+	.input_hysteresis = XMC_GPIO_INPUT_HYSTERESIS_STANDARD
+};
+
+static const XMC_GPIO_CONFIG_t evse_jumper_config_input_pullup = {
+	.mode             = XMC_GPIO_MODE_INPUT_PULL_UP,
+	.input_hysteresis = XMC_GPIO_INPUT_HYSTERESIS_STANDARD
+};
+
+static const XMC_GPIO_CONFIG_t evse_jumper_config_input_pulldown = {
+	.mode             = XMC_GPIO_MODE_INPUT_PULL_DOWN,
+	.input_hysteresis = XMC_GPIO_INPUT_HYSTERESIS_STANDARD
+};
+
+static void evse_set_jumper_configuration(const bool pin0_pu, const bool pin0_pd, const bool pin1_pu, const bool pin1_pd) {
 	// Differentiate between high, low and open
 	char pin0 = 'x';
 	if(pin0_pu && !pin0_pd) {
@@ -189,25 +207,66 @@ void evse_init_jumper(void) {
 	}
 
 	if(pin0 == 'h' && pin1 == 'h') {
-		evse.config_jumper_current = EVSE_CONFIG_JUMPER_UNCONFIGURED;
+		EVSE_CTX(evse).config_jumper_current = EVSE_CONFIG_JUMPER_UNCONFIGURED;
 	} else if(pin0 == 'o' && pin1 == 'h') {
-		evse.config_jumper_current = EVSE_CONFIG_JUMPER_CURRENT_6A;
+		EVSE_CTX(evse).config_jumper_current = EVSE_CONFIG_JUMPER_CURRENT_6A;
 	} else if(pin0 == 'l' && pin1 == 'h') {
-		evse.config_jumper_current = EVSE_CONFIG_JUMPER_CURRENT_10A;
+		EVSE_CTX(evse).config_jumper_current = EVSE_CONFIG_JUMPER_CURRENT_10A;
 	} else if(pin0 == 'h' && pin1 == 'o') {
-		evse.config_jumper_current = EVSE_CONFIG_JUMPER_CURRENT_13A;
+		EVSE_CTX(evse).config_jumper_current = EVSE_CONFIG_JUMPER_CURRENT_13A;
 	} else if(pin0 == 'o' && pin1 == 'o') {
-		evse.config_jumper_current = EVSE_CONFIG_JUMPER_CURRENT_16A;
+		EVSE_CTX(evse).config_jumper_current = EVSE_CONFIG_JUMPER_CURRENT_16A;
 	} else if(pin0 == 'l' && pin1 == 'o') {
-		evse.config_jumper_current = EVSE_CONFIG_JUMPER_CURRENT_20A;
+		EVSE_CTX(evse).config_jumper_current = EVSE_CONFIG_JUMPER_CURRENT_20A;
 	} else if(pin0 == 'h' && pin1 == 'l') {
-		evse.config_jumper_current = EVSE_CONFIG_JUMPER_CURRENT_25A;
+		EVSE_CTX(evse).config_jumper_current = EVSE_CONFIG_JUMPER_CURRENT_25A;
 	} else if(pin0 == 'o' && pin1 == 'l') {
-		evse.config_jumper_current = EVSE_CONFIG_JUMPER_CURRENT_32A;
+		EVSE_CTX(evse).config_jumper_current = EVSE_CONFIG_JUMPER_CURRENT_32A;
 	} else if(pin0 == 'l' && pin1 == 'l') {
-		evse.config_jumper_current = EVSE_CONFIG_JUMPER_SOFTWARE;
+		EVSE_CTX(evse).config_jumper_current = EVSE_CONFIG_JUMPER_SOFTWARE;
 	} else {
-		evse.config_jumper_current = EVSE_CONFIG_JUMPER_UNCONFIGURED;
+		EVSE_CTX(evse).config_jumper_current = EVSE_CONFIG_JUMPER_UNCONFIGURED;
+	}
+}
+
+// The jumper detection measures the jumper pins once with pull-up and once with pull-down.
+// It is started here and then runs in evse_tick_jumper during the startup wait,
+// until it is done the jumper configuration is "unconfigured".
+void evse_init_jumper(void) {
+	EVSE_CTX(evse).config_jumper_current   = EVSE_CONFIG_JUMPER_UNCONFIGURED;
+	EVSE_CTX(evse).jumper_detection_state  = EVSE_JUMPER_DETECTION_PULLUP;
+	EVSE_CTX(evse).jumper_detection_time   = system_timer_get_ms();
+
+	XMC_GPIO_Init(EVSE_CONFIG_JUMPER_PIN0, &evse_jumper_config_input_pullup);
+	XMC_GPIO_Init(EVSE_CONFIG_JUMPER_PIN1, &evse_jumper_config_input_pullup);
+}
+
+void evse_tick_jumper(void) {
+	if(!system_timer_is_time_elapsed_ms(EVSE_CTX(evse).jumper_detection_time, 50)) {
+		return;
+	}
+
+	if(EVSE_CTX(evse).jumper_detection_state == EVSE_JUMPER_DETECTION_PULLUP) {
+		EVSE_CTX(evse).jumper_pin0_pu         = XMC_GPIO_GetInput(EVSE_CONFIG_JUMPER_PIN0);
+		EVSE_CTX(evse).jumper_pin1_pu         = XMC_GPIO_GetInput(EVSE_CONFIG_JUMPER_PIN1);
+		EVSE_CTX(evse).jumper_detection_state = EVSE_JUMPER_DETECTION_PULLDOWN;
+		EVSE_CTX(evse).jumper_detection_time  = system_timer_get_ms();
+
+		XMC_GPIO_Init(EVSE_CONFIG_JUMPER_PIN0, &evse_jumper_config_input_pulldown);
+		XMC_GPIO_Init(EVSE_CONFIG_JUMPER_PIN1, &evse_jumper_config_input_pulldown);
+	} else if(EVSE_CTX(evse).jumper_detection_state == EVSE_JUMPER_DETECTION_PULLDOWN) {
+		const bool pin0_pd = XMC_GPIO_GetInput(EVSE_CONFIG_JUMPER_PIN0);
+		const bool pin1_pd = XMC_GPIO_GetInput(EVSE_CONFIG_JUMPER_PIN1);
+
+		XMC_GPIO_Init(EVSE_CONFIG_JUMPER_PIN0, &evse_jumper_config_input_tristate);
+		XMC_GPIO_Init(EVSE_CONFIG_JUMPER_PIN1, &evse_jumper_config_input_tristate);
+
+		evse_set_jumper_configuration(EVSE_CTX(evse).jumper_pin0_pu, pin0_pd, EVSE_CTX(evse).jumper_pin1_pu, pin1_pd);
+		EVSE_CTX(evse).jumper_detection_state = EVSE_JUMPER_DETECTION_DONE;
+		EVSE_CTX(evse).boot_jumper_detected_time = system_timer_get_ms();
+
+		// The incoming cable slot was initialized with the unconfigured jumper
+		EVSE_CTX(charging_slot).max_current[CHARGING_SLOT_INCOMING_CABLE] = charging_slot_get_ma_incoming_cable();
 	}
 }
 
@@ -219,44 +278,50 @@ void evse_load_calibration(void) {
 	// This is either our first startup or something went wrong.
 	// We initialize the calibration data with sane default values and start a calibration.
 	if(page[EVSE_CALIBRATION_MAGIC_POS] != EVSE_CALIBRATION_MAGIC) {
-		ads1118.cp_cal_mul           = 1;
-		ads1118.cp_cal_div           = 1;
-		ads1118.cp_cal_diff_voltage  = -90; // -90 seems to be around average between all EVSEs we have tested, so we use it as default
-		ads1118.cp_cal_2700ohm       = 0;
+		EVSE_CTX(ads1118).cp_cal_mul           = 1;
+		EVSE_CTX(ads1118).cp_cal_div           = 1;
+		EVSE_CTX(ads1118).cp_cal_diff_voltage  = -90; // -90 seems to be around average between all EVSEs we have tested, so we use it as default
+		EVSE_CTX(ads1118).cp_cal_2700ohm       = 0;
 		for(uint8_t i = 0; i < ADS1118_880OHM_CAL_NUM; i++) {
-			ads1118.cp_cal_880ohm[i] = 0;
+			EVSE_CTX(ads1118).cp_cal_880ohm[i] = 0;
 		}
 	} else {
-		ads1118.cp_cal_mul           = page[EVSE_CALIBRATION_MUL_POS]      - INT16_MAX;
-		ads1118.cp_cal_div           = page[EVSE_CALIBRATION_DIV_POS]      - INT16_MAX;
-		ads1118.cp_cal_diff_voltage  = page[EVSE_CALIBRATION_DIFF_POS]     - INT16_MAX;
-		ads1118.cp_cal_2700ohm       = page[EVSE_CALIBRATION_2700_POS]     - INT16_MAX;
+		EVSE_CTX(ads1118).cp_cal_mul           = page[EVSE_CALIBRATION_MUL_POS]      - INT16_MAX;
+		EVSE_CTX(ads1118).cp_cal_div           = page[EVSE_CALIBRATION_DIV_POS]      - INT16_MAX;
+		EVSE_CTX(ads1118).cp_cal_diff_voltage  = page[EVSE_CALIBRATION_DIFF_POS]     - INT16_MAX;
+		EVSE_CTX(ads1118).cp_cal_2700ohm       = page[EVSE_CALIBRATION_2700_POS]     - INT16_MAX;
 		for(uint8_t i = 0; i < ADS1118_880OHM_CAL_NUM; i++) {
-			ads1118.cp_cal_880ohm[i] = page[EVSE_CALIBRATION_880_POS + i]  - INT16_MAX;
+			EVSE_CTX(ads1118).cp_cal_880ohm[i] = page[EVSE_CALIBRATION_880_POS + i]  - INT16_MAX;
 		}
 	}
 
-	logd("Load calibration:\n\r");
-	logd(" * mul %d, div %d, diff %d\n\r", ads1118.cp_cal_mul, ads1118.cp_cal_div, ads1118.cp_cal_diff_voltage);
-	logd(" * 2700 Ohm: %d\n\r", ads1118.cp_cal_2700ohm);
+	logd("Load calibration: mul %d, div %d, diff %d, 2700 Ohm %d\n\r", EVSE_CTX(ads1118).cp_cal_mul, EVSE_CTX(ads1118).cp_cal_div, EVSE_CTX(ads1118).cp_cal_diff_voltage, EVSE_CTX(ads1118).cp_cal_2700ohm);
+#ifndef LOGRING_ACTIVE
+	// Only on the UART, in the log ring the 880 Ohm values would push out everything else at every boot
 	for(uint8_t i = 0; i < ADS1118_880OHM_CAL_NUM; i++) {
-		logd(" * 800 Ohm %d: %d\n\r", i, ads1118.cp_cal_880ohm[i]);
+		logd(" * 880 Ohm %d: %d\n\r", i, EVSE_CTX(ads1118).cp_cal_880ohm[i]);
 	}
+#endif
+
+	ads1118_update_calibration_knots();
 }
 
 void evse_save_calibration(void) {
 	uint32_t page[EEPROM_PAGE_SIZE/sizeof(uint32_t)];
 
 	page[EVSE_CALIBRATION_MAGIC_POS]       = EVSE_CALIBRATION_MAGIC;
-	page[EVSE_CALIBRATION_MUL_POS]         = (uint32_t)(ads1118.cp_cal_mul          + INT16_MAX);
-	page[EVSE_CALIBRATION_DIV_POS]         = (uint32_t)(ads1118.cp_cal_div          + INT16_MAX);
-	page[EVSE_CALIBRATION_DIFF_POS]        = (uint32_t)(ads1118.cp_cal_diff_voltage + INT16_MAX);
-	page[EVSE_CALIBRATION_2700_POS]        = (uint32_t)(ads1118.cp_cal_2700ohm      + INT16_MAX);
+	page[EVSE_CALIBRATION_MUL_POS]         = (uint32_t)(EVSE_CTX(ads1118).cp_cal_mul          + INT16_MAX);
+	page[EVSE_CALIBRATION_DIV_POS]         = (uint32_t)(EVSE_CTX(ads1118).cp_cal_div          + INT16_MAX);
+	page[EVSE_CALIBRATION_DIFF_POS]        = (uint32_t)(EVSE_CTX(ads1118).cp_cal_diff_voltage + INT16_MAX);
+	page[EVSE_CALIBRATION_2700_POS]        = (uint32_t)(EVSE_CTX(ads1118).cp_cal_2700ohm      + INT16_MAX);
 	for(uint8_t i = 0; i < ADS1118_880OHM_CAL_NUM; i++) {
-		page[EVSE_CALIBRATION_880_POS + i] = (uint32_t)(ads1118.cp_cal_880ohm[i]    + INT16_MAX);
+		page[EVSE_CALIBRATION_880_POS + i] = (uint32_t)(EVSE_CTX(ads1118).cp_cal_880ohm[i]    + INT16_MAX);
 	}
 
 	bootloader_write_eeprom_page(EVSE_CALIBRATION_PAGE, page);
+	journal_add(JOURNAL_EVENT_CALIBRATION, 0, 0);
+
+	ads1118_update_calibration_knots();
 }
 
 void evse_load_user_calibration(void) {
@@ -267,47 +332,52 @@ void evse_load_user_calibration(void) {
 	// This is either our first startup or something went wrong.
 	// We initialize the calibration data with sane default values and start a calibration.
 	if(page[EVSE_USER_CALIBRATION_MAGIC_POS] != EVSE_USER_CALIBRATION_MAGIC) {
-		ads1118.cp_user_cal_active        = false;
-		ads1118.cp_user_cal_mul           = 1;
-		ads1118.cp_user_cal_div           = 1;
-		ads1118.cp_user_cal_diff_voltage  = -90; // -90 seems to be around average between all EVSEs we have tested, so we use it as default
-		ads1118.cp_user_cal_2700ohm       = 0;
+		EVSE_CTX(ads1118).cp_user_cal_active        = false;
+		EVSE_CTX(ads1118).cp_user_cal_mul           = 1;
+		EVSE_CTX(ads1118).cp_user_cal_div           = 1;
+		EVSE_CTX(ads1118).cp_user_cal_diff_voltage  = -90; // -90 seems to be around average between all EVSEs we have tested, so we use it as default
+		EVSE_CTX(ads1118).cp_user_cal_2700ohm       = 0;
 		for(uint8_t i = 0; i < ADS1118_880OHM_CAL_NUM; i++) {
-			ads1118.cp_user_cal_880ohm[i] = 0;
+			EVSE_CTX(ads1118).cp_user_cal_880ohm[i] = 0;
 		}
 	} else {
-		ads1118.cp_user_cal_active        = (int32_t)page[EVSE_USER_CALIBRATION_ACTIV_POS];
-		ads1118.cp_user_cal_mul           = (int32_t)page[EVSE_USER_CALIBRATION_MUL_POS]     - INT16_MAX;
-		ads1118.cp_user_cal_div           = (int32_t)page[EVSE_USER_CALIBRATION_DIV_POS]     - INT16_MAX;
-		ads1118.cp_user_cal_diff_voltage  = (int32_t)page[EVSE_USER_CALIBRATION_DIFF_POS]    - INT16_MAX;
-		ads1118.cp_user_cal_2700ohm       = (int32_t)page[EVSE_USER_CALIBRATION_2700_POS]    - INT16_MAX;
+		EVSE_CTX(ads1118).cp_user_cal_active        = (int32_t)page[EVSE_USER_CALIBRATION_ACTIV_POS];
+		EVSE_CTX(ads1118).cp_user_cal_mul           = (int32_t)page[EVSE_USER_CALIBRATION_MUL_POS]     - INT16_MAX;
+		EVSE_CTX(ads1118).cp_user_cal_div           = (int32_t)page[EVSE_USER_CALIBRATION_DIV_POS]     - INT16_MAX;
+		EVSE_CTX(ads1118).cp_user_cal_diff_voltage  = (int32_t)page[EVSE_USER_CALIBRATION_DIFF_POS]    - INT16_MAX;
+		EVSE_CTX(ads1118).cp_user_cal_2700ohm       = (int32_t)page[EVSE_USER_CALIBRATION_2700_POS]    - INT16_MAX;
 		for(uint8_t i = 0; i < ADS1118_880OHM_CAL_NUM; i++) {
-			ads1118.cp_user_cal_880ohm[i] = (int32_t)page[EVSE_USER_CALIBRATION_880_POS + i] - INT16_MAX;
+			EVSE_CTX(ads1118).cp_user_cal_880ohm[i] = (int32_t)page[EVSE_USER_CALIBRATION_880_POS + i] - INT16_MAX;
 		}
 	}
 
-	logd("Load user calibration:\n\r");
-	logd(" * mul %d, div %d, diff %d\n\r", ads1118.cp_user_cal_mul, ads1118.cp_user_cal_div, ads1118.cp_user_cal_diff_voltage);
-	logd(" * 2700 Ohm: %d\n\r", ads1118.cp_user_cal_2700ohm);
+	logd("Load user calibration: active %d, mul %d, div %d, diff %d, 2700 Ohm %d\n\r", EVSE_CTX(ads1118).cp_user_cal_active, EVSE_CTX(ads1118).cp_user_cal_mul, EVSE_CTX(ads1118).cp_user_cal_div, EVSE_CTX(ads1118).cp_user_cal_diff_voltage, EVSE_CTX(ads1118).cp_user_cal_2700ohm);
+#ifndef LOGRING_ACTIVE
 	for(uint8_t i = 0; i < ADS1118_880OHM_CAL_NUM; i++) {
-		logd(" * 800 Ohm %d: %d\n\r", i, ads1118.cp_user_cal_880ohm[i]);
+		logd(" * 880 Ohm %d: %d\n\r", i, EVSE_CTX(ads1118).cp_user_cal_880ohm[i]);
 	}
+#endif
+
+	ads1118_update_calibration_knots();
 }
 
 void evse_save_user_calibration(void) {
 	uint32_t page[EEPROM_PAGE_SIZE/sizeof(uint32_t)];
 
 	page[EVSE_USER_CALIBRATION_MAGIC_POS]       = EVSE_USER_CALIBRATION_MAGIC;
-	page[EVSE_USER_CALIBRATION_ACTIV_POS]       = ads1118.cp_user_cal_active;
-	page[EVSE_USER_CALIBRATION_MUL_POS]         = (uint32_t)(ads1118.cp_user_cal_mul          + INT16_MAX);
-	page[EVSE_USER_CALIBRATION_DIV_POS]         = (uint32_t)(ads1118.cp_user_cal_div          + INT16_MAX);
-	page[EVSE_USER_CALIBRATION_DIFF_POS]        = (uint32_t)(ads1118.cp_user_cal_diff_voltage + INT16_MAX);
-	page[EVSE_USER_CALIBRATION_2700_POS]        = (uint32_t)(ads1118.cp_user_cal_2700ohm      + INT16_MAX);
+	page[EVSE_USER_CALIBRATION_ACTIV_POS]       = EVSE_CTX(ads1118).cp_user_cal_active;
+	page[EVSE_USER_CALIBRATION_MUL_POS]         = (uint32_t)(EVSE_CTX(ads1118).cp_user_cal_mul          + INT16_MAX);
+	page[EVSE_USER_CALIBRATION_DIV_POS]         = (uint32_t)(EVSE_CTX(ads1118).cp_user_cal_div          + INT16_MAX);
+	page[EVSE_USER_CALIBRATION_DIFF_POS]        = (uint32_t)(EVSE_CTX(ads1118).cp_user_cal_diff_voltage + INT16_MAX);
+	page[EVSE_USER_CALIBRATION_2700_POS]        = (uint32_t)(EVSE_CTX(ads1118).cp_user_cal_2700ohm      + INT16_MAX);
 	for(uint8_t i = 0; i < ADS1118_880OHM_CAL_NUM; i++) {
-		page[EVSE_USER_CALIBRATION_880_POS + i] = (uint32_t)(ads1118.cp_user_cal_880ohm[i]    + INT16_MAX);
+		page[EVSE_USER_CALIBRATION_880_POS + i] = (uint32_t)(EVSE_CTX(ads1118).cp_user_cal_880ohm[i]    + INT16_MAX);
 	}
 
 	bootloader_write_eeprom_page(EVSE_USER_CALIBRATION_PAGE, page);
+	journal_add(JOURNAL_EVENT_CALIBRATION, 1, 0);
+
+	ads1118_update_calibration_knots();
 }
 
 void evse_load_config(void) {
@@ -318,15 +388,43 @@ void evse_load_config(void) {
 	// This is either our first startup or something went wrong.
 	// We initialize the config data with sane default values.
 	if(page[EVSE_CONFIG_MAGIC_POS] != EVSE_CONFIG_MAGIC) {
-		evse.legacy_managed = false;
+		EVSE_CTX(evse).legacy_managed = false;
 	} else {
-		evse.legacy_managed = page[EVSE_CONFIG_MANAGED_POS];
+		EVSE_CTX(evse).legacy_managed = page[EVSE_CONFIG_MANAGED_POS];
 	}
 
 	if(page[EVSE_CONFIG_MAGIC2_POS] != EVSE_CONFIG_MAGIC2) {
-		evse.boost_mode_enabled = false;
+		EVSE_CTX(evse).boost_mode_enabled = false;
 	} else {
-		evse.boost_mode_enabled = page[EVSE_CONFIG_BOOST_POS];
+		EVSE_CTX(evse).boost_mode_enabled = page[EVSE_CONFIG_BOOST_POS];
+	}
+
+	if(page[EVSE_CONFIG_MAGIC4_POS] == EVSE_CONFIG_MAGIC4) {
+		EVSE_CTX(recorder).trigger_mask         = (page[EVSE_CONFIG_RECORDER_POS] >> 0) & 0xFF;
+		EVSE_CTX(recorder).post_trigger_entries = (page[EVSE_CONFIG_RECORDER_POS] >> 8) & 0xFF;
+	}
+
+	// A broken derating configuration (e.g. start = end) falls back to the defaults
+	if(page[EVSE_CONFIG_MAGIC5_POS] == EVSE_CONFIG_MAGIC5) {
+		const uint8_t mode              = (page[EVSE_CONFIG_DERATING_POS]      >>  0) & 0xFF;
+		const uint16_t step_current     = (page[EVSE_CONFIG_DERATING_POS]      >> 16) & 0xFFFF;
+		const int16_t start_temperature = (int16_t)((page[EVSE_CONFIG_DERATING_TEMP_POS] >>  0) & 0xFFFF);
+		const int16_t end_temperature   = (int16_t)((page[EVSE_CONFIG_DERATING_TEMP_POS] >> 16) & 0xFFFF);
+		if(!derating_set_configuration(mode, start_temperature, end_temperature, step_current)) {
+			derating_set_configuration(DERATING_MODE_OFF, DERATING_START_TEMPERATURE_DEFAULT, DERATING_END_TEMPERATURE_DEFAULT, DERATING_STEP_CURRENT_DEFAULT);
+		}
+	}
+
+	if(page[EVSE_CONFIG_MAGIC6_POS] == EVSE_CONFIG_MAGIC6) {
+		EVSE_CTX(lock).travel_time[LOCK_DIRECTION_OPEN]  = (page[EVSE_CONFIG_LOCK_POS] >>  0) & 0xFFFF;
+		EVSE_CTX(lock).travel_time[LOCK_DIRECTION_CLOSE] = (page[EVSE_CONFIG_LOCK_POS] >> 16) & 0xFFFF;
+		memcpy(EVSE_CTX(lock).travel_time_saved, EVSE_CTX(lock).travel_time, sizeof(EVSE_CTX(lock).travel_time));
+	}
+
+	// Only the slope of the CP drift model is kept, the temperature bins are learned again
+	if(page[EVSE_CONFIG_MAGIC7_POS] == EVSE_CONFIG_MAGIC7) {
+		EVSE_CTX(ads1118).cp_drift_valid = (page[EVSE_CONFIG_DRIFT_POS] >> 16) & 1;
+		EVSE_CTX(ads1118).cp_drift_slope = (int16_t)((page[EVSE_CONFIG_DRIFT_POS] >> 0) & 0xFFFF);
 	}
 
 	bool external_control_slot_to_default = false;
@@ -341,60 +439,74 @@ void evse_load_config(void) {
 	EVSEChargingSlotDefault *slot_default = (EVSEChargingSlotDefault *)(&page[EVSE_CONFIG_SLOT_DEFAULT_POS]);
 	if(slot_default->magic == EVSE_CONFIG_SLOT_MAGIC) {
 		for(uint8_t i = 0; i < 18; i++) {
-			charging_slot.max_current_default[i]         = slot_default->current[i];
-			charging_slot.active_default[i]              = slot_default->active_clear[i] & 1;
-			charging_slot.clear_on_disconnect_default[i] = slot_default->active_clear[i] & 2;
+			EVSE_CTX(charging_slot).max_current_default[i]         = slot_default->current[i];
+			EVSE_CTX(charging_slot).active_default[i]              = slot_default->active_clear[i] & 1;
+			EVSE_CTX(charging_slot).clear_on_disconnect_default[i] = slot_default->active_clear[i] & 2;
 		}
 	} else {
 		// If there is no default the button slot is activated and everything else is deactivated
 		for(uint8_t i = 0; i < 18; i++) {
-			charging_slot.max_current_default[i]         = 32000;
-			charging_slot.active_default[i]              = false;
-			charging_slot.clear_on_disconnect_default[i] = false;
+			EVSE_CTX(charging_slot).max_current_default[i]         = 32000;
+			EVSE_CTX(charging_slot).active_default[i]              = false;
+			EVSE_CTX(charging_slot).clear_on_disconnect_default[i] = false;
 		}
 
 		// The default indices are offset by 2 to the slot indices
-		charging_slot.max_current_default[CHARGING_SLOT_BUTTON-2]         = 32000;
-		charging_slot.active_default[CHARGING_SLOT_BUTTON-2]              = true;
-		charging_slot.clear_on_disconnect_default[CHARGING_SLOT_BUTTON-2] = false;
+		EVSE_CTX(charging_slot).max_current_default[CHARGING_SLOT_BUTTON-2]         = 32000;
+		EVSE_CTX(charging_slot).active_default[CHARGING_SLOT_BUTTON-2]              = true;
+		EVSE_CTX(charging_slot).clear_on_disconnect_default[CHARGING_SLOT_BUTTON-2] = false;
 
-		charging_slot.max_current_default[CHARGING_SLOT_LOAD_MANAGEMENT-2]         = 0;
-		charging_slot.active_default[CHARGING_SLOT_LOAD_MANAGEMENT-2]              = evse.legacy_managed;
-		charging_slot.clear_on_disconnect_default[CHARGING_SLOT_LOAD_MANAGEMENT-2] = evse.legacy_managed;
+		EVSE_CTX(charging_slot).max_current_default[CHARGING_SLOT_LOAD_MANAGEMENT-2]         = 0;
+		EVSE_CTX(charging_slot).active_default[CHARGING_SLOT_LOAD_MANAGEMENT-2]              = EVSE_CTX(evse).legacy_managed;
+		EVSE_CTX(charging_slot).clear_on_disconnect_default[CHARGING_SLOT_LOAD_MANAGEMENT-2] = EVSE_CTX(evse).legacy_managed;
 	}
 
 	if(external_control_slot_to_default) {
-		charging_slot.max_current_default[CHARGING_SLOT_EXTERNAL-2]         = 32000;
-		charging_slot.active_default[CHARGING_SLOT_EXTERNAL-2]              = false;
-		charging_slot.clear_on_disconnect_default[CHARGING_SLOT_EXTERNAL-2] = false;
+		EVSE_CTX(charging_slot).max_current_default[CHARGING_SLOT_EXTERNAL-2]         = 32000;
+		EVSE_CTX(charging_slot).active_default[CHARGING_SLOT_EXTERNAL-2]              = false;
+		EVSE_CTX(charging_slot).clear_on_disconnect_default[CHARGING_SLOT_EXTERNAL-2] = false;
 	}
 
 	logd("Load config:\n\r");
-	logd(" * legacy managed    %d\n\r", evse.legacy_managed);
-	logd(" * relener           %d\n\r", sdm630.relative_energy.data);
-	logd(" * shutdown input    %d\n\r", evse.shutdown_input_configuration);
-	logd(" * slot current      %d %d %d %d %d %d %d %d", charging_slot.max_current_default[0], charging_slot.max_current_default[1], charging_slot.max_current_default[2], charging_slot.max_current_default[3], charging_slot.max_current_default[4], charging_slot.max_current_default[5], charging_slot.max_current_default[6], charging_slot.max_current_default[7]);
-	logd(" * slot active/clear %d %d %d %d %d %d %d %d", charging_slot.clear_on_disconnect_default[0], charging_slot.clear_on_disconnect_default[1], charging_slot.clear_on_disconnect_default[2], charging_slot.clear_on_disconnect_default[3], charging_slot.clear_on_disconnect_default[4], charging_slot.clear_on_disconnect_default[5], charging_slot.clear_on_disconnect_default[6], charging_slot.clear_on_disconnect_default[7]);
+	logd(" * legacy managed    %d\n\r", EVSE_CTX(evse).legacy_managed);
+	logd(" * slot current      %d %d %d %d %d %d %d %d", EVSE_CTX(charging_slot).max_current_default[0], EVSE_CTX(charging_slot).max_current_default[1], EVSE_CTX(charging_slot).max_current_default[2], EVSE_CTX(charging_slot).max_current_default[3], EVSE_CTX(charging_slot).max_current_default[4], EVSE_CTX(charging_slot).max_current_default[5], EVSE_CTX(charging_slot).max_current_default[6], EVSE_CTX(charging_slot).max_current_default[7]);
+	logd(" * slot active/clear %d %d %d %d %d %d %d %d", EVSE_CTX(charging_slot).clear_on_disconnect_default[0], EVSE_CTX(charging_slot).clear_on_disconnect_default[1], EVSE_CTX(charging_slot).clear_on_disconnect_default[2], EVSE_CTX(charging_slot).clear_on_disconnect_default[3], EVSE_CTX(charging_slot).clear_on_disconnect_default[4], EVSE_CTX(charging_slot).clear_on_disconnect_default[5], EVSE_CTX(charging_slot).clear_on_disconnect_default[6], EVSE_CTX(charging_slot).clear_on_disconnect_default[7]);
 }
 
 void evse_save_config(void) {
 	uint32_t page[EEPROM_PAGE_SIZE/sizeof(uint32_t)];
 
 	page[EVSE_CONFIG_MAGIC_POS]          = EVSE_CONFIG_MAGIC;
-	page[EVSE_CONFIG_MANAGED_POS]        = evse.legacy_managed;
+	page[EVSE_CONFIG_MANAGED_POS]        = EVSE_CTX(evse).legacy_managed;
 
 	// Handle charging slot defaults
 	EVSEChargingSlotDefault *slot_default = (EVSEChargingSlotDefault *)(&page[EVSE_CONFIG_SLOT_DEFAULT_POS]);
 	for(uint8_t i = 0; i < 18; i++) {
-		slot_default->current[i]      = charging_slot.max_current_default[i];
-		slot_default->active_clear[i] = (charging_slot.active_default[i] << 0) | (charging_slot.clear_on_disconnect_default[i] << 1);
+		slot_default->current[i]      = EVSE_CTX(charging_slot).max_current_default[i];
+		slot_default->active_clear[i] = (EVSE_CTX(charging_slot).active_default[i] << 0) | (EVSE_CTX(charging_slot).clear_on_disconnect_default[i] << 1);
 	}
 	slot_default->magic = EVSE_CONFIG_SLOT_MAGIC;
 
 	page[EVSE_CONFIG_MAGIC2_POS] = EVSE_CONFIG_MAGIC2;
-	page[EVSE_CONFIG_BOOST_POS]  = evse.boost_mode_enabled;
+	page[EVSE_CONFIG_BOOST_POS]  = EVSE_CTX(evse).boost_mode_enabled;
 	page[EVSE_CONFIG_MAGIC3_POS] = EVSE_CONFIG_MAGIC3;
 
+	page[EVSE_CONFIG_MAGIC4_POS]   = EVSE_CONFIG_MAGIC4;
+	page[EVSE_CONFIG_RECORDER_POS] = (EVSE_CTX(recorder).trigger_mask << 0) | (EVSE_CTX(recorder).post_trigger_entries << 8);
+
+	page[EVSE_CONFIG_MAGIC5_POS]        = EVSE_CONFIG_MAGIC5;
+	page[EVSE_CONFIG_DERATING_POS]      = (EVSE_CTX(derating).mode << 0) | (EVSE_CTX(derating).step_current << 16);
+	page[EVSE_CONFIG_DERATING_TEMP_POS] = ((uint16_t)EVSE_CTX(derating).start_temperature << 0) | ((uint32_t)(uint16_t)EVSE_CTX(derating).end_temperature << 16);
+
+	page[EVSE_CONFIG_MAGIC6_POS] = EVSE_CONFIG_MAGIC6;
+	page[EVSE_CONFIG_LOCK_POS]   = (EVSE_CTX(lock).travel_time[LOCK_DIRECTION_OPEN] << 0) | ((uint32_t)EVSE_CTX(lock).travel_time[LOCK_DIRECTION_CLOSE] << 16);
+	memcpy(EVSE_CTX(lock).travel_time_saved, EVSE_CTX(lock).travel_time, sizeof(EVSE_CTX(lock).travel_time));
+
+	page[EVSE_CONFIG_MAGIC7_POS] = EVSE_CONFIG_MAGIC7;
+	page[EVSE_CONFIG_DRIFT_POS]  = ((uint32_t)EVSE_CTX(ads1118).cp_drift_valid << 16) | ((uint16_t)EVSE_CTX(ads1118).cp_drift_slope << 0);
+	EVSE_CTX(ads1118).cp_drift_valid_saved = EVSE_CTX(ads1118).cp_drift_valid;
+	EVSE_CTX(ads1118).cp_drift_slope_saved = EVSE_CTX(ads1118).cp_drift_slope;
+
 	bootloader_write_eeprom_page(EVSE_CONFIG_PAGE, page);
 }
 
@@ -402,12 +514,32 @@ void evse_factory_reset(void) {
 	uint32_t page[EEPROM_PAGE_SIZE/sizeof(uint32_t)] = {0};
 	bootloader_write_eeprom_page(EVSE_CONFIG_PAGE, page);
 
+	if(EVSE_CTX(evse).startup_time == 0) {
+		EVSE_WARM_START_MARKER = EVSE_WARM_START_MAGIC;
+	}
+
+	journal_add(JOURNAL_EVENT_FACTORY_RESET, 0, 0);
+	journal_commit();
+
+	NVIC_SystemReset();
+}
+
+// Reset triggered by the firmware. If the DC-Wächter calibration is already
+// done, we leave a marker so that the next startup can skip the calibration wait.
+void evse_system_reset(void) {
+	if(EVSE_CTX(evse).startup_time == 0) {
+		EVSE_WARM_START_MARKER = EVSE_WARM_START_MAGIC;
+	}
+
+	journal_commit();
+
 	NVIC_SystemReset();
 }
 
 uint16_t evse_get_cp_duty_cycle(void) {
-	uint16_t duty_cycle = (64000 - ccu4_pwm_get_duty_cycle(EVSE_CP_PWM_SLICE_NUMBER))/64;
-	if((duty_cycle >= 4) && (duty_cycle != 1000) && evse.boost_mode_enabled) {
+	PROFILER_ACCESS_SAVED();
+	const uint16_t duty_cycle = EVSE_CTX(evse).cp_pwm_duty_cycle;
+	if((duty_cycle >= 4) && (duty_cycle != 1000) && EVSE_CTX(evse).boost_mode_enabled) {
 		return duty_cycle - 4;
 	}
 
@@ -415,7 +547,7 @@ uint16_t evse_get_cp_duty_cycle(void) {
 }
 
 void evse_set_cp_duty_cycle(uint16_t duty_cycle) {
-	const bool contactor_active = XMC_GPIO_GetInput(EVSE_RELAY_PIN);
+	const bool contactor_active = evse_is_relay_active();
 	const bool use_16a = !contactor_active && (duty_cycle != 0) && (duty_cycle != 1000);
 	if(use_16a) {
 		duty_cycle = 266;
@@ -423,22 +555,32 @@ void evse_set_cp_duty_cycle(uint16_t duty_cycle) {
 	// According to IEC 61841-1 table A2 the duty cycle is allowed to be off by up to 5us.
 	// If boost mode is enabled we add 4us to the duty cycle. This means that we are still within the standard.
 	uint16_t adc_boost = 0;
-	if((duty_cycle != 0) && (duty_cycle != 1000) && evse.boost_mode_enabled) {
+	if((duty_cycle != 0) && (duty_cycle != 1000) && EVSE_CTX(evse).boost_mode_enabled) {
 		adc_boost = 4;
 	}
 
 	const uint16_t current_cp_duty_cycle = evse_get_cp_duty_cycle();
-	const uint16_t new_cp_duty_cycle     = (uint16_t)(64000 - (duty_cycle + adc_boost)*64);
-
 	if(current_cp_duty_cycle != duty_cycle) {
 		// Ignore the next 10 ADC measurements between CP/PE after we
 		// change PWM duty cycle of CP to be sure that that the measurement
 		// is not of any in-between state.
-		ads1118.cp_invalid_counter = MAX(2, ads1118.cp_invalid_counter);
-		ccu4_pwm_set_duty_cycle(EVSE_CP_PWM_SLICE_NUMBER, new_cp_duty_cycle);
+		EVSE_CTX(ads1118).cp_invalid_counter = MAX(2, EVSE_CTX(ads1118).cp_invalid_counter);
+		evse_write_cp_duty_cycle(duty_cycle + adc_boost);
 	}
 }
 
+// Raw CP PWM duty cycle in permille (boost has to be added by the caller).
+// The calibration sets the duty cycle directly, it has to go through here too.
+void evse_write_cp_duty_cycle(const uint16_t duty_cycle) {
+	if(duty_cycle == EVSE_CTX(evse).cp_pwm_duty_cycle) {
+		PROFILER_ACCESS_SAVED();
+		return;
+	}
+
+	ccu4_pwm_set_duty_cycle(EVSE_CP_PWM_SLICE_NUMBER, (uint16_t)(64000 - duty_cycle*64));
+	EVSE_CTX(evse).cp_pwm_duty_cycle = duty_cycle;
+}
+
 void evse_init(void) {
 	const XMC_GPIO_CONFIG_t pin_config_output = {
 		.mode             = XMC_GPIO_MODE_OUTPUT_PUSH_PULL,
@@ -462,24 +604,38 @@ void evse_init(void) {
 	ccu4_pwm_init(EVSE_CP_PWM_PIN, EVSE_CP_PWM_SLICE_NUMBER, EVSE_CP_PWM_PERIOD-1); // 1kHz
 	ccu4_pwm_set_duty_cycle(EVSE_CP_PWM_SLICE_NUMBER, 0);
 
+	// Shadows of the outputs that were just written (relay low, compare value 0 = 100% duty cycle)
+	EVSE_CTX(evse).relay_active      = false;
+	EVSE_CTX(evse).cp_pwm_duty_cycle = 1000;
+
 	ccu4_pwm_init(EVSE_MOTOR_ENABLE_PIN, EVSE_MOTOR_ENABLE_SLICE_NUMBER, EVSE_MOTOR_PWM_PERIOD-1); // 10 kHz
 	ccu4_pwm_set_duty_cycle(EVSE_MOTOR_ENABLE_SLICE_NUMBER, EVSE_MOTOR_PWM_PERIOD);
 
-	evse.calibration_state = 0;
-	evse.config_jumper_current_software = 6000; // default software configuration is 6A
-	evse.max_current_configured = 32000; // default user defined current ist 32A
-	evse.boost_mode_enabled = false;
+	EVSE_CTX(evse).calibration_state = 0;
+	EVSE_CTX(evse).config_jumper_current_software = 6000; // default software configuration is 6A
+	EVSE_CTX(evse).max_current_configured = 32000; // default user defined current ist 32A
+	EVSE_CTX(evse).boost_mode_enabled = false;
+
+	// A warm start marker is only valid for the very next startup
+	EVSE_CTX(evse).warm_start = EVSE_WARM_START_MARKER == EVSE_WARM_START_MAGIC;
+	EVSE_WARM_START_MARKER    = 0;
+
+	// The startup wait starts right away, the remaining
+	// initialization steps are done in parallel to it.
+	EVSE_CTX(evse).startup_time = system_timer_get_ms();
+	EVSE_CTX(evse).boot_init_start_time = EVSE_CTX(evse).startup_time;
 
 	evse_load_calibration();
 	evse_load_user_calibration();
 	evse_load_config();
+	EVSE_CTX(evse).boot_config_loaded_time = system_timer_get_ms();
+
 	evse_init_jumper();
 	evse_init_lock_switch();
 
-	evse.startup_time = system_timer_get_ms();
-	evse.car_stopped_charging = false;
-	evse.communication_watchdog_time = 0;
-	evse.contactor_turn_off_time = 0;
+	EVSE_CTX(evse).car_stopped_charging = false;
+	EVSE_CTX(evse).communication_watchdog_time = 0;
+	EVSE_CTX(evse).contactor_turn_off_time = 0;
 }
 
 void evse_tick_debug(void) {
@@ -488,64 +644,185 @@ void evse_tick_debug(void) {
 	if(system_timer_is_time_elapsed_ms(debug_time, 250)) {
 		debug_time = system_timer_get_ms();
 		uartbb_printf("\n\r");
-		uartbb_printf("IEC61851 State: %d\n\r", iec61851.state);
-		uartbb_printf("Has lock switch: %d\n\r", evse.has_lock_switch);
-		uartbb_printf("Jumper configuration: %d\n\r", evse.config_jumper_current);
-		uartbb_printf("LED State: %d\n\r", led.state);
-		uartbb_printf("Resistance: CP %d, PP %d\n\r", ads1118.cp_pe_resistance, ads1118.pp_pe_resistance);
+		uartbb_printf("IEC61851 State: %d\n\r", EVSE_CTX(iec61851).state);
+		uartbb_printf("Has lock switch: %d\n\r", EVSE_CTX(evse).has_lock_switch);
+		uartbb_printf("Jumper configuration: %d\n\r", EVSE_CTX(evse).config_jumper_current);
+		uartbb_printf("LED State: %d\n\r", EVSE_CTX(led).state);
+		uartbb_printf("Resistance: CP %d, PP %d\n\r", EVSE_CTX(ads1118).cp_pe_resistance, EVSE_CTX(ads1118).pp_pe_resistance);
 		uartbb_printf("CP PWM duty cycle: %d\n\r", ccu4_pwm_get_duty_cycle(EVSE_CP_PWM_SLICE_NUMBER));
 		uartbb_printf("Contactor Check: AC1 %d, AC2 %d, State: %d, Error: %d\n\r", contactor_check.ac1_edge_count, contactor_check.ac2_edge_count, contactor_check.state, contactor_check.error);
 		uartbb_printf("GPIO: Input %d, Output %d\n\r", XMC_GPIO_GetInput(EVSE_INPUT_GP_PIN), XMC_GPIO_GetInput(EVSE_OUTPUT_GP_PIN));
-		uartbb_printf("Lock State: %d\n\r", lock.state);
+		uartbb_printf("Lock State: %d\n\r", EVSE_CTX(lock).state);
 	}
 #endif
 }
 
+static void evse_update_telemetry(void) {
+	EVSETelemetry *t = &EVSE_CTX(evse).telemetry;
+
+	t->time                     = system_timer_get_ms();
+	t->iec61851_state           = EVSE_CTX(iec61851).state;
+	t->contactor_state          = contactor_check.state;
+	t->contactor_error          = contactor_check.error;
+	t->allowed_charging_current = iec61851_get_max_ma();
+	t->error_state              = EVSE_CTX(led).layers[LED_LAYER_FAULT].active ? EVSE_CTX(led).blink_num : 0;
+	t->lock_state               = EVSE_CTX(lock).state;
+
+	if(t->error_state != 0) {
+		t->charger_state = EVSE_CHARGER_STATE_ERROR;
+	} else if(EVSE_CTX(iec61851).state == IEC61851_STATE_C) {
+		t->charger_state = EVSE_CHARGER_STATE_CHARGING;
+	} else if(EVSE_CTX(iec61851).state == IEC61851_STATE_B) {
+		if(charging_slot_get_max_current() == 0) {
+			t->charger_state = EVSE_CHARGER_STATE_WAITING_FOR_CHARGE_RELEASE;
+		} else {
+			t->charger_state = EVSE_CHARGER_STATE_READY_TO_CHARGE;
+		}
+	} else {
+		t->charger_state = EVSE_CHARGER_STATE_NOT_CONNECTED;
+	}
+
+	t->led_state                = EVSE_CTX(led).state;
+	t->cp_pwm_duty_cycle        = evse_get_cp_duty_cycle();
+	t->adc_values[0]            = EVSE_CTX(ads1118).cp_adc_value;
+	t->adc_values[1]            = EVSE_CTX(ads1118).pp_adc_value;
+	t->voltages[0]              = EVSE_CTX(ads1118).cp_voltage_calibrated;
+	t->voltages[1]              = EVSE_CTX(ads1118).pp_voltage;
+	t->voltages[2]              = EVSE_CTX(ads1118).cp_high_voltage;
+	t->resistances[0]           = EVSE_CTX(ads1118).cp_pe_resistance;
+	t->resistances[1]           = EVSE_CTX(ads1118).pp_pe_resistance;
+	// The relay is an output that we write ourselves, its state comes from the shadow
+	t->gpio                     = XMC_GPIO_GetInput(EVSE_INPUT_GP_PIN) | (XMC_GPIO_GetInput(EVSE_OUTPUT_GP_PIN) << 1) | (XMC_GPIO_GetInput(EVSE_MOTOR_INPUT_SWITCH_PIN) << 2) | (evse_is_relay_active() << 3) | (XMC_GPIO_GetInput(EVSE_MOTOR_FAULT_PIN) << 4);
+	t->car_stopped_charging     = EVSE_CTX(evse).car_stopped_charging;
+	t->last_state_change        = EVSE_CTX(iec61851).last_state_change;
+
+	t->button_press_time        = EVSE_CTX(button).press_time;
+	t->button_release_time      = EVSE_CTX(button).release_time;
+	t->button_pressed           = EVSE_CTX(button).state == BUTTON_STATE_PRESSED;
+
+	evse_update_telemetry_led();
+}
+
+// Also called by set_indicator_led, a following get_indicator_led returns what was just set
+void evse_update_telemetry_led(void) {
+	EVSETelemetry *t = &EVSE_CTX(evse).telemetry;
+
+	t->indicator_led = EVSE_CTX(led).api_indication;
+	if((EVSE_CTX(led).api_duration == 0) || system_timer_is_time_elapsed_ms(EVSE_CTX(led).api_start, EVSE_CTX(led).api_duration)) {
+		t->indicator_led_duration = 0;
+	} else {
+		t->indicator_led_duration = EVSE_CTX(led).api_duration - ((uint32_t)(system_timer_get_ms() - EVSE_CTX(led).api_start));
+	}
+}
+
+// Copies the last published snapshot
+void evse_get_telemetry(EVSETelemetry *telemetry) {
+	memcpy(telemetry, &EVSE_CTX(evse).telemetry, sizeof(EVSETelemetry));
+}
+
+// No car connected, contactor off and nothing else going on.
+// In this state the main loop is allowed to sleep between interrupts.
+bool evse_is_idle(void) {
+	return (EVSE_CTX(evse).startup_time == 0) &&
+	       (EVSE_CTX(evse).factory_reset_time == 0) &&
+	       (EVSE_CTX(evse).calibration_state == 0) &&
+	       (EVSE_CTX(iec61851).state == IEC61851_STATE_A) &&
+	       !lock_is_moving() &&
+	       !evse_is_relay_active();
+}
+
+// Everything that is independent of the state machine
+// runs in parallel with the DC-Wächter calibration wait.
+static void evse_tick_startup(void) {
+	if(EVSE_CTX(evse).jumper_detection_state != EVSE_JUMPER_DETECTION_DONE) {
+		evse_tick_jumper();
+	}
+
+	if(EVSE_CTX(evse).lock_switch_detection_state != EVSE_LOCK_SWITCH_DETECTION_DONE) {
+		evse_tick_lock_switch();
+	}
+
+	if((EVSE_CTX(evse).boot_adc_version_found_time == 0) && EVSE_CTX(ads1118).version_found) {
+		EVSE_CTX(evse).boot_adc_version_found_time = system_timer_get_ms();
+	}
+}
+
+static bool evse_is_startup_wait_done(void) {
+	if((EVSE_CTX(evse).jumper_detection_state != EVSE_JUMPER_DETECTION_DONE) ||
+	   (EVSE_CTX(evse).lock_switch_detection_state != EVSE_LOCK_SWITCH_DETECTION_DONE)) {
+		return false;
+	}
+
+	if(system_timer_is_time_elapsed_ms(EVSE_CTX(evse).startup_time, EVSE_STARTUP_WAIT_COLD)) {
+		return true;
+	}
+
+	// On warm start we only need valid measurements from the ADS1118
+	return EVSE_CTX(evse).warm_start && EVSE_CTX(ads1118).version_found && system_timer_is_time_elapsed_ms(EVSE_CTX(evse).startup_time, EVSE_STARTUP_WAIT_WARM);
+}
+
 void evse_tick(void) {
-	// Wait 12 seconds on first startup for DC-Wächter calibration
-	if(evse.startup_time != 0 && !system_timer_is_time_elapsed_ms(evse.startup_time, 12000)) {
+	if(EVSE_CTX(evse).startup_time != 0) {
+		evse_tick_startup();
+	}
+
+	// Wait 12 seconds on first startup for DC-Wächter calibration (1 second on warm start)
+	if(EVSE_CTX(evse).startup_time != 0 && !evse_is_startup_wait_done()) {
 #if 0
 		// According to Alcona it is OK to calibrate during startup if
 		// a car is connected as long as the contactor doesn't activate.
-		if(evse.calibration_error || ((ads1118.cp_voltage_calibrated != 0) && (ads1118.cp_voltage_calibrated < 11000))) {
-			evse.calibration_error = true;
+		if(EVSE_CTX(evse).calibration_error || ((EVSE_CTX(ads1118).cp_voltage_calibrated != 0) && (EVSE_CTX(ads1118).cp_voltage_calibrated < 11000))) {
+			EVSE_CTX(evse).calibration_error = true;
 			led_set_blinking(3);
 		}
 #endif
+		evse_update_telemetry();
 		return;
 	}
 
 
-	if(evse.factory_reset_time != 0) {
-		if(system_timer_is_time_elapsed_ms(evse.factory_reset_time, 500)) {
+	if(EVSE_CTX(evse).factory_reset_time != 0) {
+		if(system_timer_is_time_elapsed_ms(EVSE_CTX(evse).factory_reset_time, 500)) {
 			evse_factory_reset();
 		}
 	}
 
 	// Turn LED on (LED flicker off after startup/calibration)
-	if(evse.startup_time != 0) {
-		evse.startup_time = 0;
-		led_set_on(false);
+	if(EVSE_CTX(evse).startup_time != 0) {
+		EVSE_CTX(evse).startup_time = 0;
+		EVSE_CTX(evse).boot_to_ready_time = system_timer_get_ms();
+		led_set_on();
 	}
 
-	if(evse.calibration_state != 0) {
-		// Nothing here
-		// calibration is done externally through API.
-		// We don't change anything while calibration is running
-	} else if(evse.calibration_error) {
+	if(EVSE_CTX(evse).calibration_state != 0) {
+		// Calibration is done through API, either step-by-step (calibrate)
+		// or by the automated sequence in calibration.c.
+		// We don't change anything else while calibration is running
+		calibration_tick();
+	} else if(EVSE_CTX(evse).calibration_error) {
 		led_set_blinking(3);
 	} else {
 		// Otherwise we implement the EVSE according to IEC 61851.
 		iec61851_tick();
 	}
 
+	recorder_tick();
+
+	if(contactor_check.error != EVSE_CTX(evse).last_contactor_error) {
+		EVSE_CTX(evse).last_contactor_error = contactor_check.error;
+		journal_add(JOURNAL_EVENT_CONTACTOR_ERROR, contactor_check.error, 0);
+	}
+
 	// Restart EVSE after 5 minutes without any communication with a Brick
-	if((evse.communication_watchdog_time != 0) && system_timer_is_time_elapsed_ms(evse.communication_watchdog_time, 1000*60*5)) {
+	if((EVSE_CTX(evse).communication_watchdog_time != 0) && system_timer_is_time_elapsed_ms(EVSE_CTX(evse).communication_watchdog_time, 1000*60*5)) {
 		// Only restart EVSE if brick-communication-watchdog triggers if no car is connected
-		if(iec61851.state == IEC61851_STATE_A) {
-			NVIC_SystemReset();
+		if(EVSE_CTX(iec61851).state == IEC61851_STATE_A) {
+			journal_add(JOURNAL_EVENT_WATCHDOG_RESET, 0, 0);
+			evse_system_reset();
 		}
 	}
 
+	evse_update_telemetry();
+
 //	evse_tick_debug();
 }
@@ -38,6 +38,14 @@
 #define EVSE_CONFIG_JUMPER_SOFTWARE     7
 #define EVSE_CONFIG_JUMPER_UNCONFIGURED 8
 
+#define EVSE_JUMPER_DETECTION_PULLUP    0
+#define EVSE_JUMPER_DETECTION_PULLDOWN  1
+#define EVSE_JUMPER_DETECTION_DONE      2
+
+#define EVSE_LOCK_SWITCH_DETECTION_HIGH 0
+#define EVSE_LOCK_SWITCH_DETECTION_LOW  1
+#define EVSE_LOCK_SWITCH_DETECTION_DONE 2
+
 #define EVSE_CALIBRATION_PAGE           1
 #define EVSE_CALIBRATION_MAGIC_POS      0
 #define EVSE_CALIBRATION_MUL_POS        1
@@ -65,6 +73,15 @@
 #define EVSE_CONFIG_MAGIC2_POS          2
 #define EVSE_CONFIG_BOOST_POS           3
 #define EVSE_CONFIG_MAGIC3_POS          4
+#define EVSE_CONFIG_MAGIC4_POS          5
+#define EVSE_CONFIG_RECORDER_POS        6
+#define EVSE_CONFIG_MAGIC5_POS          7
+#define EVSE_CONFIG_DERATING_POS        8
+#define EVSE_CONFIG_DERATING_TEMP_POS   9
+#define EVSE_CONFIG_MAGIC6_POS          10
+#define EVSE_CONFIG_LOCK_POS            11
+#define EVSE_CONFIG_MAGIC7_POS          12
+#define EVSE_CONFIG_DRIFT_POS           13
 #define EVSE_CONFIG_SLOT_DEFAULT_POS    48
 
 typedef struct {
@@ -76,17 +93,78 @@ typedef struct {
 #define EVSE_CONFIG_MAGIC               0x34567890
 #define EVSE_CONFIG_MAGIC2              0x45678923
 #define EVSE_CONFIG_MAGIC3              0x56789234
+#define EVSE_CONFIG_MAGIC4              0x6789A346
+#define EVSE_CONFIG_MAGIC5              0x789A3457
+#define EVSE_CONFIG_MAGIC6              0x89A34568
+#define EVSE_CONFIG_MAGIC7              0x9A345679
 #define EVSE_CONFIG_SLOT_MAGIC          0x62870616
 
+// Marker in RAM that is not initialized by the startup code. It survives a reset
+// that was triggered by the firmware, after a power loss it is random.
+#define EVSE_WARM_START_MAGIC           0x6789A345
+
+// Wait on startup for DC-Wächter calibration. After a reset that was triggered
+// by the firmware itself the DC-Wächter was powered the whole time, in this case
+// we only wait until the ADS1118 version detection and first measurements are done.
+#define EVSE_STARTUP_WAIT_COLD          12000
+#define EVSE_STARTUP_WAIT_WARM          1000
+
 #define EVSE_STORAGE_PAGES              16
 
+// Snapshot of everything that is reported by get_state, get_low_level_state,
+// get_indicator_led and get_button_state (and so by get_all_data_1).
+// It is published once per evse_tick. The API handlers run in the main loop
+// too (the ADS1118 task is cooperative), a reader never sees a partial update.
+typedef struct {
+	uint32_t time;
+
+	uint8_t iec61851_state;
+	uint8_t charger_state;
+	uint8_t contactor_state;
+	uint8_t contactor_error;
+	uint16_t allowed_charging_current;
+	uint8_t error_state;
+	uint8_t lock_state;
+
+	uint8_t led_state;
+	uint16_t cp_pwm_duty_cycle;
+	uint16_t adc_values[2];
+	int16_t voltages[3];
+	uint32_t resistances[2];
+	uint8_t gpio;
+	bool car_stopped_charging;
+	uint32_t last_state_change;
+
+	int16_t indicator_led;
+	uint16_t indicator_led_duration; // ms left when the snapshot was taken (or the indication was set)
+	uint32_t button_press_time;
+	uint32_t button_release_time;
+	bool button_pressed;
+} EVSETelemetry;
+
 typedef struct {
 	uint32_t startup_time;
+	bool warm_start;
+
+	// Boot phase time stamps (ms since boot)
+	uint32_t boot_init_start_time;
+	uint32_t boot_config_loaded_time;
+	uint32_t boot_jumper_detected_time;
+	uint32_t boot_adc_version_found_time;
+	uint32_t boot_to_ready_time;
 
 	uint8_t config_jumper_current;
 	uint16_t config_jumper_current_software;
 
+	uint8_t jumper_detection_state;
+	uint32_t jumper_detection_time;
+	bool jumper_pin0_pu;
+	bool jumper_pin1_pu;
+
 	bool has_lock_switch;
+	uint8_t lock_switch_detection_state;
+	uint32_t lock_switch_detection_time;
+	bool lock_switch_test_high;
 	bool legacy_managed;
 
 	uint32_t factory_reset_time;
@@ -105,21 +183,34 @@ typedef struct {
 	uint32_t communication_watchdog_time;
 
 	uint32_t contactor_turn_off_time;
+	uint8_t last_contactor_error;
 
 	bool boost_mode_enabled;
 
+	// Shadows of the relay output and the CP PWM. They are only written through
+	// evse_set_relay/evse_write_cp_duty_cycle, all reads are served from here.
+	bool relay_active;
+	uint16_t cp_pwm_duty_cycle; // Permille as written to the CP PWM (with boost)
+
 	uint8_t storage[EVSE_STORAGE_PAGES][64];
-} EVSE;
 
-extern EVSE evse;
+	EVSETelemetry telemetry;
+} EVSE;
 
 void evse_save_config(void);
+void evse_load_calibration(void);
 void evse_save_calibration(void);
 void evse_save_user_calibration(void);
 void evse_save_config(void);
 void evse_set_output(const uint16_t cp_duty_cycle, const bool contactor);
+bool evse_is_relay_active(void);
 uint16_t evse_get_cp_duty_cycle(void);
 void evse_set_cp_duty_cycle(const uint16_t duty_cycle);
+void evse_write_cp_duty_cycle(const uint16_t duty_cycle);
+void evse_update_telemetry_led(void);
+void evse_get_telemetry(EVSETelemetry *telemetry);
+bool evse_is_idle(void);
+void evse_system_reset(void);
 void evse_init(void);
 void evse_tick(void);
 
@@ -37,73 +37,83 @@
 #include "led.h"
 #include "button.h"
 #include "charging_slot.h"
-
-IEC61851 iec61851;
+#include "journal.h"
+#include "context.h"
 
 void iec61851_set_state(IEC61851State state) {
-	if(state != iec61851.state) {
+	if(state != EVSE_CTX(iec61851).state) {
 		// If we change from an error state to something else we save the time
 		// If we then change to state C we wait at least 30 seconds
 		// -> Don't start charging immediately after error
-		if((iec61851.state == IEC61851_STATE_D) && (iec61851.last_error_time == 0)) {
-			iec61851.last_error_time = system_timer_get_ms();
+		if((EVSE_CTX(iec61851).state == IEC61851_STATE_D) && (EVSE_CTX(iec61851).last_error_time == 0)) {
+			EVSE_CTX(iec61851).last_error_time = system_timer_get_ms();
 		}
-		if(iec61851.state == IEC61851_STATE_EF) { // User has to disconnect first for error state EF
-			iec61851.last_error_time = system_timer_get_ms();
+		if(EVSE_CTX(iec61851).state == IEC61851_STATE_EF) { // User has to disconnect first for error state EF
+			EVSE_CTX(iec61851).last_error_time = system_timer_get_ms();
 		}
-		if((state == IEC61851_STATE_C) && (iec61851.last_error_time != 0)) {
-			if(!system_timer_is_time_elapsed_ms(iec61851.last_error_time, 30*1000)) {
+		if((state == IEC61851_STATE_C) && (EVSE_CTX(iec61851).last_error_time != 0)) {
+			if(!system_timer_is_time_elapsed_ms(EVSE_CTX(iec61851).last_error_time, 30*1000)) {
 				return;
 			}
-			iec61851.last_error_time = 0;
+			EVSE_CTX(iec61851).last_error_time = 0;
 		}
 
 		// If we change from state C to something else we save the time
 		// If we then change back to state C we wait at least 5 seconds
 		// -> Don't start charging immediately after charging was stopped
-		if(iec61851.state == IEC61851_STATE_C) {
-			iec61851.last_state_c_end_time = system_timer_get_ms();
+		if(EVSE_CTX(iec61851).state == IEC61851_STATE_C) {
+			EVSE_CTX(iec61851).last_state_c_end_time = system_timer_get_ms();
 		}
-		if((state == IEC61851_STATE_C) && (iec61851.last_state_c_end_time != 0)) {
-			if(!system_timer_is_time_elapsed_ms(iec61851.last_state_c_end_time, 5*1000)) {
+		if((state == IEC61851_STATE_C) && (EVSE_CTX(iec61851).last_state_c_end_time != 0)) {
+			if(!system_timer_is_time_elapsed_ms(EVSE_CTX(iec61851).last_state_c_end_time, 5*1000)) {
 				return;
 			}
-			iec61851.last_state_c_end_time = 0;
+			EVSE_CTX(iec61851).last_state_c_end_time = 0;
 		}
 
 		if((state == IEC61851_STATE_A ) || (state == IEC61851_STATE_B)) {
 			// Turn LED on with timer for standby if we have a state change to state A or B
-			led_set_on(false);
+			led_set_on();
 		}
 
-		if((iec61851.state != IEC61851_STATE_A) && (state == IEC61851_STATE_A)) {
+		// Leaving an error state ends the error blinking, leaving state C the breathing
+		if((state == IEC61851_STATE_A) || (state == IEC61851_STATE_B) || (state == IEC61851_STATE_C)) {
+			led_clear_blinking();
+		}
+		if(state != IEC61851_STATE_C) {
+			led_clear_breathing();
+		}
+
+		if((EVSE_CTX(iec61851).state != IEC61851_STATE_A) && (state == IEC61851_STATE_A)) {
 			// If state changed from to A we invalidate the managed current
 			// we have to handle the clear on dusconnect slots
 			charging_slot_handle_disconnect();
 		}
 
-		iec61851.state             = state;
-		iec61851.last_state_change = system_timer_get_ms();
+		journal_add(JOURNAL_EVENT_STATE_CHANGE, (EVSE_CTX(iec61851).state << 8) | state, 0);
+
+		EVSE_CTX(iec61851).state             = state;
+		EVSE_CTX(iec61851).last_state_change = system_timer_get_ms();
 	}
 }
 
 void iec61851_handle_time_in_b2(void) {
 	uint32_t ma = iec61851_get_max_ma();
-	if(iec61851.state == IEC61851_STATE_B) {
+	if(EVSE_CTX(iec61851).state == IEC61851_STATE_B) {
 		if(ma != 0) {
-			if(iec61851.time_in_b2 == 0) {
-				iec61851.time_in_b2 = system_timer_get_ms();
+			if(EVSE_CTX(iec61851).time_in_b2 == 0) {
+				EVSE_CTX(iec61851).time_in_b2 = system_timer_get_ms();
 			}
 		} else {
-			iec61851.time_in_b2 = 0;
+			EVSE_CTX(iec61851).time_in_b2 = 0;
 		}
 	} else {
-		iec61851.time_in_b2 = 0;
+		EVSE_CTX(iec61851).time_in_b2 = 0;
 	}
 
-	if(iec61851.time_in_b2 != 0) {
-		if(system_timer_is_time_elapsed_ms(iec61851.time_in_b2, 60*1000*3)) {
-			evse.car_stopped_charging = true;
+	if(EVSE_CTX(iec61851).time_in_b2 != 0) {
+		if(system_timer_is_time_elapsed_ms(EVSE_CTX(iec61851).time_in_b2, 60*1000*3)) {
+			EVSE_CTX(evse).car_stopped_charging = true;
 		}
 	}
 }
@@ -113,11 +123,11 @@ void iec61851_handle_time_in_b2(void) {
 //       if resistance > 10000. Do we want to have a specific
 //       state for that?
 uint32_t iec61851_get_ma_from_pp_resistance(void) {
-	if(ads1118.pp_pe_resistance >= 1000) {
+	if(EVSE_CTX(ads1118).pp_pe_resistance >= 1000) {
 		return 13000; // 13A
-	} else if(ads1118.pp_pe_resistance >= 330) {
+	} else if(EVSE_CTX(ads1118).pp_pe_resistance >= 330) {
 		return 20000; // 20A
-	} else if(ads1118.pp_pe_resistance >= 150) {
+	} else if(EVSE_CTX(ads1118).pp_pe_resistance >= 150) {
 		return 32000; // 32A
 	} else {
 		return 64000; // 64A
@@ -153,16 +163,16 @@ uint16_t iec61851_get_duty_cycle_for_ma(uint32_t ma) {
 void iec61851_state_a(void) {
 	// In the case that a charging was stopped by pressing the button,
 	// we only allow to start charging again after we reach state A.
-	if(button.was_pressed) {
-		button.was_pressed = false;
-		if(button.state == BUTTON_STATE_RELEASED) {
+	if(EVSE_CTX(button).was_pressed) {
+		EVSE_CTX(button).was_pressed = false;
+		if(EVSE_CTX(button).state == BUTTON_STATE_RELEASED) {
 			charging_slot_start_charging_by_button();
 		}
 	}
 	// Apply +12V to CP, disable contactor
 	evse_set_output(1000, false);
 
-	evse.car_stopped_charging = false;
+	EVSE_CTX(evse).car_stopped_charging = false;
 }
 
 void iec61851_state_b(void) {
@@ -176,7 +186,7 @@ void iec61851_state_c(void) {
 	uint32_t ma = iec61851_get_max_ma();
 	evse_set_output(iec61851_get_duty_cycle_for_ma(ma), true);
 
-	evse.car_stopped_charging = false;
+	EVSE_CTX(evse).car_stopped_charging = false;
 
 	led_set_breathing();
 }
@@ -193,20 +203,20 @@ void iec61851_state_ef(void) {
 }
 
 void iec61851_tick(void) {
-	if(evse.calibration_state != 0) {
+	if(EVSE_CTX(evse).calibration_state != 0) {
 		return;
 	}
 
 	if(contactor_check.error != 0) {
 		led_set_blinking(4);
 		iec61851_set_state(IEC61851_STATE_EF);
-	} else if((evse.config_jumper_current == EVSE_CONFIG_JUMPER_SOFTWARE) || (evse.config_jumper_current == EVSE_CONFIG_JUMPER_UNCONFIGURED)) {
+	} else if((EVSE_CTX(evse).config_jumper_current == EVSE_CONFIG_JUMPER_SOFTWARE) || (EVSE_CTX(evse).config_jumper_current == EVSE_CONFIG_JUMPER_UNCONFIGURED)) {
 		// We don't allow the jumper to be unconfigured
 		led_set_blinking(2);
 		iec61851_set_state(IEC61851_STATE_EF);
 	} else {
 		// Wait for ADC measurements to be valid
-		if(ads1118.cp_invalid_counter > 0) {
+		if(EVSE_CTX(ads1118).cp_invalid_counter > 0) {
 			return;
 		}
 
@@ -218,17 +228,17 @@ void iec61851_tick(void) {
 		// that we don't cancel the charging here, we increase the STATE A threshold for
 		// this scenario.
 		const uint16_t current_cp_duty_cycle = evse_get_cp_duty_cycle();
-		const bool id3_mode = (current_cp_duty_cycle != 1000) && !XMC_GPIO_GetInput(EVSE_RELAY_PIN);
+		const bool id3_mode = (current_cp_duty_cycle != 1000) && !evse_is_relay_active();
 		if(!id3_mode) {
-			iec61851.id3_mode_time = 0;
+			EVSE_CTX(iec61851).id3_mode_time = 0;
 		}
 
-		if(id3_mode && (ads1118.cp_pe_resistance > IEC61851_CP_RESISTANCE_STATE_A*3)) {
-			if(iec61851.id3_mode_time == 0) {
-				iec61851.id3_mode_time = system_timer_get_ms();
+		if(id3_mode && (EVSE_CTX(ads1118).cp_pe_resistance > IEC61851_CP_RESISTANCE_STATE_A*3)) {
+			if(EVSE_CTX(iec61851).id3_mode_time == 0) {
+				EVSE_CTX(iec61851).id3_mode_time = system_timer_get_ms();
 			} else {
 				// wait for at least 2500ms between B->A state change in ID.3 mode
-				if(system_timer_is_time_elapsed_ms(iec61851.id3_mode_time, 2500)) {
+				if(system_timer_is_time_elapsed_ms(EVSE_CTX(iec61851).id3_mode_time, 2500)) {
 					iec61851_set_state(IEC61851_STATE_A);
 				}
 			}
@@ -236,17 +246,17 @@ void iec61851_tick(void) {
 		// If the relay is not turned off we force the state machine to go to state B before it can go to state A.
 		// In state B it will turn the relay off and then later go to state A,
 		// but during the change from B to A the ID.3 mode can trigger (which it wouldn't otherwise).
-		} else if(!XMC_GPIO_GetInput(EVSE_RELAY_PIN) && !id3_mode && (ads1118.cp_pe_resistance > IEC61851_CP_RESISTANCE_STATE_A)) {
+		} else if(!evse_is_relay_active() && !id3_mode && (EVSE_CTX(ads1118).cp_pe_resistance > IEC61851_CP_RESISTANCE_STATE_A)) {
 			iec61851_set_state(IEC61851_STATE_A);
-		} else if(ads1118.cp_pe_resistance > IEC61851_CP_RESISTANCE_STATE_B) {
+		} else if(EVSE_CTX(ads1118).cp_pe_resistance > IEC61851_CP_RESISTANCE_STATE_B) {
 			iec61851_set_state(IEC61851_STATE_B);
-		} else if(ads1118.cp_pe_resistance > IEC61851_CP_RESISTANCE_STATE_C) {
+		} else if(EVSE_CTX(ads1118).cp_pe_resistance > IEC61851_CP_RESISTANCE_STATE_C) {
 			if(charging_slot_get_max_current() == 0) {
 				iec61851_set_state(IEC61851_STATE_B);
 			} else {
 				iec61851_set_state(IEC61851_STATE_C);
 			}
-		} else if(ads1118.cp_pe_resistance > IEC61851_CP_RESISTANCE_STATE_D) {
+		} else if(EVSE_CTX(ads1118).cp_pe_resistance > IEC61851_CP_RESISTANCE_STATE_D) {
 			led_set_blinking(5);
 			iec61851_set_state(IEC61851_STATE_D);
 		} else {
@@ -257,7 +267,7 @@ void iec61851_tick(void) {
 
 	iec61851_handle_time_in_b2();
 
-	switch(iec61851.state) {
+	switch(EVSE_CTX(iec61851).state) {
 		case IEC61851_STATE_A:  iec61851_state_a();  break;
 		case IEC61851_STATE_B:  iec61851_state_b();  break;
 		case IEC61851_STATE_C:  iec61851_state_c();  break;
@@ -267,7 +277,7 @@ void iec61851_tick(void) {
 }
 
 void iec61851_init(void) {
-	memset(&iec61851, 0, sizeof(IEC61851));
-	iec61851.last_state_change = system_timer_get_ms();
+	memset(&EVSE_CTX(iec61851), 0, sizeof(IEC61851));
+	EVSE_CTX(iec61851).last_state_change = system_timer_get_ms();
 }
 
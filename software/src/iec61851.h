@@ -69,8 +69,6 @@ typedef struct {
 	uint32_t time_in_b2;
 } IEC61851;
 
-extern IEC61851 iec61851;
-
 void iec61851_init(void);
 void iec61851_tick(void);
 
@@ -0,0 +1,171 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * journal.c: Persistent event journal in flash
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "journal.h"
+
+#include <string.h>
+#include <stddef.h>
+
+#include "bricklib2/hal/system_timer/system_timer.h"
+#include "bricklib2/utility/util_definitions.h"
+
+#include "xmc_flash.h"
+#include "scheduler.h"
+#include "context.h"
+
+_Static_assert(JOURNAL_PAGE_SIZE == XMC_FLASH_BYTES_PER_PAGE, "The journal pages have to be flash pages");
+_Static_assert((JOURNAL_PAGE_SIZE % JOURNAL_RECORD_SIZE) == 0, "A journal record must not cross a page boundary");
+
+#ifndef EVSE_HOST
+// The flash areas are reserved in CMakeLists.txt (the firmware must not grow into them)
+_Static_assert(BOOTLOADER_FLASH_EEPROM_SIZE == FLASH_EEPROM_LENGTH, "EEPROM emulation size differs from CMakeLists.txt");
+_Static_assert(JOURNAL_PAGE_NUM*JOURNAL_PAGE_SIZE == FLASH_JOURNAL_LENGTH, "Journal size differs from CMakeLists.txt");
+#endif
+
+static uint8_t journal_checksum(const JournalRecord *record) {
+	const uint8_t *data = (const uint8_t*)record;
+	uint8_t checksum = 0;
+	for(uint8_t i = 0; i < JOURNAL_RECORD_SIZE; i++) {
+		if(i != offsetof(JournalRecord, checksum)) {
+			checksum ^= data[i];
+		}
+	}
+
+	// Inverted, so that an erased (all zero) block is never valid
+	return ~checksum;
+}
+
+static const JournalRecord *journal_get_flash_record(const uint16_t index) {
+	return (const JournalRecord*)(JOURNAL_FLASH_START + index*JOURNAL_RECORD_SIZE);
+}
+
+static bool journal_is_valid(const JournalRecord *record) {
+	return (record->sequence != 0) && (record->checksum == journal_checksum(record));
+}
+
+static bool journal_is_erased(const JournalRecord *record) {
+	const uint32_t *data = (const uint32_t*)record;
+	for(uint8_t i = 0; i < JOURNAL_RECORD_SIZE/sizeof(uint32_t); i++) {
+		if(data[i] != 0) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void journal_add(const uint8_t event, const uint16_t data16, const uint32_t data32) {
+	if(EVSE_CTX(journal).batch_count >= JOURNAL_BATCH_SIZE) {
+		journal_commit();
+	}
+
+	JournalRecord *record = &EVSE_CTX(journal).batch[EVSE_CTX(journal).batch_count];
+	record->sequence = EVSE_CTX(journal).next_sequence++;
+	record->time     = system_timer_get_ms();
+	record->event    = event;
+	record->data16   = data16;
+	record->data32   = data32;
+	record->checksum = journal_checksum(record);
+
+	if(EVSE_CTX(journal).batch_count == 0) {
+		EVSE_CTX(journal).batch_time = system_timer_get_ms();
+		scheduler_set_deadline(SCHEDULER_TASK_JOURNAL, EVSE_CTX(journal).batch_time + JOURNAL_COMMIT_TIME);
+	}
+	EVSE_CTX(journal).batch_count++;
+}
+
+// Writes all records of the batch with as few flash operations as possible:
+// One block write per page touched and one page erase whenever a new page is started.
+void journal_commit(void) {
+	uint8_t written = 0;
+	while(written < EVSE_CTX(journal).batch_count) {
+		const uint16_t index = EVSE_CTX(journal).next_index;
+		const uint8_t in_page = JOURNAL_RECORDS_PER_PAGE - (index % JOURNAL_RECORDS_PER_PAGE);
+		const uint8_t num = MIN(in_page, EVSE_CTX(journal).batch_count - written);
+
+		uint32_t *address = (uint32_t*)(JOURNAL_FLASH_START + index*JOURNAL_RECORD_SIZE);
+		if((index % JOURNAL_RECORDS_PER_PAGE) == 0) {
+			// Start of a page, the oldest 16 records are overwritten
+			XMC_FLASH_ErasePage(address);
+		}
+		XMC_FLASH_WriteBlocks(address, (const uint32_t*)&EVSE_CTX(journal).batch[written], num, false);
+
+		written += num;
+		EVSE_CTX(journal).next_index = (index + num) % JOURNAL_RECORD_NUM;
+	}
+
+	EVSE_CTX(journal).batch_count = 0;
+	scheduler_clear_deadline(SCHEDULER_TASK_JOURNAL);
+}
+
+// Copies up to max_records records with a sequence number greater than cursor (oldest first).
+// Records that are not yet committed to flash are included.
+uint8_t journal_read(const uint32_t cursor, JournalRecord *records, const uint8_t max_records) {
+	uint8_t count = 0;
+
+	for(uint16_t i = 0; (i < JOURNAL_RECORD_NUM) && (count < max_records); i++) {
+		const JournalRecord *record = journal_get_flash_record((EVSE_CTX(journal).next_index + i) % JOURNAL_RECORD_NUM);
+		if(journal_is_valid(record) && (record->sequence > cursor)) {
+			records[count++] = *record;
+		}
+	}
+
+	for(uint8_t i = 0; (i < EVSE_CTX(journal).batch_count) && (count < max_records); i++) {
+		if(EVSE_CTX(journal).batch[i].sequence > cursor) {
+			records[count++] = EVSE_CTX(journal).batch[i];
+		}
+	}
+
+	return count;
+}
+
+void journal_init(void) {
+	memset(&EVSE_CTX(journal), 0, sizeof(Journal));
+
+	// Find the newest record, the next record is written after it
+	uint32_t max_sequence = 0;
+	uint16_t max_index    = JOURNAL_RECORD_NUM - 1;
+	for(uint16_t i = 0; i < JOURNAL_RECORD_NUM; i++) {
+		const JournalRecord *record = journal_get_flash_record(i);
+		if(journal_is_valid(record) && (record->sequence > max_sequence)) {
+			max_sequence = record->sequence;
+			max_index    = i;
+		}
+	}
+
+	EVSE_CTX(journal).next_sequence = max_sequence + 1;
+	EVSE_CTX(journal).next_index    = (max_index + 1) % JOURNAL_RECORD_NUM;
+
+	// If the next block is not erased (e.g. reset during a write),
+	// we continue at the next page, it is erased before it is written.
+	if(!journal_is_erased(journal_get_flash_record(EVSE_CTX(journal).next_index))) {
+		EVSE_CTX(journal).next_index = ((EVSE_CTX(journal).next_index/JOURNAL_RECORDS_PER_PAGE + 1) % JOURNAL_PAGE_NUM) * JOURNAL_RECORDS_PER_PAGE;
+	}
+}
+
+// The deadline is set by journal_add for the first record of a batch
+void journal_tick(void) {
+	if(EVSE_CTX(journal).batch_count == 0) {
+		scheduler_clear_deadline(SCHEDULER_TASK_JOURNAL);
+	} else if(system_timer_is_time_elapsed_ms(EVSE_CTX(journal).batch_time, JOURNAL_COMMIT_TIME)) {
+		journal_commit();
+	}
+}
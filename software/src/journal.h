@@ -0,0 +1,71 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * journal.h: Persistent event journal in flash
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "configs/config_journal.h"
+
+#define JOURNAL_RECORD_SIZE       16
+#define JOURNAL_RECORDS_PER_PAGE  (JOURNAL_PAGE_SIZE/JOURNAL_RECORD_SIZE)
+#define JOURNAL_RECORD_NUM        (JOURNAL_PAGE_NUM*JOURNAL_RECORDS_PER_PAGE)
+
+#define JOURNAL_EVENT_BOOT            1 // data16: warm start, data32: firmware version
+#define JOURNAL_EVENT_STATE_CHANGE    2 // data16: old state << 8 | new state
+#define JOURNAL_EVENT_CONTACTOR_ERROR 3 // data16: contactor check error
+#define JOURNAL_EVENT_ERROR_STATE     4 // data16: error state (LED blink count)
+#define JOURNAL_EVENT_WATCHDOG_RESET  5
+#define JOURNAL_EVENT_FACTORY_RESET   6
+#define JOURNAL_EVENT_CALIBRATION     7 // data16: 0 = factory calibration, 1 = user calibration
+#define JOURNAL_EVENT_BOOST_MODE      8 // data16: boost mode enabled
+#define JOURNAL_EVENT_DERATING        9 // data16: derating state, data32: temperature in 1/100 °C
+
+// One record is exactly one flash block. The sequence number is counted across reboots,
+// the time is the uptime in ms. A record is valid if the checksum matches
+// (an erased block or a partially written block is invalid).
+typedef struct {
+	uint32_t sequence;
+	uint32_t time;
+	uint8_t event;
+	uint8_t checksum;
+	uint16_t data16;
+	uint32_t data32;
+} JournalRecord; // Not packed, the layout has no padding and the records are read/written word-wise
+
+typedef struct {
+	uint32_t next_sequence;
+	uint16_t next_index; // Index in flash of next record to be written
+
+	JournalRecord batch[JOURNAL_BATCH_SIZE];
+	uint8_t batch_count;
+	uint32_t batch_time;
+} Journal;
+
+void journal_add(const uint8_t event, const uint16_t data16, const uint32_t data32);
+void journal_commit(void);
+uint8_t journal_read(const uint32_t cursor, JournalRecord *records, const uint8_t max_records);
+void journal_init(void);
+void journal_tick(void);
+
+#endif
@@ -20,45 +20,49 @@
  */
 
 #include "led.h"
+
+#include <string.h>
+
 #include "configs/config_led.h"
 
 #include "bricklib2/utility/util_definitions.h"
 #include "bricklib2/logging/logging.h"
 #include "bricklib2/hal/ccu4_pwm/ccu4_pwm.h"
 
-#include <string.h>
-
-LED led;
-
-
-// CIE1931 correction table
-const uint16_t led_cie1931[256] = {
-	0, 28, 57, 85, 114, 142, 171, 199, 228, 256,
-	285, 313, 342, 370, 399, 427, 456, 484, 513, 541,
-	570, 598, 627, 658, 689, 721, 755, 789, 825, 861,
-	899, 937, 977, 1018, 1060, 1103, 1147, 1192, 1239, 1287,
-	1336, 1386, 1437, 1490, 1544, 1599, 1656, 1714, 1773, 1834,
-	1896, 1959, 2024, 2090, 2157, 2226, 2297, 2369, 2442, 2517,
-	2593, 2671, 2751, 2832, 2914, 2999, 3085, 3172, 3261, 3352,
-	3444, 3538, 3634, 3732, 3831, 3932, 4035, 4139, 4245, 4354,
-	4464, 4575, 4689, 4804, 4922, 5041, 5162, 5285, 5410, 5537,
-	5666, 5797, 5930, 6065, 6202, 6341, 6482, 6626, 6771, 6918,
-	7068, 7220, 7373, 7529, 7687, 7848, 8010, 8175, 8342, 8512,
-	8683, 8857, 9033, 9212, 9393, 9576, 9762, 9949, 10140, 10333,
-	10528, 10725, 10926, 11128, 11333, 11541, 11751, 11963, 12179, 12396,
-	12617, 12840, 13065, 13293, 13524, 13757, 13993, 14232, 14474, 14718,
-	14965, 15215, 15467, 15722, 15980, 16241, 16505, 16771, 17041, 17313,
-	17588, 17866, 18147, 18431, 18717, 19007, 19300, 19596, 19894, 20196,
-	20501, 20809, 21119, 21433, 21750, 22071, 22394, 22720, 23050, 23383,
-	23719, 24058, 24400, 24746, 25095, 25447, 25802, 26161, 26523, 26888,
-	27257, 27629, 28004, 28383, 28765, 29151, 29540, 29932, 30328, 30728,
-	31131, 31537, 31947, 32360, 32777, 33198, 33622, 34050, 34481, 34916,
-	35355, 35797, 36243, 36693, 37146, 37603, 38064, 38529, 38997, 39469,
-	39945, 40425, 40908, 41396, 41887, 42382, 42881, 43384, 43891, 44401,
-	44916, 45435, 45957, 46484, 47015, 47549, 48088, 48631, 49178, 49728,
-	50283, 50843, 51406, 51973, 52545, 53120, 53700, 54284, 54873, 55465,
-	56062, 56663, 57269, 57878, 58492, 59111, 59733, 60360, 60992, 61627,
-	62268, 62912, 63561, 64215, 64873, 65535,
+#include "scheduler.h"
+#include "journal.h"
+#include "profiler.h"
+#include "context.h"
+
+// CIE1931 corrected LED PWM compare values (LED_MAX_DUTY_CYCLE - cie1931/10),
+// precomputed so that the step interrupt only needs a table lookup per brightness step
+const uint16_t led_cie1931_compare[256] = {
+	6553, 6551, 6548, 6545, 6542, 6539, 6536, 6534, 6531, 6528,
+	6525, 6522, 6519, 6516, 6514, 6511, 6508, 6505, 6502, 6499,
+	6496, 6494, 6491, 6488, 6485, 6481, 6478, 6475, 6471, 6467,
+	6464, 6460, 6456, 6452, 6447, 6443, 6439, 6434, 6430, 6425,
+	6420, 6415, 6410, 6404, 6399, 6394, 6388, 6382, 6376, 6370,
+	6364, 6358, 6351, 6344, 6338, 6331, 6324, 6317, 6309, 6302,
+	6294, 6286, 6278, 6270, 6262, 6254, 6245, 6236, 6227, 6218,
+	6209, 6200, 6190, 6180, 6170, 6160, 6150, 6140, 6129, 6118,
+	6107, 6096, 6085, 6073, 6061, 6049, 6037, 6025, 6012, 6000,
+	5987, 5974, 5960, 5947, 5933, 5919, 5905, 5891, 5876, 5862,
+	5847, 5831, 5816, 5801, 5785, 5769, 5752, 5736, 5719, 5702,
+	5685, 5668, 5650, 5632, 5614, 5596, 5577, 5559, 5539, 5520,
+	5501, 5481, 5461, 5441, 5420, 5399, 5378, 5357, 5336, 5314,
+	5292, 5269, 5247, 5224, 5201, 5178, 5154, 5130, 5106, 5082,
+	5057, 5032, 5007, 4981, 4955, 4929, 4903, 4876, 4849, 4822,
+	4795, 4767, 4739, 4710, 4682, 4653, 4623, 4594, 4564, 4534,
+	4503, 4473, 4442, 4410, 4378, 4346, 4314, 4281, 4248, 4215,
+	4182, 4148, 4113, 4079, 4044, 4009, 3973, 3937, 3901, 3865,
+	3828, 3791, 3753, 3715, 3677, 3638, 3599, 3560, 3521, 3481,
+	3440, 3400, 3359, 3317, 3276, 3234, 3191, 3148, 3105, 3062,
+	3018, 2974, 2929, 2884, 2839, 2793, 2747, 2701, 2654, 2607,
+	2559, 2511, 2463, 2414, 2365, 2315, 2265, 2215, 2164, 2113,
+	2062, 2010, 1958, 1905, 1852, 1799, 1745, 1690, 1636, 1581,
+	1525, 1469, 1413, 1356, 1299, 1241, 1183, 1125, 1066, 1007,
+	947, 887, 827, 766, 704, 642, 580, 517, 454, 391,
+	327, 262, 197, 132, 66, 0,
 };
 
 #define LED_MAX_DUTY_CYCLE 6553
@@ -73,282 +77,500 @@ void led_set_duty_cycle(const uint16_t compare_value) {
 	                                            (XMC_CCU4_SHADOW_TRANSFER_PRESCALER_SLICE_0 << (EVSE_LED_SLICE_NUMBER*4)));
 }
 
-void led_reset_api_state(void) {
-	led.api_indication   = -1;
-	led.api_start        = 0;
-	led.api_duration     = 0;
+// Keyframes and length of a built-in pattern
+#define LED_PATTERN(keyframes) keyframes, (sizeof(keyframes)/sizeof(LEDKeyframe))
+
+// Error codes: blink num times, then 2s off
+static const LEDKeyframe led_pattern_blinking[] = {
+	{LED_KEYFRAME_LOOP_START, 0,   0},
+	{LED_KEYFRAME_SET,        0,   250},
+	{LED_KEYFRAME_SET,        255, 250},
+	{LED_KEYFRAME_LOOP_END,   0,   0},
+	{LED_KEYFRAME_SET,        0,   2000},
+};
+
+static const LEDKeyframe led_pattern_flicker[] = {
+	{LED_KEYFRAME_SET,        0,   50},
+	{LED_KEYFRAME_SET,        255, 50},
+};
+
+static const LEDKeyframe led_pattern_breathing[] = {
+	{LED_KEYFRAME_RAMP,       255, 1275},
+	{LED_KEYFRAME_RAMP,       0,   1275},
+};
 
-	led.api_ack_counter  = 0;
-	led.api_ack_index    = 0;
-	led.api_ack_time     = 0;
+// Indication 1001: three times fading in, then 2s on
+static const LEDKeyframe led_pattern_api_ack[] = {
+	{LED_KEYFRAME_LOOP_START, 0,   0},
+	{LED_KEYFRAME_SET,        0,   0},
+	{LED_KEYFRAME_RAMP,       255, 512},
+	{LED_KEYFRAME_LOOP_END,   3,   0},
+	{LED_KEYFRAME_SET,        255, 2000},
+};
 
-	led.api_nack_counter = 0;
-	led.api_nack_index   = 0;
-	led.api_nack_time    = 0;
+// Indication 1002: fading out once, then 400ms off
+static const LEDKeyframe led_pattern_api_nack[] = {
+	{LED_KEYFRAME_SET,        255, 0},
+	{LED_KEYFRAME_RAMP,       0,   256},
+	{LED_KEYFRAME_SET,        0,   400},
+};
 
-	led.api_nag_counter  = 0;
-	led.api_nag_index    = 0;
-	led.api_nag_time     = 0;
+// Indication 1003: fading in and out, then 400ms off
+static const LEDKeyframe led_pattern_api_nag[] = {
+	{LED_KEYFRAME_RAMP,       255, 256},
+	{LED_KEYFRAME_RAMP,       0,   256},
+	{LED_KEYFRAME_SET,        0,   400},
+};
+
+static void led_set_brightness(const uint8_t brightness) {
+#if LOGGING_LEVEL == LOGGING_NONE
+	led_set_duty_cycle(led_cie1931_compare[brightness]);
+#endif
 }
 
-void led_set_breathing(void) {
-	// Check if we are already breathing state
-	if(led.state == LED_STATE_BREATHING) {
+// step.brightness is the shadow of the LED PWM, slow ramps keep the same brightness for many steps
+static void led_step_output(void) {
+	const uint8_t brightness = (uint8_t)(EVSE_CTX(led).step.level >> LED_STEP_SHIFT);
+	if(brightness == EVSE_CTX(led).step.brightness) {
+		PROFILER_ACCESS_SAVED();
 		return;
 	}
 
-	// API has higher priority than breathing
-	if(led.state == LED_STATE_API) {
-		return;
+	EVSE_CTX(led).step.brightness = brightness;
+	led_set_brightness(brightness);
+}
+
+// Prepares the brightness steps from "from" to "to" for led_step. If the keyframe started
+// "elapsed" ms ago (late tick), the steps start where the ramp should be by now.
+static void led_step_start(const uint8_t from, const uint8_t to, const uint16_t duration, const uint32_t elapsed) {
+	__disable_irq();
+	if(elapsed >= duration) {
+		EVSE_CTX(led).step.level     = to << LED_STEP_SHIFT;
+		EVSE_CTX(led).step.increment = 0;
+		EVSE_CTX(led).step.remaining = 0;
+	} else {
+		EVSE_CTX(led).step.increment = (((int32_t)to - from) << LED_STEP_SHIFT) / duration;
+		EVSE_CTX(led).step.level     = (from << LED_STEP_SHIFT) + EVSE_CTX(led).step.increment*(int32_t)elapsed;
+		EVSE_CTX(led).step.remaining = (uint16_t)(duration - elapsed);
 	}
+	EVSE_CTX(led).step.target = to;
+	led_step_output();
+	__enable_irq();
+}
 
-	// Otherwise start breathing from LED-on-condition
-	led.state           = LED_STATE_BREATHING;
-	led.breathing_time  = 0;
-	led.breathing_index = 0;
-	led.breathing_up    = true;
+static void led_step_set(const uint8_t brightness) {
+	led_step_start(brightness, brightness, 0, 0);
 }
 
-void led_set_blinking(const uint8_t num) {
-	// Check if we are already blinking with the correct blink amount
-	if((led.state == LED_STATE_BLINKING) && (led.blink_num == num)) {
+// Called every ms by the step timer interrupt
+void led_step(void) {
+	if(EVSE_CTX(led).step.remaining == 0) {
 		return;
 	}
 
-	// Blinking overwrites API configuration
-	if(led.state == LED_STATE_API) {
-		led_reset_api_state();
+	EVSE_CTX(led).step.remaining--;
+	if(EVSE_CTX(led).step.remaining == 0) {
+		EVSE_CTX(led).step.level  = EVSE_CTX(led).step.target << LED_STEP_SHIFT;
+	} else {
+		EVSE_CTX(led).step.level += EVSE_CTX(led).step.increment;
 	}
+	led_step_output();
+}
 
-	led.state           = LED_STATE_BLINKING;
-	led.blink_num       = num;
-	led.blink_count     = num;
-	led.blink_on        = false;
-	led.blink_last_time = system_timer_get_ms();
+static void led_player_start(const LEDKeyframe *keyframes, const uint8_t length, const uint8_t loop_num) {
+	LEDPlayer *player     = &EVSE_CTX(led).player;
+
+	player->keyframes     = keyframes;
+	player->length        = length;
+	player->position      = 0;
+	player->loop_start    = 0;
+	player->loop_pass     = 0;
+	player->loop_num      = loop_num;
+	player->from          = 0;
+	player->started       = false;
+	player->keyframe_time = system_timer_get_ms();
+	player->cycle_done    = false;
+}
 
-#if LOGGING_LEVEL == LOGGING_NONE
-	led_set_duty_cycle(LED_OFF);
-#endif
+static void led_player_stop(void) {
+	EVSE_CTX(led).player.keyframes = NULL;
+	EVSE_CTX(led).player.length    = 0;
 }
 
-// Called whenever there is activity
-// LED will go to standby after 15 minutes again
-void led_set_on(const bool force) {
-	// led "on" does not overwrite API state
-	if(!force && (led.state == LED_STATE_API)) {
+static void led_player_tick(void) {
+	LEDPlayer *player  = &EVSE_CTX(led).player;
+	player->cycle_done = false;
+	if(player->length == 0) {
 		return;
 	}
 
-	led.on_time = system_timer_get_ms();
-	led.state = LED_STATE_ON;
-#if LOGGING_LEVEL == LOGGING_NONE
-	led_set_duty_cycle(LED_ON);
-#endif
-}
+	for(uint8_t i = 0; i < LED_PLAYER_KEYFRAMES_PER_TICK; i++) {
+		const LEDKeyframe *keyframe = &player->keyframes[player->position];
+		if(keyframe->type == LED_KEYFRAME_LOOP_START) {
+			player->loop_start = player->position + 1;
+			player->loop_pass  = 0;
+		} else if(keyframe->type == LED_KEYFRAME_LOOP_END) {
+			const uint8_t loop_num = (keyframe->index == 0) ? player->loop_num : keyframe->index;
+			player->loop_pass++;
+			if(player->loop_pass < loop_num) {
+				player->position = player->loop_start;
+				continue;
+			}
+		} else {
+			if(!system_timer_is_time_elapsed_ms(player->keyframe_time, keyframe->duration)) {
+				break;
+			}
+
+			// Advance by the duration instead of setting the current time,
+			// so that a late tick does not stretch the pattern.
+			player->keyframe_time += keyframe->duration;
+			player->from           = keyframe->index;
+			player->started        = false;
+		}
 
-void led_set_off(void) {
-	// led "off" does not overwrite API state
-	if(led.state == LED_STATE_API) {
+		player->position++;
+		if(player->position >= player->length) {
+			player->position   = 0;
+			player->cycle_done = true;
+		}
+	}
+
+	// The brightness steps within the keyframe are done by led_step
+	const LEDKeyframe *keyframe = &player->keyframes[player->position];
+	if(player->started) {
 		return;
 	}
 
-	led.state = LED_STATE_OFF;
-	led_set_duty_cycle(LED_OFF);
+	if(keyframe->type == LED_KEYFRAME_SET) {
+		led_step_set(keyframe->index);
+		player->started = true;
+	} else if(keyframe->type == LED_KEYFRAME_RAMP) {
+		led_step_start(player->from, keyframe->index, keyframe->duration, system_timer_get_ms() - player->keyframe_time);
+		player->started = true;
+	}
 }
 
-void led_init(void) {
-	memset(&led, 0, sizeof(LED));
+// Time of the next keyframe of the visible pattern
+static uint32_t led_player_get_deadline(void) {
+	const LEDPlayer *player = &EVSE_CTX(led).player;
+	return player->keyframe_time + player->keyframes[player->position].duration;
+}
 
-#if LOGGING_LEVEL == LOGGING_NONE
-	ccu4_pwm_init(EVSE_LED_PIN, EVSE_LED_SLICE_NUMBER, LED_MAX_DUTY_CYCLE-1); // ~9.7 kHz
-	ccu4_pwm_set_duty_cycle(EVSE_LED_SLICE_NUMBER, LED_OFF);
-#endif
-	led_reset_api_state();
+// The setters compare with the current content, some modules call them
+// in every tick and the pattern must not start again then.
+static void led_layer_set_brightness(const uint8_t layer, const LEDState state, const uint8_t brightness) {
+	LEDLayer *l = &EVSE_CTX(led).layers[layer];
+	if(l->active && (l->state == state) && (l->brightness == brightness)) {
+		return;
+	}
 
-	led.state = LED_STATE_FLICKER;
+	l->active     = true;
+	l->state      = state;
+	l->brightness = brightness;
+	l->keyframes  = NULL;
+	l->length     = 0;
+	l->sequence++;
+	scheduler_trigger(SCHEDULER_TASK_LED);
 }
 
-void led_tick_status_off(void) {
-#if LOGGING_LEVEL == LOGGING_NONE
-	led_set_duty_cycle(LED_OFF);
-#endif
+static void led_layer_set_pattern(const uint8_t layer, const LEDState state, const LEDKeyframe *keyframes, const uint8_t length, const uint8_t loop_num) {
+	LEDLayer *l = &EVSE_CTX(led).layers[layer];
+	if(l->active && (l->state == state) && (l->brightness < 0) && (l->keyframes == keyframes) && (l->length == length) && (l->loop_num == loop_num)) {
+		return;
+	}
+
+	l->active     = true;
+	l->state      = state;
+	l->brightness = -1;
+	l->keyframes  = keyframes;
+	l->length     = length;
+	l->loop_num   = loop_num;
+	l->sequence++;
+	scheduler_trigger(SCHEDULER_TASK_LED);
 }
 
-void led_tick_status_on(void) {
-	if(system_timer_is_time_elapsed_ms(led.on_time, LED_STANDBY_TIME)) {
-		led.state = LED_STATE_OFF;
-#if LOGGING_LEVEL == LOGGING_NONE
-		led_set_duty_cycle(LED_OFF);
-#endif
+static void led_layer_clear(const uint8_t layer) {
+	LEDLayer *l = &EVSE_CTX(led).layers[layer];
+	if(!l->active) {
+		return;
+	}
+
+	l->active = false;
+	l->sequence++;
+	scheduler_trigger(SCHEDULER_TASK_LED);
+}
+
+static void led_set_api_layer(const int16_t indication) {
+	if((indication >= 0) && (indication <= 255)) {
+		led_layer_set_brightness(LED_LAYER_API, LED_STATE_API, (uint8_t)indication);
+	} else if(indication == 1001) {
+		led_layer_set_pattern(LED_LAYER_API, LED_STATE_API, LED_PATTERN(led_pattern_api_ack), 0);
+	} else if(indication == 1002) {
+		led_layer_set_pattern(LED_LAYER_API, LED_STATE_API, LED_PATTERN(led_pattern_api_nack), 0);
+	} else if(indication == 1003) {
+		led_layer_set_pattern(LED_LAYER_API, LED_STATE_API, LED_PATTERN(led_pattern_api_nag), 0);
+	} else if((indication > 2000) && (indication < 2011)) {
+		led_layer_set_pattern(LED_LAYER_API, LED_STATE_API, LED_PATTERN(led_pattern_blinking), (uint8_t)(indication - 2000));
+	} else if((indication >= LED_PATTERN_CUSTOM_INDICATION) && (indication < LED_PATTERN_CUSTOM_INDICATION + LED_PATTERN_CUSTOM_NUM)) {
+		const LEDPattern *pattern = &EVSE_CTX(led).custom_patterns[indication - LED_PATTERN_CUSTOM_INDICATION];
+		led_layer_set_pattern(LED_LAYER_API, LED_STATE_API, pattern->keyframes, pattern->length, 0);
 	} else {
-#if LOGGING_LEVEL == LOGGING_NONE
-		led_set_duty_cycle(LED_ON);
-#endif
+		led_layer_clear(LED_LAYER_API);
 	}
 }
 
-void led_tick_status_blinking(void) {
-	if(led.blink_count >= led.blink_num) {
-		if(system_timer_is_time_elapsed_ms(led.blink_last_time, LED_BLINK_DURATION_WAIT)) {
-			led.blink_last_time         = system_timer_get_ms();
-			led.blink_count             = 0;
-			led.currently_in_wait_state = true;
+// Active layer with the highest priority, this is the visible layer after the next LED tick
+uint8_t led_get_top_layer(void) {
+	for(uint8_t i = 0; i < LED_LAYER_NUM; i++) {
+		if(EVSE_CTX(led).layers[i].active) {
+			return i;
 		}
-	} else if(led.blink_on) {
-		if(system_timer_is_time_elapsed_ms(led.blink_last_time, LED_BLINK_DURATION_ON)) {
-			led.blink_last_time = system_timer_get_ms();
-#if LOGGING_LEVEL == LOGGING_NONE
-			led_set_duty_cycle(LED_OFF);
-#endif
-			led.blink_on = false;
-			led.blink_count++;
+	}
+
+	return LED_LAYER_NUM;
+}
+
+// Negative indications (LED back to EVSE control) are valid too
+bool led_is_api_indication_valid(const int16_t indication) {
+	if(indication < 256) {
+		return true;
+	}
+
+	if((indication >= 1001) && (indication <= 1003)) {
+		return true;
+	}
+
+	if((indication >= 2001) && (indication <= 2010)) {
+		return true;
+	}
+
+	if((indication >= LED_PATTERN_CUSTOM_INDICATION) && (indication < LED_PATTERN_CUSTOM_INDICATION + LED_PATTERN_CUSTOM_NUM)) {
+		return EVSE_CTX(led).custom_patterns[indication - LED_PATTERN_CUSTOM_INDICATION].length > 0;
+	}
+
+	return false;
+}
+
+// The indication is kept while a layer with higher priority is visible,
+// the duration runs from now on in any case.
+void led_set_api_indication(const int16_t indication, const uint16_t duration) {
+	EVSE_CTX(led).api_indication = indication;
+	EVSE_CTX(led).api_duration   = duration;
+	EVSE_CTX(led).api_start      = system_timer_get_ms();
+	led_set_api_layer(indication);
+	scheduler_trigger(SCHEDULER_TASK_LED);
+}
+
+// Gives the LED back to the EVSE, which turns it on (until standby)
+void led_clear_api_indication(void) {
+	if(!EVSE_CTX(led).layers[LED_LAYER_API].active) {
+		return;
+	}
+
+	EVSE_CTX(led).api_indication = -1;
+	EVSE_CTX(led).api_start      = 0;
+	EVSE_CTX(led).api_duration   = 0;
+	led_layer_clear(LED_LAYER_API);
+	led_set_on();
+}
+
+// Loops can't be nested and every loop and the pattern itself have to take some time
+bool led_set_custom_pattern(const uint8_t pattern, const LEDKeyframe *keyframes, const uint8_t length) {
+	if((pattern >= LED_PATTERN_CUSTOM_NUM) || (length > LED_PATTERN_LENGTH_MAX)) {
+		return false;
+	}
+
+	bool in_loop           = false;
+	uint32_t duration      = 0;
+	uint32_t loop_duration = 0;
+	for(uint8_t i = 0; i < length; i++) {
+		switch(keyframes[i].type) {
+			case LED_KEYFRAME_SET:
+			case LED_KEYFRAME_RAMP: {
+				duration      += keyframes[i].duration;
+				loop_duration += keyframes[i].duration;
+				break;
+			}
+
+			case LED_KEYFRAME_LOOP_START: {
+				if(in_loop) {
+					return false;
+				}
+				in_loop       = true;
+				loop_duration = 0;
+				break;
+			}
+
+			case LED_KEYFRAME_LOOP_END: {
+				if(!in_loop || (loop_duration == 0)) {
+					return false;
+				}
+				in_loop = false;
+				break;
+			}
+
+			default: return false;
 		}
-	} else {
-		if(system_timer_is_time_elapsed_ms(led.blink_last_time, LED_BLINK_DURATION_OFF)) {
-			led.blink_last_time = system_timer_get_ms();
-#if LOGGING_LEVEL == LOGGING_NONE
-			led_set_duty_cycle(LED_ON);
-#endif
-			led.blink_on = true;
+	}
+
+	if(in_loop || ((length > 0) && (duration == 0))) {
+		return false;
+	}
+
+	memcpy(EVSE_CTX(led).custom_patterns[pattern].keyframes, keyframes, length*sizeof(LEDKeyframe));
+	EVSE_CTX(led).custom_patterns[pattern].length = length;
+
+	// A pattern that is currently used by the API layer starts again with the new keyframes
+	if(EVSE_CTX(led).layers[LED_LAYER_API].active && (EVSE_CTX(led).api_indication == LED_PATTERN_CUSTOM_INDICATION + pattern)) {
+		if(length == 0) {
+			led_clear_api_indication();
+		} else {
+			EVSE_CTX(led).layers[LED_LAYER_API].active = false;
+			led_set_api_layer(EVSE_CTX(led).api_indication);
 		}
 	}
+
+	return true;
 }
 
-void led_tick_status_flicker(void) {
-	if(system_timer_is_time_elapsed_ms(led.flicker_last_time, LED_FLICKER_DURATION)) {
-#if LOGGING_LEVEL == LOGGING_NONE
-		led_set_duty_cycle(led.flicker_on ? LED_ON : LED_OFF);
-#endif
-		led.flicker_last_time = system_timer_get_ms();
-		led.flicker_on        = ! led.flicker_on;
-	}
+void led_set_breathing(void) {
+	led_layer_set_pattern(LED_LAYER_CHARGING, LED_STATE_BREATHING, LED_PATTERN(led_pattern_breathing), 0);
+}
+
+void led_clear_breathing(void) {
+	led_layer_clear(LED_LAYER_CHARGING);
 }
 
-void led_tick_status_breathing(void) {
-	if(!system_timer_is_time_elapsed_ms(led.breathing_time, 5)) {
+void led_set_blinking(const uint8_t num) {
+	// Check if we are already blinking with the correct blink amount
+	if(EVSE_CTX(led).layers[LED_LAYER_FAULT].active && (EVSE_CTX(led).blink_num == num)) {
 		return;
 	}
-	led.breathing_time = system_timer_get_ms();
 
-	if(led.breathing_up) {
-		led.breathing_index += 1;
+	// The blink count is the error state, it is only journaled when it changes
+	journal_add(JOURNAL_EVENT_ERROR_STATE, num, 0);
+
+	EVSE_CTX(led).blink_num = num;
+	led_layer_set_pattern(LED_LAYER_FAULT, LED_STATE_BLINKING, LED_PATTERN(led_pattern_blinking), num);
+}
+
+void led_clear_blinking(void) {
+	led_layer_clear(LED_LAYER_FAULT);
+}
+
+// Called whenever there is activity
+// LED will go to standby after 15 minutes again
+void led_set_on(void) {
+	EVSE_CTX(led).on_time = system_timer_get_ms();
+	led_layer_set_brightness(LED_LAYER_STANDBY, LED_STATE_ON, 255);
+}
+
+// As long as the button is pressed (or key is turned to off) the LED stays off
+void led_set_key_switch_off(const bool off) {
+	if(off) {
+		led_layer_set_brightness(LED_LAYER_KEY_SWITCH, LED_STATE_OFF, 0);
 	} else {
-		led.breathing_index -= 1;
+		led_layer_clear(LED_LAYER_KEY_SWITCH);
 	}
-	led.breathing_index = BETWEEN(0, led.breathing_index, 255);
+}
 
-	if(led.breathing_index == 0) {
-		led.breathing_up = true;
-	} else if(led.breathing_index == 255) {
-		led.breathing_up = false;
-	}
+void led_init(void) {
+	memset(&EVSE_CTX(led), 0, sizeof(LED));
 
 #if LOGGING_LEVEL == LOGGING_NONE
-	led_set_duty_cycle(6553 - led_cie1931[led.breathing_index]/10);
+	ccu4_pwm_init(EVSE_LED_PIN, EVSE_LED_SLICE_NUMBER, LED_MAX_DUTY_CYCLE-1); // ~9.7 kHz
+	ccu4_pwm_set_duty_cycle(EVSE_LED_SLICE_NUMBER, LED_OFF);
 #endif
-}
+	EVSE_CTX(led).api_indication = -1;
+	EVSE_CTX(led).visible_layer  = LED_LAYER_NUM;
+	EVSE_CTX(led).state          = LED_STATE_OFF;
 
+	// Flicker until the EVSE is ready (see evse_tick)
+	led_layer_set_pattern(LED_LAYER_STANDBY, LED_STATE_FLICKER, LED_PATTERN(led_pattern_flicker), 0);
+}
 
-void led_tick_status_api_ack(void) {
-	if((led.api_ack_counter < 3) && (system_timer_is_time_elapsed_ms(led.api_ack_time, 2))) {
-		led_set_duty_cycle(6553 - led_cie1931[led.api_ack_index]/10);
-		led.api_ack_index++;
-		led.api_ack_time+=2;
-		if(led.api_ack_index == 0) {
-			led.api_ack_counter++;
-		}
-	} else if((led.api_ack_counter >= 3) && (system_timer_is_time_elapsed_ms(led.api_ack_time, 2000))) {
-		led.api_ack_index           = 0;
-		led.api_ack_counter         = 0;
-		led.api_ack_time            = system_timer_get_ms();
-		led.currently_in_wait_state = true;
+static void led_tick_standby(void) {
+	const LEDLayer *layer = &EVSE_CTX(led).layers[LED_LAYER_STANDBY];
+	if(layer->active && (layer->state == LED_STATE_ON) && system_timer_is_time_elapsed_ms(EVSE_CTX(led).on_time, LED_STANDBY_TIME)) {
+		led_layer_set_brightness(LED_LAYER_STANDBY, LED_STATE_OFF, 0);
 	}
 }
 
-void led_tick_status_api_nack(void) {
-	if((led.api_nack_counter < 1) && (system_timer_is_time_elapsed_ms(led.api_nack_time, 1))) {
-		led_set_duty_cycle(6553 - led_cie1931[255-led.api_nack_index]/10);
-		led.api_nack_index++;
-		led.api_nack_time++;
-		if(led.api_nack_index == 0) {
-			led.api_nack_counter++;
-		}
-	} else if((led.api_nack_counter >= 1) && (system_timer_is_time_elapsed_ms(led.api_nack_time, 400))) {
-		led.api_nack_index          = 0;
-		led.api_nack_counter        = 0;
-		led.api_nack_time           = system_timer_get_ms();
-		led.currently_in_wait_state = true;
+static void led_tick_api(void) {
+	if(!EVSE_CTX(led).layers[LED_LAYER_API].active || !system_timer_is_time_elapsed_ms(EVSE_CTX(led).api_start, EVSE_CTX(led).api_duration)) {
+		return;
 	}
-}
 
-void led_tick_status_api_nag(void) {
-	if((led.api_nag_counter == 0) && (system_timer_is_time_elapsed_ms(led.api_nag_time, 1))) {
-		led_set_duty_cycle(6553 - led_cie1931[led.api_nag_index]/10);
-		led.api_nag_index++;
-		led.api_nag_time++;
-		if(led.api_nag_index == 0) {
-			led.api_nag_counter++;
-		}
-	} else if((led.api_nag_counter == 1) && (system_timer_is_time_elapsed_ms(led.api_nag_time, 1))) {
-		led_set_duty_cycle(6553 - led_cie1931[255-led.api_nag_index]/10);
-		led.api_nag_index++;
-		led.api_nag_time++;
-		if(led.api_nag_index == 0) {
-			led.api_nag_counter++;
-		}
-	} else if((led.api_nag_counter >= 2) && (system_timer_is_time_elapsed_ms(led.api_nag_time, 400))) {
-		led.api_nag_index           = 0;
-		led.api_nag_counter         = 0;
-		led.api_nag_time            = system_timer_get_ms();
-		led.currently_in_wait_state = true;
+	// A visible animation always ends after a complete cycle
+	const bool is_animation_visible = (EVSE_CTX(led).visible_layer == LED_LAYER_API) && (EVSE_CTX(led).layers[LED_LAYER_API].brightness < 0);
+	if(!is_animation_visible || EVSE_CTX(led).player.cycle_done) {
+		led_clear_api_indication();
 	}
 }
 
-void led_tick_status_api(void) {
-	led.currently_in_wait_state = false;
-
-	if((led.api_indication >= 0) && (led.api_indication <= 255)) {
-		led_set_duty_cycle(6553 - led_cie1931[led.api_indication]/10);
-	} else if(led.api_indication == 1001) {
-		led_tick_status_api_ack();
-	} else if(led.api_indication == 1002) {
-		led_tick_status_api_nack();
-	} else if(led.api_indication == 1003) {
-		led_tick_status_api_nag();
-	} else if(led.api_indication > 2000 && led.api_indication < 2011) {
-		if(led.blink_external != led.api_indication) {
-			// If external blinking is activated, turn LED off and start in off state
-			// with last time set to now.
-			// This way we don't waste any time and the first blinking pattern already has
-			// the correct amount of blinks.
-			led_set_duty_cycle(LED_OFF);
-			led.blink_num       = (uint32_t)(led.api_indication - 2000);
-			led.blink_count     = 0;
-			led.blink_on        = false;
-			led.blink_last_time = system_timer_get_ms();
-			led.blink_external  = led.api_indication;
+// Picks the active layer with the highest priority and starts its content if it changed
+static void led_compose(void) {
+	const uint8_t visible = led_get_top_layer();
+	if(visible == LED_LAYER_NUM) {
+		if(EVSE_CTX(led).visible_layer != LED_LAYER_NUM) {
+			EVSE_CTX(led).visible_layer = LED_LAYER_NUM;
+			EVSE_CTX(led).state         = LED_STATE_OFF;
+			led_player_stop();
+			led_step_set(0);
 		}
-		led_tick_status_blinking();
+		return;
 	}
 
-	if(system_timer_is_time_elapsed_ms(led.api_start, led.api_duration) && !led.currently_in_wait_state) {
-		led_reset_api_state();
-		led_set_on(true);
-		led.blink_external = -1;
+	const LEDLayer *layer = &EVSE_CTX(led).layers[visible];
+	if((visible == EVSE_CTX(led).visible_layer) && (layer->sequence == EVSE_CTX(led).visible_sequence)) {
+		return;
+	}
+
+	EVSE_CTX(led).visible_layer    = visible;
+	EVSE_CTX(led).visible_sequence = layer->sequence;
+	EVSE_CTX(led).state            = layer->state;
+	if(layer->brightness >= 0) {
+		led_player_stop();
+		led_step_set((uint8_t)layer->brightness);
+	} else {
+		led_player_start(layer->keyframes, layer->length, layer->loop_num);
+	}
+}
+
+static void led_deadline_min(uint32_t *deadline, bool *has_deadline, const uint32_t time) {
+	if(!*has_deadline || ((int32_t)(time - *deadline) < 0)) {
+		*deadline     = time;
+		*has_deadline = true;
 	}
 }
 
 void led_tick(void) {
-	if((led.state != LED_STATE_API) || (led.api_indication <= 2000) || (led.api_indication >= 2011)) {
-		led.blink_external  = -1;
+	// Timers of the layers run also while the layer is not visible
+	led_tick_standby();
+
+	led_compose();
+	led_player_tick();
+
+	// An API animation ends at the end of a cycle, that is only known after the player tick
+	led_tick_api();
+	led_compose();
+
+	// Decide when the LED tick has to run again
+	uint32_t deadline = 0;
+	bool has_deadline = false;
+	if(EVSE_CTX(led).player.length > 0) {
+		led_deadline_min(&deadline, &has_deadline, led_player_get_deadline());
+	}
+	if(EVSE_CTX(led).layers[LED_LAYER_STANDBY].active && (EVSE_CTX(led).layers[LED_LAYER_STANDBY].state == LED_STATE_ON)) {
+		led_deadline_min(&deadline, &has_deadline, EVSE_CTX(led).on_time + LED_STANDBY_TIME);
+	}
+	if(EVSE_CTX(led).layers[LED_LAYER_API].active) {
+		led_deadline_min(&deadline, &has_deadline, EVSE_CTX(led).api_start + EVSE_CTX(led).api_duration);
 	}
 
-	switch(led.state) {
-		case LED_STATE_OFF:       led_tick_status_off();       break;
-		case LED_STATE_ON:        led_tick_status_on();        break;
-		case LED_STATE_BLINKING:  led_tick_status_blinking();  break;
-		case LED_STATE_FLICKER:   led_tick_status_flicker();   break;
-		case LED_STATE_BREATHING: led_tick_status_breathing(); break;
-		case LED_STATE_API:       led_tick_status_api();       break;
+	if(has_deadline) {
+		scheduler_set_deadline(SCHEDULER_TASK_LED, deadline);
+	} else {
+		scheduler_clear_deadline(SCHEDULER_TASK_LED);
 	}
 }
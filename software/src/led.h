@@ -25,14 +25,39 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-#define LED_FLICKER_DURATION    50
-
-#define LED_BLINK_DURATION_ON   250
-#define LED_BLINK_DURATION_OFF  250
-#define LED_BLINK_DURATION_WAIT 2000
-
 #define LED_STANDBY_TIME (1000*60*15) // Standby after 15 minutes
 
+// Animations are patterns of keyframes that are played by led_tick. Each keyframe either
+// sets a brightness (index into led_cie1931_compare, 0 = off, 255 = on) for a duration or ramps
+// from the current brightness to the new one. A loop can repeat the keyframes between
+// LOOP_START and LOOP_END, the pattern itself repeats from the start after the last keyframe.
+#define LED_KEYFRAME_SET        0
+#define LED_KEYFRAME_RAMP       1
+#define LED_KEYFRAME_LOOP_START 2
+#define LED_KEYFRAME_LOOP_END   3 // index = number of passes, 0 = number given when the pattern is started
+#define LED_KEYFRAME_TYPE_NUM   4
+
+#define LED_PATTERN_LENGTH_MAX  14 // Keyframes per pattern, a custom pattern fits into one TFP message
+#define LED_PATTERN_CUSTOM_NUM  4  // Custom patterns (RAM only), used by indication 3001-3004
+#define LED_PATTERN_CUSTOM_INDICATION 3001
+
+// Every module writes to its own layer, led_tick shows the active layer with the highest
+// priority (lowest number). The layers below keep their content and appear again
+// when the layers above are cleared.
+#define LED_LAYER_FAULT         0 // Error blink codes
+#define LED_LAYER_KEY_SWITCH    1 // LED off while the button is pressed (key switch turned off)
+#define LED_LAYER_API           2 // set_indicator_led
+#define LED_LAYER_CHARGING      3 // Breathing in state C
+#define LED_LAYER_STANDBY       4 // Flicker during startup, then on until standby
+#define LED_LAYER_NUM           5
+
+// The player handles at most this many keyframes per tick, so also
+// keyframes with 0ms duration are evaluated in constant time.
+#define LED_PLAYER_KEYFRAMES_PER_TICK 4
+
+// Fixed point brightness of the steps within a keyframe
+#define LED_STEP_SHIFT 16
+
 typedef enum {
 	LED_STATE_OFF,
 	LED_STATE_ON,
@@ -43,47 +68,82 @@ typedef enum {
 } LEDState;
 
 typedef struct {
-	LEDState state;
+	uint8_t type;
+	uint8_t index;     // Brightness or number of loop passes
+	uint16_t duration; // ms
+} __attribute__((__packed__)) LEDKeyframe;
+
+typedef struct {
+	uint8_t length;
+	LEDKeyframe keyframes[LED_PATTERN_LENGTH_MAX];
+} LEDPattern;
+
+typedef struct {
+	const LEDKeyframe *keyframes;
+	uint8_t length;
+	uint8_t position;
+	uint8_t loop_start;     // Position after LOOP_START
+	uint8_t loop_pass;
+	uint8_t loop_num;       // Number of passes for LOOP_END with index 0
+	uint8_t from;           // Brightness at the start of the current keyframe
+	bool started;           // Steps of the current keyframe are handed to led_step
+	uint32_t keyframe_time; // Start of the current keyframe
+	bool cycle_done;        // Pattern started again from the beginning in this tick
+} LEDPlayer;
+
+// The player only runs at the keyframe boundaries, the brightness steps in between are
+// done by led_step in the 1ms step timer interrupt (independent of the main loop).
+// Only written by the main loop with interrupts disabled.
+typedef struct {
+	int32_t level;      // Brightness, fixed point with LED_STEP_SHIFT
+	int32_t increment;  // Added to level every ms
+	uint16_t remaining; // ms until target is reached
+	uint8_t target;
+	uint8_t brightness; // Brightness that is currently set
+} LEDStep;
+
+typedef struct {
+	bool active;
+	LEDState state;               // LED state that is reported while the layer is visible
+	int16_t brightness;           // Constant brightness, -1 = pattern
+	const LEDKeyframe *keyframes;
+	uint8_t length;
+	uint8_t loop_num;
+	uint8_t sequence;             // Incremented on every change of the content
+} LEDLayer;
+
+typedef struct {
+	LEDState state;               // State of the visible layer
+	uint8_t visible_layer;        // LED_LAYER_NUM = none
+	uint8_t visible_sequence;
+	LEDLayer layers[LED_LAYER_NUM];
 
 	uint32_t on_time;
 
 	uint32_t blink_num;
-	uint32_t blink_count;
-	bool blink_on;
-	uint32_t blink_last_time;
-	int16_t blink_external;
 
-	bool flicker_on;
-	uint32_t flicker_last_time;
-
-	uint32_t breathing_time;
-	int16_t breathing_index;
-	bool breathing_up;
+	LEDPlayer player;
+	LEDStep step;
 
 	int16_t api_indication;
 	uint16_t api_duration;
 	uint32_t api_start;
 
-	uint8_t api_ack_counter;
-	uint8_t api_ack_index;
-	uint32_t api_ack_time;
-
-	uint8_t api_nack_counter;
-	uint8_t api_nack_index;
-	uint32_t api_nack_time;
-
-	uint8_t api_nag_counter;
-	uint8_t api_nag_index;
-	uint32_t api_nag_time;
-	bool currently_in_wait_state;
+	LEDPattern custom_patterns[LED_PATTERN_CUSTOM_NUM];
 } LED;
 
-extern LED led;
-
-void led_set_on(const bool force);
-void led_set_off(void);
+void led_set_on(void);
+void led_set_key_switch_off(const bool off);
 void led_set_breathing(void);
+void led_clear_breathing(void);
 void led_set_blinking(const uint8_t num);
+void led_clear_blinking(void);
+uint8_t led_get_top_layer(void);
+bool led_is_api_indication_valid(const int16_t indication);
+void led_set_api_indication(const int16_t indication, const uint16_t duration);
+void led_clear_api_indication(void);
+bool led_set_custom_pattern(const uint8_t pattern, const LEDKeyframe *keyframes, const uint8_t length);
+void led_step(void);
 void led_init(void);
 void led_tick(void);
 
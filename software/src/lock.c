@@ -30,104 +30,256 @@
 #include "bricklib2/utility/util_definitions.h"
 #include "configs/config_evse.h"
 #include "evse.h"
-
-Lock lock;
+#include "profiler.h"
+#include "scheduler.h"
+#include "context.h"
 
 LockState lock_get_state(void) {
-	return lock.state;
+	return EVSE_CTX(lock).state;
+}
+
+bool lock_is_moving(void) {
+	return (EVSE_CTX(lock).state == LOCK_STATE_CLOSING) || (EVSE_CTX(lock).state == LOCK_STATE_OPENING);
+}
+
+static void lock_motor_start(const uint8_t direction) {
+	if(direction == LOCK_DIRECTION_CLOSE) {
+		XMC_GPIO_SetOutputHigh(EVSE_MOTOR_PHASE_PIN);
+	} else {
+		XMC_GPIO_SetOutputLow(EVSE_MOTOR_PHASE_PIN);
+	}
+
+	EVSE_CTX(lock).lock_start             = system_timer_get_ms();
+	EVSE_CTX(lock).last_input_switch_seen = 0;
+
+	__disable_irq();
+	EVSE_CTX(lock).duty_cycle    = LOCK_DUTY_CYCLE_START;
+	EVSE_CTX(lock).motor_running = true;
+	ccu4_pwm_set_duty_cycle(EVSE_MOTOR_ENABLE_SLICE_NUMBER, EVSE_CTX(lock).duty_cycle);
+	__enable_irq();
+}
+
+static void lock_motor_stop(void) {
+	__disable_irq();
+	EVSE_CTX(lock).motor_running = false;
+	EVSE_CTX(lock).duty_cycle    = LOCK_DUTY_CYCLE_OFF;
+	ccu4_pwm_set_duty_cycle(EVSE_MOTOR_ENABLE_SLICE_NUMBER, EVSE_CTX(lock).duty_cycle);
+	__enable_irq();
+}
+
+// The lock switch only reports the closed position, so opening always runs like a lock without switch
+static bool lock_has_switch(const uint8_t direction) {
+	return EVSE_CTX(evse).has_lock_switch && (direction == LOCK_DIRECTION_CLOSE);
+}
+
+// With a lock switch a timeout only leads to a retry, so the learned travel time can be used.
+// Without a switch the end position is assumed after the timeout, this stays at the blind 2s.
+static uint32_t lock_get_timeout(const uint8_t direction) {
+	if(!lock_has_switch(direction) || (EVSE_CTX(lock).travel_time[direction] == 0)) {
+		return LOCK_TRAVEL_TIME_DEFAULT;
+	}
+
+	return (uint32_t)EVSE_CTX(lock).travel_time[direction]*3/2 + LOCK_TRAVEL_TIME_MARGIN;
+}
+
+// Without a switch a stall is taken as the end stop, unless it comes much too early.
+// Opening has no learned travel time check, the lock may already be (partly) open after a reboot or jam.
+static bool lock_is_end_stop(const uint8_t direction, const uint32_t travel_time) {
+	if(travel_time < LOCK_TRAVEL_TIME_MIN) {
+		return false;
+	}
+
+	if(direction == LOCK_DIRECTION_OPEN) {
+		return true;
+	}
+
+	return !EVSE_CTX(lock).from_end_position || (travel_time >= EVSE_CTX(lock).travel_time[direction]/2U);
+}
+
+// travel_time = 0: End position assumed after the timeout
+static void lock_done(const uint8_t direction, const uint32_t travel_time) {
+	lock_motor_stop();
+	EVSE_CTX(lock).state     = (direction == LOCK_DIRECTION_CLOSE) ? LOCK_STATE_CLOSE : LOCK_STATE_OPEN;
+	EVSE_CTX(lock).retry_num = 0;
+
+	LockStatistics *statistics = &EVSE_CTX(lock).statistics[direction];
+	statistics->cycles++;
+	statistics->last_travel_time = (uint16_t)MIN(travel_time, UINT16_MAX);
+
+	// Nothing to learn after a timeout or if the travel did not start at the other end position
+	if(!EVSE_CTX(lock).from_end_position || (travel_time < LOCK_TRAVEL_TIME_MIN)) {
+		return;
+	}
+
+	if(EVSE_CTX(lock).travel_time[direction] == 0) {
+		EVSE_CTX(lock).travel_time[direction] = statistics->last_travel_time;
+	} else {
+		const int32_t diff = (int32_t)statistics->last_travel_time - EVSE_CTX(lock).travel_time[direction];
+		EVSE_CTX(lock).travel_time[direction] = (uint16_t)(EVSE_CTX(lock).travel_time[direction] + diff/(1 << LOCK_TRAVEL_TIME_FILTER_SHIFT));
+	}
+}
+
+static void lock_retry(const uint8_t direction) {
+	lock_motor_stop();
+
+	EVSE_CTX(lock).retry_num++;
+	if(EVSE_CTX(lock).retry_num > LOCK_RETRY_NUM) {
+		EVSE_CTX(lock).state      = LOCK_STATE_ERROR;
+		EVSE_CTX(lock).error_time = system_timer_get_ms();
+		EVSE_CTX(lock).retry_num  = 0;
+		EVSE_CTX(lock).statistics[direction].errors++;
+		return;
+	}
+
+	EVSE_CTX(lock).statistics[direction].retries++;
+	EVSE_CTX(lock).retry_pause_start = system_timer_get_ms();
+	EVSE_CTX(lock).from_end_position = false;
 }
 
 void lock_set_locked(const bool locked) {
 	if(locked) {
-		if(lock.state == LOCK_STATE_CLOSING) {
+		if((EVSE_CTX(lock).state == LOCK_STATE_CLOSING) || (EVSE_CTX(lock).state == LOCK_STATE_CLOSE)) {
 			return;
 		}
 
-		lock.state = LOCK_STATE_CLOSING;
-		XMC_GPIO_SetOutputHigh(EVSE_MOTOR_PHASE_PIN);
+		// A lock that failed is not tried again in every tick, opening is always allowed
+		if((EVSE_CTX(lock).state == LOCK_STATE_ERROR) && !system_timer_is_time_elapsed_ms(EVSE_CTX(lock).error_time, LOCK_ERROR_HOLDOFF)) {
+			return;
+		}
+
+		EVSE_CTX(lock).from_end_position = (EVSE_CTX(lock).state == LOCK_STATE_OPEN);
+		EVSE_CTX(lock).state             = LOCK_STATE_CLOSING;
+		EVSE_CTX(lock).retry_num         = 0;
+		lock_motor_start(LOCK_DIRECTION_CLOSE);
+		scheduler_trigger(SCHEDULER_TASK_LOCK);
 	} else {
-		if(lock.state == LOCK_STATE_OPENING) {
+		if((EVSE_CTX(lock).state == LOCK_STATE_OPENING) || (EVSE_CTX(lock).state == LOCK_STATE_OPEN)) {
 			return;
 		}
 
-		lock.state = LOCK_STATE_OPENING;
-		XMC_GPIO_SetOutputLow(EVSE_MOTOR_PHASE_PIN);
+		EVSE_CTX(lock).from_end_position = (EVSE_CTX(lock).state == LOCK_STATE_CLOSE);
+		EVSE_CTX(lock).state             = LOCK_STATE_OPENING;
+		EVSE_CTX(lock).retry_num         = 0;
+		lock_motor_start(LOCK_DIRECTION_OPEN);
+		scheduler_trigger(SCHEDULER_TASK_LOCK);
 	}
-
-	lock.duty_cycle = 3200;
-	ccu4_pwm_set_duty_cycle(EVSE_MOTOR_ENABLE_SLICE_NUMBER, lock.duty_cycle);
 }
 
 void lock_init(void) {
-	memset(&lock, 0, sizeof(Lock));
+	memset(&EVSE_CTX(lock), 0, sizeof(Lock));
+	EVSE_CTX(lock).duty_cycle = LOCK_DUTY_CYCLE_OFF;
+
+	// The lock tick has nothing to do until the lock is moved (and it is not compiled in without LOCK_ENABLE)
+	scheduler_clear_deadline(SCHEDULER_TASK_LOCK);
+
+#ifdef LOCK_ENABLE
+	const XMC_GPIO_CONFIG_t pin_config_fault = {
+		.mode             = XMC_GPIO_MODE_INPUT_PULL_UP,
+		.input_hysteresis = XMC_GPIO_INPUT_HYSTERESIS_STANDARD
+	};
+
+	XMC_GPIO_Init(EVSE_MOTOR_FAULT_PIN, &pin_config_fault);
+#endif
 }
 
-void lock_tick(void) {
-	if((lock.state == LOCK_STATE_CLOSING) || (lock.state == LOCK_STATE_OPENING)) {
-		if(lock.state == LOCK_STATE_CLOSING) {
-			XMC_GPIO_SetOutputHigh(EVSE_MOTOR_PHASE_PIN);
+// Called every ms by the step timer interrupt.
+// This creates a PWM run-up to reduce the inrush current of the lock motor.
+void lock_step(void) {
+	if(!EVSE_CTX(lock).motor_running) {
+		return;
+	}
+
+	// duty_cycle is the shadow of the motor PWM, at full power there is nothing left to write
+	if(EVSE_CTX(lock).duty_cycle == 0) {
+		PROFILER_ACCESS_SAVED();
+		return;
+	}
+
+	EVSE_CTX(lock).duty_cycle -= MIN(LOCK_DUTY_CYCLE_STEP, EVSE_CTX(lock).duty_cycle);
+	ccu4_pwm_set_duty_cycle(EVSE_MOTOR_ENABLE_SLICE_NUMBER, EVSE_CTX(lock).duty_cycle);
+}
+
+// The end position is detected by the lock switch (if there is one) or by the stall at
+// the end stop (the motor driver reports the overcurrent on the fault pin). Without
+// both the lock is assumed to be at the end position after the timeout.
+static void lock_tick_moving(void) {
+	const uint8_t direction = (EVSE_CTX(lock).state == LOCK_STATE_CLOSING) ? LOCK_DIRECTION_CLOSE : LOCK_DIRECTION_OPEN;
+
+	if(!EVSE_CTX(lock).motor_running) {
+		if(system_timer_is_time_elapsed_ms(EVSE_CTX(lock).retry_pause_start, LOCK_RETRY_PAUSE)) {
+			lock_motor_start(direction);
+		}
+		return;
+	}
+
+	const uint32_t travel_time = system_timer_get_ms() - EVSE_CTX(lock).lock_start;
+	const bool has_switch      = lock_has_switch(direction);
+
+	if(has_switch) {
+		// The switch input is low in the closed position
+		if(!XMC_GPIO_GetInput(EVSE_MOTOR_INPUT_SWITCH_PIN)) {
+			if(EVSE_CTX(lock).last_input_switch_seen == 0) {
+				EVSE_CTX(lock).last_input_switch_seen = system_timer_get_ms();
+			}
+
+			if(system_timer_is_time_elapsed_ms(EVSE_CTX(lock).last_input_switch_seen, LOCK_SWITCH_CONFIRM_TIME)) {
+				lock_done(direction, EVSE_CTX(lock).last_input_switch_seen - EVSE_CTX(lock).lock_start);
+				return;
+			}
 		} else {
-			XMC_GPIO_SetOutputLow(EVSE_MOTOR_PHASE_PIN);
+			EVSE_CTX(lock).last_input_switch_seen = 0;
 		}
+	}
+
+	// A lock that is already open stalls right away when opening, during the run-up this can
+	// not be told apart from a jam. The fault pin is only evaluated once the motor is at full power.
+	const bool fault_ignored = (direction == LOCK_DIRECTION_OPEN) && (EVSE_CTX(lock).duty_cycle != 0);
 
-		// This creates about 1 second of slow PWM run-up to reduce power draw from lock motor
-		if(system_timer_is_time_elapsed_ms(lock.last_duty_cycle_update, 1)) {
-			lock.last_duty_cycle_update = system_timer_get_ms();
-			lock.duty_cycle -= MIN(5, lock.duty_cycle);
+	if(!fault_ignored && !XMC_GPIO_GetInput(EVSE_MOTOR_FAULT_PIN)) {
+		if(has_switch && (EVSE_CTX(lock).last_input_switch_seen != 0)) {
+			// Stall at the end stop while the switch confirmation is still running
+			lock_done(direction, EVSE_CTX(lock).last_input_switch_seen - EVSE_CTX(lock).lock_start);
+		} else if(!has_switch && lock_is_end_stop(direction, travel_time)) {
+			lock_done(direction, travel_time);
+		} else {
+			EVSE_CTX(lock).statistics[direction].stalls++;
+			lock_retry(direction);
 		}
+		return;
+	}
 
-		if(evse.has_lock_switch) {
-			if(!XMC_GPIO_GetInput(EVSE_MOTOR_INPUT_SWITCH_PIN)) {
-				if(lock.state == LOCK_STATE_CLOSING) {
-					if(lock.last_input_switch_seen == 0) {
-						lock.last_input_switch_seen = system_timer_get_ms();
-					}
-
-					if((lock.last_input_switch_seen != 0) && system_timer_is_time_elapsed_ms(lock.last_input_switch_seen, 500)) {
-						lock.state = LOCK_STATE_CLOSE;
-						lock.last_input_switch_seen = 0;
-						lock.lock_start = 0;
-						lock.duty_cycle = 6400;
-					}
-				}
-			} else {
-				if(lock.state == LOCK_STATE_OPENING) {
-					if(lock.last_input_switch_seen == 0) {
-						lock.last_input_switch_seen = system_timer_get_ms();
-					}
-
-					if((lock.last_input_switch_seen != 0) && system_timer_is_time_elapsed_ms(lock.last_input_switch_seen, 500)) {
-						lock.state = LOCK_STATE_OPEN;
-						lock.last_input_switch_seen = 0;
-						lock.lock_start = 0;
-						lock.duty_cycle = 6400;
-					}
-				}
-			}
+	if(travel_time >= lock_get_timeout(direction)) {
+		if(has_switch) {
+			EVSE_CTX(lock).statistics[direction].timeouts++;
+			lock_retry(direction);
 		} else {
-			if(lock.lock_start == 0) {
-				lock.lock_start = system_timer_get_ms();
-			}
-			if(lock.state == LOCK_STATE_CLOSING) {
-				if(system_timer_is_time_elapsed_ms(lock.lock_start, 2000)) {
-					lock.state = LOCK_STATE_CLOSE;
-					lock.lock_start = 0;
-					lock.last_input_switch_seen = 0;
-					lock.duty_cycle = 6400;
-				}
-			} else if(lock.state == LOCK_STATE_OPENING) {
-				if(system_timer_is_time_elapsed_ms(lock.lock_start, 2000)) {
-					lock.state = LOCK_STATE_OPEN;
-					lock.lock_start = 0;
-					lock.last_input_switch_seen = 0;
-					lock.duty_cycle = 6400;
-				}
-			}
+			lock_done(direction, 0);
 		}
+	}
+}
 
-		ccu4_pwm_set_duty_cycle(EVSE_MOTOR_ENABLE_SLICE_NUMBER, lock.duty_cycle);
-	} else {
-		lock.duty_cycle = 6400;
-		ccu4_pwm_set_duty_cycle(EVSE_MOTOR_ENABLE_SLICE_NUMBER, lock.duty_cycle);
+// Runs in every main loop iteration while the lock is moving (the deadline stays due)
+// and once after it stopped, triggered by lock_set_locked. A pending save is retried.
+void lock_tick(void) {
+	if(lock_is_moving()) {
+		lock_tick_moving();
+		return;
+	}
+
+	scheduler_clear_deadline(SCHEDULER_TASK_LOCK);
+
+	// The learned travel times are only written to the EEPROM if they moved
+	// noticeably, the lock may move a few times per charging session.
+	// The write of the config page blocks the main loop, so it waits until
+	// the EVSE is idle (usually right after the lock opened in state A).
+	for(uint8_t direction = 0; direction < LOCK_DIRECTION_NUM; direction++) {
+		if(ABS((int32_t)EVSE_CTX(lock).travel_time[direction] - EVSE_CTX(lock).travel_time_saved[direction]) > LOCK_TRAVEL_TIME_SAVE_DIFF) {
+			if(evse_is_idle()) {
+				evse_save_config();
+			} else {
+				scheduler_set_deadline_in(SCHEDULER_TASK_LOCK, LOCK_TRAVEL_TIME_SAVE_RETRY);
+			}
+			break;
+		}
 	}
-}
\ No newline at end of file
+}
@@ -25,6 +25,30 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "configs/config_lock.h"
+
+// Motor enable PWM (period EVSE_MOTOR_PWM_PERIOD, a lower compare value drives the motor
+// harder). While closing/opening the duty cycle runs up from START by STEP every ms
+// (see lock_step), from 60% to full power in about 200ms.
+#define LOCK_DUTY_CYCLE_OFF   6400
+#define LOCK_DUTY_CYCLE_START 2560
+#define LOCK_DUTY_CYCLE_STEP  13
+
+#define LOCK_SWITCH_CONFIRM_TIME      100   // ms the lock switch has to show the end position
+#define LOCK_TRAVEL_TIME_MIN          100   // ms, a stall before this is a jam and not the end stop
+#define LOCK_TRAVEL_TIME_DEFAULT      2000  // ms, timeout as long as no travel time is learned
+#define LOCK_TRAVEL_TIME_MARGIN       250   // ms, timeout is 3/2 of the learned travel time plus margin
+#define LOCK_TRAVEL_TIME_FILTER_SHIFT 2     // Exponential average of the learned travel times
+#define LOCK_TRAVEL_TIME_SAVE_DIFF    100   // ms, learned travel times are saved if they moved more than this
+#define LOCK_TRAVEL_TIME_SAVE_RETRY   1000  // ms between two checks if the EVSE is idle for the save
+#define LOCK_RETRY_NUM                3     // Retries after a stall or timeout before the lock goes to error
+#define LOCK_RETRY_PAUSE              200   // ms motor off before a retry
+#define LOCK_ERROR_HOLDOFF            10000 // ms after an error before closing is tried again (opening is always allowed)
+
+#define LOCK_DIRECTION_OPEN  0
+#define LOCK_DIRECTION_CLOSE 1
+#define LOCK_DIRECTION_NUM   2
+
 typedef enum {
 	LOCK_STATE_INIT,
 	LOCK_STATE_OPEN,
@@ -35,21 +59,40 @@ typedef enum {
 } LockState;
 
 typedef struct {
-	uint32_t last_duty_cycle_update;
+	uint32_t cycles;           // Travels that reached the end position
+	uint16_t retries;
+	uint16_t stalls;           // Motor driver fault (stall) before the end position
+	uint16_t timeouts;         // End position not seen by the lock switch in time
+	uint16_t errors;           // Travels that failed after all retries
+	uint16_t last_travel_time; // ms, 0 = end position was not detected (no switch, no stall)
+} LockStatistics;
+
+typedef struct {
 	uint16_t duty_cycle;
+	bool motor_running;             // lock_step only runs the PWM up while the motor runs
 
 	uint32_t last_input_switch_seen;
-	uint32_t lock_start;
+	uint32_t lock_start;            // Start of the motor (also after a retry)
+	uint32_t retry_pause_start;
+	uint32_t error_time;
+	uint8_t retry_num;
+	bool from_end_position;         // Travel started at the other end position, only then the travel time is learned
+
+	// Learned per unit and direction (0 = not learned yet), saved in the EVSE config
+	uint16_t travel_time[LOCK_DIRECTION_NUM];
+	uint16_t travel_time_saved[LOCK_DIRECTION_NUM];
+
+	LockStatistics statistics[LOCK_DIRECTION_NUM];
 
 	LockState state;
 } Lock;
 
-extern Lock lock;
-
 LockState lock_get_state(void);
+bool lock_is_moving(void);
 void lock_set_locked(const bool locked);
 
+void lock_step(void);
 void lock_init(void);
 void lock_tick(void);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,103 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * logring.c: Binary log records in RAM ring buffer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "logring.h"
+
+#include <string.h>
+
+#include "bricklib2/hal/system_timer/system_timer.h"
+#include "context.h"
+
+#if defined(LOGRING_ENABLE) && (LOGGING_LEVEL == LOGGING_NONE)
+
+static uint16_t logring_get_used(void) {
+	if(EVSE_CTX(logring).end >= EVSE_CTX(logring).start) {
+		return EVSE_CTX(logring).end - EVSE_CTX(logring).start;
+	}
+
+	return LOGRING_SIZE - EVSE_CTX(logring).start + EVSE_CTX(logring).end;
+}
+
+static void logring_put(const uint8_t *data, const uint8_t length) {
+	for(uint8_t i = 0; i < length; i++) {
+		EVSE_CTX(logring).buffer[EVSE_CTX(logring).end] = data[i];
+		EVSE_CTX(logring).end = (EVSE_CTX(logring).end + 1) % LOGRING_SIZE;
+	}
+}
+
+static uint8_t logring_get_record_length(const uint16_t start) {
+	const uint8_t argc = EVSE_CTX(logring).buffer[(start + 6) % LOGRING_SIZE] & 0xF;
+	return LOGRING_HEADER_SIZE + argc*sizeof(uint32_t);
+}
+
+// If a record doesn't fit, the oldest records are overwritten
+// (whole records, the dropped count says how many are lost).
+void logring_write(const uint16_t id, const uint8_t level, const uint8_t argc, const uint32_t *argv) {
+	const uint8_t length = LOGRING_HEADER_SIZE + argc*sizeof(uint32_t);
+	while(logring_get_used() + length >= LOGRING_SIZE) {
+		EVSE_CTX(logring).start = (EVSE_CTX(logring).start + logring_get_record_length(EVSE_CTX(logring).start)) % LOGRING_SIZE;
+		EVSE_CTX(logring).dropped++;
+	}
+
+	uint8_t header[LOGRING_HEADER_SIZE];
+	const uint32_t time = system_timer_get_ms();
+	memcpy(&header[0], &time, sizeof(uint32_t));
+	memcpy(&header[4], &id, sizeof(uint16_t));
+	header[6] = (level << 4) | argc;
+
+	logring_put(header, LOGRING_HEADER_SIZE);
+	logring_put((const uint8_t*)argv, argc*sizeof(uint32_t));
+}
+
+// Reads as many complete records as fit into data, returns the number of bytes
+uint8_t logring_read(uint8_t *data, const uint8_t length) {
+	uint8_t read = 0;
+	while(EVSE_CTX(logring).start != EVSE_CTX(logring).end) {
+		const uint8_t record_length = logring_get_record_length(EVSE_CTX(logring).start);
+		if(read + record_length > length) {
+			break;
+		}
+
+		for(uint8_t i = 0; i < record_length; i++) {
+			data[read++]            = EVSE_CTX(logring).buffer[EVSE_CTX(logring).start];
+			EVSE_CTX(logring).start = (EVSE_CTX(logring).start + 1) % LOGRING_SIZE;
+		}
+	}
+
+	return read;
+}
+
+uint16_t logring_get_dropped(void) {
+	return EVSE_CTX(logring).dropped;
+}
+
+void logring_init(void) {
+	memset(&EVSE_CTX(logring), 0, sizeof(LogRing));
+}
+
+#else
+
+void logring_write(const uint16_t id, const uint8_t level, const uint8_t argc, const uint32_t *argv) {}
+uint8_t logring_read(uint8_t *data, const uint8_t length) { return 0; }
+uint16_t logring_get_dropped(void) { return 0; }
+void logring_init(void) {}
+
+#endif
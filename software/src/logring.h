@@ -0,0 +1,110 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * logring.h: Binary log records in RAM ring buffer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef LOGRING_H
+#define LOGRING_H
+
+#include <stdint.h>
+
+#include "bricklib2/logging/logging.h"
+
+// A log record consists of
+// * uint32_t time in ms,
+// * uint16_t id (file id in upper 4 bit, line in lower 12 bit),
+// * uint8_t level (upper 4 bit) and argument count (lower 4 bit) and
+// * up to 8 uint32_t arguments.
+// The format string is not stored, tests/log_ring.py looks
+// it up in the source code by file id and line. So it has to
+// run on exactly the source the firmware was built from, it
+// warns if the firmware version of the Bricklet differs.
+
+#define LOGRING_FILE_MAIN          1
+#define LOGRING_FILE_COMMUNICATION 2
+#define LOGRING_FILE_EVSE          3
+#define LOGRING_FILE_ADS1118       4
+#define LOGRING_FILE_IEC61851      5
+#define LOGRING_FILE_LED           6
+#define LOGRING_FILE_LOCK          7
+#define LOGRING_FILE_BUTTON        8
+#define LOGRING_FILE_CHARGING_SLOT 9
+#define LOGRING_FILE_CALIBRATION   10
+
+#define LOGRING_LEVEL_DEBUG   0
+#define LOGRING_LEVEL_INFO    1
+#define LOGRING_LEVEL_WARNING 2
+#define LOGRING_LEVEL_ERROR   3
+
+#define LOGRING_HEADER_SIZE   7
+#define LOGRING_MAX_ARGS      8
+
+typedef struct {
+	uint8_t buffer[LOGRING_SIZE];
+	uint16_t start;
+	uint16_t end;
+	uint16_t dropped;
+} LogRing;
+
+void logring_write(const uint16_t id, const uint8_t level, const uint8_t argc, const uint32_t *argv);
+uint8_t logring_read(uint8_t *data, const uint8_t length);
+uint16_t logring_get_dropped(void);
+void logring_init(void);
+
+// Every source file that logs has to define LOGRING_FILE_ID before including this header
+#if defined(LOGRING_ENABLE) && (LOGGING_LEVEL == LOGGING_NONE)
+
+// The log calls write into the ring (instead of the UART)
+#define LOGRING_ACTIVE
+
+#define LOGRING_NARGS(...) LOGRING_NARGS_(0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define LOGRING_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, n, ...) n
+
+#define LOGRING_CAT(a, b) LOGRING_CAT_(a, b)
+#define LOGRING_CAT_(a, b) a ## b
+
+#define LOGRING_ARGS_0()
+#define LOGRING_ARGS_1(a)      , (uint32_t)(a)
+#define LOGRING_ARGS_2(a, ...) , (uint32_t)(a) LOGRING_ARGS_1(__VA_ARGS__)
+#define LOGRING_ARGS_3(a, ...) , (uint32_t)(a) LOGRING_ARGS_2(__VA_ARGS__)
+#define LOGRING_ARGS_4(a, ...) , (uint32_t)(a) LOGRING_ARGS_3(__VA_ARGS__)
+#define LOGRING_ARGS_5(a, ...) , (uint32_t)(a) LOGRING_ARGS_4(__VA_ARGS__)
+#define LOGRING_ARGS_6(a, ...) , (uint32_t)(a) LOGRING_ARGS_5(__VA_ARGS__)
+#define LOGRING_ARGS_7(a, ...) , (uint32_t)(a) LOGRING_ARGS_6(__VA_ARGS__)
+#define LOGRING_ARGS_8(a, ...) , (uint32_t)(a) LOGRING_ARGS_7(__VA_ARGS__)
+
+#define LOGRING_LOG(level, ...) \
+	do { \
+		const uint32_t logring_argv[] = {0 LOGRING_CAT(LOGRING_ARGS_, LOGRING_NARGS(__VA_ARGS__))(__VA_ARGS__)}; \
+		logring_write((LOGRING_FILE_ID << 12) | (__LINE__ & 0xFFF), level, LOGRING_NARGS(__VA_ARGS__), &logring_argv[1]); \
+	} while(0)
+
+#undef logd
+#undef logi
+#undef logw
+#undef loge
+
+#define logd(str, ...) LOGRING_LOG(LOGRING_LEVEL_DEBUG,   ##__VA_ARGS__)
+#define logi(str, ...) LOGRING_LOG(LOGRING_LEVEL_INFO,    ##__VA_ARGS__)
+#define logw(str, ...) LOGRING_LOG(LOGRING_LEVEL_WARNING, ##__VA_ARGS__)
+#define loge(str, ...) LOGRING_LOG(LOGRING_LEVEL_ERROR,   ##__VA_ARGS__)
+
+#endif
+
+#endif
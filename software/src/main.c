@@ -19,6 +19,8 @@
  * Boston, MA 02111-1307, USA.
  */
 
+#define LOGRING_FILE_ID LOGRING_FILE_MAIN
+
 #include <stdio.h>
 #include <stdbool.h>
 
@@ -27,6 +29,7 @@
 #include "bricklib2/bootloader/bootloader.h"
 #include "bricklib2/hal/system_timer/system_timer.h"
 #include "bricklib2/logging/logging.h"
+#include "logring.h"
 #include "bricklib2/warp/contactor_check.h"
 #include "communication.h"
 
@@ -36,31 +39,75 @@
 #include "lock.h"
 #include "led.h"
 #include "button.h"
+#include "step_timer.h"
 #include "charging_slot.h"
+#include "recorder.h"
+#include "journal.h"
+#include "derating.h"
+#include "profiler.h"
+#include "scheduler.h"
+#include "memory_usage.h"
+#include "context.h"
 
 int main(void) {
+	memory_usage_paint_main_stack();
 	logging_init();
+	logring_init();
 	logd("Start EVSE Bricklet\n\r");
 
+	scheduler_init();
 	communication_init();
+	recorder_init(); // before evse_init, the recorder configuration is part of the EVSE config
+	lock_init(); // before evse_init, the learned lock travel times are part of the EVSE config
+	derating_init(); // before evse_init, the derating configuration is part of the EVSE config
 	evse_init();
+	journal_init(); // after evse_init, the boot record contains the warm start flag
+	journal_add(JOURNAL_EVENT_BOOT, EVSE_CTX(evse).warm_start, (FIRMWARE_VERSION_MAJOR << 16) | (FIRMWARE_VERSION_MINOR << 8) | FIRMWARE_VERSION_REVISION);
 	charging_slot_init();
 	ads1118_init();
 	iec61851_init();
-	lock_init();
 	contactor_check_init();
 	led_init();
 	button_init();
+	step_timer_init(); // after led_init, lock_init and button_init, the interrupt steps all three
+#ifdef PROFILER_ENABLE
+	profiler_init();
+#endif
 
 	while(true) {
-		bootloader_tick();
-		communication_tick();
-		evse_tick();
-		ads1118_tick();
-//		lock_tick();
-		contactor_check_tick();
-		led_tick();
-		button_tick();
-		charging_slot_tick();
+		PROFILER_LOOP_START();
+		PROFILER_TICK(PROFILER_MODULE_BOOTLOADER,      bootloader_tick());
+		PROFILER_TICK(PROFILER_MODULE_COMMUNICATION,   communication_tick());
+		PROFILER_TICK(PROFILER_MODULE_EVSE,            evse_tick());
+		if(scheduler_is_due(SCHEDULER_TASK_ADS1118)) {
+			PROFILER_TICK(PROFILER_MODULE_ADS1118,     ads1118_tick());
+		}
+#ifdef LOCK_ENABLE
+		if(scheduler_is_due(SCHEDULER_TASK_LOCK)) {
+			PROFILER_TICK(PROFILER_MODULE_LOCK,        lock_tick());
+		}
+#endif
+		// bricklib2 times the contactor check itself
+		PROFILER_TICK(PROFILER_MODULE_CONTACTOR_CHECK, contactor_check_tick());
+		if(scheduler_is_due(SCHEDULER_TASK_LED)) {
+			PROFILER_TICK(PROFILER_MODULE_LED,         led_tick());
+		}
+		if(scheduler_is_due(SCHEDULER_TASK_BUTTON)) {
+			PROFILER_TICK(PROFILER_MODULE_BUTTON,      button_tick());
+		}
+		if(scheduler_is_due(SCHEDULER_TASK_CHARGING_SLOT)) {
+			PROFILER_TICK(PROFILER_MODULE_CHARGING_SLOT, charging_slot_tick());
+		}
+		if(scheduler_is_due(SCHEDULER_TASK_DERATING)) {
+			PROFILER_TICK(PROFILER_MODULE_DERATING,    derating_tick());
+		}
+		if(scheduler_is_due(SCHEDULER_TASK_JOURNAL)) {
+			PROFILER_TICK(PROFILER_MODULE_JOURNAL,     journal_tick());
+		}
+
+		// In idle state we sleep until the next interrupt if no deadline is due
+		if(evse_is_idle()) {
+			scheduler_sleep();
+		}
 	}
 }
@@ -0,0 +1,62 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * memory_usage.c: Stack high-water marks and static RAM usage
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "memory_usage.h"
+
+#include "configs/config.h"
+
+// Main stack boundaries from linker script
+extern uint32_t __stack_start;
+extern uint32_t __stack_end;
+
+// Fills the unused part of the main stack with the paint pattern.
+// Has to be called as early as possible in main.
+void memory_usage_paint_main_stack(void) {
+	// Leave some room for the stack frame of this function
+	uint32_t *end = (uint32_t*)(__get_MSP() - 32);
+
+	memory_usage_paint(&__stack_start, (uint32_t)(end - &__stack_start));
+}
+
+void memory_usage_paint(uint32_t *start, const uint32_t length) {
+	for(uint32_t i = 0; i < length; i++) {
+		start[i] = MEMORY_USAGE_STACK_PAINT;
+	}
+}
+
+// Stacks grow downwards, the used part ends at the
+// first word (from the bottom) that was overwritten.
+uint32_t memory_usage_get_stack_used(const uint32_t *start, const uint32_t length) {
+	uint32_t unused = 0;
+	while((unused < length) && (start[unused] == MEMORY_USAGE_STACK_PAINT)) {
+		unused++;
+	}
+
+	return (length - unused)*sizeof(uint32_t);
+}
+
+uint32_t memory_usage_get_main_stack_size(void) {
+	return (uint32_t)(&__stack_end - &__stack_start)*sizeof(uint32_t);
+}
+
+uint32_t memory_usage_get_main_stack_used(void) {
+	return memory_usage_get_stack_used(&__stack_start, (uint32_t)(&__stack_end - &__stack_start));
+}
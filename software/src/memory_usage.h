@@ -0,0 +1,35 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * memory_usage.h: Stack high-water marks and static RAM usage
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef MEMORY_USAGE_H
+#define MEMORY_USAGE_H
+
+#include <stdint.h>
+
+#define MEMORY_USAGE_STACK_PAINT 0xA5A5A5A5
+
+void memory_usage_paint_main_stack(void);
+void memory_usage_paint(uint32_t *start, const uint32_t length);
+uint32_t memory_usage_get_stack_used(const uint32_t *start, const uint32_t length);
+uint32_t memory_usage_get_main_stack_size(void);
+uint32_t memory_usage_get_main_stack_used(void);
+
+#endif
@@ -0,0 +1,92 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * profiler.c: Main loop and tick function profiler
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "profiler.h"
+
+#ifdef PROFILER_ENABLE
+
+#include <string.h>
+
+#include "configs/config.h"
+#include "bricklib2/hal/system_timer/system_timer.h"
+
+Profiler profiler;
+
+// Cycle counter based on the 1ms system timer and the SysTick down-counter.
+// Overflows after ~89s with 48MHz, so only use it for differences.
+uint32_t profiler_get_cycles(void) {
+	uint32_t ms;
+	uint32_t val;
+	do {
+		ms  = system_timer_get_ms();
+		val = SysTick->VAL;
+	} while(ms != system_timer_get_ms());
+
+	const uint32_t period = SysTick->LOAD + 1;
+	return ms*period + (period - 1 - val);
+}
+
+void profiler_add(const uint8_t module, const uint32_t start) {
+	const uint32_t cycles = profiler_get_cycles() - start;
+	ProfilerModule *m = &profiler.module[module];
+
+	if((m->count == 0) || (cycles < m->min)) {
+		m->min = cycles;
+	}
+	if(cycles > m->max) {
+		m->max = cycles;
+	}
+	m->sum += cycles;
+	m->count++;
+}
+
+void profiler_loop_start(void) {
+	const uint32_t now = profiler_get_cycles();
+	if(profiler.loop_count != 0) {
+		const uint32_t gap = now - profiler.loop_last_start;
+		if(gap > profiler.loop_gap_max) {
+			profiler.loop_gap_max = gap;
+		}
+	}
+	profiler.loop_last_start = now;
+	profiler.loop_count++;
+	profiler.sample = (profiler.loop_count & (PROFILER_SAMPLE_INTERVAL-1)) == 0;
+
+	if(system_timer_is_time_elapsed_ms(profiler.loops_per_second_time, 1000)) {
+		profiler.loops_per_second       = profiler.loop_count - profiler.loops_per_second_count;
+		profiler.loops_per_second_count = profiler.loop_count;
+		profiler.loops_per_second_time  = system_timer_get_ms();
+
+		profiler.accesses_saved_per_second       = profiler.accesses_saved - profiler.accesses_saved_per_second_count;
+		profiler.accesses_saved_per_second_count = profiler.accesses_saved;
+	}
+}
+
+void profiler_reset(void) {
+	memset(&profiler, 0, sizeof(Profiler));
+	profiler.loops_per_second_time = system_timer_get_ms();
+}
+
+void profiler_init(void) {
+	profiler_reset();
+}
+
+#endif
@@ -0,0 +1,105 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * profiler.h: Main loop and tick function profiler
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "configs/config_profiler.h"
+
+#define PROFILER_MODULE_BOOTLOADER       0
+#define PROFILER_MODULE_COMMUNICATION    1
+#define PROFILER_MODULE_EVSE             2
+#define PROFILER_MODULE_ADS1118          3
+#define PROFILER_MODULE_CONTACTOR_CHECK  4
+#define PROFILER_MODULE_LED              5
+#define PROFILER_MODULE_BUTTON           6
+#define PROFILER_MODULE_CHARGING_SLOT    7
+#define PROFILER_MODULE_LOCK             8
+#define PROFILER_MODULE_JOURNAL          9
+#define PROFILER_MODULE_DERATING         10
+#define PROFILER_MODULE_NUM              11
+
+// All times are in CPU clock cycles
+typedef struct {
+	uint32_t min;
+	uint32_t max;
+	uint64_t sum;
+	uint32_t count;
+} ProfilerModule;
+
+typedef struct {
+	ProfilerModule module[PROFILER_MODULE_NUM];
+
+	bool sample;
+	uint32_t loop_count;
+	uint32_t loop_last_start;
+	uint32_t loop_gap_max;
+
+	uint32_t loops_per_second;
+	uint32_t loops_per_second_count;
+	uint32_t loops_per_second_time;
+
+	uint32_t coop_task_switches;
+
+	// Peripheral reads and writes that were served by or skipped because of a shadow value.
+	// Also counted in the step timer interrupt without locking, a count may get lost now and then.
+	uint32_t accesses_saved;
+	uint32_t accesses_saved_per_second;
+	uint32_t accesses_saved_per_second_count;
+} Profiler;
+
+#ifdef PROFILER_ENABLE
+
+extern Profiler profiler;
+
+#define PROFILER_LOOP_START() profiler_loop_start()
+#define PROFILER_COOP_TASK_SWITCH() profiler.coop_task_switches++
+#define PROFILER_ACCESS_SAVED() profiler.accesses_saved++
+#define PROFILER_TICK(module, tick) \
+	do { \
+		if(profiler.sample) { \
+			const uint32_t profiler_start = profiler_get_cycles(); \
+			tick; \
+			profiler_add(module, profiler_start); \
+		} else { \
+			tick; \
+		} \
+	} while(0)
+
+uint32_t profiler_get_cycles(void);
+void profiler_add(const uint8_t module, const uint32_t start);
+void profiler_loop_start(void);
+void profiler_reset(void);
+void profiler_init(void);
+
+#else
+
+#define PROFILER_LOOP_START()
+#define PROFILER_COOP_TASK_SWITCH()
+#define PROFILER_ACCESS_SAVED()
+#define PROFILER_TICK(module, tick) tick
+
+#endif
+
+#endif
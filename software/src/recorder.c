@@ -0,0 +1,166 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * recorder.c: Flight recorder for state machine inputs
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "recorder.h"
+
+#include <string.h>
+
+#include "configs/config_evse.h"
+#include "bricklib2/hal/system_timer/system_timer.h"
+#include "bricklib2/utility/util_definitions.h"
+#include "bricklib2/warp/contactor_check.h"
+
+#include "evse.h"
+#include "ads1118.h"
+#include "iec61851.h"
+#include "button.h"
+#include "charging_slot.h"
+#include "context.h"
+
+static void recorder_get_inputs(RecorderEntry *entry) {
+	entry->time                 = system_timer_get_ms();
+	entry->cp_pe_resistance     = MIN(EVSE_CTX(ads1118).cp_pe_resistance, 0xFFFF);
+	entry->pp_pe_resistance     = MIN(EVSE_CTX(ads1118).pp_pe_resistance, 0xFFFF);
+	entry->cp_duty_cycle        = evse_get_cp_duty_cycle();
+	entry->max_current          = charging_slot_get_max_current();
+	entry->flags                = (evse_is_relay_active()                       ? RECORDER_FLAG_RELAY              : 0) |
+	                              ((EVSE_CTX(ads1118).cp_invalid_counter > 0)             ? RECORDER_FLAG_CP_INVALID         : 0) |
+	                              ((EVSE_CTX(button).state == BUTTON_STATE_PRESSED)       ? RECORDER_FLAG_BUTTON_PRESSED     : 0) |
+	                              (EVSE_CTX(button).was_pressed                           ? RECORDER_FLAG_BUTTON_WAS_PRESSED : 0) |
+	                              (EVSE_CTX(evse).car_stopped_charging                    ? RECORDER_FLAG_CAR_STOPPED        : 0) |
+	                              ((EVSE_CTX(evse).calibration_state != 0)                ? RECORDER_FLAG_CALIBRATION        : 0);
+	entry->contactor            = (contactor_check.state & 0x3) | (contactor_check.error << 2);
+	entry->jumper_configuration = EVSE_CTX(evse).config_jumper_current;
+	entry->iec61851_state       = EVSE_CTX(iec61851).state;
+}
+
+static bool recorder_is_resistance_changed(const uint16_t value, const uint16_t last) {
+	return ABS((int32_t)value - (int32_t)last) > (last >> RECORDER_RESISTANCE_DEADBAND_SHIFT);
+}
+
+// The time is not compared, the resistances only with a deadband.
+// A resistance change that matters changes the IEC 61851 state too.
+static bool recorder_is_changed(const RecorderEntry *entry, const RecorderEntry *last) {
+	return recorder_is_resistance_changed(entry->cp_pe_resistance, last->cp_pe_resistance) ||
+	       recorder_is_resistance_changed(entry->pp_pe_resistance, last->pp_pe_resistance) ||
+	       (entry->cp_duty_cycle        != last->cp_duty_cycle)        ||
+	       (entry->max_current          != last->max_current)          ||
+	       (entry->flags                != last->flags)                ||
+	       (entry->contactor            != last->contactor)            ||
+	       (entry->jumper_configuration != last->jumper_configuration) ||
+	       (entry->iec61851_state       != last->iec61851_state);
+}
+
+static void recorder_add(const RecorderEntry *entry) {
+	EVSE_CTX(recorder).entries[EVSE_CTX(recorder).next] = *entry;
+	EVSE_CTX(recorder).next  = (EVSE_CTX(recorder).next + 1) % RECORDER_ENTRY_NUM;
+	EVSE_CTX(recorder).count = MIN(EVSE_CTX(recorder).count + 1, RECORDER_ENTRY_NUM);
+
+	// The recorder freezes after the entry that caused the
+	// trigger and the configured number of entries after it
+	if(EVSE_CTX(recorder).trigger != 0) {
+		if(EVSE_CTX(recorder).post_trigger_remaining == 0) {
+			EVSE_CTX(recorder).frozen = true;
+		} else {
+			EVSE_CTX(recorder).post_trigger_remaining--;
+		}
+	}
+}
+
+void recorder_trigger(const uint8_t trigger) {
+	// Only the first trigger counts until the recorder is rearmed
+	if(EVSE_CTX(recorder).trigger != 0) {
+		return;
+	}
+
+	EVSE_CTX(recorder).trigger                = trigger;
+	EVSE_CTX(recorder).trigger_time           = system_timer_get_ms();
+	EVSE_CTX(recorder).post_trigger_remaining = EVSE_CTX(recorder).post_trigger_entries;
+}
+
+void recorder_rearm(void) {
+	EVSE_CTX(recorder).next                   = 0;
+	EVSE_CTX(recorder).count                  = 0;
+	EVSE_CTX(recorder).trigger                = 0;
+	EVSE_CTX(recorder).trigger_time           = 0;
+	EVSE_CTX(recorder).post_trigger_remaining = 0;
+	EVSE_CTX(recorder).frozen                 = false;
+	memset(&EVSE_CTX(recorder).last, 0, sizeof(RecorderEntry));
+}
+
+// Copies the recorded entries in chronological order (oldest first),
+// starting at byte offset. Returns the total length of all entries.
+uint16_t recorder_read(const uint16_t offset, uint8_t *data, const uint16_t length) {
+	const uint16_t total = EVSE_CTX(recorder).count*sizeof(RecorderEntry);
+	const uint16_t first = (EVSE_CTX(recorder).next + RECORDER_ENTRY_NUM - EVSE_CTX(recorder).count) % RECORDER_ENTRY_NUM;
+
+	for(uint16_t i = 0; (i < length) && (offset + i < total); i++) {
+		const uint16_t index = (first + (offset + i)/sizeof(RecorderEntry)) % RECORDER_ENTRY_NUM;
+		data[i] = ((uint8_t*)&EVSE_CTX(recorder).entries[index])[(offset + i) % sizeof(RecorderEntry)];
+	}
+
+	return total;
+}
+
+void recorder_init(void) {
+	recorder_rearm();
+	EVSE_CTX(recorder).trigger_mask         = RECORDER_TRIGGER_DEFAULT;
+	EVSE_CTX(recorder).post_trigger_entries = RECORDER_POST_TRIGGER_ENTRIES_DEFAULT;
+}
+
+// Called after every state machine evaluation
+void recorder_tick(void) {
+	if(EVSE_CTX(recorder).frozen) {
+		return;
+	}
+
+	RecorderEntry entry;
+	recorder_get_inputs(&entry);
+
+	// Triggers are edge triggered, the conditions are compared to the last entry
+	if(EVSE_CTX(recorder).count > 0) {
+		uint8_t trigger = 0;
+		if((entry.iec61851_state == IEC61851_STATE_EF) && (EVSE_CTX(recorder).last.iec61851_state != IEC61851_STATE_EF)) {
+			trigger |= RECORDER_TRIGGER_STATE_EF;
+		}
+		if((entry.iec61851_state == IEC61851_STATE_D) && (EVSE_CTX(recorder).last.iec61851_state != IEC61851_STATE_D)) {
+			trigger |= RECORDER_TRIGGER_STATE_D;
+		}
+		if((entry.contactor >> 2) && !(EVSE_CTX(recorder).last.contactor >> 2)) {
+			trigger |= RECORDER_TRIGGER_CONTACTOR_ERROR;
+		}
+		if((entry.flags & RECORDER_FLAG_CAR_STOPPED) && !(EVSE_CTX(recorder).last.flags & RECORDER_FLAG_CAR_STOPPED)) {
+			trigger |= RECORDER_TRIGGER_CAR_STOPPED_CHARGING;
+		}
+
+		trigger &= EVSE_CTX(recorder).trigger_mask;
+		if(trigger != 0) {
+			recorder_trigger(trigger);
+		}
+	}
+
+	// Only record changes (and a heartbeat)
+	const bool changed = (EVSE_CTX(recorder).count == 0) || recorder_is_changed(&entry, &EVSE_CTX(recorder).last);
+	if(changed || system_timer_is_time_elapsed_ms(EVSE_CTX(recorder).last.time, RECORDER_HEARTBEAT_TIME)) {
+		recorder_add(&entry);
+		EVSE_CTX(recorder).last = entry;
+	}
+}
@@ -0,0 +1,88 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * recorder.h: Flight recorder for state machine inputs
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define RECORDER_ENTRY_NUM 128
+
+// A new entry is recorded if any input changes, but at least once per second
+#define RECORDER_HEARTBEAT_TIME 1000
+
+// The resistances are noisy, a change by less than 1/16 of the recorded value is not recorded
+#define RECORDER_RESISTANCE_DEADBAND_SHIFT 4
+
+#define RECORDER_TRIGGER_STATE_EF             (1 << 0)
+#define RECORDER_TRIGGER_CONTACTOR_ERROR      (1 << 1)
+#define RECORDER_TRIGGER_CAR_STOPPED_CHARGING (1 << 2)
+#define RECORDER_TRIGGER_STATE_D              (1 << 3)
+#define RECORDER_TRIGGER_MANUAL               (1 << 7)
+
+#define RECORDER_TRIGGER_DEFAULT (RECORDER_TRIGGER_STATE_EF | RECORDER_TRIGGER_CONTACTOR_ERROR | RECORDER_TRIGGER_CAR_STOPPED_CHARGING)
+#define RECORDER_POST_TRIGGER_ENTRIES_DEFAULT 16
+
+#define RECORDER_FLAG_RELAY               (1 << 0)
+#define RECORDER_FLAG_CP_INVALID          (1 << 1)
+#define RECORDER_FLAG_BUTTON_PRESSED      (1 << 2)
+#define RECORDER_FLAG_BUTTON_WAS_PRESSED  (1 << 3)
+#define RECORDER_FLAG_CAR_STOPPED         (1 << 4)
+#define RECORDER_FLAG_CALIBRATION         (1 << 5)
+
+// All inputs of iec61851_tick plus the resulting state.
+// Resistances are saturated at 0xFFFF Ohm (above all state thresholds).
+typedef struct {
+	uint32_t time;
+	uint16_t cp_pe_resistance;
+	uint16_t pp_pe_resistance;
+	uint16_t cp_duty_cycle;
+	uint16_t max_current;
+	uint8_t flags;
+	uint8_t contactor; // state in bit 0-1, error in bit 2-7
+	uint8_t jumper_configuration;
+	uint8_t iec61851_state;
+} __attribute__((__packed__)) RecorderEntry;
+
+typedef struct {
+	RecorderEntry entries[RECORDER_ENTRY_NUM];
+	uint16_t next;
+	uint16_t count;
+
+	uint8_t trigger_mask;
+	uint8_t post_trigger_entries;
+
+	uint8_t trigger;
+	uint32_t trigger_time;
+	uint8_t post_trigger_remaining;
+	bool frozen;
+
+	RecorderEntry last;
+} Recorder;
+
+void recorder_trigger(const uint8_t trigger);
+void recorder_rearm(void);
+uint16_t recorder_read(const uint16_t offset, uint8_t *data, const uint16_t length);
+void recorder_init(void);
+void recorder_tick(void);
+
+#endif
@@ -0,0 +1,75 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * scheduler.c: Deadline based scheduling of the main loop ticks
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "scheduler.h"
+
+#include "configs/config.h"
+#include "bricklib2/hal/system_timer/system_timer.h"
+#include "context.h"
+
+// Task will run in every main loop iteration from time on
+// until a new deadline is set or the deadline is cleared.
+void scheduler_set_deadline(const uint8_t task, const uint32_t time) {
+	EVSE_CTX(scheduler).deadline[task] = time;
+	EVSE_CTX(scheduler).active        |= (1U << task);
+}
+
+void scheduler_set_deadline_in(const uint8_t task, const uint32_t ms) {
+	scheduler_set_deadline(task, system_timer_get_ms() + ms);
+}
+
+// Task will not run until a new deadline is set or it is triggered
+void scheduler_clear_deadline(const uint8_t task) {
+	EVSE_CTX(scheduler).active &= ~(1U << task);
+}
+
+// Pending event, task will run in next main loop iteration
+void scheduler_trigger(const uint8_t task) {
+	scheduler_set_deadline(task, system_timer_get_ms());
+}
+
+bool scheduler_is_due(const uint8_t task) {
+	if(!(EVSE_CTX(scheduler).active & (1U << task))) {
+		return false;
+	}
+
+	return ((int32_t)(system_timer_get_ms() - EVSE_CTX(scheduler).deadline[task])) >= 0;
+}
+
+// Sleeps until the next interrupt if no task is due.
+// The 1ms SysTick interrupt wakes us up at the latest, which is the resolution
+// of all deadlines anyway. TFP communication (SPI interrupt) wakes us up immediately.
+void scheduler_sleep(void) {
+	for(uint8_t task = 0; task < SCHEDULER_TASK_NUM; task++) {
+		if(scheduler_is_due(task)) {
+			return;
+		}
+	}
+
+	__WFI();
+}
+
+void scheduler_init(void) {
+	// Run all tasks once, they set their own deadline afterwards
+	for(uint8_t task = 0; task < SCHEDULER_TASK_NUM; task++) {
+		scheduler_trigger(task);
+	}
+}
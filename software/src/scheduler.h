@@ -0,0 +1,52 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * scheduler.h: Deadline based scheduling of the main loop ticks
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Ticks that only run if their deadline is reached.
+// All other ticks run in every main loop iteration.
+#define SCHEDULER_TASK_ADS1118       0
+#define SCHEDULER_TASK_LED           1
+#define SCHEDULER_TASK_BUTTON        2
+#define SCHEDULER_TASK_LOCK          3
+#define SCHEDULER_TASK_CHARGING_SLOT 4
+#define SCHEDULER_TASK_DERATING      5
+#define SCHEDULER_TASK_JOURNAL       6
+#define SCHEDULER_TASK_NUM           7
+
+typedef struct {
+	uint32_t deadline[SCHEDULER_TASK_NUM];
+	uint32_t active; // Bitmask of tasks with a deadline
+} Scheduler;
+
+void scheduler_set_deadline(const uint8_t task, const uint32_t time);
+void scheduler_set_deadline_in(const uint8_t task, const uint32_t ms);
+void scheduler_clear_deadline(const uint8_t task);
+void scheduler_trigger(const uint8_t task);
+bool scheduler_is_due(const uint8_t task);
+void scheduler_sleep(void);
+void scheduler_init(void);
+
+#endif
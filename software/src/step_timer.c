@@ -0,0 +1,73 @@
+/* evse-bricklet
+ * Copyright (C) 2026 Olaf Lüke <olaf@tinkerforge.com>
+ *
+ * step_timer.c: 1ms timer interrupt for LED/lock PWM steps and button
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include "step_timer.h"
+#include "configs/config_step_timer.h"
+
+#include "bricklib2/hal/ccu4_pwm/ccu4_pwm.h"
+
+#include "led.h"
+#include "lock.h"
+#include "button.h"
+
+// The PWM animations (LED ramps, lock motor run-up) step in the period match interrupt
+// of a free CCU4 slice. The ticks in the main loop only decide what is stepped, so the
+// animations stay smooth while the main loop is busy (ADC task, flash writes).
+// The button is sampled and debounced here too, so no press is lost.
+void STEP_TIMER_IRQ_HANDLER(void) {
+	led_step();
+#ifdef LOCK_ENABLE
+	lock_step();
+#endif
+	button_step();
+}
+
+// Has to be called after led_init, lock_init and button_init. The CCU4 module itself
+// is already initialized by the PWM of the CP (evse_init).
+void step_timer_init(void) {
+	const XMC_CCU4_SLICE_COMPARE_CONFIG_t compare_config = {
+		.timer_mode          = XMC_CCU4_SLICE_TIMER_COUNT_MODE_EA,
+		.monoshot            = XMC_CCU4_SLICE_TIMER_REPEAT_MODE_REPEAT,
+		.shadow_xfer_clear   = false,
+		.dither_timer_period = false,
+		.dither_duty_cycle   = false,
+		.prescaler_mode      = XMC_CCU4_SLICE_PRESCALER_MODE_NORMAL,
+		.mcm_enable          = false,
+		.prescaler_initval   = XMC_CCU4_SLICE_PRESCALER_1,
+		.float_limit         = 0,
+		.dither_limit        = 0,
+		.passive_level       = XMC_CCU4_SLICE_OUTPUT_PASSIVE_LEVEL_LOW,
+		.timer_concatenation = false
+	};
+
+	XMC_CCU4_SLICE_CompareInit(STEP_TIMER_SLICE, &compare_config);
+	XMC_CCU4_SLICE_SetTimerPeriodMatch(STEP_TIMER_SLICE, STEP_TIMER_PERIOD-1);
+	XMC_CCU4_EnableShadowTransfer(STEP_TIMER_CCU, XMC_CCU4_SHADOW_TRANSFER_SLICE_0 << (STEP_TIMER_SLICE_NUMBER*4));
+
+	XMC_CCU4_SLICE_EnableEvent(STEP_TIMER_SLICE, XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH);
+	XMC_CCU4_SLICE_SetInterruptNode(STEP_TIMER_SLICE, XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH, STEP_TIMER_SERVICE_REQUEST);
+	NVIC_SetPriority(STEP_TIMER_IRQ, STEP_TIMER_IRQ_PRIORITY);
+	NVIC_EnableIRQ(STEP_TIMER_IRQ);
+
+	XMC_CCU4_EnableClock(STEP_TIMER_CCU, STEP_TIMER_SLICE_NUMBER);
+	XMC_CCU4_SLICE_StartTimer(STEP_TIMER_SLICE);
+}
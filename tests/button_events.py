@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# Prints the button events of the EVSE Bricklet (press, release, long press
+# and double press). The events are queued by the Bricklet, with the callback
+# they are sent as soon as they happen, otherwise they are read every second.
+
+HOST = "localhost"
+PORT = 4223
+UID = "XYZ"
+
+import sys
+import time
+
+from tinkerforge.ip_connection import IPConnection
+from tinkerforge.bricklet_evse import BrickletEVSE
+
+FUNCTION_GET_BUTTON_EVENTS = 51
+FUNCTION_SET_BUTTON_EVENT_CALLBACK_CONFIGURATION = 52
+FUNCTION_GET_BUTTON_EVENT_CALLBACK_CONFIGURATION = 53
+CALLBACK_BUTTON_EVENT = 54
+
+EVENTS = ['press', 'release', 'long press', 'double press']
+
+def get_events(ipcon, evse):
+    length, lost, types, times = ipcon.send_request(evse, FUNCTION_GET_BUTTON_EVENTS, (), '', 51, 'B H 8B 8I')
+    return [(EVENTS[types[i]], times[i]) for i in range(length)], lost
+
+def cb_button_event(event_type, event_time):
+    print('{0:>10} ms: {1}'.format(event_time, EVENTS[event_type]))
+
+if __name__ == "__main__":
+    use_callback = '--callback' in sys.argv
+
+    ipcon = IPConnection() # Create IP connection
+    evse = BrickletEVSE(UID, ipcon) # Create device object
+    evse.response_expected[FUNCTION_GET_BUTTON_EVENTS] = BrickletEVSE.RESPONSE_EXPECTED_ALWAYS_TRUE
+    evse.response_expected[FUNCTION_SET_BUTTON_EVENT_CALLBACK_CONFIGURATION] = BrickletEVSE.RESPONSE_EXPECTED_TRUE
+    evse.response_expected[FUNCTION_GET_BUTTON_EVENT_CALLBACK_CONFIGURATION] = BrickletEVSE.RESPONSE_EXPECTED_ALWAYS_TRUE
+    evse.callback_formats[CALLBACK_BUTTON_EVENT] = (13, 'B I')
+    evse.registered_callbacks[CALLBACK_BUTTON_EVENT] = cb_button_event
+
+    ipcon.connect(HOST, PORT) # Connect to brickd
+    # Don't use device before ipcon is connected
+
+    ipcon.send_request(evse, FUNCTION_SET_BUTTON_EVENT_CALLBACK_CONFIGURATION, (use_callback,), '!', 0, '')
+    print('Callback enabled: {0}'.format(ipcon.send_request(evse, FUNCTION_GET_BUTTON_EVENT_CALLBACK_CONFIGURATION, (), '', 9, '!')))
+
+    try:
+        while True:
+            if not use_callback:
+                events, lost = get_events(ipcon, evse)
+                if lost > 0:
+                    print('{0} events lost'.format(lost))
+                for name, event_time in events:
+                    print('{0:>10} ms: {1}'.format(event_time, name))
+            time.sleep(1)
+    except KeyboardInterrupt:
+        pass
+
+    ipcon.send_request(evse, FUNCTION_SET_BUTTON_EVENT_CALLBACK_CONFIGURATION, (False,), '!', 0, '')
+    ipcon.disconnect()
@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# Runs the automated CP/PE calibration of the EVSE Bricklet (start_calibration).
+# The EVSE sets the duty cycles and waits for stable measurements by itself,
+# this script only switches the resistors when the EVSE asks for them (calibration
+# state callback) and gives the CP/PE voltages measured by the operator.
+#
+# Usage: calibration.py [cp_voltage_high cp_voltage_low] (in mV, asked for when needed if not given)
+
+import sys
+import queue
+
+from evse_tester import EVSETester, TestTimeout
+
+FUNCTION_START_CALIBRATION = 38
+FUNCTION_SET_CALIBRATION_RESISTOR = 39
+FUNCTION_SET_CALIBRATION_LOW_VOLTAGE = 40
+FUNCTION_ABORT_CALIBRATION = 41
+FUNCTION_GET_CALIBRATION_STATE = 42
+CALLBACK_CALIBRATION_STATE = 43
+
+CALIBRATION_PASSWORD = 0x0BB03200
+
+PHASE_IDLE = 0
+PHASE_MEASURE = 1
+PHASE_WAIT_FOR_RESISTOR = 2
+PHASE_WAIT_FOR_LOW_VOLTAGE = 3
+PHASE_DONE = 4
+PHASE_ERROR = 5
+
+RESISTOR_NONE = 0
+RESISTOR_2700OHM = 1
+RESISTOR_880OHM = 2
+
+ERRORS = {0: 'none', 1: 'not settled', 2: 'noisy', 3: 'no resistor', 4: 'host timeout', 5: 'aborted'}
+
+CALIBRATION_TIMEOUT = 120.0
+
+def step_name(step):
+    if step == 1:
+        return '+12V'
+    if step == 2:
+        return '2700 Ohm'
+    if step <= 16:
+        return '880 Ohm {0}A'.format(6 + (step - 3)*2)
+    return '-12V'
+
+def calibrate(evse_tester, cp_voltage_high, cp_voltage_low):
+    evse = evse_tester.evse
+    ipcon = evse_tester.ipcon
+    for fid in [FUNCTION_START_CALIBRATION, FUNCTION_SET_CALIBRATION_RESISTOR, FUNCTION_SET_CALIBRATION_LOW_VOLTAGE,
+                FUNCTION_ABORT_CALIBRATION, FUNCTION_GET_CALIBRATION_STATE]:
+        evse.response_expected[fid] = evse.RESPONSE_EXPECTED_ALWAYS_TRUE
+
+    # The callback only queues the state, the requests (and the operator input)
+    # are done here and not in the callback thread of the IP connection
+    states = queue.Queue()
+    evse.callback_formats[CALLBACK_CALIBRATION_STATE] = (22, 'B B B B h h I H')
+    evse.registered_callbacks[CALLBACK_CALIBRATION_STATE] = lambda *args: states.put(args)
+
+    evse_tester.set_cp_pe_resistor(False, False, False)
+    ipcon.send_request(evse, FUNCTION_START_CALIBRATION, (CALIBRATION_PASSWORD, cp_voltage_high), 'I i', 8, '')
+
+    try:
+        while True:
+            try:
+                phase, step, resistor, error, value, high_voltage, variance, duration = states.get(timeout = CALIBRATION_TIMEOUT)
+            except queue.Empty:
+                ipcon.send_request(evse, FUNCTION_ABORT_CALIBRATION, (), '', 8, '')
+                raise TestTimeout('Timeout after {0}s: calibration'.format(CALIBRATION_TIMEOUT))
+
+            if phase == PHASE_MEASURE and step > 1:
+                # The result of a step is reported with the state change to the next step
+                evse_tester.log('{0}: {1} (high voltage {2}mV, variance {3}, {4}ms)'.format(step_name(step - 1), value, high_voltage, variance, duration))
+                evse_tester.step_times.append((step_name(step - 1), duration/1000))
+            elif phase == PHASE_WAIT_FOR_RESISTOR:
+                evse_tester.set_cp_pe_resistor(resistor >= RESISTOR_2700OHM, resistor == RESISTOR_880OHM, False)
+                ipcon.send_request(evse, FUNCTION_SET_CALIBRATION_RESISTOR, (resistor,), 'B', 8, '')
+            elif phase == PHASE_WAIT_FOR_LOW_VOLTAGE:
+                if cp_voltage_low == None:
+                    cp_voltage_low = int(input("CP/PE Spannung -12V eingeben (in mV): "))
+                ipcon.send_request(evse, FUNCTION_SET_CALIBRATION_LOW_VOLTAGE, (cp_voltage_low,), 'i', 8, '')
+            elif phase == PHASE_ERROR:
+                evse_tester.log('Calibration failed in step {0} ({1}): {2}'.format(step, step_name(step), ERRORS.get(error, error)))
+                return False
+            elif phase == PHASE_DONE:
+                evse_tester.log('Calibration done, offset {0}mV'.format(value))
+                return True
+    finally:
+        evse.registered_callbacks.pop(CALLBACK_CALIBRATION_STATE)
+        evse_tester.set_cp_pe_resistor(False, False, False)
+
+if __name__ == "__main__":
+    if len(sys.argv) == 3:
+        cp_voltage_high = int(sys.argv[1])
+        cp_voltage_low = int(sys.argv[2])
+    else:
+        cp_voltage_high = int(input("CP/PE Spannung +12V eingeben (in mV): "))
+        cp_voltage_low = None # asked for when the EVSE measures -12V
+
+    evse_tester = EVSETester()
+    ok = calibrate(evse_tester, cp_voltage_high, cp_voltage_low)
+    print(evse_tester.report())
+    evse_tester.disconnect()
+    sys.exit(0 if ok else 1)
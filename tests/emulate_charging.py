@@ -1,24 +1,29 @@
 #!/usr/bin/env python3
 # -*- coding: utf-8 -*-
 
-import time
+import sys
 
-from evse_tester import EVSETester
-
-if __name__ == "__main__":
-    evse_tester = EVSETester()
+from evse_tester import run_stations, IEC61851_STATE_B
 
+def emulate_charging(evse_tester):
     # Initial config
     evse_tester.set_contactor(True, False)
     evse_tester.set_diode(True)
     evse_tester.set_cp_pe_resistor(False, False, False)
     evse_tester.set_pp_pe_resistor(False, False, True, False)
-    evse_tester.evse.reset()
-    time.sleep(10)
 
-    evse_tester.set_cp_pe_resistor(True, False, False)
-    time.sleep(5)
-    evse_tester.set_cp_pe_resistor(True, True, False)
+    with evse_tester.step('Reset'):
+        evse_tester.reset_evse()
+
+    with evse_tester.step('Connect vehicle (state B)'):
+        evse_tester.set_cp_pe_resistor(True, False, False)
+        evse_tester.wait_for_iec61851_state(IEC61851_STATE_B)
 
-    evse_tester.wait_for_contactor_gpio(True)
-    evse_tester.set_contactor(True, True)
+    with evse_tester.step('Request charging'):
+        evse_tester.set_cp_pe_resistor(True, True, False)
+        evse_tester.wait_for_contactor_gpio(True)
+        evse_tester.set_contactor(True, True)
+
+if __name__ == "__main__":
+    # Optional: names of the stations to use (default all stations in evse_tester.STATIONS)
+    run_stations(emulate_charging, sys.argv[1:] if len(sys.argv) > 1 else None)
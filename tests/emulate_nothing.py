@@ -1,19 +1,22 @@
 #!/usr/bin/env python3
 # -*- coding: utf-8 -*-
 
-import time
+import sys
 
-from evse_tester import EVSETester
-
-if __name__ == "__main__":
-    evse_tester = EVSETester()
+from evse_tester import run_stations
 
+def emulate_nothing(evse_tester):
     # Initial config
     evse_tester.set_contactor(True, False)
     evse_tester.set_diode(True)
     evse_tester.set_cp_pe_resistor(False, False, False)
     evse_tester.set_pp_pe_resistor(False, False, True, False)
-    evse_tester.evse.reset()
-    time.sleep(10)
 
-    print("Done")
+    with evse_tester.step('Reset'):
+        evse_tester.reset_evse()
+
+    evse_tester.log("Done")
+
+if __name__ == "__main__":
+    # Optional: names of the stations to use (default all stations in evse_tester.STATIONS)
+    run_stations(emulate_nothing, sys.argv[1:] if len(sys.argv) > 1 else None)
@@ -4,15 +4,25 @@
 HOST     = "localhost"
 PORT     = 4223
 
-UID_EVSE = None
-UID_IDAI = "Mj8"
-UID_IDO4 = "QXz"
-UID_IDI4 = "QQ3"
-UID_IQR1 = "FYF"
-UID_IQR2 = "NWq"
-UID_ICOU = "Gh4"
-
-from tinkerforge.ip_connection import IPConnection
+# One entry per test station. Several stations can be driven
+# concurrently from one process (see run_stations). If the EVSE UID
+# is None, the EVSE Bricklet is found through enumerate (only
+# possible if there is exactly one EVSE behind the brickd of the station).
+STATIONS = {
+    'station1': {
+        'host': HOST,
+        'port': PORT,
+        'evse': None,
+        'idai': "Mj8",
+        'ido4': "QXz",
+        'idi4': "QQ3",
+        'iqr1': "FYF",
+        'iqr2': "NWq",
+        'icou': "Gh4",
+    },
+}
+
+from tinkerforge.ip_connection import IPConnection, Error
 from tinkerforge.bricklet_evse import BrickletEVSE
 
 from tinkerforge.bricklet_industrial_dual_analog_in_v2 import BrickletIndustrialDualAnalogInV2
@@ -22,63 +32,190 @@ from tinkerforge.bricklet_industrial_quad_relay_v2     import BrickletIndustrial
 from tinkerforge.bricklet_industrial_counter           import BrickletIndustrialCounter
 
 import time
+import threading
+import traceback
+from collections import namedtuple
+from contextlib import contextmanager
+
+FUNCTION_GET_ALL_DATA_1 = 20
+FUNCTION_GET_BOOT_INFO = 29
+
+IEC61851_STATE_A = 0
+IEC61851_STATE_B = 1
+IEC61851_STATE_C = 2
+
+GPIO_INPUT = 1 << 0
+GPIO_RELAY = 1 << 3
+
+POLL_INTERVAL = 0.005 # get_all_data_1 takes about 2ms over USB, don't flood the Bricklet
+DEFAULT_TIMEOUT = 10.0
+STARTUP_TIMEOUT = 20.0 # Cold start waits 12s for the DC-Wächter calibration
+
+AllData1 = namedtuple('AllData1', ['iec61851_state', 'charger_state', 'contactor_state', 'contactor_error', 'allowed_charging_current', 'error_state', 'lock_state',
+                                   'jumper_configuration', 'has_lock_switch', 'evse_version',
+                                   'led_state', 'cp_pwm_duty_cycle', 'adc_values', 'voltages', 'resistances', 'gpio', 'car_stopped_charging', 'time_since_state_change', 'uptime',
+                                   'indication', 'duration', 'button_press_time', 'button_release_time', 'button_pressed', 'boost_mode_enabled'])
+
+BootInfo = namedtuple('BootInfo', ['warm_start', 'init_start_time', 'config_loaded_time', 'jumper_detected_time', 'adc_version_found_time', 'boot_to_ready_time'])
 
-log = print 
+class TestTimeout(Exception):
+    pass
 
 class EVSETester:
-    def __init__(self, log_func = None):
-        if log_func:
-            global log
-            log = log_func
+    def __init__(self, log_func = None, station = 'station1', name = None):
+        config = STATIONS[station]
+
+        self.name = name if name != None else station
+        self.log = log_func if log_func != None else print
+        self.step_times = []
+        self.found_evse = threading.Event()
+        self.uid_evse = config['evse']
 
         self.ipcon = IPConnection()
-        self.ipcon.connect(HOST, PORT)
-        self.ipcon.register_callback(IPConnection.CALLBACK_ENUMERATE, self.cb_enumerate)
-        self.ipcon.enumerate()
-
-        log("Trying to find EVSE Bricklet...")
-        while UID_EVSE == None:
-            time.sleep(0.1)
-        log("Found EVSE Bricklet: {0}".format(UID_EVSE))
-
-        self.evse = BrickletEVSE(UID_EVSE, self.ipcon)
-    
-        self.idai = BrickletIndustrialDualAnalogInV2(UID_IDAI, self.ipcon)
-        self.ido4 = BrickletIndustrialDigitalOut4V2(UID_IDO4,  self.ipcon) 
-        self.idi4 = BrickletIndustrialDigitalIn4V2(UID_IDI4,   self.ipcon)
-        self.iqr1 = BrickletIndustrialQuadRelayV2(UID_IQR1,    self.ipcon)
-        self.iqr2 = BrickletIndustrialQuadRelayV2(UID_IQR2,    self.ipcon)
-        self.icou = BrickletIndustrialCounter(UID_ICOU,        self.ipcon)
+        self.ipcon.connect(config['host'], config['port'])
+
+        if self.uid_evse == None:
+            self.ipcon.register_callback(IPConnection.CALLBACK_ENUMERATE, self.cb_enumerate)
+            self.ipcon.enumerate()
+
+            self.log("Trying to find EVSE Bricklet...")
+            if not self.found_evse.wait(DEFAULT_TIMEOUT):
+                raise TestTimeout("No EVSE Bricklet found")
+            self.log("Found EVSE Bricklet: {0}".format(self.uid_evse))
+
+        self.evse = BrickletEVSE(self.uid_evse, self.ipcon)
+        self.evse.response_expected[FUNCTION_GET_ALL_DATA_1] = BrickletEVSE.RESPONSE_EXPECTED_ALWAYS_TRUE
+        self.evse.response_expected[FUNCTION_GET_BOOT_INFO] = BrickletEVSE.RESPONSE_EXPECTED_ALWAYS_TRUE
+
+        self.idai = BrickletIndustrialDualAnalogInV2(config['idai'], self.ipcon)
+        self.ido4 = BrickletIndustrialDigitalOut4V2(config['ido4'],  self.ipcon)
+        self.idi4 = BrickletIndustrialDigitalIn4V2(config['idi4'],   self.ipcon)
+        self.iqr1 = BrickletIndustrialQuadRelayV2(config['iqr1'],    self.ipcon)
+        self.iqr2 = BrickletIndustrialQuadRelayV2(config['iqr2'],    self.ipcon)
+        self.icou = BrickletIndustrialCounter(config['icou'],        self.ipcon)
 
     def cb_enumerate(self, uid, connected_uid, position, hardware_version, firmware_version, device_identifier, enumeration_type):
-        global UID_EVSE
-        if device_identifier == BrickletEVSE.DEVICE_IDENTIFIER:
-            UID_EVSE = uid
+        if device_identifier == BrickletEVSE.DEVICE_IDENTIFIER and not self.found_evse.is_set():
+            self.uid_evse = uid
+            self.found_evse.set()
+
+    def get_all_data_1(self):
+        return AllData1(*self.ipcon.send_request(self.evse, FUNCTION_GET_ALL_DATA_1, (), '', 64, 'B B B B H B B B ! B B H 2H 3h 2I B ! I I h H I I ! !'))
+
+    def get_boot_info(self):
+        return BootInfo(*self.ipcon.send_request(self.evse, FUNCTION_GET_BOOT_INFO, (), '', 29, '! I I I I I'))
+
+    # Measures the time of a test step, see report()
+    @contextmanager
+    def step(self, description):
+        self.log(description)
+        t = time.monotonic()
+        try:
+            yield
+        finally:
+            self.step_times.append((description, time.monotonic() - t))
+
+    def report(self):
+        total = sum(duration for _, duration in self.step_times)
+        lines = ['Step timing {0} ({1:.1f}s total):'.format(self.name, total)]
+        for description, duration in self.step_times:
+            lines.append('  {0:7.3f}s {1:5.1f}%  {2}'.format(duration, 100*duration/max(total, 0.001), description))
+        return '\n'.join(lines)
+
+    # Polls get_all_data_1 until condition(data) is true and returns the data
+    # that fulfilled the condition. Raises TestTimeout after timeout seconds
+    # (None = wait forever, only for steps that need the operator).
+    def wait_for(self, description, condition, timeout = DEFAULT_TIMEOUT):
+        t = time.monotonic()
+        while True:
+            try:
+                data = self.get_all_data_1()
+                if condition(data):
+                    return data
+            except Error as e:
+                # The Bricklet doesn't answer while it resets
+                if e.value != Error.TIMEOUT:
+                    raise
+
+            if timeout != None and time.monotonic() - t > timeout:
+                raise TestTimeout('Timeout after {0}s: {1}'.format(timeout, description))
+
+            time.sleep(POLL_INTERVAL)
+
+    # Waits until value(data) stays within +-tolerance for stable_time seconds
+    def wait_for_stable(self, description, value, tolerance, stable_time, timeout = DEFAULT_TIMEOUT):
+        window = []
+        def is_stable(data):
+            now = time.monotonic()
+            window.append((now, value(data)))
+            while now - window[0][0] > stable_time:
+                window.pop(0)
+
+            values = [v for _, v in window]
+            if max(values) - min(values) > 2*tolerance:
+                del window[:-1]
+                return False
+
+            return now - window[0][0] >= stable_time*0.9
+
+        return self.wait_for(description, is_stable, timeout)
+
+    # Waits for the EVSE to start up (again). If the uptime before a reset is
+    # given, the EVSE has to restart first (uptime going backwards or not ready).
+    def wait_for_startup(self, uptime_before_reset = None, timeout = STARTUP_TIMEOUT):
+        t = time.monotonic()
+        last_uptime = uptime_before_reset
+        restarted = uptime_before_reset == None
+        while True:
+            try:
+                boot_info = self.get_boot_info()
+                uptime = self.get_all_data_1().uptime
+                if boot_info.boot_to_ready_time == 0 or (last_uptime != None and uptime < last_uptime):
+                    restarted = True
+                last_uptime = uptime
+
+                if restarted and boot_info.boot_to_ready_time != 0:
+                    self.log("EVSE ready after {0}ms (warm start: {1})".format(boot_info.boot_to_ready_time, boot_info.warm_start))
+                    return boot_info
+            except Error as e:
+                # The Bricklet doesn't answer while it resets
+                if e.value != Error.TIMEOUT:
+                    raise
+
+            if time.monotonic() - t > timeout:
+                raise TestTimeout('Timeout after {0}s: EVSE startup'.format(timeout))
+
+            time.sleep(POLL_INTERVAL)
+
+    def reset_evse(self):
+        uptime = self.get_all_data_1().uptime
+        self.evse.reset()
+        return self.wait_for_startup(uptime)
 
     # Live = True
     def set_contactor(self, contactor_input, contactor_output):
         if contactor_input:
             self.ido4.set_pwm_configuration(0, 500, 5000)
-            log('AC0 live')
+            self.log('AC0 live')
         else:
             self.ido4.set_pwm_configuration(0, 500, 0)
-            log('AC0 off')
+            self.log('AC0 off')
 
         if contactor_output:
             self.ido4.set_pwm_configuration(1, 500, 5000)
-            log('AC1 live')
+            self.log('AC1 live')
         else:
             self.ido4.set_pwm_configuration(1, 500, 0)
-            log('AC1 off')
+            self.log('AC1 off')
 
     def set_diode(self, enable):
         value = list(self.iqr1.get_value())
         value[0] = enable
         self.iqr1.set_value(value)
         if enable:
-            log("Enable lock switch configuration diode")
+            self.log("Enable lock switch configuration diode")
         else:
-            log("Disable lock switch configuration diode")
+            self.log("Disable lock switch configuration diode")
 
     def get_cp_pe_voltage(self):
         return self.idai.get_voltage(1)
@@ -94,8 +231,8 @@ class EVSETester:
         if r2700: l.append("2700 Ohm")
         if r880:  l.append("880 Ohm")
         if r240:  l.append("240 Ohm")
-    
-        log("Set CP/PE resistor: " + ', '.join(l))
+
+        self.log("Set CP/PE resistor: " + ', '.join(l))
 
     def set_pp_pe_resistor(self, r1500, r680, r220, r100):
         value = [r1500, r680, r220, r100]
@@ -106,62 +243,119 @@ class EVSETester:
         if r680:  l.append("680 Ohm")
         if r220:  l.append("220 Ohm")
         if r100:  l.append("110 Ohm")
-    
-        log("Set PP/PE resistor: " + ', '.join(l)) 
 
-    def wait_for_contactor_gpio(self, active):
+        self.log("Set PP/PE resistor: " + ', '.join(l))
+
+    def wait_for_contactor_gpio(self, active, timeout = DEFAULT_TIMEOUT):
         if active:
-            log("Waiting for contactor GPIO to become active...")
+            self.log("Waiting for contactor GPIO to become active...")
         else:
-            log("Waiting for contactor GPIO to become inactive...")
-
-        while True:
-            state = self.evse.get_low_level_state()
-            if state.gpio[3] == active:
-                break
-            time.sleep(0.01)
+            self.log("Waiting for contactor GPIO to become inactive...")
 
-        log("Done")
+        data = self.wait_for('contactor GPIO {0}'.format(active), lambda d: bool(d.gpio & GPIO_RELAY) == active, timeout)
+        self.log("Done")
+        return data
 
-    def wait_for_button_gpio(self, active):
+    def wait_for_button_gpio(self, active, timeout = None):
         if active:
-            log("Waiting for button GPIO to become active...")
+            self.log("Waiting for button GPIO to become active...")
         else:
-            log("Waiting for button GPIO to become inactive...")
+            self.log("Waiting for button GPIO to become inactive...")
 
-        while True:
-            state = self.evse.get_low_level_state()
-            if state.gpio[0] == active:
-                break
-            time.sleep(0.1)
+        data = self.wait_for('button GPIO {0}'.format(active), lambda d: bool(d.gpio & GPIO_INPUT) == active, timeout)
+        self.log("Done")
+        return data
 
-        log("Done")
+    def wait_for_iec61851_state(self, state, timeout = DEFAULT_TIMEOUT):
+        return self.wait_for('IEC 61851 state {0}'.format('ABCDE'[state]), lambda d: d.iec61851_state == state, timeout)
 
-if __name__ == "__main__":
-    evse_tester = EVSETester()
+    # Stable CP/PE resistance (after a resistor or duty cycle change)
+    def wait_for_cp_pe_resistance(self, timeout = DEFAULT_TIMEOUT):
+        return self.wait_for_stable('stable CP/PE resistance', lambda d: d.resistances[0], 50, 0.3, timeout).resistances[0]
+
+    def wait_for_pp_pe_resistance(self, timeout = DEFAULT_TIMEOUT):
+        return self.wait_for_stable('stable PP/PE resistance', lambda d: d.resistances[1], 10, 0.3, timeout).resistances[1]
+
+    # The calibration uses the CP high voltage directly, the CP ADC runs with 32 SPS
+    # and the duty cycle changes without the usual measurement blanking.
+    def wait_for_cp_high_voltage(self, timeout = DEFAULT_TIMEOUT):
+        return self.wait_for_stable('stable CP high voltage', lambda d: d.voltages[2], 30, 1.0, timeout).voltages[2]
+
+    # Waits until ms have passed on the EVSE (independent of the USB/network latency)
+    def wait_for_uptime(self, ms, timeout = DEFAULT_TIMEOUT):
+        start = self.get_all_data_1().uptime
+        return self.wait_for('{0}ms uptime'.format(ms), lambda d: d.uptime - start >= ms, timeout)
+
+    def disconnect(self):
+        self.ipcon.disconnect()
+
+# Runs test(evse_tester) for all given stations concurrently, each in its own
+# thread with its own IP connection. Returns {station: (ok, evse_tester)}.
+def run_stations(test, stations = None):
+    if stations == None:
+        stations = list(STATIONS.keys())
 
+    results = {}
+    print_lock = threading.Lock()
+
+    def run(station):
+        def station_log(s):
+            with print_lock:
+                print('[{0}] {1}'.format(station, s))
+
+        evse_tester = None
+        ok = False
+        try:
+            evse_tester = EVSETester(log_func = station_log, station = station)
+            test(evse_tester)
+            ok = True
+        except Exception:
+            station_log('FAILED:\n' + traceback.format_exc())
+
+        if evse_tester != None:
+            station_log(evse_tester.report())
+            evse_tester.disconnect()
+
+        results[station] = (ok, evse_tester)
+
+    threads = [threading.Thread(target = run, args = (station,)) for station in stations]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+
+    return results
+
+def charge_cycles(evse_tester):
     # Initial config
     evse_tester.set_contactor(True, False)
     evse_tester.set_diode(True)
     evse_tester.set_cp_pe_resistor(False, False, False)
     evse_tester.set_pp_pe_resistor(False, False, True, False)
-    evse_tester.evse.reset()
-    time.sleep(5)
+    evse_tester.reset_evse()
 
     while True:
-        time.sleep(5)
-        evse_tester.set_cp_pe_resistor(True, False, False)
-        time.sleep(5)
-        evse_tester.set_cp_pe_resistor(True, True, False)
-
-        evse_tester.wait_for_contactor_gpio(True)
-        evse_tester.set_contactor(True, True)
-
-        time.sleep(10)
-        evse_tester.set_cp_pe_resistor(True, False, False)
-        evse_tester.wait_for_contactor_gpio(False)
-        evse_tester.set_contactor(True, False)
-
-        time.sleep(5)
-        evse_tester.set_cp_pe_resistor(False, False, False)
-        time.sleep(5)
+        with evse_tester.step('Connect vehicle (state B)'):
+            evse_tester.set_cp_pe_resistor(True, False, False)
+            evse_tester.wait_for_iec61851_state(IEC61851_STATE_B)
+
+        with evse_tester.step('Request charging (state C)'):
+            evse_tester.set_cp_pe_resistor(True, True, False)
+            evse_tester.wait_for_contactor_gpio(True)
+            evse_tester.set_contactor(True, True)
+            evse_tester.wait_for_iec61851_state(IEC61851_STATE_C)
+
+        with evse_tester.step('Stop charging'):
+            evse_tester.set_cp_pe_resistor(True, False, False)
+            evse_tester.wait_for_contactor_gpio(False)
+            evse_tester.set_contactor(True, False)
+
+        with evse_tester.step('Disconnect vehicle (state A)'):
+            evse_tester.set_cp_pe_resistor(False, False, False)
+            evse_tester.wait_for_iec61851_state(IEC61851_STATE_A)
+
+        evse_tester.log(evse_tester.report())
+        evse_tester.step_times = []
+
+if __name__ == "__main__":
+    run_stations(charge_cycles)
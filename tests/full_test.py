@@ -4,11 +4,20 @@
 import time
 import sys
 
-from evse_tester import EVSETester
+from evse_tester import EVSETester, IEC61851_STATE_A, IEC61851_STATE_C
+
+# Continuous calibration of the CP max voltage in state A: 500ms after the state change,
+# then moving average of 4 and a queue of 32 values at 16 CP samples/s (value at 2/3 is used)
+AUTOCALIBRATION_TIME = 3000
 
 def no_log(s):
     pass
 
+def fail(evse_tester):
+    print('-----------------> NICHT OK')
+    print(evse_tester.report())
+    sys.exit(1)
+
 if __name__ == "__main__":
     print('Schaltereinstellung auf 32A stellen')
     input("Enter drücken...")
@@ -28,11 +37,11 @@ if __name__ == "__main__":
     evse_tester.set_diode(True)
     evse_tester.set_cp_pe_resistor(False, False, False)
     evse_tester.set_pp_pe_resistor(False, False, True, False)
-    evse_tester.evse.reset()
 
-    print('Warte auf DC-Schutz Kalibrierung (15 Sekunden)')
+    print('Warte auf DC-Schutz Kalibrierung (ca. 12 Sekunden)')
     print('--> Flackert LED? Wenn nicht kaputt! <--')
-    time.sleep(15)
+    with evse_tester.step('Reset und DC-Schutz Kalibrierung'):
+        evse_tester.reset_evse()
     print('... OK')
 
 
@@ -40,16 +49,14 @@ if __name__ == "__main__":
     print('Teste Jumper-Einstellung')
     if hw_conf.jumper_configuration != 6:
         print('Falsche Jumper-Einstellung: {0}'.format(hw_conf.jumper_configuration))
-        print('-----------------> NICHT OK')
-        sys.exit(1)
+        fail(evse_tester)
     else:
         print('... OK')
 
     print('Teste Lock-Switch-Einstellung')
     if hw_conf.has_lock_switch:
         print('Falsche Lock-Switch-Einstellung: {0}'.format(hw_conf.has_lock_switch))
-        print('-----------------> NICHT OK')
-        sys.exit(1)
+        fail(evse_tester)
     else:
         print('... OK')
 
@@ -67,29 +74,31 @@ if __name__ == "__main__":
         print('Fehler während EVSE-Kalibrierung: {0}, {1}, {2}'.format(1, 0x0BB03201, voltage1))
         sys.exit(1)
 
-    print('Kalibriere mit 2700 Ohm (3,5 Sekunden)')
-    time.sleep(1)
-    evse_tester.set_cp_pe_resistor(True, False, False)
-    time.sleep(2.5)
-    ret = evse_tester.evse.calibrate(2, 0x0BB03202, 0)
+    print('Kalibriere mit 2700 Ohm')
+    with evse_tester.step('Kalibrierung 2700 Ohm'):
+        evse_tester.set_cp_pe_resistor(True, False, False)
+        evse_tester.wait_for_cp_high_voltage()
+        ret = evse_tester.evse.calibrate(2, 0x0BB03202, 0)
     if not ret:
         print('Fehler während EVSE-Kalibrierung: 2700ohm')
-        sys.exit(1)
+        fail(evse_tester)
 
     evse_tester.set_cp_pe_resistor(True, True, False)
 
     cal_state = 3
     for a in range(6, 33, 2):
-        print('Kalibriere mit 880 Ohm bei {0}A (3,5 Sekunden)'.format(a))
-        time.sleep(3.5)
-        ret = evse_tester.evse.calibrate(cal_state, 0x0BB03200 + cal_state, 0)
+        print('Kalibriere mit 880 Ohm bei {0}A'.format(a))
+        with evse_tester.step('Kalibrierung 880 Ohm {0}A'.format(a)):
+            evse_tester.wait_for_cp_high_voltage()
+            ret = evse_tester.evse.calibrate(cal_state, 0x0BB03200 + cal_state, 0)
         cal_state += 1
         if not ret:
             print('Fehler während EVSE-Kalibrierung: 880ohm {0}A'.format(a))
-            sys.exit(1)
+            fail(evse_tester)
 
     evse_tester.set_cp_pe_resistor(False, False, False)
-    time.sleep(1)
+    with evse_tester.step('CP/PE Spannung stabil'):
+        evse_tester.wait_for_stable('stable CP voltage', lambda d: d.voltages[0], 30, 0.5)
 
     voltage2 = int(input("CP/PE Spannung eingeben (in mV): "))
     data.append(str(voltage2))
@@ -114,54 +123,58 @@ if __name__ == "__main__":
     print('... OK')
 
     print('Warte auf Autokalibrierung')
-    time.sleep(15)
+    with evse_tester.step('Autokalibrierung'):
+        evse_tester.wait_for_iec61851_state(IEC61851_STATE_A)
+        evse_tester.wait_for_uptime(AUTOCALIBRATION_TIME)
     print('... OK')
-    print('Setze 2700 Ohm Widerstand (2 Sekunden)')
-    evse_tester.set_cp_pe_resistor(True, False, False)
-    time.sleep(2)
+    print('Setze 2700 Ohm Widerstand')
+    with evse_tester.step('CP/PE Widerstand 2700 Ohm'):
+        evse_tester.set_cp_pe_resistor(True, False, False)
+        resistance = evse_tester.wait_for_cp_pe_resistance()
     print('... OK')
 
     print('Test PP/CP Widerstand (ohne PWM)')
-    ll = evse_tester.evse.get_low_level_state()
-    data.append(str(ll.resistances[0]))
-    if 880*0.8 < ll.resistances[0] < 2700*1.20:
-        print('... OK ({0} Ohm)'.format(ll.resistances[0]))
+    data.append(str(resistance))
+    if 880*0.8 < resistance < 2700*1.20:
+        print('... OK ({0} Ohm)'.format(resistance))
     else:
-        print('-----------------> NICHT OK {0}'.format(ll.resistances[0]))
-        sys.exit(1)
+        print('NICHT OK {0}'.format(resistance))
+        fail(evse_tester)
 
     print('Setze 2700 Ohm + 1300 Ohm Widerstand')
     evse_tester.set_cp_pe_resistor(True, True, False)
     print('... OK')
 
-    evse_tester.wait_for_contactor_gpio(True)
-
-    print('Aktiviere Schütz (5 Sekunden)')
-    evse_tester.set_contactor(True, True)
+    with evse_tester.step('Warte auf Schütz'):
+        evse_tester.wait_for_contactor_gpio(True)
 
-    time.sleep(5)
+    print('Aktiviere Schütz')
+    with evse_tester.step('Schütz aktiv, PP/PE Widerstand stabil'):
+        evse_tester.set_contactor(True, True)
+        evse_tester.wait_for_iec61851_state(IEC61851_STATE_C)
+        resistance = evse_tester.wait_for_pp_pe_resistance()
     print('... OK')
 
     print('Prüfe PP/PE Widerstand')
-    ll = evse_tester.evse.get_low_level_state()
-    if 200 < ll.resistances[1] < 240:
-        data.append(str(ll.resistances[1]))
-        print('... OK ({0} Ohm)'.format(ll.resistances[1]))
+    if 200 < resistance < 240:
+        data.append(str(resistance))
+        print('... OK ({0} Ohm)'.format(resistance))
     else:
-        print('-----------------> NICHT OK {0}'.format(ll.resistances[1]))
+        print('-----------------> NICHT OK {0}'.format(resistance))
 
     for a in range(6, 33, 2):
         print('Test CP/PE {0}A'.format(a))
-        evse_tester.evse.set_max_charging_current(a*1000)
-        time.sleep(2)
-        ll = evse_tester.evse.get_low_level_state()
-        if 880*0.7 < ll.resistances[0] < 880*1.30:
-            data.append(str(ll.resistances[0]))
-            print('... OK ({0} Ohm)'.format(ll.resistances[0]))
+        with evse_tester.step('CP/PE Widerstand {0}A'.format(a)):
+            evse_tester.evse.set_max_charging_current(a*1000)
+            evse_tester.wait_for('allowed current {0}A'.format(a), lambda d: d.allowed_charging_current == a*1000)
+            resistance = evse_tester.wait_for_cp_pe_resistance()
+        if 880*0.7 < resistance < 880*1.30:
+            data.append(str(resistance))
+            print('... OK ({0} Ohm)'.format(resistance))
         else:
-            print('-----------------> NICHT OK {0}'.format(ll.resistances[0]))
-            sys.exit(1)
-    
+            print('NICHT OK {0}'.format(resistance))
+            fail(evse_tester)
+
     print('Ausschaltzeit messen')
     t1 = time.time()
     evse_tester.set_cp_pe_resistor(True, False, False)
@@ -177,26 +190,25 @@ if __name__ == "__main__":
         print('Ausschaltzeit: {0}ms OK'.format(delay))
     else:
         print('Ausschaltzeit: {0}ms'.format(delay))
-        print('-----------------> NICHT OK')
-        sys.exit(1)
+        fail(evse_tester)
 
     print('Schaltereinstellung auf "Disabled" stellen und dann Taster drücken')
     evse_tester.wait_for_button_gpio(True) # Button True = Pressed
     print('')
 
-    evse_tester.evse.reset()
-    time.sleep(2)
+    with evse_tester.step('Reset mit Jumper "Disabled"'):
+        evse_tester.reset_evse()
     hw_conf = evse_tester.evse.get_hardware_configuration()
     print('Teste Jumper-Einstellung')
     if hw_conf.jumper_configuration != 8:
         print('Falsche Jumper-Einstellung: {0}'.format(hw_conf.jumper_configuration))
-        print('-----------------> NICHT OK')
-        sys.exit(1)
+        fail(evse_tester)
     else:
         print('... OK')
 
     print('')
     print('Fertig. Alles OK')
+    print(evse_tester.report())
 
     with open('full_test_log.csv', 'a+') as f:
         f.write(', '.join(data) + '\n')
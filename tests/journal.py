@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# Reads the event journal of the EVSE Bricklet from flash (read_journal_low_level).
+# The journal survives resets, the sequence number is counted across reboots.
+
+HOST = "localhost"
+PORT = 4223
+UID = "XYZ"
+
+import struct
+
+from tinkerforge.ip_connection import IPConnection
+from tinkerforge.bricklet_evse import BrickletEVSE
+
+FUNCTION_READ_JOURNAL_LOW_LEVEL = 37
+
+RECORD_FORMAT = '<IIBBHI'
+RECORD_SIZE = struct.calcsize(RECORD_FORMAT)
+
+STATES = ['A', 'B', 'C', 'D', 'EF']
+EVENTS = {
+    1: lambda d16, d32: 'Boot ({0} start, firmware {1}.{2}.{3})'.format('warm' if d16 else 'cold', (d32 >> 16) & 0xFF, (d32 >> 8) & 0xFF, d32 & 0xFF),
+    2: lambda d16, d32: 'State change {0} -> {1}'.format(STATES[(d16 >> 8) % 5], STATES[(d16 & 0xFF) % 5]),
+    3: lambda d16, d32: 'Contactor error {0}'.format(d16),
+    4: lambda d16, d32: 'Error state (LED blink {0})'.format(d16),
+    5: lambda d16, d32: 'Communication watchdog reset',
+    6: lambda d16, d32: 'Factory reset',
+    7: lambda d16, d32: 'Calibration saved ({0})'.format('user' if d16 else 'factory'),
+    8: lambda d16, d32: 'Boost mode {0}'.format('enabled' if d16 else 'disabled'),
+    9: lambda d16, d32: 'Temperature derating {0} at {1:.2f}°C'.format(['off', 'derating', 'cutoff'][d16 % 3], ((d32 + 2**31) % 2**32 - 2**31)/100),
+}
+
+def read_records(ipcon, evse, cursor=0):
+    records = []
+    while True:
+        count, data = ipcon.send_request(evse, FUNCTION_READ_JOURNAL_LOW_LEVEL, (cursor,), 'I', 57, 'B 48B')
+        if count == 0:
+            return records
+
+        for i in range(count):
+            records.append(struct.unpack(RECORD_FORMAT, bytes(data[i*RECORD_SIZE:(i + 1)*RECORD_SIZE])))
+        cursor = records[-1][0]
+
+if __name__ == "__main__":
+    ipcon = IPConnection() # Create IP connection
+    evse = BrickletEVSE(UID, ipcon) # Create device object
+    evse.response_expected[FUNCTION_READ_JOURNAL_LOW_LEVEL] = BrickletEVSE.RESPONSE_EXPECTED_ALWAYS_TRUE
+
+    ipcon.connect(HOST, PORT) # Connect to brickd
+    # Don't use device before ipcon is connected
+
+    for sequence, time, event, checksum, data16, data32 in read_records(ipcon, evse):
+        text = EVENTS[event](data16, data32) if event in EVENTS else 'Unknown event {0}: {1} {2}'.format(event, data16, data32)
+        print('{0:6d} {1:10d} {2}'.format(sequence, time, text))
+
+    ipcon.disconnect()
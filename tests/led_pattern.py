@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# Uploads a custom LED pattern to the EVSE Bricklet and shows it with
+# set_indicator_led (custom patterns 0-3 are indication 3001-3004).
+# The patterns are only kept in RAM until the next reset.
+
+HOST = "localhost"
+PORT = 4223
+UID = "XYZ"
+
+import struct
+
+from tinkerforge.ip_connection import IPConnection
+from tinkerforge.bricklet_evse import BrickletEVSE
+
+FUNCTION_SET_INDICATOR_LED = 18
+FUNCTION_SET_INDICATOR_LED_PATTERN = 48
+FUNCTION_GET_INDICATOR_LED_PATTERN = 49
+FUNCTION_GET_INDICATOR_LED_LAYERS = 50
+
+KEYFRAME_SET = 0
+KEYFRAME_RAMP = 1
+KEYFRAME_LOOP_START = 2
+KEYFRAME_LOOP_END = 3
+
+PATTERN_LENGTH_MAX = 14
+LAYERS = ['fault', 'key switch', 'api', 'charging', 'standby', 'none']
+PATTERN_CUSTOM_INDICATION = 3001
+
+# (type, brightness index or loop passes, duration in ms)
+EXAMPLE = [
+    (KEYFRAME_LOOP_START, 0,   0),
+    (KEYFRAME_SET,        255, 100),
+    (KEYFRAME_SET,        0,   100),
+    (KEYFRAME_LOOP_END,   2,   0),
+    (KEYFRAME_RAMP,       255, 500),
+    (KEYFRAME_RAMP,       0,   500),
+    (KEYFRAME_SET,        0,   1000),
+]
+
+def encode(keyframes):
+    data = b''.join(struct.pack('<BBH', *keyframe) for keyframe in keyframes)
+    return list(data + bytes(PATTERN_LENGTH_MAX*4 - len(data)))
+
+def decode(length, data):
+    return [struct.unpack('<BBH', bytes(data[i*4:i*4 + 4])) for i in range(length)]
+
+def set_pattern(ipcon, evse, pattern, keyframes):
+    ipcon.send_request(evse, FUNCTION_SET_INDICATOR_LED_PATTERN, (pattern, len(keyframes), encode(keyframes)), 'B B 56B', 0, '')
+
+def get_pattern(ipcon, evse, pattern):
+    length, data = ipcon.send_request(evse, FUNCTION_GET_INDICATOR_LED_PATTERN, (pattern,), 'B', 65, 'B 56B')
+    return decode(length, data)
+
+# The LED shows the active layer with the highest priority, an indication
+# is kept while the error blinking or the key switch is visible
+def get_layers(ipcon, evse):
+    visible, active, led_state = ipcon.send_request(evse, FUNCTION_GET_INDICATOR_LED_LAYERS, (), '', 11, 'B B B')
+    return LAYERS[min(visible, 5)], [LAYERS[i] for i in range(5) if active & (1 << i)], led_state
+
+if __name__ == "__main__":
+    ipcon = IPConnection() # Create IP connection
+    evse = BrickletEVSE(UID, ipcon) # Create device object
+    evse.response_expected[FUNCTION_SET_INDICATOR_LED] = BrickletEVSE.RESPONSE_EXPECTED_ALWAYS_TRUE
+    evse.response_expected[FUNCTION_SET_INDICATOR_LED_PATTERN] = BrickletEVSE.RESPONSE_EXPECTED_ALWAYS_TRUE
+    evse.response_expected[FUNCTION_GET_INDICATOR_LED_PATTERN] = BrickletEVSE.RESPONSE_EXPECTED_ALWAYS_TRUE
+    evse.response_expected[FUNCTION_GET_INDICATOR_LED_LAYERS] = BrickletEVSE.RESPONSE_EXPECTED_ALWAYS_TRUE
+
+    ipcon.connect(HOST, PORT) # Connect to brickd
+    # Don't use device before ipcon is connected
+
+    set_pattern(ipcon, evse, 0, EXAMPLE)
+    print('Pattern 0: {0}'.format(get_pattern(ipcon, evse, 0)))
+
+    # Show the pattern for 10 seconds
+    print('Status: {0}'.format(ipcon.send_request(evse, FUNCTION_SET_INDICATOR_LED, (PATTERN_CUSTOM_INDICATION, 10000), 'h H', 9, 'B')))
+    print('Visible layer: {0}, active layers: {1}, LED state: {2}'.format(*get_layers(ipcon, evse)))
+
+    ipcon.disconnect()
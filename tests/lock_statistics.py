@@ -0,0 +1,43 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# Prints the learned travel times and the statistics of the lock motor of the
+# EVSE Bricklet. Only firmwares built with LOCK_ENABLE support this, others
+# answer with "function not supported".
+
+HOST = "localhost"
+PORT = 4223
+UID = "XYZ"
+
+import time
+
+from tinkerforge.ip_connection import IPConnection
+from tinkerforge.bricklet_evse import BrickletEVSE
+
+FUNCTION_GET_LOCK_STATISTICS = 55
+
+LOCK_STATES = ['init', 'open', 'closing', 'close', 'opening', 'error']
+DIRECTIONS = ['open', 'close']
+
+if __name__ == "__main__":
+    ipcon = IPConnection() # Create IP connection
+    evse = BrickletEVSE(UID, ipcon) # Create device object
+    evse.response_expected[FUNCTION_GET_LOCK_STATISTICS] = BrickletEVSE.RESPONSE_EXPECTED_ALWAYS_TRUE
+
+    ipcon.connect(HOST, PORT) # Connect to brickd
+    # Don't use device before ipcon is connected
+
+    try:
+        while True:
+            state, has_switch, learned, last, cycles, retries, stalls, timeouts, errors = \
+                ipcon.send_request(evse, FUNCTION_GET_LOCK_STATISTICS, (), '', 50, 'B ! 2H 2H 2I 2H 2H 2H 2H')
+
+            print('Lock {0}, switch {1}'.format(LOCK_STATES[state], 'yes' if has_switch else 'no'))
+            for i, direction in enumerate(DIRECTIONS):
+                print('  {0:>5}: learned {1:4} ms, last {2:4} ms, cycles {3}, retries {4}, stalls {5}, timeouts {6}, errors {7}'
+                      .format(direction, learned[i], last[i], cycles[i], retries[i], stalls[i], timeouts[i], errors[i]))
+            time.sleep(1)
+    except KeyboardInterrupt:
+        pass
+
+    ipcon.disconnect()
@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# Reads the binary log ring of the EVSE Bricklet (read_log_low_level)
+# and expands the records with the format strings from the firmware source.
+# A record only stores the file id and the line of the log call, so this
+# has to run on exactly the source of the firmware that runs on the Bricklet.
+# With any other source the records are expanded with the wrong format
+# strings (or not at all). A firmware version mismatch is reported, local
+# changes to the source can't be detected.
+
+HOST = "localhost"
+PORT = 4223
+UID = "XYZ"
+
+import os
+import re
+import sys
+import time
+import struct
+
+from tinkerforge.ip_connection import IPConnection
+from tinkerforge.bricklet_evse import BrickletEVSE
+
+FUNCTION_READ_LOG_LOW_LEVEL = 30
+
+SOURCE_PATH = os.path.join(os.path.dirname(os.path.realpath(__file__)), '..', 'software', 'src')
+LEVELS = ['D', 'I', 'W', 'E']
+
+def find_call_end(source, start):
+    depth = 0
+    in_string = False
+    i = start
+    while i < len(source):
+        c = source[i]
+        if in_string:
+            if c == '\\':
+                i += 1
+            elif c == '"':
+                in_string = False
+        elif c == '"':
+            in_string = True
+        elif c == '(':
+            depth += 1
+        elif c == ')':
+            depth -= 1
+            if depth == 0:
+                return i
+        i += 1
+    return len(source)
+
+# Returns {(file_id, line): format} for all log calls in the firmware source
+def load_formats(path):
+    with open(os.path.join(path, 'logring.h')) as f:
+        file_ids = {int(m.group(2)): m.group(1).lower() + '.c' for m in re.finditer(r'#define LOGRING_FILE_(\w+)\s+(\d+)', f.read())}
+
+    formats = {}
+    for file_id, name in file_ids.items():
+        try:
+            with open(os.path.join(path, name)) as f:
+                source = f.read()
+        except FileNotFoundError:
+            continue
+
+        for m in re.finditer(r'\blog[diwe]\s*\(\s*"((?:[^"\\]|\\.)*)"', source):
+            end = find_call_end(source, source.index('(', m.start()))
+            fmt = m.group(1).encode().decode('unicode_escape').rstrip('\r\n')
+            # Depending on the compiler __LINE__ of a multi-line call is the first or last line
+            for line in range(source.count('\n', 0, m.start()) + 1, source.count('\n', 0, end) + 2):
+                formats[(file_id, line)] = fmt
+
+    return formats
+
+def load_firmware_version(path):
+    with open(os.path.join(path, 'configs', 'config.h')) as f:
+        source = f.read()
+
+    return tuple(int(re.search(r'#define FIRMWARE_VERSION_{0}\s+(\d+)'.format(part), source).group(1)) for part in ['MAJOR', 'MINOR', 'REVISION'])
+
+def format_record(fmt, args):
+    values = []
+    for m in re.finditer(r'%[-+ #0]*\d*(?:\.\d+)?[hl]*([diuxXc%])', fmt):
+        if m.group(1) == '%':
+            continue
+        value = args.pop(0) if len(args) > 0 else 0
+        if m.group(1) in 'di':
+            value = struct.unpack('<i', struct.pack('<I', value))[0]
+        values.append(value)
+
+    fmt = re.sub(r'(%[-+ #0]*\d*(?:\.\d+)?)[hl]*([diuxXc%])', r'\1\2', fmt)
+    return fmt % tuple(values)
+
+def decode(data, formats):
+    records = []
+    while len(data) >= 7:
+        timestamp, record_id, level_argc = struct.unpack('<IHB', data[:7])
+        argc = level_argc & 0xF
+        args = list(struct.unpack('<{0}I'.format(argc), data[7:7 + argc*4]))
+        data = data[7 + argc*4:]
+
+        file_id, line = record_id >> 12, record_id & 0xFFF
+        fmt = formats.get((file_id, line))
+        if fmt == None:
+            text = 'unknown format (file {0}, line {1}): {2}'.format(file_id, line, args)
+        else:
+            text = format_record(fmt, args)
+
+        records.append('{0:10d} {1} {2}'.format(timestamp, LEVELS[(level_argc >> 4) & 3], text))
+
+    return records
+
+if __name__ == "__main__":
+    formats = load_formats(SOURCE_PATH)
+
+    ipcon = IPConnection() # Create IP connection
+    evse = BrickletEVSE(UID, ipcon) # Create device object
+    evse.response_expected[FUNCTION_READ_LOG_LOW_LEVEL] = BrickletEVSE.RESPONSE_EXPECTED_ALWAYS_TRUE
+
+    ipcon.connect(HOST, PORT) # Connect to brickd
+    # Don't use device before ipcon is connected
+
+    firmware_version = tuple(evse.get_identity().firmware_version)
+    source_version = load_firmware_version(SOURCE_PATH)
+    if firmware_version != source_version:
+        print('Warning: Bricklet runs firmware {0}, source in {1} is {2}, log records will be expanded wrongly'.format(
+              '.'.join(map(str, firmware_version)), SOURCE_PATH, '.'.join(map(str, source_version))), file=sys.stderr)
+
+    last_dropped = 0
+    while True:
+        dropped, length, data = ipcon.send_request(evse, FUNCTION_READ_LOG_LOW_LEVEL, (), '', 71, 'H B 60B')
+        if dropped != last_dropped:
+            print('{0} records dropped'.format(dropped - last_dropped))
+            last_dropped = dropped
+
+        for record in decode(bytes(data[:length]), formats):
+            print(record)
+
+        if length == 0:
+            time.sleep(0.1)
+
+    ipcon.disconnect()
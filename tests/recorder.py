@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# Reads the flight recorder of the EVSE Bricklet and writes the
+# entries (all inputs of iec61851_tick) to recorder.csv. The CSV can be
+# replayed on the host with software/host/evse_replay.
+
+HOST = "localhost"
+PORT = 4223
+UID = "XYZ"
+
+import csv
+import struct
+from collections import namedtuple
+
+from tinkerforge.ip_connection import IPConnection
+from tinkerforge.bricklet_evse import BrickletEVSE
+
+FUNCTION_TRIGGER_RECORDER = 33
+FUNCTION_GET_RECORDER_STATE = 35
+FUNCTION_READ_RECORDER_LOW_LEVEL = 36
+
+ENTRY_FORMAT = '<IHHHHBBBB'
+ENTRY_SIZE = struct.calcsize(ENTRY_FORMAT)
+
+FLAG_RELAY = 1 << 0
+FLAG_CP_INVALID = 1 << 1
+FLAG_BUTTON_PRESSED = 1 << 2
+FLAG_BUTTON_WAS_PRESSED = 1 << 3
+FLAG_CAR_STOPPED = 1 << 4
+FLAG_CALIBRATION = 1 << 5
+
+RecorderEntry = namedtuple('RecorderEntry', ['time', 'cp_pe_resistance', 'pp_pe_resistance', 'cp_duty_cycle', 'max_current',
+                                             'relay', 'cp_invalid', 'button_pressed', 'button_was_pressed', 'car_stopped', 'calibration',
+                                             'contactor_state', 'contactor_error', 'jumper_configuration', 'iec61851_state'])
+
+def decode(data):
+    entries = []
+    for i in range(0, len(data) - ENTRY_SIZE + 1, ENTRY_SIZE):
+        time, cp, pp, duty, max_current, flags, contactor, jumper, state = struct.unpack(ENTRY_FORMAT, data[i:i + ENTRY_SIZE])
+        entries.append(RecorderEntry(time, cp, pp, duty, max_current,
+                                     bool(flags & FLAG_RELAY), bool(flags & FLAG_CP_INVALID), bool(flags & FLAG_BUTTON_PRESSED),
+                                     bool(flags & FLAG_BUTTON_WAS_PRESSED), bool(flags & FLAG_CAR_STOPPED), bool(flags & FLAG_CALIBRATION),
+                                     contactor & 0x3, contactor >> 2, jumper, state))
+    return entries
+
+def read_entries(ipcon, evse):
+    data = []
+    total = None
+    while total == None or len(data) < total:
+        total, offset, chunk = ipcon.send_request(evse, FUNCTION_READ_RECORDER_LOW_LEVEL, (len(data),), 'H', 72, 'H H 60B')
+        data += chunk[:total - offset]
+        if total == 0:
+            break
+    return decode(bytes(data))
+
+if __name__ == "__main__":
+    ipcon = IPConnection() # Create IP connection
+    evse = BrickletEVSE(UID, ipcon) # Create device object
+    evse.response_expected[FUNCTION_GET_RECORDER_STATE] = BrickletEVSE.RESPONSE_EXPECTED_ALWAYS_TRUE
+    evse.response_expected[FUNCTION_READ_RECORDER_LOW_LEVEL] = BrickletEVSE.RESPONSE_EXPECTED_ALWAYS_TRUE
+
+    ipcon.connect(HOST, PORT) # Connect to brickd
+    # Don't use device before ipcon is connected
+
+    frozen, trigger, trigger_time, count, uptime = ipcon.send_request(evse, FUNCTION_GET_RECORDER_STATE, (), '', 20, '! B I H I')
+    if not frozen:
+        print('Recorder is not frozen, entries may change while reading (use trigger_recorder to freeze it)')
+    print('Trigger {0:#04x} at {1} ms, {2} entries, uptime {3} ms'.format(trigger, trigger_time, count, uptime))
+
+    with open('recorder.csv', 'w') as f:
+        writer = csv.writer(f)
+        writer.writerow(RecorderEntry._fields)
+        for entry in read_entries(ipcon, evse):
+            writer.writerow(entry)
+
+    ipcon.disconnect()
@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# Shows the temperature of the EVSE Bricklet (ADS1118 on the PCB), the state of
+# the thermal derating and the temperature history of the last hour. With
+# arguments the derating is configured first (saved in the EVSE config).
+#
+# Usage: temperature.py [mode start_temperature end_temperature step_current]
+# mode: 0 = off, 1 = linear, 2 = step, temperatures in °C, step current in mA
+
+HOST = "localhost"
+PORT = 4223
+UID = "XYZ"
+
+import sys
+
+from tinkerforge.ip_connection import IPConnection
+from tinkerforge.bricklet_evse import BrickletEVSE
+
+FUNCTION_SET_TEMPERATURE_DERATING = 44
+FUNCTION_GET_TEMPERATURE_DERATING = 45
+FUNCTION_GET_TEMPERATURE_STATE = 46
+FUNCTION_READ_TEMPERATURE_HISTORY_LOW_LEVEL = 47
+
+MODES = ['off', 'linear', 'step']
+STATES = ['none', 'derating', 'cutoff']
+
+def read_history(ipcon, evse):
+    data = []
+    total = None
+    while total == None or len(data) < total:
+        total, offset, chunk = ipcon.send_request(evse, FUNCTION_READ_TEMPERATURE_HISTORY_LOW_LEVEL, (len(data),), 'H', 72, 'H H 60B')
+        data += chunk[:total - offset]
+        if total == 0:
+            break
+
+    # (temperature in °C, max current in mA) per minute, oldest first
+    return [((data[i] + 128) % 256 - 128, data[i + 1]*500) for i in range(0, len(data) - 1, 2)]
+
+if __name__ == "__main__":
+    ipcon = IPConnection() # Create IP connection
+    evse = BrickletEVSE(UID, ipcon) # Create device object
+    for fid in [FUNCTION_SET_TEMPERATURE_DERATING, FUNCTION_GET_TEMPERATURE_DERATING, FUNCTION_GET_TEMPERATURE_STATE, FUNCTION_READ_TEMPERATURE_HISTORY_LOW_LEVEL]:
+        evse.response_expected[fid] = BrickletEVSE.RESPONSE_EXPECTED_ALWAYS_TRUE
+
+    ipcon.connect(HOST, PORT) # Connect to brickd
+    # Don't use device before ipcon is connected
+
+    if len(sys.argv) == 5:
+        mode, start, end, step_current = int(sys.argv[1]), float(sys.argv[2]), float(sys.argv[3]), int(sys.argv[4])
+        ipcon.send_request(evse, FUNCTION_SET_TEMPERATURE_DERATING, (mode, int(start*100), int(end*100), step_current), 'B h h H', 8, '')
+
+    mode, start, end, step_current = ipcon.send_request(evse, FUNCTION_GET_TEMPERATURE_DERATING, (), '', 15, 'B h h H')
+    print('Derating {0}: start {1:.2f}°C, end {2:.2f}°C, step current {3}mA'.format(MODES[mode % 3], start/100, end/100, step_current))
+
+    temperature, temperature_max, state, max_current = ipcon.send_request(evse, FUNCTION_GET_TEMPERATURE_STATE, (), '', 15, 'h h B H')
+    print('Temperature {0:.2f}°C (max {1:.2f}°C), derating {2}, max current {3}mA'.format(temperature/100, temperature_max/100, STATES[state % 3], max_current))
+
+    history = read_history(ipcon, evse)
+    print('History ({0} minutes, oldest first):'.format(len(history)))
+    for i, (temperature, max_current) in enumerate(history):
+        print('  -{0:2d}min {1:4d}°C {2:6d}mA'.format(len(history) - i, temperature, max_current))
+
+    ipcon.disconnect()